@@ -68,6 +68,9 @@ struct Light_s {
 	uint							vertex_buffer_offset;
 	
 	uint							type;
+	
+	uint							alias_table_offset;
+	uint							alias_table_pad[3];
 };
 
 layout(binding = CONV_LIGHT_BUFFER_BINDING, set = CONV_LIGHT_BUFFER_SET) buffer light_storage_buffer { Light_s light_buffer[]; };
@@ -236,7 +239,121 @@ float evalIesLightCubic(const uint idx, vec3 dir){
 bool isTriangleMeshLight(const uint idx){
 	return light_buffer[idx].type == LIGHT_TYPE_TRIANGLE_MESH;
 }
+
+#if defined(CONV_LIGHT_ALIAS_TABLE_BINDING) && defined(CONV_LIGHT_ALIAS_TABLE_SET)
+struct AliasTableEntry_s {
+	float							probability;
+	uint							alias;
+	float							pdf;
+};
+layout(binding = CONV_LIGHT_ALIAS_TABLE_BINDING, set = CONV_LIGHT_ALIAS_TABLE_SET) readonly buffer light_alias_table_buffer { AliasTableEntry_s light_alias_table[]; };
+
+
+uint sampleTriangleMeshLight(const uint idx, const float rand, out float pdf){
+	const uint count = light_buffer[idx].triangle_count;
+	const uint offset = light_buffer[idx].alias_table_offset;
+	if( offset == uint(-1) ){
+		pdf = 1.0 / float(count);
+		return min(uint(rand * float(count)), count - 1);
+	}
+	const float u = rand * float(count);
+	const uint i = min(uint(u), count - 1);
+	const AliasTableEntry_s entry = light_alias_table[offset + i];
+	const uint tri = (u - float(i)) < entry.probability ? i : entry.alias;
+	pdf = light_alias_table[offset + tri].pdf;
+	return tri;
+}
+#endif
 #endif 
 
+#if defined(CONV_LIGHT_TREE_BINDING) && defined(CONV_LIGHT_TREE_SET)
+// same layout as LightTreeNode_s, the tree nodes are followed by one leaf per infinite light (see light_tree.hpp)
+struct LightTreeNode_s {
+	vec3							min;
+	float							power;
+	vec3							max;
+	float							cos_theta_o;
+	vec3							axis;
+	float							cos_theta_e;
+	uint							second_child;
+	uint							light_index;
+	uint							is_leaf;
+	uint							pad;
+};
+layout(binding = CONV_LIGHT_TREE_BINDING, set = CONV_LIGHT_TREE_SET) readonly buffer light_tree_buffer { LightTreeNode_s light_tree[]; };
+
+// cos(max(0, a - b)) and sin(max(0, a - b))
+float lightTreeCosSubClamped(const float sin_a, const float cos_a, const float sin_b, const float cos_b){
+	return cos_a > cos_b ? 1.0f : cos_a * cos_b + sin_a * sin_b;
+}
+float lightTreeSinSubClamped(const float sin_a, const float cos_a, const float sin_b, const float cos_b){
+	return cos_a > cos_b ? 0.0f : sin_a * cos_b - cos_a * sin_b;
+}
+
+float lightTreeImportance(const uint node, const vec3 p, const vec3 n){
+	const LightTreeNode_s ln = light_tree[node];
+	const vec3 center = (ln.min + ln.max) * 0.5f;
+	const vec3 d = p - center;
+	const float distance2 = dot(d, d);
+	const float radius2 = dot(ln.max - center, ln.max - center);
+	const float d2 = max(distance2, max(length(ln.max - ln.min) * 0.5f, 1e-8f));
+
+	const vec3 wi = distance2 > 0.0f ? d / sqrt(distance2) : vec3(0);
+	const float cos_theta_w = dot(ln.axis, wi);
+	const float sin_theta_w = sqrt(max(1.0f - cos_theta_w * cos_theta_w, 0.0f));
+	const float cos_theta_b = distance2 < radius2 ? -1.0f : sqrt(max(1.0f - radius2 / distance2, 0.0f));
+	const float sin_theta_b = sqrt(max(1.0f - cos_theta_b * cos_theta_b, 0.0f));
+	const float sin_theta_o = sqrt(max(1.0f - ln.cos_theta_o * ln.cos_theta_o, 0.0f));
+
+	const float cos_theta_x = lightTreeCosSubClamped(sin_theta_w, cos_theta_w, sin_theta_o, ln.cos_theta_o);
+	const float sin_theta_x = lightTreeSinSubClamped(sin_theta_w, cos_theta_w, sin_theta_o, ln.cos_theta_o);
+	const float cos_theta_p = lightTreeCosSubClamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+	if(cos_theta_p <= ln.cos_theta_e) return 0.0f;
+
+	float importance = ln.power * cos_theta_p / d2;
+	if(n != vec3(0)){
+		const float cos_theta_i = abs(dot(wi, n));
+		const float sin_theta_i = sqrt(max(1.0f - cos_theta_i * cos_theta_i, 0.0f));
+		importance *= lightTreeCosSubClamped(sin_theta_i, cos_theta_i, sin_theta_b, cos_theta_b);
+	}
+	return max(importance, 0.0f);
+}
+
+// picks a light for the shading point p with normal n (zero to ignore it), returns -1 if no light can contribute
+int sampleLightTree(const uint tree_node_count, const uint infinite_count, const vec3 p, const vec3 n, float u, out float pdf){
+	pdf = 0.0f;
+	const float p_infinite = infinite_count == 0 ? 0.0f : (tree_node_count == 0 ? 1.0f : float(infinite_count) / float(infinite_count + 1));
+	if(u < p_infinite){
+		const uint i = min(uint(u / p_infinite * float(infinite_count)), infinite_count - 1);
+		pdf = p_infinite / float(infinite_count);
+		return int(light_tree[tree_node_count + i].light_index);
+	}
+	if(tree_node_count == 0) return -1;
+
+	const float one_minus_epsilon = 0.99999994f;
+	u = min((u - p_infinite) / (1.0f - p_infinite), one_minus_epsilon);
+	float tree_pdf = 1.0f - p_infinite;
+	uint node = 0;
+	while(light_tree[node].is_leaf == 0){
+		const float i0 = lightTreeImportance(node + 1, p, n);
+		const float i1 = lightTreeImportance(light_tree[node].second_child, p, n);
+		if(i0 <= 0.0f && i1 <= 0.0f) return -1;
+		const float p0 = i0 / (i0 + i1);
+		if(u < p0){
+			node = node + 1;
+			tree_pdf *= p0;
+			u = min(u / p0, one_minus_epsilon);
+		} else {
+			node = light_tree[node].second_child;
+			tree_pdf *= 1.0f - p0;
+			u = min((u - p0) / (1.0f - p0), one_minus_epsilon);
+		}
+	}
+	if(lightTreeImportance(node, p, n) <= 0.0f) return -1;
+	pdf = tree_pdf;
+	return int(light_tree[node].light_index);
+}
+#endif
+
 #endif 
 #endif 
\ No newline at end of file
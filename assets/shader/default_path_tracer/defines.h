@@ -15,6 +15,7 @@
 #define GLOBAL_DESC_AS_BINDING                  5
 
 #define GLSL_GLOBAL_LIGHT_DATA_BINDING          6
+#define GLSL_GLOBAL_LIGHT_TREE_BINDING          7
 #define GLSL_GLOBAL_RT_OUT_IMAGE_BINDING        8
 #define GLSL_GLOBAL_RT_ACC_IMAGE_BINDING        9
 #define GLSL_GLOBAL_RT_ACC_C_IMAGE_BINDING      10
@@ -60,6 +61,8 @@ STRUCT (
     FLOAT   (sr_tmin)
     FLOAT   (sr_tmax_offset)
     UINT    (light_count)
+    UINT    (light_tree_node_count)
+    UINT    (light_tree_infinite_count)
     UINT    (sampling_strategy)
 
     VEC2    (pixel_filter_extra)
@@ -44,6 +44,9 @@
 #define ADJOINT_DESC_LIGHT_DERIVATIVES_BUFFER_BINDING 9
 #define ADJOINT_DESC_LIGHT_TEXTURE_DERIVATIVES_BUFFER_BINDING 10
 #define ADJOINT_DESC_TRIANGLE_BUFFER_BINDING 11
+#define ADJOINT_DESC_LIGHT_RAY_OFFSETS_BUFFER_BINDING 12
+#define ADJOINT_DESC_LIGHT_ALIAS_TABLE_BUFFER_BINDING 13
+#define ADJOINT_DESC_RADIANCE_FIXED_BUFFER_BINDING 14
 
 
 #define OBJ_DESC_RADIANCE_BUFFER_BINDING 0
@@ -53,6 +56,7 @@
 #define OBJ_DESC_CHANNEL_WEIGHTS_BUFFER_BINDING 4
 #define OBJ_DESC_PHI_BUFFER_BINDING 5
 #define OBJ_DESC_VERTEX_COLOR_BUFFER_BINDING 6
+#define OBJ_DESC_RADIANCE_FIXED_BUFFER_BINDING 7
 
 
 #define RASTERIZER_DESC_SET 1
@@ -83,6 +87,16 @@
 
 #define OBJ_FUNC_WORKGROUP_SIZE 32
 
+// deterministic accumulation: int64 fixed point, LightGrads seen as LIGHT_GRADS_FIXED_ENTRIES int64 values
+#define LIGHT_GRADS_FIXED_ENTRIES 20
+#define LIGHT_GRADS_FIXED_COLOR 0
+#define LIGHT_GRADS_FIXED_P 4
+#define LIGHT_GRADS_FIXED_N 8
+#define LIGHT_GRADS_FIXED_T 12
+#define LIGHT_GRADS_FIXED_INTENSITY 16
+#define LIGHT_GRADS_FIXED_IANGLE 17
+#define LIGHT_GRADS_FIXED_OANGLE 18
+
 #if !defined(HLSL) || !defined(GLSL)
 #define IALT_SHADER_DIR "assets/shader/ialt/"
 #endif
@@ -198,6 +212,9 @@ STRUCT (
     UINT (triangle_count)
     UINT (tri_rays)
     UINT (sam_rays)
+    UINT (ray_count)
+    UINT (deterministic)
+    FLOAT (fixed_point_scale)
 ,AdjointInfo_s)
 
 
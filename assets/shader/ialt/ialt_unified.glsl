@@ -32,21 +32,33 @@ layout(constant_id = 2) const uint USE_UNPHYSICAL_NICE_PREVIEW = 0;
 
 #define CONV_LIGHT_BUFFER_BINDING ADJOINT_DESC_LIGHT_BUFFER_BINDING
 #define CONV_LIGHT_BUFFER_SET ADJOINT_DESC_SET
+#define CONV_LIGHT_ALIAS_TABLE_BINDING ADJOINT_DESC_LIGHT_ALIAS_TABLE_BUFFER_BINDING
+#define CONV_LIGHT_ALIAS_TABLE_SET ADJOINT_DESC_SET
 #include "../convenience/glsl/light_data.glsl"
 
 layout(binding = ADJOINT_DESC_INFO_BUFFER_BINDING, set = ADJOINT_DESC_SET) readonly restrict buffer info_storage_buffer { AdjointInfo_s info; };
 layout(binding = ADJOINT_DESC_AREA_BUFFER_BINDING, set = ADJOINT_DESC_SET) readonly restrict buffer vertex_area_buffer { float vtxArea[]; };
+layout(binding = ADJOINT_DESC_LIGHT_RAY_OFFSETS_BUFFER_BINDING, set = ADJOINT_DESC_SET) readonly restrict buffer light_ray_offsets_buffer { uint light_ray_offsets[]; };
 
 #if EXEC_MODE == 0 
 layout(binding = ADJOINT_DESC_RADIANCE_BUFFER_BINDING, set = ADJOINT_DESC_SET) buffer radiance_storage_buffer { float radiance[]; };
+layout(binding = ADJOINT_DESC_RADIANCE_FIXED_BUFFER_BINDING, set = ADJOINT_DESC_SET) restrict buffer radiance_fixed_storage_buffer { int64_t radiance_fixed[]; };
 #define SH_DATA_BUFFER_ radiance
 #elif EXEC_MODE == 1 || EXEC_MODE == 2 
 layout(binding = ADJOINT_DESC_RADIANCE_BUFFER_BINDING, set = ADJOINT_DESC_SET) readonly restrict buffer radiance_storage_buffer { float objFcnPartial[]; };
-layout(binding = ADJOINT_DESC_LIGHT_DERIVATIVES_BUFFER_BINDING, set = ADJOINT_DESC_SET) writeonly restrict buffer light_derivatives_buffer { LightGrads light_derivatives[]; };
-layout(binding = ADJOINT_DESC_LIGHT_TEXTURE_DERIVATIVES_BUFFER_BINDING, set = ADJOINT_DESC_SET) writeonly restrict buffer light_texture_derivatives_buffer { double light_texture_derivatives[]; };
+layout(binding = ADJOINT_DESC_LIGHT_DERIVATIVES_BUFFER_BINDING, set = ADJOINT_DESC_SET) writeonly buffer light_derivatives_buffer { LightGrads light_derivatives[]; };
+layout(binding = ADJOINT_DESC_LIGHT_TEXTURE_DERIVATIVES_BUFFER_BINDING, set = ADJOINT_DESC_SET) writeonly buffer light_texture_derivatives_buffer { double light_texture_derivatives[]; };
+// the same buffers as int64 fixed point for deterministic accumulation
+layout(binding = ADJOINT_DESC_LIGHT_DERIVATIVES_BUFFER_BINDING, set = ADJOINT_DESC_SET) buffer light_derivatives_fixed_buffer { int64_t light_derivatives_fixed[]; };
+layout(binding = ADJOINT_DESC_LIGHT_TEXTURE_DERIVATIVES_BUFFER_BINDING, set = ADJOINT_DESC_SET) buffer light_texture_derivatives_fixed_buffer { int64_t light_texture_derivatives_fixed[]; };
 #define SH_DATA_BUFFER_ objFcnPartial
 #endif
 
+// integer additions are associative, summing fixed point values gives the same bits regardless of the order of the threads
+int64_t toFixedPoint(const double aValue){
+    return int64_t(round(aValue * double(info.fixed_point_scale)));
+}
+
 layout(location = 0) rayPayloadEXT AdjointPayload ap;
 
 #include "../sphericalharmonics/sphericalharmonics.glsl"
@@ -149,6 +161,7 @@ vec3 evaluateBRDF(const in vec3 wi, const in vec3 wo, const in HitDataStruct hd)
 
 
 int tri_idx;
+float tri_pdf;
 vec3 bary;
 void generateLightRay(inout vec3 rayOrigin, inout vec3 rayDirection, inout vec3 radiantFlux, const in uint nRays, const in uint light_idx){
     const Light_s light = light_buffer[light_idx];
@@ -238,7 +251,7 @@ void generateLightRay(inout vec3 rayOrigin, inout vec3 rayDirection, inout vec3
 		
 		
         
-		tri_idx = sampleRangeUniform(1, int(light.triangle_count), tea_nextFloat(seed)) - 1;
+		tri_idx = int(sampleTriangleMeshLight(light_idx, tea_nextFloat(seed), tri_pdf));
 		bary = sampleUnitTriangleUniform(tea_nextFloat2(seed));
 		
 		uint idx_0 = 0;
@@ -320,7 +333,7 @@ void generateLightRay(inout vec3 rayOrigin, inout vec3 rayDirection, inout vec3
         
 
         const float cosTheta = dot(rayDirection, n_ws_norm);
-        const float fluxFactor = M_2PI * area * light.intensity * float(light.triangle_count) / float(nRays); 
+        const float fluxFactor = M_2PI * area * light.intensity / (tri_pdf * float(nRays)); 
         radiantFlux = color * fluxFactor * cosTheta; 
 	}
 }
@@ -792,7 +805,7 @@ void computeParametricDerivatives(inout ParamDerivsDataStruct dFluxdp, inout mat
         rayColor = light.color * texColor; 
 
         const float cosTheta = dot(rayDirection, n_ws_norm);
-        const float fluxFactor = M_2PI * area * light.intensity * float(light.triangle_count) / float(nRays); 
+        const float fluxFactor = M_2PI * area * light.intensity / (tri_pdf * float(nRays)); 
         
         dFluxdp.intensity = fluxFactor * cosTheta / light.intensity; 
         dFluxdp.color = texColor * fluxFactor * cosTheta; 
@@ -835,24 +848,49 @@ void computeBrdfDerivative(inout vec3 dBrdfdWiR, inout vec3 dBrdfdWiG, inout vec
 
 void addToLightDerivatives(const in vec3 dOdFlux, const in ParamDerivsDataStruct dFluxdp, const in vec3 dOdp_brdf, const in vec3 rayColor, const in int textureIdx, const in uint light_idx){
     const dvec3 dOdP = dot(rayColor, dOdFlux) * dFluxdp.position +  dOdp_brdf;
-    const dvec3 dOdP_sum = subgroupAdd(dOdP);
-
     const dvec3 dOdN = dot(rayColor, dOdFlux) * dFluxdp.normal;
-    const dvec3 dOdN_sum = subgroupAdd(dOdN);
-
     const dvec3 dOdT = dot(rayColor, dOdFlux) * dFluxdp.tangent;
-    const dvec3 dOdT_sum = subgroupAdd(dOdT);
-
     const double dOdI = dot(rayColor, dOdFlux) * dFluxdp.intensity;
-    const double dOdI_sum = subgroupAdd(dOdI);
-
     const dvec3 dOdC = dOdFlux * dFluxdp.color; 
-    const dvec3 dOdC_sum = subgroupAdd(dOdC);
-
     const dvec2 dOdA = dot(rayColor, dOdFlux) * dFluxdp.angles;
-    const dvec2 dOdA_sum = subgroupAdd(dOdA);
 
-    if( subgroupElect() ){
+    
+    if( info.deterministic != 0 ){
+        const uint base = light_idx * LIGHT_GRADS_FIXED_ENTRIES;
+        [[unroll]]
+        for (uint i = 0u; i < 3u; i++) {
+            atomicAdd(light_derivatives_fixed[base + LIGHT_GRADS_FIXED_P + i], toFixedPoint(dOdP[i]));
+            atomicAdd(light_derivatives_fixed[base + LIGHT_GRADS_FIXED_N + i], toFixedPoint(dOdN[i]));
+            atomicAdd(light_derivatives_fixed[base + LIGHT_GRADS_FIXED_T + i], toFixedPoint(dOdT[i]));
+            atomicAdd(light_derivatives_fixed[base + LIGHT_GRADS_FIXED_COLOR + i], toFixedPoint(dOdC[i]));
+        }
+        atomicAdd(light_derivatives_fixed[base + LIGHT_GRADS_FIXED_INTENSITY], toFixedPoint(dOdI));
+        atomicAdd(light_derivatives_fixed[base + LIGHT_GRADS_FIXED_IANGLE], toFixedPoint(dOdA[0]));
+        atomicAdd(light_derivatives_fixed[base + LIGHT_GRADS_FIXED_OANGLE], toFixedPoint(dOdA[1]));
+        if( textureIdx >= 0 ){
+            const dvec3 dOdTC = dOdFlux * dFluxdp.textureColor;
+            atomicAdd(light_texture_derivatives_fixed[textureIdx*3  ], toFixedPoint(dOdTC[0]));
+            atomicAdd(light_texture_derivatives_fixed[textureIdx*3+1], toFixedPoint(dOdTC[1]));
+            atomicAdd(light_texture_derivatives_fixed[textureIdx*3+2], toFixedPoint(dOdTC[2]));
+        }
+        return;
+    }
+
+    dvec3 dOdP_sum = dOdP, dOdN_sum = dOdN, dOdT_sum = dOdT, dOdC_sum = dOdC;
+    double dOdI_sum = dOdI;
+    dvec2 dOdA_sum = dOdA;
+    bool writeSums = true;
+    if( subgroupAllEqual(light_idx) ){
+        dOdP_sum = subgroupAdd(dOdP);
+        dOdN_sum = subgroupAdd(dOdN);
+        dOdT_sum = subgroupAdd(dOdT);
+        dOdI_sum = subgroupAdd(dOdI);
+        dOdC_sum = subgroupAdd(dOdC);
+        dOdA_sum = subgroupAdd(dOdA);
+        writeSums = subgroupElect();
+    }
+
+    if( writeSums ){
         atomicAdd(light_derivatives[light_idx].dOdP[0], dOdP_sum[0]);
         atomicAdd(light_derivatives[light_idx].dOdP[1], dOdP_sum[1]);
         atomicAdd(light_derivatives[light_idx].dOdP[2], dOdP_sum[2]);
@@ -934,9 +972,16 @@ void processLocalSample(const in HitDataStruct hd, const in vec3 wi, const in ve
                 if(dot(wo, n_k) > tinyEps) { shWeight = evalHSH(l, m, wo, n_k, t_k) * smoothing; }
 
                 #if EXEC_MODE == 0 
-                    [[unroll, dependency_infinite]]
-                    for (uint i = 0u; i < 3u; i++) { 
-                        atomicAdd(radiance[hd.radBuffIdx[k] + shIdx * 3 + i], localFlux[i] * shWeight * hd.bary[k] / vtxArea[hd.idx[k]] );
+                    if( info.deterministic != 0 ){
+                        [[unroll, dependency_infinite]]
+                        for (uint i = 0u; i < 3u; i++) { 
+                            atomicAdd(radiance_fixed[hd.radBuffIdx[k] + shIdx * 3 + i], toFixedPoint(localFlux[i] * shWeight * hd.bary[k] / vtxArea[hd.idx[k]]) );
+                        }
+                    }else{
+                        [[unroll, dependency_infinite]]
+                        for (uint i = 0u; i < 3u; i++) { 
+                            atomicAdd(radiance[hd.radBuffIdx[k] + shIdx * 3 + i], localFlux[i] * shWeight * hd.bary[k] / vtxArea[hd.idx[k]] );
+                        }
                     }
                 #elif EXEC_MODE == 1 
                     [[unroll, dependency_infinite]]
@@ -961,13 +1006,28 @@ void processLocalSample(const in HitDataStruct hd, const in vec3 wi, const in ve
 
 void main()
 {
-    const uint light_idx = uint(gl_LaunchIDEXT.z); 
-    const uint nRays = (gl_LaunchSizeEXT.x * gl_LaunchSizeEXT.y);
+    uint light_idx = uint(gl_LaunchIDEXT.z); 
+    uint nRays = (gl_LaunchSizeEXT.x * gl_LaunchSizeEXT.y);
+    uint ray_idx = uint(gl_LaunchIDEXT.y * gl_LaunchSizeEXT.x + gl_LaunchIDEXT.x);
     vec3 rayOrigin, rayDirection, radiantFlux, rayThroughput = vec3(1.0);
     HitDataStruct hd;
 
     
-    seed = tea_init(uint(gl_LaunchIDEXT.y * gl_LaunchSizeEXT.x + gl_LaunchIDEXT.x), info.seed); 
+    if( info.ray_count > 0 ){
+        if( ray_idx >= info.ray_count ) return;
+        uint lo = 0, hi = info.light_count;
+        while( hi - lo > 1 ){
+            const uint mid = (lo + hi) / 2;
+            if( light_ray_offsets[mid] <= ray_idx ) lo = mid;
+            else hi = mid;
+        }
+        light_idx = lo;
+        nRays = light_ray_offsets[lo + 1] - light_ray_offsets[lo];
+        ray_idx -= light_ray_offsets[lo];
+    }
+
+    
+    seed = tea_init(ray_idx, info.seed); 
     
     
     
@@ -1091,9 +1151,15 @@ void main()
         dOdp_brdf += (dOdBrdf_indirect.r * dBrdfdWiR_indirect + dOdBrdf_indirect.g * dBrdfdWiG_indirect + dOdBrdf_indirect.b * dBrdfdWiB_indirect) * dwidp;
         addToLightDerivatives(dOdFlux, dFluxdp, dOdp_brdf, rayColor, textureIdx, light_idx);
     #elif EXEC_MODE == 2 
-        atomicAdd(light_derivatives[light_idx].dOdP[0], dOdOrigin[0]);
-        atomicAdd(light_derivatives[light_idx].dOdP[1], dOdOrigin[1]);
-        atomicAdd(light_derivatives[light_idx].dOdP[2], dOdOrigin[2]);
+        if( info.deterministic != 0 ){
+            atomicAdd(light_derivatives_fixed[light_idx * LIGHT_GRADS_FIXED_ENTRIES + LIGHT_GRADS_FIXED_P + 0], toFixedPoint(dOdOrigin[0]));
+            atomicAdd(light_derivatives_fixed[light_idx * LIGHT_GRADS_FIXED_ENTRIES + LIGHT_GRADS_FIXED_P + 1], toFixedPoint(dOdOrigin[1]));
+            atomicAdd(light_derivatives_fixed[light_idx * LIGHT_GRADS_FIXED_ENTRIES + LIGHT_GRADS_FIXED_P + 2], toFixedPoint(dOdOrigin[2]));
+        }else{
+            atomicAdd(light_derivatives[light_idx].dOdP[0], dOdOrigin[0]);
+            atomicAdd(light_derivatives[light_idx].dOdP[1], dOdOrigin[1]);
+            atomicAdd(light_derivatives[light_idx].dOdP[2], dOdOrigin[2]);
+        }
     #endif
 
 }
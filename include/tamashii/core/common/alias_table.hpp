@@ -0,0 +1,37 @@
+#pragma once
+#include <tamashii/public.hpp>
+
+#include <vector>
+
+T_BEGIN_NAMESPACE
+/**
+* AliasTable
+* Samples an index proportional to a list of weights in constant time (Walker/Vose alias method)
+* The entry layout is shared with the shaders, pdf is the probability of picking the entry itself
+**/
+struct AliasTableEntry_s {
+	float											probability;
+	uint32_t										alias;
+	float											pdf;
+};
+
+class AliasTable {
+public:
+													AliasTable() = default;
+													// builds in O(n), large weight lists are normalized on the thread pool
+													// returns false and leaves the table empty if no weight is positive
+	bool											build(const float* aWeights, size_t aCount);
+	bool											build(const std::vector<float>& aWeights) { return build(aWeights.data(), aWeights.size()); }
+	void											clear() { mEntries.clear(); }
+
+													// aU in [0,1)
+	[[nodiscard]] uint32_t							sample(float aU) const;
+	[[nodiscard]] float								pdf(uint32_t aIndex) const { return mEntries[aIndex].pdf; }
+
+	[[nodiscard]] size_t							size() const { return mEntries.size(); }
+	[[nodiscard]] bool								empty() const { return mEntries.empty(); }
+	[[nodiscard]] const std::vector<AliasTableEntry_s>& getEntries() const { return mEntries; }
+private:
+	std::vector<AliasTableEntry_s>					mEntries;
+};
+T_END_NAMESPACE
@@ -1,9 +1,11 @@
 #pragma once
 #include <tamashii/public.hpp>
+#include <tamashii/core/common/mpsc_queue.hpp>
 
 #include <string>
 #include <array>
-#include <map>
+#include <vector>
+#include <thread>
 
 T_BEGIN_NAMESPACE
 enum class EventType
@@ -157,22 +159,33 @@ public:
 	void			reset();
 
 	void			setCallback(EventType aEventType, Input aInput, const std::function<bool(const Event&)>& aCallback);
+
+	struct Stats {
+		uint64_t	mQueued;
+		uint64_t	mDropped;		// queue was full (longer than event_queue_wait), or the oldest was dropped by the consumer
+		uint64_t	mProcessed;
+	};
+	Stats			getStats() const;
 private:
-					EventSystem() = default;
+					EventSystem();
 					~EventSystem() = default;
 				
 	Event			getEvent();
 	void			processEvent(const Event& aEvent);
 
 	
-#define	MAX_QUED_EVENTS	256
-#define	MASK_QUED_EVENTS ( MAX_QUED_EVENTS - 1 )
-	std::array<Event, MAX_QUED_EVENTS> mEventQue;
-	int								mEventHead = 0;
-	int								mEventTail = 0;
-	std::mutex						mMutex;
-
-	std::map<EventType,std::map<Input,std::function<bool(const Event&)>>> mCallbacks;
+	static constexpr size_t			MAX_QUEUED_EVENTS = 4096;
+	static constexpr size_t			EVENT_TYPE_COUNT = static_cast<size_t>(EventType::ACTION) + 1;
+	static constexpr size_t			INPUT_COUNT = static_cast<size_t>(Input::A_EXIT) + 1;
+	MpscQueue<Event>				mEventQueue;
+	std::atomic<std::thread::id>	mConsumerThread;
+	std::atomic<uint64_t>			mQueued;
+	std::atomic<uint64_t>			mDropped;
+	std::atomic<uint64_t>			mProcessed;
+	uint64_t						mReportedDropped;
+
+									// indexed by event type and input, sized on the first callback of a type
+	std::array<std::vector<std::function<bool(const Event&)>>, EVENT_TYPE_COUNT> mCallbacks;
 };
 
 T_END_NAMESPACE
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+#include <tamashii/public.hpp>
+
+#include <vector>
+
+T_BEGIN_NAMESPACE
+/**
+* LightTree
+* Bounding volume hierarchy over lights for picking one light per shading point proportional to an estimate of its
+* contribution. Every node stores bounds, an emission cone (axis, spread of the normals theta_o and falloff theta_e)
+* and the summed power. Infinite lights (directional) are not part of the tree, they are picked uniformly with a
+* probability of count / (count + 1) when there are bounded lights too.
+* The node layout is shared with the shaders (light_tree.glsl), infinite lights follow the tree as leaf nodes.
+**/
+struct LightTreeNode_s {
+	glm::vec3										min;
+	float											power;
+	glm::vec3										max;
+	float											cos_theta_o;
+	glm::vec3										axis;
+	float											cos_theta_e;
+	uint32_t										second_child;	// interior, the first child is the next node
+	uint32_t										light_index;	// leaf
+	uint32_t										is_leaf;
+	uint32_t										pad;
+};
+
+struct LightTreeLight {
+	glm::vec3										mMin;
+	glm::vec3										mMax;
+	glm::vec3										mAxis;
+	float											mCosThetaO;		// -1 emits in every direction
+	float											mCosThetaE;
+	float											mPower;
+	bool											mInfinite = false;
+};
+
+class LightTree {
+public:
+													LightTree() = default;
+													// aLights[i] becomes light index i, lights without power are left out
+	void											build(const std::vector<LightTreeLight>& aLights);
+	void											clear();
+
+													// aN may be zero to ignore the orientation of the receiver, returns -1 if no light can contribute
+	[[nodiscard]] int								sample(const glm::vec3& aP, const glm::vec3& aN, float aU, float& aPdf) const;
+	[[nodiscard]] float								pdf(const glm::vec3& aP, const glm::vec3& aN, uint32_t aLightIndex) const;
+
+													// tree nodes followed by one leaf per infinite light
+	[[nodiscard]] const std::vector<LightTreeNode_s>& getNodes() const { return mNodes; }
+	[[nodiscard]] uint32_t							getTreeNodeCount() const { return mTreeNodeCount; }
+	[[nodiscard]] uint32_t							getInfiniteLightCount() const { return static_cast<uint32_t>(mNodes.size()) - mTreeNodeCount; }
+	[[nodiscard]] bool								empty() const { return mNodes.empty(); }
+
+	static float									importance(const LightTreeNode_s& aNode, const glm::vec3& aP, const glm::vec3& aN);
+private:
+	uint32_t										buildRecursive(std::vector<uint32_t>& aIndices, size_t aBegin, size_t aEnd, const std::vector<LightTreeLight>& aLights,
+														uint32_t aDepth, uint64_t aTrail);
+	[[nodiscard]] float								infiniteProbability() const;
+
+	std::vector<LightTreeNode_s>					mNodes;
+	uint32_t										mTreeNodeCount = 0;
+													// per light, the child choices from the root (bit i = depth i), or the infinite leaf
+	struct LightLocation {
+		uint64_t									mTrail;
+		uint32_t									mNode;
+	};
+	std::vector<LightLocation>						mLocations;
+};
+T_END_NAMESPACE
@@ -0,0 +1,73 @@
+#pragma once
+#include <tamashii/public.hpp>
+
+#include <atomic>
+#include <memory>
+
+T_BEGIN_NAMESPACE
+/**
+* MpscQueue
+* Bounded lock free queue for many producer threads and one consumer thread. Every cell carries a sequence number
+* that tells whether it is free for the position a producer claimed or holds a value for the consumer. Values of one
+* producer are popped in the order they were pushed. The capacity is rounded up to a power of two.
+**/
+template<typename T>
+class MpscQueue {
+public:
+	explicit										MpscQueue(const size_t aCapacity) : mMask(0), mHead(0), mTail(0)
+													{
+														size_t capacity = 2;
+														while (capacity < aCapacity) capacity <<= 1;
+														mMask = capacity - 1;
+														mCells = std::make_unique<Cell[]>(capacity);
+														for (size_t i = 0; i < capacity; i++) mCells[i].mSequence.store(i, std::memory_order_relaxed);
+													}
+													MpscQueue(MpscQueue const&) = delete;
+	void											operator=(MpscQueue const&) = delete;
+
+													// any thread, returns false if the queue is full
+	template<typename U>
+	bool											tryPush(U&& aValue)
+													{
+														size_t pos = mHead.load(std::memory_order_relaxed);
+														while (true) {
+															Cell& cell = mCells[pos & mMask];
+															const size_t seq = cell.mSequence.load(std::memory_order_acquire);
+															const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+															if (diff == 0) {
+																if (mHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+																	cell.mValue = std::forward<U>(aValue);
+																	cell.mSequence.store(pos + 1, std::memory_order_release);
+																	return true;
+																}
+															}
+															// the consumer has not freed the cell of the previous round yet
+															else if (diff < 0) return false;
+															else pos = mHead.load(std::memory_order_relaxed);
+														}
+													}
+													// consumer thread only, returns false if the next value is not published yet
+	bool											tryPop(T& aValue)
+													{
+														Cell& cell = mCells[mTail & mMask];
+														if (cell.mSequence.load(std::memory_order_acquire) != mTail + 1) return false;
+														aValue = std::move(cell.mValue);
+														cell.mSequence.store(mTail + mMask + 1, std::memory_order_release);
+														mTail++;
+														return true;
+													}
+
+	[[nodiscard]] size_t							capacity() const { return mMask + 1; }
+													// consumer thread only, approximate while producers are active
+	[[nodiscard]] size_t							size() const { return mHead.load(std::memory_order_relaxed) - mTail; }
+private:
+	struct Cell {
+		std::atomic<size_t>							mSequence;
+		T											mValue;
+	};
+	std::unique_ptr<Cell[]>							mCells;
+	size_t											mMask;
+	alignas(64) std::atomic<size_t>					mHead;
+	alignas(64) size_t								mTail;
+};
+T_END_NAMESPACE
@@ -0,0 +1,97 @@
+#pragma once
+#include <tamashii/public.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+T_BEGIN_NAMESPACE
+/**
+* Profiler
+* Records cpu scopes of named stages into per thread ring buffers and exports them as chrome trace json
+* (chrome://tracing, ui.perfetto.dev). Recording is controlled by the var profile, when it is off a scope
+* costs one relaxed atomic load. Names are not copied and have to outlive the export (string literals).
+* Export and clear may run while other threads record, slots that are overwritten during the export are skipped.
+**/
+class Profiler {
+public:
+	struct Event {
+		const char*									mName;
+		uint64_t									mBegin;		// ns since the profiler was created
+		uint64_t									mDuration;	// ns
+	};
+
+	static Profiler&								getInstance()
+													{
+														static Profiler instance;
+														return instance;
+													}
+													Profiler(Profiler const&) = delete;
+	void											operator=(Profiler const&) = delete;
+
+	[[nodiscard]] bool								enabled() const { return mEnabled.load(std::memory_order_relaxed); }
+	void											setEnabled(bool aEnabled);
+
+	[[nodiscard]] uint64_t							now() const;
+	void											record(const char* aName, uint64_t aBegin, uint64_t aEnd);
+
+													// only the last profile_buffer_size events of each thread are kept
+	bool											exportChromeTrace(const std::string& aFile) const;
+	void											clear();
+
+private:
+	// the owning thread writes, the export reads; the sequence is 2 * event + 1 while written and 2 * event + 2 after
+	struct Slot {
+		std::atomic<uint64_t>						mSequence;
+		std::atomic<const char*>					mName;
+		std::atomic<uint64_t>						mBegin;
+		std::atomic<uint64_t>						mDuration;
+	};
+	struct ThreadBuffer {
+		std::vector<Slot>							mSlots;
+		std::atomic<uint64_t>						mHead;		// total number of recorded events, only written by the owner
+		std::atomic<uint64_t>						mFirst;		// events before were cleared
+		uint32_t									mThreadId;
+	};
+
+													Profiler();
+													~Profiler() = default;
+
+	ThreadBuffer&									threadBuffer();
+
+	std::atomic_bool								mEnabled;
+	const uint64_t									mStart;
+	mutable std::mutex								mMutex;
+	std::vector<std::shared_ptr<ThreadBuffer>>		mBuffers;
+};
+
+class ScopedTimer {
+public:
+	explicit										ScopedTimer(const char* aName) : mName(nullptr), mBegin(0)
+													{
+														Profiler& profiler = Profiler::getInstance();
+														if (!profiler.enabled()) return;
+														mName = aName;
+														mBegin = profiler.now();
+													}
+													~ScopedTimer() { stop(); }
+													// ends the scope early, for stages that follow each other in one block
+	void											stop()
+													{
+														if (!mName) return;
+														Profiler& profiler = Profiler::getInstance();
+														profiler.record(mName, mBegin, profiler.now());
+														mName = nullptr;
+													}
+	T_DELETE_MOVE_COPY_CONSTRUCTOR(ScopedTimer)
+private:
+	const char*										mName;
+	uint64_t										mBegin;
+};
+T_END_NAMESPACE
+
+#define T_PROFILE_CONCAT_INNER(a, b) a##b
+#define T_PROFILE_CONCAT(a, b) T_PROFILE_CONCAT_INNER(a, b)
+#define T_PROFILE_SCOPE(name) const tamashii::ScopedTimer T_PROFILE_CONCAT(_tProfileScope, __LINE__)(name)
@@ -0,0 +1,37 @@
+#pragma once
+#include <tamashii/public.hpp>
+
+#include <map>
+
+T_BEGIN_NAMESPACE
+/**
+* RangeAllocator
+* Hands out ranges of a linear space, e.g. elements of a gpu buffer, first fit from a free list
+* Freed ranges are merged with their free neighbours, the space can grow at its end
+**/
+class RangeAllocator {
+public:
+	static constexpr uint64_t						INVALID = UINT64_MAX;
+
+	explicit										RangeAllocator(uint64_t aCapacity = 0);
+
+													// frees everything
+	void											reset(uint64_t aCapacity);
+													// returns the offset of the range or INVALID if no free range is large enough
+	[[nodiscard]] uint64_t							allocate(uint64_t aSize);
+	void											free(uint64_t aOffset, uint64_t aSize);
+													// appends free space at the end, a smaller capacity is ignored
+	void											grow(uint64_t aCapacity);
+
+	[[nodiscard]] uint64_t							capacity() const { return mCapacity; }
+	[[nodiscard]] uint64_t							used() const { return mUsed; }
+													// one past the last allocated element
+	[[nodiscard]] uint64_t							end() const;
+	[[nodiscard]] uint64_t							largestFreeRange() const;
+	[[nodiscard]] size_t							freeRangeCount() const { return mFree.size(); }
+private:
+	std::map<uint64_t, uint64_t>					mFree;		// offset -> size
+	uint64_t										mCapacity;
+	uint64_t										mUsed;
+};
+T_END_NAMESPACE
@@ -0,0 +1,102 @@
+#pragma once
+#include <tamashii/public.hpp>
+
+#include <deque>
+#include <vector>
+#include <limits>
+
+T_BEGIN_NAMESPACE
+/**
+* SlotMap
+* Stores values densely and hands out generational handles that stay valid while the value lives
+* Insert and erase are O(1), erase moves the last value into the freed spot so iteration stays dense
+* A handle of an erased value is detected as stale, even if its slot was reused
+**/
+struct SlotHandle {
+	uint32_t										mIndex = std::numeric_limits<uint32_t>::max();
+	uint32_t										mGeneration = 0;
+
+	[[nodiscard]] bool								valid() const { return mIndex != std::numeric_limits<uint32_t>::max(); }
+	bool											operator==(const SlotHandle& aOther) const { return mIndex == aOther.mIndex && mGeneration == aOther.mGeneration; }
+	bool											operator!=(const SlotHandle& aOther) const { return !(*this == aOther); }
+};
+
+template<typename T>
+class SlotMap {
+public:
+	using iterator = typename std::deque<T>::iterator;
+	using const_iterator = typename std::deque<T>::const_iterator;
+
+	SlotHandle										insert(T aValue)
+													{
+														uint32_t slot;
+														if (mFreeSlots.empty()) {
+															slot = static_cast<uint32_t>(mSlots.size());
+															mSlots.push_back({ 0, 0 });
+														} else {
+															slot = mFreeSlots.back();
+															mFreeSlots.pop_back();
+														}
+														mSlots[slot].mDense = static_cast<uint32_t>(mValues.size());
+														mValues.push_back(std::move(aValue));
+														mDenseToSlot.push_back(slot);
+														return { slot, mSlots[slot].mGeneration };
+													}
+													// returns the dense index the last value was moved to, size() if nothing moved
+													// and max() if the handle is stale
+	uint32_t										erase(const SlotHandle aHandle)
+													{
+														if (!contains(aHandle)) return std::numeric_limits<uint32_t>::max();
+														const uint32_t dense = mSlots[aHandle.mIndex].mDense;
+														const uint32_t last = static_cast<uint32_t>(mValues.size()) - 1;
+														if (dense != last) {
+															mValues[dense] = std::move(mValues[last]);
+															mDenseToSlot[dense] = mDenseToSlot[last];
+															mSlots[mDenseToSlot[dense]].mDense = dense;
+														}
+														mValues.pop_back();
+														mDenseToSlot.pop_back();
+														mSlots[aHandle.mIndex].mGeneration++;
+														mFreeSlots.push_back(aHandle.mIndex);
+														return dense;
+													}
+	void											clear()
+													{
+														for (const uint32_t slot : mDenseToSlot) {
+															mSlots[slot].mGeneration++;
+															mFreeSlots.push_back(slot);
+														}
+														mValues.clear();
+														mDenseToSlot.clear();
+													}
+
+	[[nodiscard]] bool								contains(const SlotHandle aHandle) const
+													{ return aHandle.mIndex < mSlots.size() && mSlots[aHandle.mIndex].mGeneration == aHandle.mGeneration; }
+													// nullptr if the handle is stale
+	[[nodiscard]] T*								get(const SlotHandle aHandle) { return contains(aHandle) ? &mValues[mSlots[aHandle.mIndex].mDense] : nullptr; }
+	[[nodiscard]] const T*							get(const SlotHandle aHandle) const { return contains(aHandle) ? &mValues[mSlots[aHandle.mIndex].mDense] : nullptr; }
+	[[nodiscard]] SlotHandle						handle(const uint32_t aDenseIndex) const { return { mDenseToSlot[aDenseIndex], mSlots[mDenseToSlot[aDenseIndex]].mGeneration }; }
+
+													// dense storage, the order changes on erase
+	[[nodiscard]] std::deque<T>&					values() { return mValues; }
+	[[nodiscard]] const std::deque<T>&				values() const { return mValues; }
+	[[nodiscard]] size_t							size() const { return mValues.size(); }
+	[[nodiscard]] bool								empty() const { return mValues.empty(); }
+	T&												operator[](const size_t aDenseIndex) { return mValues[aDenseIndex]; }
+	const T&										operator[](const size_t aDenseIndex) const { return mValues[aDenseIndex]; }
+	T&												front() { return mValues.front(); }
+	iterator										begin() { return mValues.begin(); }
+	iterator										end() { return mValues.end(); }
+	const_iterator									begin() const { return mValues.begin(); }
+	const_iterator									end() const { return mValues.end(); }
+private:
+	struct Slot {
+		uint32_t									mDense;
+		uint32_t									mGeneration;
+	};
+	std::deque<T>									mValues;
+	std::vector<uint32_t>							mDenseToSlot;
+	std::vector<Slot>								mSlots;
+	std::vector<uint32_t>							mFreeSlots;
+};
+T_END_NAMESPACE
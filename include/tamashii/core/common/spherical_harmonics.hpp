@@ -0,0 +1,52 @@
+#pragma once
+#include <tamashii/public.hpp>
+
+#include <functional>
+#include <vector>
+
+T_BEGIN_NAMESPACE
+/**
+* Spherical harmonics (SH) and hemispherical harmonics (HSH) on the cpu
+* Same basis as sphericalharmonics.glsl: real, Condon-Shortley phase, normalized to 4pi (SH) and 2pi (HSH),
+* m > 0 uses cos(m phi), m < 0 sin(|m| phi), phi = atan(y, x), theta = acos(z).
+* HSH directions are given in the frame (tangent, cross(normal, tangent), normal) and clamped to the upper hemisphere.
+* Evaluation uses the cartesian recurrence (no trigonometry), batches run 8 directions at once with AVX2.
+* Coefficient sets follow the radiance buffer layout: index(l, m) * aChannels + channel
+**/
+namespace sh {
+	constexpr uint32_t								index(const int aL, const int aM) { return static_cast<uint32_t>(aL * (aL + 1) + aM); }
+	constexpr uint32_t								coefficientCount(const uint32_t aOrder) { return (aOrder + 1) * (aOrder + 1); }
+
+													// aOut holds coefficientCount(aOrder) values
+	void											evalSH(uint32_t aOrder, const glm::vec3& aDir, float* aOut);
+	void											evalHSH(uint32_t aOrder, const glm::vec3& aLocalDir, float* aOut);
+	void											evalHSH(uint32_t aOrder, const glm::vec3& aDir, const glm::vec3& aNormal, const glm::vec3& aTangent, float* aOut);
+
+													// directions as separate x, y, z arrays, aOut[index * aCount + i] is the basis function index for direction i
+	void											evalSHBatch(uint32_t aOrder, const float* aX, const float* aY, const float* aZ, size_t aCount, float* aOut);
+	void											evalHSHBatch(uint32_t aOrder, const float* aX, const float* aY, const float* aZ, size_t aCount, float* aOut);
+
+	glm::vec3										evalSHSumRGB(uint32_t aOrder, const float* aCoefficients, const glm::vec3& aDir);
+	glm::vec3										evalHSHSumRGB(uint32_t aOrder, const float* aCoefficients, const glm::vec3& aDir, const glm::vec3& aNormal, const glm::vec3& aTangent);
+
+													// gauss-legendre quadrature in cos(theta) (aResolution nodes) times 2 * aResolution uniform phi steps,
+													// exact for band limited functions when aResolution > order of function plus aOrder
+	void											projectSH(uint32_t aOrder, const std::function<glm::vec3(const glm::vec3&)>& aFunc, uint32_t aResolution, std::vector<float>& aCoefficients);
+	void											projectHSH(uint32_t aOrder, const std::function<glm::vec3(const glm::vec3&)>& aFunc, uint32_t aResolution, std::vector<float>& aCoefficients);
+
+	/**
+	* Rotation of SH coefficient sets, one dense matrix per band
+	* After apply, evaluating the result in direction R * d gives the value of the input in direction d
+	**/
+	class Rotation {
+	public:
+													Rotation(uint32_t aOrder, const glm::mat3& aRotation);
+		void										apply(const float* aIn, float* aOut, uint32_t aChannels = 3) const;
+		[[nodiscard]] uint32_t						order() const { return mOrder; }
+		[[nodiscard]] const std::vector<float>&		band(const uint32_t aL) const { return mBands[aL]; }
+	private:
+		uint32_t									mOrder;
+		std::vector<std::vector<float>>				mBands;
+	};
+}
+T_END_NAMESPACE
@@ -0,0 +1,55 @@
+#pragma once
+#include <tamashii/public.hpp>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <deque>
+#include <vector>
+
+T_BEGIN_NAMESPACE
+/**
+* ThreadPool
+* Shared worker threads for cpu side work like scene import and mesh processing
+**/
+class ThreadPool {
+public:
+    static ThreadPool&                              getInstance()
+                                                    {
+                                                        static ThreadPool instance;
+                                                        return instance;
+                                                    }
+                                                    ThreadPool(ThreadPool const&) = delete;
+    void                                            operator=(ThreadPool const&) = delete;
+
+    [[nodiscard]] uint32_t                          threadCount() const;
+
+    template<typename F>
+    auto                                            submit(F&& aFunc) -> std::future<std::invoke_result_t<F>>
+                                                    {
+                                                        using R = std::invoke_result_t<F>;
+                                                        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(aFunc));
+                                                        std::future<R> future = task->get_future();
+                                                        enqueue([task] { (*task)(); });
+                                                        return future;
+                                                    }
+                                                    // calls aFunc(i) for every i in [aBegin, aEnd), the calling thread takes part in the work
+                                                    // so nested calls from inside a task can not dead lock; blocks until all indices are done
+    void                                            parallelFor(size_t aBegin, size_t aEnd, const std::function<void(size_t)>& aFunc);
+
+private:
+                                                    ThreadPool();
+                                                    ~ThreadPool();
+
+    void                                            enqueue(std::function<void()> aTask);
+    void                                            worker();
+
+    std::vector<std::thread>                        mWorkers;
+    std::deque<std::function<void()>>               mTasks;
+    std::mutex                                      mMutex;
+    std::condition_variable                         mCondition;
+    bool                                            mStop;
+};
+T_END_NAMESPACE
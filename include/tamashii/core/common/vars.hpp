@@ -32,6 +32,18 @@ namespace var {
 	extern ccli::Var<std::string> cfg_filename;
 	extern ccli::Var<std::string> logLevel;
 	extern ccli::Var<bool> gltf_io_use_watt;
+	extern ccli::Var<uint32_t> gltf_export_chunk_size;
+	extern ccli::Var<std::string> exr_compression;
+	extern ccli::Var<bool> exr_half;
+	extern ccli::Var<uint32_t> worker_threads;
+	extern ccli::Var<std::string> tangent_method;
+	extern ccli::Var<uint32_t> tangent_split_size;
+	extern ccli::Var<uint32_t> bsp_patch_level;
+	extern ccli::Var<bool> profile;
+	extern ccli::Var<uint32_t> profile_buffer_size;
+	extern ccli::Var<std::string> profile_export;
+	extern ccli::Var<uint32_t> event_queue_wait;
+	extern ccli::Var<uint32_t> event_queue_key_wait;
 
 	
 	extern ccli::Var<std::string> render_backend;
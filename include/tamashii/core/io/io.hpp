@@ -4,7 +4,9 @@
 
 #include <filesystem>
 #include <deque>
+#include <future>
 #include <memory>
+#include <vector>
 
 T_BEGIN_NAMESPACE
 
@@ -138,11 +140,28 @@ namespace io {
 			spdlog::warn("...format not supported");
 			return false;
 		}
+		struct ExrSettings
+		{
+			enum class Compression : uint32_t { NONE, ZIP, PIZ };
+			Compression mCompression;
+			bool mHalf;
+			ExrSettings() : mCompression(Compression::NONE), mHalf(false) {}
+			// exr_compression and exr_half
+			static ExrSettings fromVars();
+		};
 		/* IMAGE */
 		static void			save_image_png_8_bit(std::string const& aName, int aWidth, int aHeight, int aChannels, const uint8_t* aPixels);
 		
 		
 		static void			save_image_exr(std::string const& aName, int aWidth, int aHeight, const float* aPixels, uint32_t aStride = 3, const std::vector<uint8_t>& aOut = { 2, 1, 0 } /*B G R*/);
+							// deinterleaves on the thread pool straight from aPixels, compression runs per scanline block in parallel
+		static bool			save_image_exr(std::string const& aName, int aWidth, int aHeight, const float* aPixels, uint32_t aStride, const std::vector<uint8_t>& aOut, const ExrSettings& aSettings);
+							// queued on a background io thread that owns the pixels until they are written
+		static std::future<bool> save_image_png_8_bit_async(std::string aName, int aWidth, int aHeight, int aChannels, std::vector<uint8_t> aPixels);
+		static std::future<bool> save_image_exr_async(std::string aName, int aWidth, int aHeight, std::vector<float> aPixels, uint32_t aStride = 4,
+							std::vector<uint8_t> aOut = { 3, 2, 1, 0 } /*A B G R*/, const ExrSettings& aSettings = ExrSettings::fromVars());
+							// blocks until all queued saves are written
+		static void			wait_for_image_saves();
 		/* FILE */
 		static bool			write_file(std::string const& aFilename, std::string const& aContent);
 		static bool			write_file_append(std::string const& aFilename, std::string const& aContent);
@@ -0,0 +1,61 @@
+#pragma once
+#include <tamashii/public.hpp>
+#include <tamashii/core/platform/mapped_file.hpp>
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+T_BEGIN_NAMESPACE
+namespace io {
+	/**
+	* Snapshot
+	* Binary container of named data sections plus integer metadata, read through a memory mapping.
+	* Sections are split into chunks that are encoded and decoded in parallel. Uncompressed sections are stored
+	* contiguous and 64 byte aligned, so they can be used in place. Compressed chunks are byte shuffled by element
+	* size and deflated, chunks that do not get smaller are stored raw. Everything is in native byte order, the header
+	* records it and files from the other byte order are rejected.
+	**/
+	class Snapshot {
+	public:
+		enum class Compression : uint32_t { NONE, DEFLATE };
+		struct Section {
+			std::string								mName;
+			const void*								mData;
+			uint64_t								mSize;			// in bytes
+			uint32_t								mElementSize;	// shuffle width for compression, 4 for float data
+		};
+
+													Snapshot() = default;
+													Snapshot(Snapshot const&) = delete;
+		void										operator=(Snapshot const&) = delete;
+
+		static bool									write(const std::string& aFile, const std::map<std::string, uint64_t>& aMeta, const std::vector<Section>& aSections,
+														Compression aCompression, uint32_t aChunkSize = 4 << 20);
+
+		bool										open(const std::string& aFile);
+		void										close();
+
+		[[nodiscard]] std::optional<uint64_t>		meta(const std::string& aKey) const;
+		[[nodiscard]] bool							has(const std::string& aSection) const;
+		[[nodiscard]] uint64_t						size(const std::string& aSection) const;
+													// data inside the mapping, nullptr if the section is compressed
+		[[nodiscard]] const void*					view(const std::string& aSection) const;
+													// aSize has to match the section size
+		bool										read(const std::string& aSection, void* aOut, uint64_t aSize) const;
+
+	private:
+		struct SectionInfo {
+			Compression								mCompression;
+			uint32_t								mElementSize;
+			uint64_t								mSize;
+			uint64_t								mChunkSize;
+			std::vector<std::pair<uint64_t, uint64_t>> mChunks;	// file offset, stored size
+		};
+		MappedFile									mFile;
+		std::map<std::string, uint64_t>				mMeta;
+		std::map<std::string, SectionInfo>			mSections;
+	};
+}
+T_END_NAMESPACE
@@ -0,0 +1,36 @@
+#pragma once
+#include <tamashii/public.hpp>
+
+#include <string>
+#include <string_view>
+
+T_BEGIN_NAMESPACE
+/**
+* MappedFile
+* Read only view of a whole file, memory mapped by the OS
+**/
+class MappedFile {
+public:
+                                                    MappedFile() = default;
+                                                    ~MappedFile();
+                                                    MappedFile(MappedFile const&) = delete;
+    void                                            operator=(MappedFile const&) = delete;
+
+    bool                                            open(const std::string& aFile);
+    void                                            close();
+
+    [[nodiscard]] bool                              isOpen() const { return mData != nullptr || mOpenEmpty; }
+    [[nodiscard]] const char*                       data() const { return mData; }
+    [[nodiscard]] size_t                            size() const { return mSize; }
+    [[nodiscard]] std::string_view                  view() const { return { mData, mSize }; }
+
+private:
+    const char*                                     mData = nullptr;
+    size_t                                          mSize = 0;
+    bool                                            mOpenEmpty = false;
+#if defined( _WIN32 )
+    void*                                           mFile = nullptr;
+    void*                                           mMapping = nullptr;
+#endif
+};
+T_END_NAMESPACE
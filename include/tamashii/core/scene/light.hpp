@@ -72,6 +72,9 @@ struct Light_s {
 	uint32_t						vertex_buffer_offset;
 	
 	uint32_t						type;
+	
+	uint32_t						alias_table_offset;
+	uint32_t						alias_table_pad[3];
 };
 
 class Light : public Asset {
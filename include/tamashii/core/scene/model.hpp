@@ -6,6 +6,8 @@
 
 #include <string>
 #include <list>
+#include <memory>
+#include <utility>
 #include <vector>
 
 T_BEGIN_NAMESPACE
@@ -113,12 +115,25 @@ public:
 
 	
 	Topology								getTopology() const;
+											// copies of a mesh share vertices and indices, the non const getters give the mesh its
+											// own copy first (copy on write); read through a const mesh to keep sharing
 	uint32_t*								getIndicesArray();
+	const uint32_t*							getIndicesArray() const;
 	std::vector<uint32_t>*					getIndicesVector();
+	const std::vector<uint32_t>*			getIndicesVector() const;
 	std::vector<uint32_t>&					getIndicesVectorRef();
+	const std::vector<uint32_t>&			getIndicesVectorRef() const;
 	vertex_s*								getVerticesArray();
+	const vertex_s*							getVerticesArray() const;
 	std::vector<vertex_s>*					getVerticesVector();
+	const std::vector<vertex_s>*			getVerticesVector() const;
 	std::vector<vertex_s>&					getVerticesVectorRef();
+	const std::vector<vertex_s>&			getVerticesVectorRef() const;
+	bool									sharesGeometryWith(const Mesh& aMesh) const;
+											// gives the mesh its own copy of shared data, the non const getters call it. Not thread
+											// safe: detach before per mesh writes are spread over threads, not while the mesh is copied
+	void									detachIndices();
+	void									detachVertices();
 	CustomData*								addCustomData(const std::string& aKey);
 	CustomData*								getCustomData(const std::string& aKey);
 	void									deleteCustomData(const std::string& aKey);
@@ -169,8 +184,8 @@ private:
 	bool									mHasTextureCoordinates1;
 	bool									mHasColors0;
 
-	std::vector<uint32_t>					mIndices;
-	std::vector<vertex_s>					mVertices;
+	std::shared_ptr<std::vector<uint32_t>>	mIndices;
+	std::shared_ptr<std::vector<vertex_s>>	mVertices;
 	std::map<std::string, CustomData>		mCustomData;
 
 											
@@ -2,9 +2,11 @@
 #include <tamashii/public.hpp>
 #include <tamashii/core/forward.h>
 #include <tamashii/core/common/math.hpp>
+#include <tamashii/core/common/slot_map.hpp>
 
 #include <list>
 #include <deque>
+#include <vector>
 
 T_BEGIN_NAMESPACE
 struct Ref {
@@ -13,17 +15,19 @@ struct Ref {
 	};
 											
 								Ref(const Type type) : type{ type }, uuid{uuid::getUUID()},
-									model_matrix { glm::mat4{1.0f} }, extra{ nullptr } {}
+									model_matrix { glm::mat4{1.0f} }, transform_node{ -1 }, extra{ nullptr } {}
 	virtual						~Ref() = default;
 	const Type					type;
 	const UUID					uuid;
 	glm::mat4					model_matrix;
 
-	std::deque<TRS*>			transforms;			
+	int							transform_node;		// innermost transform above the ref in the flattened hierarchy of the scene, -1 if none
 	void*						extra;				
+	SlotHandle					handle;				// into the ref list of the scene, stale once the ref was removed
     const Ref&					operator=(const Ref& other) const { return other; }
 
-	void						updateSceneGraphNodesFromModelMatrix(bool aFlipY = false) const;
+								// aTransforms from RenderScene::getTransforms
+	void						updateSceneGraphNodesFromModelMatrix(const std::vector<TRS*>& aTransforms, bool aFlipY = false) const;
 };
 struct RefMesh : Ref {
 								RefMesh() : Ref{ Type::Mesh }, mesh{ nullptr } {}
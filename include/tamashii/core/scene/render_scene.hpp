@@ -1,9 +1,12 @@
 #pragma once
 #include <tamashii/public.hpp>
 #include <tamashii/core/forward.h>
+#include <tamashii/core/common/slot_map.hpp>
 
 #include <string>
 #include <deque>
+#include <vector>
+#include <unordered_map>
 
 T_BEGIN_NAMESPACE
 
@@ -137,8 +140,14 @@ public:
 	void									addMaterial(Material* aMaterial);
 	std::shared_ptr<RefModel>				addModelRef(const std::shared_ptr<Model>& aModel, glm::vec3 aPosition = glm::vec3(0), glm::vec4 aRotation = glm::vec4(0), glm::vec3 aScale = glm::vec3(1));
 
+											// O(1), the last ref of the list takes the place of the removed one
+											// refs that were already removed are ignored
 	void									removeModel(const std::shared_ptr<RefModel>& aRefModel);
 	void									removeLight(const std::shared_ptr<RefLight>& aRefLight);
+											// nullptr if the handle is stale
+	std::shared_ptr<RefModel>				getModelRef(SlotHandle aHandle) const;
+	std::shared_ptr<RefLight>				getLightRef(SlotHandle aHandle) const;
+	std::shared_ptr<RefCamera>				getCameraRef(SlotHandle aHandle) const;
 
 											
 	void									requestImageUpdate();
@@ -148,6 +157,10 @@ public:
 	void									requestModelGeometryUpdate();
 	void									requestLightUpdate();
 	void									requestCameraUpdate();
+											// the TRS of scene graph nodes was edited, every cached world matrix is recomputed on the next update
+	void									requestTransformUpdate();
+											// TRS of the scene graph nodes above the ref, outermost first
+	std::vector<TRS*>						getTransforms(const Ref& aRef) const;
 
 	void									intersect(glm::vec3 aOrigin, glm::vec3 aDirection, IntersectionSettings aSettings, Intersection *aHitInfo) const;
 
@@ -182,7 +195,12 @@ public:
 	io::SceneData							getSceneInfo();
 private:
 	static void								filterSceneInfo(io::SceneData& aSceneInfo);
-	void									traverseSceneGraph(Node& aNode, glm::mat4 aMatrix = glm::mat4(1.0f), bool aAnimatedPath = false);
+	void									traverseSceneGraph(Node& aNode, glm::mat4 aMatrix = glm::mat4(1.0f), bool aAnimatedPath = false, int aTransformNode = -1);
+	int										addTransformNode(TRS* aTrs, int aParent, bool aAnimated, const glm::mat4& aWorld);
+											// a node is used by refs and child nodes and freed with its last user
+	void									retainTransformNode(int aIndex);
+	void									releaseTransformNode(int aIndex);
+	void									updateTransforms(float aTime);
 
 	std::string								mSceneFile;
 	std::atomic<bool>						mReady;	
@@ -197,9 +215,24 @@ private:
 	std::deque<Image*>						mImages;
 
 											
-	std::deque<std::shared_ptr<RefModel>>	mRefModels;
-	std::deque<std::shared_ptr<RefCamera>>	mRefCameras;
-	std::deque<std::shared_ptr<RefLight>>	mRefLights;
+	SlotMap<std::shared_ptr<RefModel>>		mRefModels;
+	SlotMap<std::shared_ptr<RefCamera>>		mRefCameras;
+	SlotMap<std::shared_ptr<RefLight>>		mRefLights;
+											// number of refs per model/light, the asset is removed with its last ref
+	std::unordered_map<const Asset*, uint32_t> mAssetRefCount;
+
+											// every scene graph node with a local transform, parents before their children
+	struct TransformNode {
+		TRS*								mTrs;		// nullptr if the node is free
+		int									mParent;
+		uint32_t							mUsers;
+		glm::mat4							mWorld;
+	};
+	std::vector<TransformNode>				mTransformNodes;
+	std::vector<uint32_t>					mFreeTransformNodes;
+											// nodes below an animation, the only ones recomputed per update
+	std::vector<uint32_t>					mAnimatedTransformNodes;
+	bool									mTransformsDirty;
 
 	std::shared_ptr<Camera>					mDefaultCamera;
 	std::shared_ptr<RefCamera>				mDefaultCameraRef;
@@ -9,8 +9,16 @@ namespace topology {
 	void calcFlatNormals(Mesh* aMesh);
 	void calcSmoothNormals(Mesh* aMesh);
 
-	
+	enum class TangentMethod { MIKKTSPACE, FAST };
+	// var::tangent_method, MIKKTSPACE by default, auto resolves to MIKKTSPACE if aNeedsExact (mesh is normal mapped) and FAST otherwise
+	TangentMethod selectTangentMethod(bool aNeedsExact);
+	// generates tangents with the selected method, meshes without uvs get stark tangents
+	void calcTangents(Mesh* aMesh, bool aNeedsExact = true);
+
+	// meshes above var::tangent_split_size triangles are split into independent components that run in parallel
 	void calcMikkTSpaceTangents(Mesh* aMesh);
+	// per vertex sum of the triangle uv tangents, orthogonalized against the normal
+	void calcFastTangents(Mesh* aMesh);
 
 	
 	
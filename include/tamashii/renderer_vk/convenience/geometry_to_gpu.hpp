@@ -1,7 +1,10 @@
 #pragma once
 #include <tamashii/core/scene/render_scene.hpp>
+#include <tamashii/core/common/range_allocator.hpp>
 #include <rvk/rvk.hpp>
 
+#include <memory>
+
 T_BEGIN_NAMESPACE
 class MaterialDataVulkan;
 class LightDataVulkan;
@@ -10,6 +13,7 @@ public:
 															GeometryDataVulkan(rvk::LogicalDevice* aDevice);
 															~GeometryDataVulkan();
 
+															// aMaxIndices/aMaxVertices are the initial capacities, the buffers grow by chunks when a scene needs more
 	void													prepare(uint32_t aMaxIndices = 2097152,
 	                                                                uint32_t aMaxVertices = 524288,
 	                                                                uint32_t aIndexBufferUsageFlags = rvk::Buffer::Use::INDEX,
@@ -17,9 +21,19 @@ public:
 	void													destroy();
 
 	void													loadScene(rvk::SingleTimeCommand* aStc, tamashii::SceneBackendData aScene);
+															// the layout stays dense and in scene order, models keep their ranges while it
+															// does and new models are appended, otherwise all ranges are rebuilt.
+															// Limitation: removing, resizing or reordering a model resets both allocators and
+															// re-assigns every range, freed ranges are never reused and the free/coalescing part
+															// of RangeAllocator is not used here. The dense per vertex buffers of the
+															// implementations depend on this layout and would need remapping otherwise.
+															// Every model is uploaded again on each call either way.
 	void													update(rvk::SingleTimeCommand* aStc, tamashii::SceneBackendData aScene);
 	void													unloadScene();
 
+	static constexpr uint32_t								INDEX_CHUNK_SIZE = 1024 * 1024;
+	static constexpr uint32_t								VERTEX_CHUNK_SIZE = 256 * 1024;
+
 	struct primitveBufferOffset_s {
 		uint32_t											mIndexOffset = 0;
 		uint32_t											mIndexByteOffset = 0;
@@ -27,8 +41,11 @@ public:
 		uint32_t											mVertexByteOffset = 0;
 	};
 
+															// the buffers are replaced when they grow, fetch them again after loadScene/update
 	rvk::Buffer*											getIndexBuffer();
 	rvk::Buffer*											getVertexBuffer();
+															// true if a buffer was replaced, descriptors that bind them have to be updated
+	bool													bufferChanged(bool aReset = true);
 															
 	primitveBufferOffset_s									getOffset() const;
 	primitveBufferOffset_s									getOffset(Mesh *aMesh);
@@ -44,16 +61,27 @@ public:
 	static SceneInfo_s										getSceneGeometryInfo(tamashii::SceneBackendData aScene);
 
 protected:
-	rvk::LogicalDevice*										mDevice;
+	struct ModelRange_s {
+		uint32_t											mIndexOffset;
+		uint32_t											mIndexCount;
+		uint32_t											mVertexOffset;
+		uint32_t											mVertexCount;
+	};
+	void													growBuffer(std::unique_ptr<rvk::Buffer>& aBuffer, uint32_t aUsageFlags, VkDeviceSize aSize);
 
-	uint32_t												mMaxIndexCount;
-	uint32_t												mMaxVertexCount;
+	rvk::LogicalDevice*										mDevice;
 
-	rvk::Buffer												mIndexBuffer;
-	rvk::Buffer												mVertexBuffer;
+	uint32_t												mIndexBufferUsageFlags;
+	uint32_t												mVertexBufferUsageFlags;
+	std::unique_ptr<rvk::Buffer>							mIndexBuffer;
+	std::unique_ptr<rvk::Buffer>							mVertexBuffer;
+	RangeAllocator											mIndexRanges;			// in indices
+	RangeAllocator											mVertexRanges;			// in vertices
+	std::unordered_map<Model*, ModelRange_s>				mModelRanges;
 	primitveBufferOffset_s									mBufferOffset;			
 	std::unordered_map<Model*, primitveBufferOffset_s>		mModelToBOffset;		
 	std::unordered_map<Mesh*, primitveBufferOffset_s>		mMeshToBOffset;			
+	bool													mBufferResized;
 };
 
 class GeometryDataBlasVulkan : public GeometryDataVulkan {
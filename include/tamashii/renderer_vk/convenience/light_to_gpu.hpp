@@ -1,6 +1,8 @@
 #pragma once
 #include <tamashii/core/scene/render_scene.hpp>
 #include <tamashii/core/scene/light.hpp>
+#include <tamashii/core/common/alias_table.hpp>
+#include <tamashii/core/common/light_tree.hpp>
 #include <rvk/rvk.hpp>
 
 T_BEGIN_NAMESPACE
@@ -24,16 +26,40 @@ public:
 													const std::deque<std::shared_ptr<RefModel>>* aRefModels = nullptr, GeometryDataVulkan* aGeometryDataVulkan = nullptr);
 
 	rvk::Buffer*								getLightBuffer();
+												// per triangle mesh light alias tables for picking a triangle by area times emission,
+												// Light_s::alias_table_offset points to the first entry of a light (-1 if uniform)
+	rvk::Buffer*								getAliasTableBuffer();
+	const AliasTable*							getAliasTable(RefMesh* aRefMesh) const;
+												// bvh over all lights for picking one light per shading point, see LightTree
+	rvk::Buffer*								getLightTreeBuffer();
+	const LightTree&							getLightTree() const;
 	int											getIndex(RefLight* aRefLight);
 	int											getIndex(RefMesh* aRefMesh);
 	uint32_t									getLightCount() const;
 private:
+	struct MeshAliasTable {
+		glm::mat4								mModelMatrix;
+		const Texture*							mTexture;
+		size_t									mTriangleCount;
+		AliasTable								mTable;
+		float									mEmittingArea;		// world space area weighted by the emission texture
+	};
+	void										updateAliasTables(rvk::SingleTimeCommand* aStc, const std::vector<std::pair<RefModel*, RefMesh*>>& aMeshLights);
+	void										updateLightTree(rvk::SingleTimeCommand* aStc, const std::vector<std::pair<RefModel*, RefMesh*>>& aMeshLights);
+
 	rvk::LogicalDevice*							mDevice;
+	uint32_t									mBufferUsageFlags;
 	uint32_t									mMaxLightCount;
 	std::vector<Light_s>						mLights;
 	std::unordered_map<RefLight*, uint32_t>	mRefLightToIndex;		
 	std::unordered_map<RefMesh*, uint32_t>	mRefMeshToIndex;		
 	rvk::Buffer									mLightBuffer;
+	std::unordered_map<RefMesh*, MeshAliasTable> mAliasTables;
+												// offset of every uploaded table in the buffer, the upload is skipped while it stays the same
+	std::vector<std::pair<RefMesh*, uint32_t>>	mAliasTableOffsets;
+	rvk::Buffer									mAliasTableBuffer;
+	LightTree									mLightTree;
+	rvk::Buffer									mLightTreeBuffer;
 };
 
 T_END_NAMESPACE
\ No newline at end of file
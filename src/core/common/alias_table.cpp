@@ -0,0 +1,89 @@
+#include <tamashii/core/common/alias_table.hpp>
+#include <tamashii/core/common/thread_pool.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+T_USE_NAMESPACE
+
+namespace {
+	constexpr size_t PARALLEL_CHUNK_SIZE = 1 << 16;
+
+	double sumWeights(const float* aWeights, const size_t aCount)
+	{
+		const auto valid = [](const float aWeight) { return std::isfinite(aWeight) && aWeight > 0.0f ? static_cast<double>(aWeight) : 0.0; };
+		if (aCount <= PARALLEL_CHUNK_SIZE) {
+			double sum = 0.0;
+			for (size_t i = 0; i < aCount; i++) sum += valid(aWeights[i]);
+			return sum;
+		}
+		
+		const size_t chunkCount = (aCount + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+		std::vector<double> partial(chunkCount, 0.0);
+		ThreadPool::getInstance().parallelFor(0, chunkCount, [&](const size_t aChunk) {
+			const size_t end = std::min(aCount, (aChunk + 1) * PARALLEL_CHUNK_SIZE);
+			double sum = 0.0;
+			for (size_t i = aChunk * PARALLEL_CHUNK_SIZE; i < end; i++) sum += valid(aWeights[i]);
+			partial[aChunk] = sum;
+		});
+		double sum = 0.0;
+		for (const double p : partial) sum += p;
+		return sum;
+	}
+}
+
+bool AliasTable::build(const float* aWeights, const size_t aCount)
+{
+	mEntries.clear();
+	if (!aCount) return false;
+	const double sum = sumWeights(aWeights, aCount);
+	if (!(sum > 0.0) || !std::isfinite(sum)) return false;
+
+	mEntries.resize(aCount);
+	std::vector<double> scaled(aCount);
+	const auto fill = [&](const size_t aBegin, const size_t aEnd) {
+		for (size_t i = aBegin; i < aEnd; i++) {
+			const double p = std::isfinite(aWeights[i]) && aWeights[i] > 0.0f ? aWeights[i] / sum : 0.0;
+			mEntries[i] = { 1.0f, static_cast<uint32_t>(i), static_cast<float>(p) };
+			scaled[i] = p * static_cast<double>(aCount);
+		}
+	};
+	if (aCount <= PARALLEL_CHUNK_SIZE) fill(0, aCount);
+	else {
+		const size_t chunkCount = (aCount + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+		ThreadPool::getInstance().parallelFor(0, chunkCount, [&](const size_t aChunk) {
+			fill(aChunk * PARALLEL_CHUNK_SIZE, std::min(aCount, (aChunk + 1) * PARALLEL_CHUNK_SIZE));
+		});
+	}
+
+	// zero weights are paired first so rounding leftovers at the end can only be entries with a weight
+	std::vector<uint32_t> small, large;
+	small.reserve(aCount);
+	large.reserve(aCount);
+	for (size_t i = 0; i < aCount; i++) if (scaled[i] > 0.0) (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+	for (size_t i = 0; i < aCount; i++) if (scaled[i] <= 0.0) small.push_back(static_cast<uint32_t>(i));
+	while (!small.empty() && !large.empty()) {
+		const uint32_t s = small.back(); small.pop_back();
+		const uint32_t l = large.back();
+		mEntries[s].probability = static_cast<float>(scaled[s]);
+		mEntries[s].alias = l;
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+		if (scaled[l] < 1.0) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	
+	for (const uint32_t i : large) mEntries[i].probability = 1.0f;
+	for (const uint32_t i : small) mEntries[i].probability = 1.0f;
+	return true;
+}
+
+uint32_t AliasTable::sample(const float aU) const
+{
+	const auto count = static_cast<uint32_t>(mEntries.size());
+	const float u = aU * static_cast<float>(count);
+	const uint32_t i = std::min(static_cast<uint32_t>(u), count - 1);
+	const AliasTableEntry_s& entry = mEntries[i];
+	return (u - static_cast<float>(i)) < entry.probability ? i : entry.alias;
+}
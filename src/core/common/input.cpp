@@ -1,5 +1,9 @@
 #include <tamashii/core/common/input.hpp>
 #include <tamashii/core/common/common.hpp>
+#include <tamashii/core/common/vars.hpp>
+
+#include <algorithm>
+#include <chrono>
 
 T_USE_NAMESPACE
 
@@ -34,29 +38,53 @@ glm::vec2 InputSystem::getMouseWheelRelative() const
 	return mMouseWheelRelative;
 }
 
+EventSystem::EventSystem() : mEventQueue(MAX_QUEUED_EVENTS), mQueued{ 0 }, mDropped{ 0 }, mProcessed{ 0 }, mReportedDropped(0)
+{}
+
 void EventSystem::queueEvent(const EventType aType, const Input aInput, const int aValue, const float aX, const float aY, std::string_view aString) {
 	EventSystem& es = getInstance();
 	
-	const std::lock_guard lock(es.mMutex);
-	Event* ev = &es.mEventQue[es.mEventHead & MASK_QUED_EVENTS];
-
-	if (es.mEventHead - es.mEventTail >= MAX_QUED_EVENTS) {
-		
-		
-		es.mEventTail++;
+	Event ev;
+	ev.mType = aType;
+	ev.mInput = aInput;
+	ev.mValue = aValue;
+	ev.mX = aX;
+	ev.mY = aY;
+	ev.mMessage = aString;
+
+	if (!es.mEventQueue.tryPush(std::move(ev))) {
+		bool queued = false;
+		if (es.mConsumerThread.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+			// the consumer can not wait for itself, it makes room by dropping the oldest event like the old queue did
+			Event oldest;
+			while (!queued && es.mEventQueue.tryPop(oldest)) {
+				es.mDropped.fetch_add(1, std::memory_order_relaxed);
+				queued = es.mEventQueue.tryPush(std::move(ev));
+			}
+		}
+		else {
+			// a dropped key release would leave the key down, key events wait longer
+			const uint32_t waitMs = ev.isKeyEvent() ? std::max(var::event_queue_wait.value(), var::event_queue_key_wait.value()) : var::event_queue_wait.value();
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(waitMs);
+			while (waitMs && !(queued = es.mEventQueue.tryPush(std::move(ev))) && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+		}
+		if (!queued) {
+			es.mDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
 	}
-	es.mEventHead++;
-
-	ev->mType = aType;
-	ev->mInput = aInput;
-	ev->mValue = aValue;
-	ev->mX = aX;
-	ev->mY = aY;
-	ev->mMessage = aString;
+	es.mQueued.fetch_add(1, std::memory_order_relaxed);
 }
 
 void EventSystem::eventLoop()
 {
+	mConsumerThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+	const uint64_t dropped = mDropped.load(std::memory_order_relaxed);
+	if (dropped != mReportedDropped) {
+		spdlog::warn("EventSystem: event queue full, dropped {} events", dropped - mReportedDropped);
+		mReportedDropped = dropped;
+	}
+
 	InputSystem& is = InputSystem::getInstance();
 	is.mMousePosRelative = { 0, 0 };
 	is.mMouseWheelRelative = { 0, 0 };
@@ -78,13 +106,12 @@ void EventSystem::eventLoop()
 }
 
 void EventSystem::clearEventQueue() {
-	const std::lock_guard lock(mMutex);
-	mEventHead = mEventTail = 0;
+	Event ev;
+	while (mEventQueue.tryPop(ev)) {}
 }
 
 void EventSystem::reset()
 {
-	const std::lock_guard lock(mMutex);
 	InputSystem& is = InputSystem::getInstance();
 	is.mMousePosRelative = { 0, 0 };
 	is.mMouseWheelRelative = { 0, 0 };
@@ -97,34 +124,30 @@ void EventSystem::reset()
 void EventSystem::setCallback(const EventType aEventType, const Input aInput, const std::function<bool(const Event&)>&
                               aCallback)
 {
-	const auto it = mCallbacks.find(aEventType);
-	if (it == mCallbacks.end()) mCallbacks.insert({ aEventType , {} });
+	auto& callbacks = mCallbacks[static_cast<size_t>(aEventType)];
+	if (callbacks.empty()) callbacks.resize(INPUT_COUNT);
+	// the first callback registered for an input stays
+	auto& callback = callbacks[static_cast<size_t>(aInput)];
+	if (!callback) callback = aCallback;
+}
 
-	const auto& it2 = mCallbacks.find(aEventType);
-	it2->second.insert({ aInput, aCallback });
+EventSystem::Stats EventSystem::getStats() const
+{
+	return { mQueued.load(std::memory_order_relaxed), mDropped.load(std::memory_order_relaxed), mProcessed.load(std::memory_order_relaxed) };
 }
 
 Event EventSystem::getEvent()
 {
-	const std::lock_guard lock(mMutex);
-	
-	if (mEventHead > mEventTail) {
-		mEventTail++;
-		return mEventQue[(mEventTail - 1) & MASK_QUED_EVENTS];
-	}
-	return Event{};
+	Event ev;
+	if (mEventQueue.tryPop(ev)) mProcessed.fetch_add(1, std::memory_order_relaxed);
+	return ev;
 }
 
 void EventSystem::processEvent(const Event& aEvent)
 {
-	if (!mCallbacks.empty()) {
-		const auto& it = mCallbacks.find(aEvent.mType);
-		if (it != mCallbacks.end())
-		{
-			const auto& it2 = it->second.find(aEvent.mInput);
-			if ((it2 != it->second.end()) && it2->second(aEvent)) return;
-		}
-	}
+	const auto& callbacks = mCallbacks[static_cast<size_t>(aEvent.mType)];
+	const auto input = static_cast<size_t>(aEvent.mInput);
+	if (input < callbacks.size() && callbacks[input] && callbacks[input](aEvent)) return;
 
 	InputSystem& inputSystem = InputSystem::getInstance();
 	if (aEvent.isKeyEvent()) {
@@ -0,0 +1,313 @@
+#include <tamashii/core/common/light_tree.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+T_USE_NAMESPACE
+
+namespace {
+	constexpr uint32_t BUCKET_COUNT = 12;
+	// below this depth splits are chosen by cost, deeper nodes are split at the median so trails fit in 64 bit
+	constexpr uint32_t COST_SPLIT_MAX_DEPTH = 32;
+	constexpr float ONE_MINUS_EPSILON = 0x1.fffffep-1f;
+	constexpr float PI = 3.14159265358979323846f;
+
+	float safeSqrt(const float aX) { return std::sqrt(std::max(aX, 0.0f)); }
+	float safeAcos(const float aX) { return std::acos(std::clamp(aX, -1.0f, 1.0f)); }
+	// cos(max(0, a - b)) and sin(max(0, a - b)) of two angles given by sine and cosine
+	float cosSubClamped(const float aSinA, const float aCosA, const float aSinB, const float aCosB)
+	{ return aCosA > aCosB ? 1.0f : aCosA * aCosB + aSinA * aSinB; }
+	float sinSubClamped(const float aSinA, const float aCosA, const float aSinB, const float aCosB)
+	{ return aCosA > aCosB ? 0.0f : aSinA * aCosB - aCosA * aSinB; }
+
+	struct Cone {
+		glm::vec3									mAxis = glm::vec3(0.0f);
+		float										mCosThetaO = 1.0f;
+		float										mCosThetaE = 1.0f;
+		bool										mEmpty = true;
+	};
+
+	// smallest cone containing both normal cones, the falloff is the larger of the two
+	Cone unionCone(const Cone& aA, const Cone& aB)
+	{
+		if (aA.mEmpty) return aB;
+		if (aB.mEmpty) return aA;
+		Cone cone = aA;
+		cone.mCosThetaE = std::min(aA.mCosThetaE, aB.mCosThetaE);
+		const float thetaA = safeAcos(aA.mCosThetaO);
+		const float thetaB = safeAcos(aB.mCosThetaO);
+		const float thetaD = safeAcos(glm::dot(aA.mAxis, aB.mAxis));
+		if (std::min(thetaD + thetaB, PI) <= thetaA) return cone;
+		if (std::min(thetaD + thetaA, PI) <= thetaB) {
+			cone.mAxis = aB.mAxis;
+			cone.mCosThetaO = aB.mCosThetaO;
+			return cone;
+		}
+		const float thetaO = (thetaA + thetaD + thetaB) * 0.5f;
+		const glm::vec3 rotationAxis = glm::cross(aA.mAxis, aB.mAxis);
+		if (thetaO >= PI || glm::dot(rotationAxis, rotationAxis) == 0.0f) {
+			cone.mCosThetaO = -1.0f;
+			return cone;
+		}
+		// rotate the axis of a towards b by theta_o - theta_a
+		const float thetaR = thetaO - thetaA;
+		const glm::vec3 k = glm::normalize(rotationAxis);
+		cone.mAxis = glm::normalize(aA.mAxis * std::cos(thetaR) + glm::cross(k, aA.mAxis) * std::sin(thetaR));
+		cone.mCosThetaO = std::cos(thetaO);
+		return cone;
+	}
+
+	struct Bounds {
+		glm::vec3									mMin = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3									mMax = glm::vec3(-std::numeric_limits<float>::max());
+		Cone										mCone;
+		double										mPower = 0.0;
+
+		void										add(const LightTreeLight& aLight)
+													{
+														mMin = glm::min(mMin, aLight.mMin);
+														mMax = glm::max(mMax, aLight.mMax);
+														mCone = unionCone(mCone, { aLight.mAxis, aLight.mCosThetaO, aLight.mCosThetaE, false });
+														mPower += aLight.mPower;
+													}
+		void										add(const Bounds& aBounds)
+													{
+														if (aBounds.mCone.mEmpty) return;
+														mMin = glm::min(mMin, aBounds.mMin);
+														mMax = glm::max(mMax, aBounds.mMax);
+														mCone = unionCone(mCone, aBounds.mCone);
+														mPower += aBounds.mPower;
+													}
+	};
+
+	// measure of the directions the cone emits to, see Conty and Kulla, Importance Sampling of Many Lights
+	// with Adaptive Tree Splitting
+	float orientationMeasure(const Cone& aCone)
+	{
+		const float thetaO = safeAcos(aCone.mCosThetaO);
+		const float thetaW = std::min(thetaO + safeAcos(aCone.mCosThetaE), PI);
+		const float sinThetaO = safeSqrt(1.0f - aCone.mCosThetaO * aCone.mCosThetaO);
+		return 2.0f * PI * (1.0f - aCone.mCosThetaO) + PI / 2.0f * (2.0f * thetaW * sinThetaO - std::cos(thetaO - 2.0f * thetaW) -
+			2.0f * thetaO * sinThetaO + aCone.mCosThetaO);
+	}
+
+	float cost(const Bounds& aBounds, const float aPadding, const float aKr)
+	{
+		if (aBounds.mCone.mEmpty) return 0.0f;
+		const glm::vec3 d = aBounds.mMax - aBounds.mMin + aPadding;
+		const float area = 2.0f * (d.x * d.y + d.x * d.z + d.y * d.z);
+		return static_cast<float>(aBounds.mPower) * area * orientationMeasure(aBounds.mCone) * aKr;
+	}
+
+	glm::vec3 centroid(const LightTreeLight& aLight) { return (aLight.mMin + aLight.mMax) * 0.5f; }
+}
+
+void LightTree::build(const std::vector<LightTreeLight>& aLights)
+{
+	clear();
+	mLocations.assign(aLights.size(), { 0, std::numeric_limits<uint32_t>::max() });
+	std::vector<uint32_t> bounded;
+	std::vector<uint32_t> infinite;
+	for (uint32_t i = 0; i < aLights.size(); i++) {
+		if (!(aLights[i].mPower > 0.0f) || !std::isfinite(aLights[i].mPower)) continue;
+		(aLights[i].mInfinite ? infinite : bounded).push_back(i);
+	}
+
+	mNodes.reserve(2 * bounded.size() + infinite.size());
+	if (!bounded.empty()) buildRecursive(bounded, 0, bounded.size(), aLights, 0, 0);
+	mTreeNodeCount = static_cast<uint32_t>(mNodes.size());
+	for (const uint32_t i : infinite) {
+		LightTreeNode_s node = {};
+		node.power = aLights[i].mPower;
+		node.light_index = i;
+		node.is_leaf = 1;
+		mLocations[i] = { 0, static_cast<uint32_t>(mNodes.size()) };
+		mNodes.push_back(node);
+	}
+}
+
+void LightTree::clear()
+{
+	mNodes.clear();
+	mLocations.clear();
+	mTreeNodeCount = 0;
+}
+
+uint32_t LightTree::buildRecursive(std::vector<uint32_t>& aIndices, const size_t aBegin, const size_t aEnd, const std::vector<LightTreeLight>& aLights,
+	const uint32_t aDepth, const uint64_t aTrail)
+{
+	Bounds bounds;
+	glm::vec3 centroidMin(std::numeric_limits<float>::max()), centroidMax(-std::numeric_limits<float>::max());
+	for (size_t i = aBegin; i < aEnd; i++) {
+		bounds.add(aLights[aIndices[i]]);
+		centroidMin = glm::min(centroidMin, centroid(aLights[aIndices[i]]));
+		centroidMax = glm::max(centroidMax, centroid(aLights[aIndices[i]]));
+	}
+
+	const auto nodeIndex = static_cast<uint32_t>(mNodes.size());
+	LightTreeNode_s node = {};
+	node.min = bounds.mMin;
+	node.max = bounds.mMax;
+	node.power = static_cast<float>(bounds.mPower);
+	node.axis = bounds.mCone.mAxis;
+	node.cos_theta_o = bounds.mCone.mCosThetaO;
+	node.cos_theta_e = bounds.mCone.mCosThetaE;
+	mNodes.push_back(node);
+	if (aEnd - aBegin == 1) {
+		mNodes[nodeIndex].light_index = aIndices[aBegin];
+		mNodes[nodeIndex].is_leaf = 1;
+		mLocations[aIndices[aBegin]] = { aTrail, nodeIndex };
+		return nodeIndex;
+	}
+
+	// binned split on the centroids with the lowest power, area and orientation cost
+	const glm::vec3 extent = centroidMax - centroidMin;
+	const float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+	const float padding = 1e-4f * glm::length(bounds.mMax - bounds.mMin);
+	float bestCost = std::numeric_limits<float>::max();
+	int bestAxis = -1;
+	uint32_t bestBucket = 0;
+	const auto bucketOf = [&](const uint32_t aLight, const int aAxis) {
+		const float t = (centroid(aLights[aLight])[aAxis] - centroidMin[aAxis]) / extent[aAxis];
+		return std::min(static_cast<uint32_t>(t * BUCKET_COUNT), BUCKET_COUNT - 1);
+	};
+	if (aDepth < COST_SPLIT_MAX_DEPTH) {
+		for (int axis = 0; axis < 3; axis++) {
+			if (!(extent[axis] > 0.0f)) continue;
+			std::array<Bounds, BUCKET_COUNT> buckets;
+			for (size_t i = aBegin; i < aEnd; i++) buckets[bucketOf(aIndices[i], axis)].add(aLights[aIndices[i]]);
+
+			// costs of all splits behind bucket i from the left and from the right
+			std::array<float, BUCKET_COUNT - 1> costs {};
+			Bounds below, above;
+			const float kr = maxExtent / extent[axis];
+			for (uint32_t i = 0; i < BUCKET_COUNT - 1; i++) {
+				below.add(buckets[i]);
+				costs[i] = cost(below, padding, kr);
+			}
+			for (uint32_t i = BUCKET_COUNT - 1; i > 0; i--) {
+				above.add(buckets[i]);
+				costs[i - 1] += cost(above, padding, kr);
+			}
+			for (uint32_t i = 0; i < BUCKET_COUNT - 1; i++) {
+				if (costs[i] > 0.0f && costs[i] < bestCost) {
+					bestCost = costs[i];
+					bestAxis = axis;
+					bestBucket = i;
+				}
+			}
+		}
+	}
+
+	const auto first = aIndices.begin() + static_cast<ptrdiff_t>(aBegin);
+	const auto last = aIndices.begin() + static_cast<ptrdiff_t>(aEnd);
+	auto mid = bestAxis == -1 ? first : std::partition(first, last, [&](const uint32_t aLight) { return bucketOf(aLight, bestAxis) <= bestBucket; });
+	if (mid == first || mid == last) {
+		const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		mid = first + (last - first) / 2;
+		std::nth_element(first, mid, last, [&](const uint32_t aA, const uint32_t aB) { return centroid(aLights[aA])[axis] < centroid(aLights[aB])[axis]; });
+	}
+	const size_t split = static_cast<size_t>(mid - aIndices.begin());
+	buildRecursive(aIndices, aBegin, split, aLights, aDepth + 1, aTrail);
+	mNodes[nodeIndex].second_child = buildRecursive(aIndices, split, aEnd, aLights, aDepth + 1, aTrail | (1ull << aDepth));
+	return nodeIndex;
+}
+
+float LightTree::importance(const LightTreeNode_s& aNode, const glm::vec3& aP, const glm::vec3& aN)
+{
+	const glm::vec3 center = (aNode.min + aNode.max) * 0.5f;
+	const glm::vec3 d = aP - center;
+	const float distance2 = glm::dot(d, d);
+	const float radius2 = glm::dot(aNode.max - center, aNode.max - center);
+	const float d2 = std::max(distance2, std::max(glm::length(aNode.max - aNode.min) * 0.5f, 1e-8f));
+
+	const glm::vec3 wi = distance2 > 0.0f ? d / std::sqrt(distance2) : glm::vec3(0.0f);
+	const float cosThetaW = glm::dot(aNode.axis, wi);
+	const float sinThetaW = safeSqrt(1.0f - cosThetaW * cosThetaW);
+	// angle of the sphere around the bounds seen from the point, everything if the point is inside
+	const float cosThetaB = distance2 < radius2 ? -1.0f : safeSqrt(1.0f - radius2 / distance2);
+	const float sinThetaB = safeSqrt(1.0f - cosThetaB * cosThetaB);
+	const float sinThetaO = safeSqrt(1.0f - aNode.cos_theta_o * aNode.cos_theta_o);
+
+	// smallest angle between the emission cone and the point
+	const float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, aNode.cos_theta_o);
+	const float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, aNode.cos_theta_o);
+	const float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP <= aNode.cos_theta_e) return 0.0f;
+
+	float importance = aNode.power * cosThetaP / d2;
+	if (aN != glm::vec3(0.0f)) {
+		const float cosThetaI = std::abs(glm::dot(wi, aN));
+		const float sinThetaI = safeSqrt(1.0f - cosThetaI * cosThetaI);
+		importance *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+	}
+	return std::max(importance, 0.0f);
+}
+
+float LightTree::infiniteProbability() const
+{
+	const uint32_t infiniteCount = getInfiniteLightCount();
+	if (!infiniteCount) return 0.0f;
+	return mTreeNodeCount ? static_cast<float>(infiniteCount) / static_cast<float>(infiniteCount + 1) : 1.0f;
+}
+
+int LightTree::sample(const glm::vec3& aP, const glm::vec3& aN, float aU, float& aPdf) const
+{
+	aPdf = 0.0f;
+	if (mNodes.empty()) return -1;
+	const float pInfinite = infiniteProbability();
+	if (aU < pInfinite) {
+		const uint32_t infiniteCount = getInfiniteLightCount();
+		const uint32_t i = std::min(static_cast<uint32_t>(aU / pInfinite * static_cast<float>(infiniteCount)), infiniteCount - 1);
+		aPdf = pInfinite / static_cast<float>(infiniteCount);
+		return static_cast<int>(mNodes[mTreeNodeCount + i].light_index);
+	}
+
+	aU = std::min((aU - pInfinite) / (1.0f - pInfinite), ONE_MINUS_EPSILON);
+	float pdf = 1.0f - pInfinite;
+	uint32_t nodeIndex = 0;
+	while (true) {
+		const LightTreeNode_s& node = mNodes[nodeIndex];
+		if (node.is_leaf) {
+			if (importance(node, aP, aN) <= 0.0f) return -1;
+			aPdf = pdf;
+			return static_cast<int>(node.light_index);
+		}
+		const float i0 = importance(mNodes[nodeIndex + 1], aP, aN);
+		const float i1 = importance(mNodes[node.second_child], aP, aN);
+		if (i0 <= 0.0f && i1 <= 0.0f) return -1;
+		const float p0 = i0 / (i0 + i1);
+		if (aU < p0) {
+			nodeIndex = nodeIndex + 1;
+			pdf *= p0;
+			aU = std::min(aU / p0, ONE_MINUS_EPSILON);
+		} else {
+			nodeIndex = node.second_child;
+			pdf *= 1.0f - p0;
+			aU = std::min((aU - p0) / (1.0f - p0), ONE_MINUS_EPSILON);
+		}
+	}
+}
+
+float LightTree::pdf(const glm::vec3& aP, const glm::vec3& aN, const uint32_t aLightIndex) const
+{
+	if (aLightIndex >= mLocations.size() || mLocations[aLightIndex].mNode == std::numeric_limits<uint32_t>::max()) return 0.0f;
+	const float pInfinite = infiniteProbability();
+	if (mLocations[aLightIndex].mNode >= mTreeNodeCount) return pInfinite / static_cast<float>(getInfiniteLightCount());
+
+	float pdf = 1.0f - pInfinite;
+	uint64_t trail = mLocations[aLightIndex].mTrail;
+	uint32_t nodeIndex = 0;
+	while (!mNodes[nodeIndex].is_leaf) {
+		const LightTreeNode_s& node = mNodes[nodeIndex];
+		const float i0 = importance(mNodes[nodeIndex + 1], aP, aN);
+		const float i1 = importance(mNodes[node.second_child], aP, aN);
+		if (i0 <= 0.0f && i1 <= 0.0f) return 0.0f;
+		const bool second = trail & 1;
+		pdf *= (second ? i1 : i0) / (i0 + i1);
+		nodeIndex = second ? node.second_child : nodeIndex + 1;
+		trail >>= 1;
+	}
+	return importance(mNodes[nodeIndex], aP, aN) > 0.0f ? pdf : 0.0f;
+}
@@ -0,0 +1,116 @@
+#include <tamashii/core/common/profiler.hpp>
+#include <tamashii/core/common/vars.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+T_USE_NAMESPACE
+
+namespace {
+	uint64_t steadyNs()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	void writeJsonString(std::ofstream& aOut, const char* aString)
+	{
+		aOut << '"';
+		for (const char* c = aString; *c; c++) {
+			if (*c == '"' || *c == '\\') aOut << '\\';
+			if (static_cast<unsigned char>(*c) >= 0x20) aOut << *c;
+		}
+		aOut << '"';
+	}
+}
+
+Profiler::Profiler() : mEnabled{ false }, mStart{ steadyNs() }
+{}
+
+void Profiler::setEnabled(const bool aEnabled)
+{
+	mEnabled.store(aEnabled, std::memory_order_relaxed);
+}
+
+uint64_t Profiler::now() const
+{
+	return steadyNs() - mStart;
+}
+
+void Profiler::record(const char* aName, const uint64_t aBegin, const uint64_t aEnd)
+{
+	ThreadBuffer& buffer = threadBuffer();
+	const uint64_t head = buffer.mHead.load(std::memory_order_relaxed);
+	Slot& slot = buffer.mSlots[head % buffer.mSlots.size()];
+	// odd while written, so an export running at the same time can tell that the slot is torn
+	slot.mSequence.store(2 * head + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.mName.store(aName, std::memory_order_relaxed);
+	slot.mBegin.store(aBegin, std::memory_order_relaxed);
+	slot.mDuration.store(aEnd - aBegin, std::memory_order_relaxed);
+	slot.mSequence.store(2 * head + 2, std::memory_order_release);
+	buffer.mHead.store(head + 1, std::memory_order_release);
+}
+
+Profiler::ThreadBuffer& Profiler::threadBuffer()
+{
+	thread_local ThreadBuffer* buffer = nullptr;
+	if (buffer) return *buffer;
+
+	// the profiler keeps the buffer alive so events of finished threads are still exported
+	const auto b = std::make_shared<ThreadBuffer>();
+	b->mSlots = std::vector<Slot>(std::max(1u, var::profile_buffer_size.value()));
+	b->mHead = 0;
+	b->mFirst = 0;
+	const std::lock_guard lock(mMutex);
+	b->mThreadId = static_cast<uint32_t>(mBuffers.size());
+	mBuffers.push_back(b);
+	buffer = b.get();
+	return *buffer;
+}
+
+bool Profiler::exportChromeTrace(const std::string& aFile) const
+{
+	std::ofstream out(aFile, std::ios::trunc);
+	if (!out.is_open()) {
+		spdlog::error("Profiler: could not open {}", aFile);
+		return false;
+	}
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	out.precision(3);
+	out << std::fixed;
+	bool first = true;
+	size_t count = 0;
+	const std::lock_guard lock(mMutex);
+	for (const std::shared_ptr<ThreadBuffer>& buffer : mBuffers) {
+		const uint64_t head = buffer->mHead.load(std::memory_order_acquire);
+		const uint64_t size = buffer->mSlots.size();
+		for (uint64_t i = std::max(head > size ? head - size : 0, buffer->mFirst.load(std::memory_order_relaxed)); i < head; i++) {
+			const Slot& slot = buffer->mSlots[i % size];
+			const uint64_t sequence = slot.mSequence.load(std::memory_order_acquire);
+			const Event e = { slot.mName.load(std::memory_order_relaxed), slot.mBegin.load(std::memory_order_relaxed), slot.mDuration.load(std::memory_order_relaxed) };
+			std::atomic_thread_fence(std::memory_order_acquire);
+			// the owner has wrapped around and is writing or has written a newer event into this slot
+			if (sequence != 2 * i + 2 || slot.mSequence.load(std::memory_order_relaxed) != sequence) continue;
+			if (!first) out << ',';
+			first = false;
+			// chrome trace timestamps are in microseconds
+			out << "{\"name\":";
+			writeJsonString(out, e.mName);
+			out << ",\"cat\":\"tamashii\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->mThreadId
+				<< ",\"ts\":" << static_cast<double>(e.mBegin) * 1e-3 << ",\"dur\":" << static_cast<double>(e.mDuration) * 1e-3 << '}';
+			count++;
+		}
+	}
+	out << "]}\n";
+	spdlog::info("Profiler: exported {} events of {} threads to {}", count, mBuffers.size(), aFile);
+	return true;
+}
+
+void Profiler::clear()
+{
+	// only the owning thread writes the head, clearing moves the first exported event instead
+	const std::lock_guard lock(mMutex);
+	for (const std::shared_ptr<ThreadBuffer>& buffer : mBuffers) buffer->mFirst.store(buffer->mHead.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
@@ -0,0 +1,84 @@
+#include <tamashii/core/common/range_allocator.hpp>
+
+#include <algorithm>
+#include <iterator>
+
+T_USE_NAMESPACE
+
+RangeAllocator::RangeAllocator(const uint64_t aCapacity) : mCapacity(0), mUsed(0)
+{
+	reset(aCapacity);
+}
+
+void RangeAllocator::reset(const uint64_t aCapacity)
+{
+	mFree.clear();
+	mCapacity = aCapacity;
+	mUsed = 0;
+	if (aCapacity) mFree.emplace(0, aCapacity);
+}
+
+uint64_t RangeAllocator::allocate(const uint64_t aSize)
+{
+	if (aSize == 0) return INVALID;
+	for (auto it = mFree.begin(); it != mFree.end(); ++it) {
+		if (it->second < aSize) continue;
+		const uint64_t offset = it->first;
+		const uint64_t remaining = it->second - aSize;
+		mFree.erase(it);
+		if (remaining) mFree.emplace(offset + aSize, remaining);
+		mUsed += aSize;
+		return offset;
+	}
+	return INVALID;
+}
+
+void RangeAllocator::free(uint64_t aOffset, uint64_t aSize)
+{
+	if (aSize == 0) return;
+	if (aOffset + aSize > mCapacity) {
+		spdlog::error("RangeAllocator: range [{}, {}) is outside of the capacity {}", aOffset, aOffset + aSize, mCapacity);
+		return;
+	}
+	mUsed -= aSize;
+
+	auto next = mFree.lower_bound(aOffset);
+	if (next != mFree.begin()) {
+		const auto prev = std::prev(next);
+		if (prev->first + prev->second == aOffset) {
+			aOffset = prev->first;
+			aSize += prev->second;
+			mFree.erase(prev);
+		}
+	}
+	if (next != mFree.end() && aOffset + aSize == next->first) {
+		aSize += next->second;
+		mFree.erase(next);
+	}
+	mFree.emplace(aOffset, aSize);
+}
+
+void RangeAllocator::grow(const uint64_t aCapacity)
+{
+	if (aCapacity <= mCapacity) return;
+	const uint64_t added = aCapacity - mCapacity;
+	const uint64_t offset = mCapacity;
+	mCapacity = aCapacity;
+	// add the new space as a used range and free it, so it merges with a free tail
+	mUsed += added;
+	free(offset, added);
+}
+
+uint64_t RangeAllocator::end() const
+{
+	if (mFree.empty()) return mCapacity;
+	const auto& last = *mFree.rbegin();
+	return last.first + last.second == mCapacity ? last.first : mCapacity;
+}
+
+uint64_t RangeAllocator::largestFreeRange() const
+{
+	uint64_t largest = 0;
+	for (const auto& range : mFree) largest = std::max(largest, range.second);
+	return largest;
+}
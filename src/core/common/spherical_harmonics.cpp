@@ -0,0 +1,322 @@
+#include <tamashii/core/common/spherical_harmonics.hpp>
+#include <tamashii/core/common/thread_pool.hpp>
+
+#include <algorithm>
+#include <cmath>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+T_USE_NAMESPACE
+
+namespace {
+	constexpr float SQRT2 = 1.414213562373095f;
+	constexpr double PI = 3.14159265358979323846;
+	constexpr size_t PARALLEL_CHUNK_SIZE = 1 << 14;
+
+	/*
+	 * normalized associated legendre recurrence (K_l^m P_l^m without the sin(theta)^m factor):
+	 * N_m^m = diag_m * N_m-1^m-1, N_m+1^m = sub_m * x * N_m^m, N_l^m = a_lm * (x * N_l-1^m - b_lm * N_l-2^m)
+	 */
+	struct Recurrence {
+		uint32_t				mOrder;
+		std::vector<float>		mDiag;
+		std::vector<float>		mSub;
+		std::vector<float>		mA;
+		std::vector<float>		mB;
+
+		explicit Recurrence(const uint32_t aOrder) : mOrder(aOrder), mDiag(aOrder + 1, 1.0f), mSub(aOrder + 1, 0.0f),
+			mA(sh::coefficientCount(aOrder), 0.0f), mB(sh::coefficientCount(aOrder), 0.0f)
+		{
+			for (uint32_t m = 1; m <= aOrder; m++) mDiag[m] = static_cast<float>(-std::sqrt((2.0 * m + 1.0) / (2.0 * m)));
+			for (uint32_t m = 0; m <= aOrder; m++) mSub[m] = static_cast<float>(std::sqrt(2.0 * m + 3.0));
+			for (uint32_t m = 0; m <= aOrder; m++) {
+				for (uint32_t l = m + 2; l <= aOrder; l++) {
+					const double l2 = static_cast<double>(l) * l, lm1 = static_cast<double>(l - 1) * (l - 1), m2 = static_cast<double>(m) * m;
+					mA[sh::index(l, m)] = static_cast<float>(std::sqrt((4.0 * l2 - 1.0) / (l2 - m2)));
+					mB[sh::index(l, m)] = static_cast<float>(std::sqrt((lm1 - m2) / (4.0 * lm1 - 1.0)));
+				}
+			}
+		}
+
+		// aX, aY: direction components carrying sin(theta)^m through (x + iy)^m, aArg: legendre argument,
+		// aScale: per m correction of sin(theta) (1 for SH), aStore(index, value)
+		template<typename T, typename Store>
+		void eval(const T aX, const T aY, const T aArg, const T aScale, Store&& aStore) const
+		{
+			T c(1.0f), s(0.0f), power(1.0f), nmm(1.0f);
+			for (uint32_t m = 0; m <= mOrder; m++) {
+				if (m > 0) {
+					const T cn = aX * c - aY * s;
+					s = aX * s + aY * c;
+					c = cn;
+					power = power * aScale;
+					nmm = nmm * T(mDiag[m]);
+				}
+				const T cm = c * power * T(SQRT2);
+				const T sm = s * power * T(SQRT2);
+				const auto emit = [&](const uint32_t aL, const T aN) {
+					if (m == 0) aStore(sh::index(static_cast<int>(aL), 0), aN);
+					else {
+						aStore(sh::index(static_cast<int>(aL), static_cast<int>(m)), aN * cm);
+						aStore(sh::index(static_cast<int>(aL), -static_cast<int>(m)), aN * sm);
+					}
+				};
+				emit(m, nmm);
+				if (m == mOrder) break;
+				T p2 = nmm;
+				T p1 = aArg * T(mSub[m]) * nmm;
+				emit(m + 1, p1);
+				for (uint32_t l = m + 2; l <= mOrder; l++) {
+					const uint32_t idx = sh::index(static_cast<int>(l), static_cast<int>(m));
+					const T n = T(mA[idx]) * (aArg * p1 - T(mB[idx]) * p2);
+					emit(l, n);
+					p2 = p1;
+					p1 = n;
+				}
+			}
+		}
+	};
+
+#ifdef __AVX2__
+	struct Lanes {
+		__m256 v;
+		Lanes(const __m256 aV) : v(aV) {}
+		explicit Lanes(const float aF) : v(_mm256_set1_ps(aF)) {}
+		friend Lanes operator+(const Lanes a, const Lanes b) { return _mm256_add_ps(a.v, b.v); }
+		friend Lanes operator-(const Lanes a, const Lanes b) { return _mm256_sub_ps(a.v, b.v); }
+		friend Lanes operator*(const Lanes a, const Lanes b) { return _mm256_mul_ps(a.v, b.v); }
+	};
+#endif
+
+	// hemisphere directions below the horizon are moved onto it, like the theta clamp on the gpu
+	void clampToHemisphere(float& aX, float& aY, float& aZ)
+	{
+		if (aZ < 0.0f) {
+			const float r = std::sqrt(aX * aX + aY * aY);
+			if (r > 0.0f) { aX /= r; aY /= r; }
+			aZ = 0.0f;
+		}
+		aZ = std::min(aZ, 1.0f);
+	}
+
+	void evalScalar(const Recurrence& aRec, const bool aHemisphere, float aX, float aY, float aZ, float* aOut, const size_t aStride)
+	{
+		const auto store = [&](const uint32_t aIndex, const float aValue) { aOut[aIndex * aStride] = aValue; };
+		if (aHemisphere) {
+			clampToHemisphere(aX, aY, aZ);
+			aRec.eval(aX, aY, 2.0f * aZ - 1.0f, std::sqrt(4.0f * aZ / (1.0f + aZ)), store);
+		}
+		else aRec.eval(aX, aY, aZ, 1.0f, store);
+	}
+
+	void evalRange(const Recurrence& aRec, const bool aHemisphere, const float* aX, const float* aY, const float* aZ,
+		const size_t aBegin, const size_t aEnd, const size_t aStride, float* aOut)
+	{
+		size_t i = aBegin;
+#ifdef __AVX2__
+		for (; i + 8 <= aEnd; i += 8) {
+			__m256 x = _mm256_loadu_ps(aX + i);
+			__m256 y = _mm256_loadu_ps(aY + i);
+			__m256 z = _mm256_loadu_ps(aZ + i);
+			const auto store = [&](const uint32_t aIndex, const Lanes aValue) { _mm256_storeu_ps(aOut + aIndex * aStride + i, aValue.v); };
+			if (aHemisphere) {
+				const __m256 zero = _mm256_setzero_ps();
+				const __m256 one = _mm256_set1_ps(1.0f);
+				const __m256 below = _mm256_cmp_ps(z, zero, _CMP_LT_OQ);
+				const __m256 r2 = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+				const __m256 valid = _mm256_and_ps(below, _mm256_cmp_ps(r2, zero, _CMP_GT_OQ));
+				const __m256 invR = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_max_ps(r2, _mm256_set1_ps(1e-30f))));
+				x = _mm256_blendv_ps(x, _mm256_mul_ps(x, invR), valid);
+				y = _mm256_blendv_ps(y, _mm256_mul_ps(y, invR), valid);
+				z = _mm256_min_ps(_mm256_max_ps(z, zero), one);
+				const __m256 arg = _mm256_sub_ps(_mm256_add_ps(z, z), one);
+				const __m256 scale = _mm256_sqrt_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_set1_ps(4.0f), z), _mm256_add_ps(one, z)));
+				aRec.eval(Lanes(x), Lanes(y), Lanes(arg), Lanes(scale), store);
+			}
+			else aRec.eval(Lanes(x), Lanes(y), Lanes(z), Lanes(1.0f), store);
+		}
+#endif
+		for (; i < aEnd; i++) evalScalar(aRec, aHemisphere, aX[i], aY[i], aZ[i], aOut + i, aStride);
+	}
+
+	void evalBatch(const uint32_t aOrder, const bool aHemisphere, const float* aX, const float* aY, const float* aZ, const size_t aCount, float* aOut)
+	{
+		const Recurrence rec(aOrder);
+		if (aCount <= PARALLEL_CHUNK_SIZE) {
+			evalRange(rec, aHemisphere, aX, aY, aZ, 0, aCount, aCount, aOut);
+			return;
+		}
+		const size_t chunkCount = (aCount + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+		ThreadPool::getInstance().parallelFor(0, chunkCount, [&](const size_t aChunk) {
+			const size_t begin = aChunk * PARALLEL_CHUNK_SIZE;
+			evalRange(rec, aHemisphere, aX, aY, aZ, begin, std::min(aCount, begin + PARALLEL_CHUNK_SIZE), aCount, aOut);
+		});
+	}
+
+	glm::vec3 toLocal(const glm::vec3& aDir, const glm::vec3& aNormal, const glm::vec3& aTangent)
+	{
+		return { glm::dot(aDir, aTangent), glm::dot(aDir, glm::cross(aNormal, aTangent)), glm::dot(aDir, aNormal) };
+	}
+
+	glm::vec3 sumRGB(const uint32_t aOrder, const float* aCoefficients, const std::vector<float>& aBasis)
+	{
+		glm::vec3 color(0.0f);
+		for (uint32_t i = 0; i < sh::coefficientCount(aOrder); i++) {
+			color += aBasis[i] * glm::vec3(aCoefficients[i * 3], aCoefficients[i * 3 + 1], aCoefficients[i * 3 + 2]);
+		}
+		return color;
+	}
+
+	// nodes and weights of the n point gauss-legendre rule on [-1, 1]
+	void gaussLegendre(const uint32_t aN, std::vector<double>& aNodes, std::vector<double>& aWeights)
+	{
+		aNodes.resize(aN);
+		aWeights.resize(aN);
+		for (uint32_t i = 0; i < aN; i++) {
+			double x = std::cos(PI * (i + 0.75) / (aN + 0.5));
+			double dp = 1.0;
+			for (int iter = 0; iter < 100; iter++) {
+				double p0 = 1.0, p1 = x;
+				for (uint32_t k = 2; k <= aN; k++) {
+					const double p2 = ((2.0 * k - 1.0) * x * p1 - (k - 1.0) * p0) / k;
+					p0 = p1;
+					p1 = p2;
+				}
+				dp = aN * (x * p1 - p0) / (x * x - 1.0);
+				const double dx = p1 / dp;
+				x -= dx;
+				if (std::abs(dx) < 1e-15) break;
+			}
+			aNodes[i] = x;
+			aWeights[i] = 2.0 / ((1.0 - x * x) * dp * dp);
+		}
+	}
+
+	// calls aFunc(dir, weight) for the product rule, weights sum up to the area of the (hemi)sphere
+	void quadrature(const uint32_t aResolution, const bool aHemisphere, const std::function<void(const glm::vec3&, double)>& aFunc)
+	{
+		const uint32_t n = std::max(1u, aResolution);
+		const uint32_t phiSteps = 2 * n;
+		std::vector<double> nodes, weights;
+		gaussLegendre(n, nodes, weights);
+		for (uint32_t i = 0; i < n; i++) {
+			const double z = aHemisphere ? 0.5 * (nodes[i] + 1.0) : nodes[i];
+			const double w = (aHemisphere ? 0.5 : 1.0) * weights[i] * 2.0 * PI / phiSteps;
+			const double r = std::sqrt(std::max(0.0, 1.0 - z * z));
+			for (uint32_t j = 0; j < phiSteps; j++) {
+				const double phi = 2.0 * PI * (j + 0.5) / phiSteps;
+				aFunc(glm::vec3(static_cast<float>(r * std::cos(phi)), static_cast<float>(r * std::sin(phi)), static_cast<float>(z)), w);
+			}
+		}
+	}
+
+	void project(const uint32_t aOrder, const bool aHemisphere, const std::function<glm::vec3(const glm::vec3&)>& aFunc, const uint32_t aResolution, std::vector<float>& aCoefficients)
+	{
+		const uint32_t count = sh::coefficientCount(aOrder);
+		const Recurrence rec(aOrder);
+		std::vector<double> sum(count * 3, 0.0);
+		std::vector<float> basis(count);
+		quadrature(aResolution, aHemisphere, [&](const glm::vec3& aDir, const double aWeight) {
+			evalScalar(rec, aHemisphere, aDir.x, aDir.y, aDir.z, basis.data(), 1);
+			const glm::vec3 value = aFunc(aDir);
+			for (uint32_t i = 0; i < count; i++) {
+				for (int c = 0; c < 3; c++) sum[i * 3 + c] += aWeight * basis[i] * value[c];
+			}
+		});
+		const double norm = aHemisphere ? 2.0 * PI : 4.0 * PI;
+		aCoefficients.resize(count * 3);
+		for (uint32_t i = 0; i < count * 3; i++) aCoefficients[i] = static_cast<float>(sum[i] / norm);
+	}
+}
+
+void sh::evalSH(const uint32_t aOrder, const glm::vec3& aDir, float* aOut)
+{
+	evalScalar(Recurrence(aOrder), false, aDir.x, aDir.y, aDir.z, aOut, 1);
+}
+
+void sh::evalHSH(const uint32_t aOrder, const glm::vec3& aLocalDir, float* aOut)
+{
+	evalScalar(Recurrence(aOrder), true, aLocalDir.x, aLocalDir.y, aLocalDir.z, aOut, 1);
+}
+
+void sh::evalHSH(const uint32_t aOrder, const glm::vec3& aDir, const glm::vec3& aNormal, const glm::vec3& aTangent, float* aOut)
+{
+	evalHSH(aOrder, toLocal(aDir, aNormal, aTangent), aOut);
+}
+
+void sh::evalSHBatch(const uint32_t aOrder, const float* aX, const float* aY, const float* aZ, const size_t aCount, float* aOut)
+{
+	evalBatch(aOrder, false, aX, aY, aZ, aCount, aOut);
+}
+
+void sh::evalHSHBatch(const uint32_t aOrder, const float* aX, const float* aY, const float* aZ, const size_t aCount, float* aOut)
+{
+	evalBatch(aOrder, true, aX, aY, aZ, aCount, aOut);
+}
+
+glm::vec3 sh::evalSHSumRGB(const uint32_t aOrder, const float* aCoefficients, const glm::vec3& aDir)
+{
+	std::vector<float> basis(coefficientCount(aOrder));
+	evalSH(aOrder, aDir, basis.data());
+	return sumRGB(aOrder, aCoefficients, basis);
+}
+
+glm::vec3 sh::evalHSHSumRGB(const uint32_t aOrder, const float* aCoefficients, const glm::vec3& aDir, const glm::vec3& aNormal, const glm::vec3& aTangent)
+{
+	std::vector<float> basis(coefficientCount(aOrder));
+	evalHSH(aOrder, aDir, aNormal, aTangent, basis.data());
+	return sumRGB(aOrder, aCoefficients, basis);
+}
+
+void sh::projectSH(const uint32_t aOrder, const std::function<glm::vec3(const glm::vec3&)>& aFunc, const uint32_t aResolution, std::vector<float>& aCoefficients)
+{
+	project(aOrder, false, aFunc, aResolution, aCoefficients);
+}
+
+void sh::projectHSH(const uint32_t aOrder, const std::function<glm::vec3(const glm::vec3&)>& aFunc, const uint32_t aResolution, std::vector<float>& aCoefficients)
+{
+	project(aOrder, true, aFunc, aResolution, aCoefficients);
+}
+
+sh::Rotation::Rotation(const uint32_t aOrder, const glm::mat3& aRotation) : mOrder(aOrder), mBands(aOrder + 1)
+{
+	// D_jk = 1/4pi * integral of Y_j(R^-1 d) Y_k(d), the integrand of band l has degree 2l so order + 1 nodes are exact
+	const uint32_t count = coefficientCount(aOrder);
+	const Recurrence rec(aOrder);
+	const glm::mat3 inverse = glm::transpose(aRotation);
+	std::vector<std::vector<double>> bands(aOrder + 1);
+	for (uint32_t l = 0; l <= aOrder; l++) bands[l].assign((2 * l + 1) * (2 * l + 1), 0.0);
+	std::vector<float> basis(count), rotated(count);
+	quadrature(aOrder + 1, false, [&](const glm::vec3& aDir, const double aWeight) {
+		const glm::vec3 dir = inverse * aDir;
+		evalScalar(rec, false, aDir.x, aDir.y, aDir.z, basis.data(), 1);
+		evalScalar(rec, false, dir.x, dir.y, dir.z, rotated.data(), 1);
+		for (uint32_t l = 0; l <= aOrder; l++) {
+			const uint32_t size = 2 * l + 1;
+			const uint32_t offset = l * l;
+			for (uint32_t j = 0; j < size; j++) {
+				for (uint32_t k = 0; k < size; k++) bands[l][j * size + k] += aWeight * rotated[offset + j] * basis[offset + k];
+			}
+		}
+	});
+	for (uint32_t l = 0; l <= aOrder; l++) {
+		mBands[l].resize(bands[l].size());
+		for (size_t i = 0; i < bands[l].size(); i++) mBands[l][i] = static_cast<float>(bands[l][i] / (4.0 * PI));
+	}
+}
+
+void sh::Rotation::apply(const float* aIn, float* aOut, const uint32_t aChannels) const
+{
+	for (uint32_t l = 0; l <= mOrder; l++) {
+		const uint32_t size = 2 * l + 1;
+		const uint32_t offset = l * l;
+		for (uint32_t k = 0; k < size; k++) {
+			for (uint32_t c = 0; c < aChannels; c++) {
+				float sum = 0.0f;
+				for (uint32_t j = 0; j < size; j++) sum += aIn[(offset + j) * aChannels + c] * mBands[l][j * size + k];
+				aOut[(offset + k) * aChannels + c] = sum;
+			}
+		}
+	}
+}
@@ -0,0 +1,97 @@
+#include <tamashii/core/common/thread_pool.hpp>
+#include <tamashii/core/common/vars.hpp>
+
+#include <atomic>
+
+T_USE_NAMESPACE
+
+ThreadPool::ThreadPool() : mStop{ false }
+{
+	uint32_t count = var::worker_threads.value();
+	if (count == 0) count = std::max(1u, std::thread::hardware_concurrency());
+	mWorkers.reserve(count);
+	for (uint32_t i = 0; i < count; i++) mWorkers.emplace_back(&ThreadPool::worker, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		const std::lock_guard lock(mMutex);
+		mStop = true;
+	}
+	mCondition.notify_all();
+	for (std::thread& t : mWorkers) if (t.joinable()) t.join();
+}
+
+uint32_t ThreadPool::threadCount() const
+{
+	return static_cast<uint32_t>(mWorkers.size());
+}
+
+void ThreadPool::parallelFor(const size_t aBegin, const size_t aEnd, const std::function<void(size_t)>& aFunc)
+{
+	if (aEnd <= aBegin) return;
+	const size_t count = aEnd - aBegin;
+	if (count == 1 || mWorkers.empty()) {
+		for (size_t i = aBegin; i < aEnd; i++) aFunc(i);
+		return;
+	}
+
+	struct State {
+		std::atomic<size_t>		mNext;
+		std::atomic<size_t>		mDone;
+		std::mutex				mMutex;
+		std::condition_variable	mCondition;
+		std::exception_ptr		mException;
+	};
+	const auto state = std::make_shared<State>();
+	state->mNext = aBegin;
+	state->mDone = 0;
+
+	auto run = [state, aEnd, count, &aFunc] {
+		size_t i;
+		while ((i = state->mNext.fetch_add(1)) < aEnd) {
+			try { aFunc(i); }
+			catch (...) {
+				const std::lock_guard lock(state->mMutex);
+				if (!state->mException) state->mException = std::current_exception();
+			}
+			if (state->mDone.fetch_add(1) + 1 == count) {
+				const std::lock_guard lock(state->mMutex);
+				state->mCondition.notify_all();
+			}
+		}
+	};
+
+	const size_t helpers = std::min(count - 1, mWorkers.size());
+	for (size_t i = 0; i < helpers; i++) enqueue(run);
+	run();
+
+	std::unique_lock lock(state->mMutex);
+	state->mCondition.wait(lock, [&] { return state->mDone.load() == count; });
+	if (state->mException) std::rethrow_exception(state->mException);
+}
+
+void ThreadPool::enqueue(std::function<void()> aTask)
+{
+	{
+		const std::lock_guard lock(mMutex);
+		mTasks.emplace_back(std::move(aTask));
+	}
+	mCondition.notify_one();
+}
+
+void ThreadPool::worker()
+{
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock lock(mMutex);
+			mCondition.wait(lock, [this] { return mStop || !mTasks.empty(); });
+			if (mStop && mTasks.empty()) return;
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+		task();
+	}
+}
@@ -1,5 +1,6 @@
 #include <tamashii/core/common/vars.hpp>
 #include <tamashii/core/common/input.hpp>
+#include <tamashii/core/common/profiler.hpp>
 
 #include <filesystem>
 
@@ -29,6 +30,20 @@ ccli::Var<bool> tamashii::var::headless("", "headless", false, ccli::Flag::Confi
 ccli::Var<bool> tamashii::var::play_animation("", "play_animation", false, ccli::Flag::CliOnly, "Play animation on startup");
 ccli::Var<std::string> tamashii::var::cfg_filename("", "cfg_filename", "tamashii.cfg", ccli::Flag::None, "Name of the config file");
 ccli::Var<bool> tamashii::var::gltf_io_use_watt("", "gltf_io_use_watt", false, ccli::Flag::ConfigRead, "Use watt instead of correct light units for gltf io");
+ccli::Var<uint32_t> tamashii::var::gltf_export_chunk_size("", "gltf_export_chunk_size", 16, ccli::Flag::ConfigRead, "Size in MiB of the staging block used when streaming glTF buffers to disk");
+ccli::Var<std::string> tamashii::var::exr_compression("", "exr_compression", "none", ccli::Flag::ConfigRead, "Compression of exported exr images: none, zip or piz");
+ccli::Var<bool> tamashii::var::exr_half("", "exr_half", false, ccli::Flag::ConfigRead, "Store exported exr images as half floats");
+ccli::Var<uint32_t> tamashii::var::worker_threads("", "worker_threads", 0, ccli::Flag::ConfigRead, "Number of cpu worker threads used for import and mesh processing (0 = hardware concurrency)");
+ccli::Var<std::string> tamashii::var::tangent_method("", "tangent_method", "mikktspace", ccli::Flag::ConfigRead, "Tangent generation for imported meshes: mikktspace, fast or auto (mikktspace only for meshes with a normal map)");
+ccli::Var<uint32_t> tamashii::var::tangent_split_size("", "tangent_split_size", 65536, ccli::Flag::ConfigRead, "Meshes with more triangles get their tangents generated per connected component in parallel (0 = never split)");
+ccli::Var<uint32_t> tamashii::var::bsp_patch_level("", "bsp_patch_level", 3, ccli::Flag::ConfigRead, "Tessellation level of Quake 3 BSP bezier patches (subdivisions per patch edge)");
+ccli::Var<bool> tamashii::var::profile("", "profile", false, ccli::Flag::None, "Record cpu timings of import, upload and optimizer stages", [](const bool v) { tamashii::Profiler::getInstance().setEnabled(v); });
+ccli::Var<uint32_t> tamashii::var::profile_buffer_size("", "profile_buffer_size", 65536, ccli::Flag::ConfigRead, "Number of profiler events kept per thread, older events are overwritten");
+ccli::Var<std::string> tamashii::var::profile_export("", "profile_export", "", ccli::Flag::None, "Write the recorded profiler events to this file as chrome trace json", [](const std::string& sv) {
+	if (!sv.empty()) tamashii::Profiler::getInstance().exportChromeTrace(sv);
+});
+ccli::Var<uint32_t> tamashii::var::event_queue_wait("", "event_queue_wait", 0, ccli::Flag::ConfigRead, "Milliseconds a thread waits for space in a full event queue before the event is dropped (0 = drop immediately)");
+ccli::Var<uint32_t> tamashii::var::event_queue_key_wait("", "event_queue_key_wait", 100, ccli::Flag::ConfigRead, "Milliseconds a thread waits for space in a full event queue before a key event is dropped");
 
 #define LOG_LEVEL_VAR(l) ccli::Var<std::string> tamashii::var::logLevel("", "log_level", (l), ccli::Flag::None, "Set spdlog logging level", [](const std::string& sv) { spdlog::set_level(spdlog::level::from_str(sv)); });
 #ifndef NDEBUG
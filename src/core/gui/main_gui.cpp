@@ -23,11 +23,11 @@ T_USE_NAMESPACE
 
 namespace {
     
-	void updateSceneGraphFromModelMatrix(const Ref& aRef)
+	void updateSceneGraphFromModelMatrix(const Ref& aRef, const std::vector<TRS*>& aTransforms)
     {
-		if(aRef.transforms.empty()) return;
+		if(aTransforms.empty()) return;
 		glm::mat4 sg_model_matrix = glm::mat4(1.0f);
-		for (TRS* trs : aRef.transforms) {
+		for (TRS* trs : aTransforms) {
 			sg_model_matrix *= trs->getMatrix(0);
 		}
 
@@ -47,7 +47,7 @@ namespace {
 		const bool trsNeedsUpdate = (translationNeedsUpdate || scaleNeedsUpdate || rotationNeedsUpdate);
 		if (!trsNeedsUpdate) return;
 
-		TRS* trs = aRef.transforms.front();
+		TRS* trs = aTransforms.front();
 		if (translationNeedsUpdate)
 		{
 			const glm::vec3 diff = c_translation - sg_translation;
@@ -404,8 +404,9 @@ void MainGUI::drawImGuizmo()
 		if(ImGuizmo::Manipulate(glm::value_ptr(view_matrix), glm::value_ptr(projection_matrix), op, mode,
 			glm::value_ptr(selection->model_matrix), glm::value_ptr(delta), pSnap)) {
 
+			const std::vector<TRS*> transforms = mUc->scene->getTransforms(*selection);
 			TRS* trs = nullptr;
-			if (!selection->transforms.empty()) trs = selection->transforms.front();
+			if (!transforms.empty()) trs = transforms.front();
 			if(trs)
 			{
 				glm::vec3 scale;
@@ -440,9 +441,10 @@ void MainGUI::drawImGuizmo()
 						v = { newRotation[1], newRotation[2], newRotation[3] , newRotation[0] };
 					}
 				}
+				mUc->scene->requestTransformUpdate();
 			}
 			selection->model_matrix = glm::mat4(1.0f);
-			for (const TRS* t : selection->transforms) {
+			for (const TRS* t : transforms) {
 				selection->model_matrix *= t->getMatrix(mUc->scene->getCurrentTime());
 			}
 
@@ -458,7 +460,7 @@ void MainGUI::drawImGuizmo()
 					surfaceLight.setDimensions(glm::vec3(scale_x, scale_y, scale_z));
 				}
 				mUc->scene->requestLightUpdate();
-				if (!lightRef.transforms.empty()) trs = lightRef.transforms.front();
+				if (!transforms.empty()) trs = transforms.front();
 			}
 			else if (selection->type == Ref::Type::Model) {
 				mUc->scene->requestModelInstanceUpdate();
@@ -466,7 +468,7 @@ void MainGUI::drawImGuizmo()
 				const auto& modelRef = dynamic_cast<RefModel&>(*selection);
 				for (const auto& refMesh : modelRef.refMeshes) light |= refMesh->mesh->getMaterial()->isLight();
 				if (light) mUc->scene->requestLightUpdate();
-				if (!modelRef.transforms.empty()) trs = modelRef.transforms.front();
+				if (!transforms.empty()) trs = transforms.front();
 			}
 		}
 	}
@@ -833,7 +835,10 @@ void MainGUI::drawEdit()
 			ImGui::SameLine();
 			model_mat_requieres_update |= ImGui::DragFloat4("##c3", &selection.reference->model_matrix[3][0], 0.1f, 0, 0, "%.3f", 0);
 			
-			if (model_mat_requieres_update) updateSceneGraphFromModelMatrix(*selection.reference);
+			if (model_mat_requieres_update) {
+				updateSceneGraphFromModelMatrix(*selection.reference, mUc->scene->getTransforms(*selection.reference));
+				mUc->scene->requestTransformUpdate();
+			}
 			if (selection.reference->type == Ref::Type::Light) {
 				lightsRequiereUpdate |= model_mat_requieres_update;
 
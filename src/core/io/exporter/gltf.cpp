@@ -12,7 +12,14 @@
 #include <tamashii/core/scene/light.hpp>
 #include <tamashii/core/scene/scene_graph.hpp>
 
+#include <tamashii/core/common/thread_pool.hpp>
+#include <stb_image_write.h>
+
+#include <array>
+#include <atomic>
 #include <filesystem>
+#include <fstream>
+#include <sstream>
 #include <numbers>
 
 
@@ -24,6 +31,7 @@ T_USE_NAMESPACE
 namespace {
 	uint64_t rountUpToMultipleOf(const uint64_t aNumToRound, const uint64_t aMultiple) { return (aNumToRound + aMultiple - 1) & -aMultiple; }
 	constexpr uint64_t ROUND_UP_CONST = 4;
+	constexpr uint64_t EXPORT_JOB_ELEMENTS = 1 << 16;
 
 	std::unordered_map<tamashii::Image*, int> imageToIndexDirectory = {};
 	std::unordered_map<tamashii::Texture*, int> textureToIndexDirectory = {};
@@ -31,12 +39,21 @@ namespace {
 	std::unordered_map<tamashii::Model*, int> modelToIndexDirectory = {};
 	std::unordered_map<tamashii::Camera*, int> cameraToIndexDirectory = {};
 	std::unordered_map<tamashii::Light*, int> lightToIndexDirectory = {};
+	std::unordered_map<tamashii::Mesh*, tinygltf::Primitive> meshToPrimitiveDirectory = {};
 
 	std::deque<std::string> usedImageFilepaths = {};
 
+	// every accessor of the binary buffer is recorded as a deferred write, the data is only deinterleaved from
+	// the scene when the buffer is written, either into one memory block (embedded) or chunk wise to disk
+	struct BufferWrite {
+		uint64_t mOffset;
+		uint64_t mCount;
+		uint64_t mElementSize;
+		std::function<void(uint8_t* aDst, uint64_t aFirst, uint64_t aCount)> mWrite;
+	};
 	struct gltfBuffer {
-		std::vector<uint8_t> &mData;
 		uint64_t mPointer;
+		std::vector<BufferWrite> mWrites;
 	};
 
 	
@@ -314,203 +331,103 @@ namespace {
 		} else materialToIndexDirectory.insert(std::pair(aMaterial, index));
 	}
 
-	uint64_t calcBufferSize(const io::SceneData& aSceneInfo)
-	{
-		uint64_t size = 0;
-		for(const auto& model : aSceneInfo.mModels)
-		{
-			for(const auto& mesh : model->getMeshList())
-			{
-				if (mesh->hasIndices()) {
-					if (mesh->getVertexCount() <= std::numeric_limits<uint8_t>::max()) size += rountUpToMultipleOf(mesh->getIndexCount() * sizeof(uint8_t), ROUND_UP_CONST);
-					else if (mesh->getVertexCount() <= std::numeric_limits<uint16_t>::max()) size += rountUpToMultipleOf(mesh->getIndexCount() * sizeof(uint16_t), ROUND_UP_CONST);
-					else if (mesh->getVertexCount() <= std::numeric_limits<uint32_t>::max()) size += rountUpToMultipleOf(mesh->getIndexCount() * sizeof(uint32_t), ROUND_UP_CONST);
-				}
-				{
-					const size_t vertexCount = mesh->getVertexCount();
-					if(mesh->hasPositions()) size += rountUpToMultipleOf(vertexCount * sizeof(glm::vec3), ROUND_UP_CONST);
-					if (mesh->hasColors0()) size += rountUpToMultipleOf(vertexCount * sizeof(glm::vec4), ROUND_UP_CONST);
-					if (mesh->hasNormals()) size += rountUpToMultipleOf(vertexCount * sizeof(glm::vec3), ROUND_UP_CONST);
-					if (mesh->hasTangents()) size += rountUpToMultipleOf(vertexCount * sizeof(glm::vec4), ROUND_UP_CONST);
-					if (mesh->hasTexCoords0()) size += rountUpToMultipleOf(vertexCount * sizeof(glm::vec2), ROUND_UP_CONST);
-					if (mesh->hasTexCoords1()) size += rountUpToMultipleOf(vertexCount * sizeof(glm::vec2), ROUND_UP_CONST);
-					for (const auto& [id, data] : mesh->getCustomDataMap())
-					{
-						size += rountUpToMultipleOf(data.bytes() * sizeof(uint8_t), ROUND_UP_CONST);
-					}
-				}
-			}
-		}
-		
-		if (!aSceneInfo.mSceneGraphs.empty()) {
-			uint32_t timesteps = 0;
-			aSceneInfo.mSceneGraphs[0]->visit([&size](Node* aNode)
-			{
-				const TRS& trs = aNode->getTRS();
-				if (trs.hasTranslationAnimation())
-				{
-					const uint64_t ts = trs.translationSteps.size();
-					const uint64_t tts = trs.translationTimeSteps.size();
-					size += ts ? rountUpToMultipleOf(ts * sizeof(trs.translationSteps[0]), ROUND_UP_CONST) : 0;
-					size += tts ? rountUpToMultipleOf(tts * sizeof(trs.translationTimeSteps[0]), ROUND_UP_CONST) : 0;
-				}
-				if (trs.hasRotationAnimation())
-				{
-					const uint64_t rs = trs.rotationSteps.size();
-					const uint64_t rts = trs.rotationTimeSteps.size();
-					size += rs ? rountUpToMultipleOf(rs * sizeof(trs.rotationSteps[0]), ROUND_UP_CONST) : 0;
-					size += rts ? rountUpToMultipleOf(rts * sizeof(trs.rotationTimeSteps[0]), ROUND_UP_CONST) : 0;
-				}
-				if (trs.hasScaleAnimation())
-				{
-					const uint64_t ss = trs.scaleSteps.size();
-					const uint64_t sts = trs.scaleTimeSteps.size();
-					size += ss ? rountUpToMultipleOf(ss * sizeof(trs.scaleSteps[0]), ROUND_UP_CONST) : 0;
-					size += sts ? rountUpToMultipleOf(sts * sizeof(trs.scaleTimeSteps[0]), ROUND_UP_CONST) : 0;
-				}
-			});
-		}
-		return size;
-	}
-
-	int getAccessor(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, const size_t aSizeInBytes, const size_t aCount)
+	int getBufferView(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, const size_t aSizeInBytes)
 	{
 		tinygltf::BufferView bufferView;
 		bufferView.buffer = 0;
 		bufferView.byteOffset = aBuffer.mPointer;
 		bufferView.byteLength = aSizeInBytes;
+		aBuffer.mPointer += rountUpToMultipleOf(aSizeInBytes, ROUND_UP_CONST);
 
 		const int posBufferView = static_cast<int>(aGltfModel.bufferViews.size());
 		aGltfModel.bufferViews.push_back(bufferView);
-
+		return posBufferView;
+	}
+	template<typename T, typename F>
+	int getAccessor(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, const size_t aCount, F&& aWrite)
+	{
+		const uint64_t offset = aBuffer.mPointer;
 		tinygltf::Accessor accessor;
-		accessor.bufferView = posBufferView;
+		accessor.bufferView = getBufferView(aGltfModel, aBuffer, aCount * sizeof(T));
 		accessor.count = aCount;
-		aBuffer.mPointer += rountUpToMultipleOf(aSizeInBytes, ROUND_UP_CONST);
+		aBuffer.mWrites.push_back({ offset, aCount, sizeof(T), [write = std::forward<F>(aWrite)](uint8_t* aDst, const uint64_t aFirst, const uint64_t aElements)
+		{
+			for (uint64_t i = 0; i < aElements; i++) {
+				const T value = write(aFirst + i);
+				std::memcpy(aDst + i * sizeof(T), &value, sizeof(T));
+			}
+		} });
 
 		const int posAccessor = static_cast<int>(aGltfModel.accessors.size());
 		aGltfModel.accessors.push_back(accessor);
 		return posAccessor;
 	}
+	template<typename T, typename F>
+	int saveVertexAttribute(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, tamashii::Mesh* aMesh, const int aType, F&& aGet)
+	{
+		const vertex_s* vertices = std::as_const(*aMesh).getVerticesArray();
+		const int posAccessor = getAccessor<T>(aGltfModel, aBuffer, aMesh->getVertexCount(), [vertices, get = std::forward<F>(aGet)](const uint64_t aIdx) { return get(vertices[aIdx]); });
+		tinygltf::Accessor& accessor = aGltfModel.accessors[posAccessor];
+		accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+		accessor.type = aType;
+		return posAccessor;
+	}
 	int saveIndices(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, tamashii::Mesh* aMesh)
 	{
-		const std::vector<uint32_t>& indices = aMesh->getIndicesVectorRef();
-		uint32_t bytes = 4;
-		if (aMesh->getVertexCount() <= std::numeric_limits<uint8_t>::max()) bytes = 1;
-		else if (aMesh->getVertexCount() <= std::numeric_limits<uint16_t>::max()) bytes = 2;
-		const uint64_t sizeInBytes = indices.size() * bytes;
-		if (bytes == 1) {
-			const auto idx = reinterpret_cast<uint8_t*>(aBuffer.mPointer + aBuffer.mData.data());
-			for (size_t i = 0; i < indices.size(); i++) idx[i] = static_cast<uint8_t>(indices[i]);
+		const uint32_t* indices = std::as_const(*aMesh).getIndicesArray();
+		const size_t count = aMesh->getIndexCount();
+		int posAccessor;
+		int componentType;
+		if (aMesh->getVertexCount() <= std::numeric_limits<uint8_t>::max()) {
+			posAccessor = getAccessor<uint8_t>(aGltfModel, aBuffer, count, [indices](const uint64_t aIdx) { return static_cast<uint8_t>(indices[aIdx]); });
+			componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
 		}
-		else if (bytes == 2) {
-			const auto idx = reinterpret_cast<uint16_t*>(aBuffer.mPointer + aBuffer.mData.data());
-			for (size_t i = 0; i < indices.size(); i++) idx[i] = static_cast<uint16_t>(indices[i]);
+		else if (aMesh->getVertexCount() <= std::numeric_limits<uint16_t>::max()) {
+			posAccessor = getAccessor<uint16_t>(aGltfModel, aBuffer, count, [indices](const uint64_t aIdx) { return static_cast<uint16_t>(indices[aIdx]); });
+			componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
 		}
-		else if (bytes == 4) {
-			const auto idx = reinterpret_cast<uint32_t*>(aBuffer.mPointer + aBuffer.mData.data());
-			for (size_t i = 0; i < indices.size(); i++) idx[i] = indices[i];
+		else {
+			posAccessor = getAccessor<uint32_t>(aGltfModel, aBuffer, count, [indices](const uint64_t aIdx) { return indices[aIdx]; });
+			componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
 		}
-
-		const int posAccessor = getAccessor(aGltfModel, aBuffer, sizeInBytes, indices.size());
 		tinygltf::Accessor& accessor = aGltfModel.accessors[posAccessor];
-		if (bytes == 1) accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
-		else if (bytes == 2) accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
-		else if (bytes == 4) accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+		accessor.componentType = componentType;
 		accessor.type = TINYGLTF_TYPE_SCALAR;
 		return posAccessor;
 	}
 	int savePositions(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, tamashii::Mesh* aMesh)
 	{
-		const std::vector<vertex_s>& vertices = aMesh->getVerticesVectorRef();
-		const uint64_t sizeInBytes = vertices.size() * sizeof(glm::vec3);
-		const auto positions = reinterpret_cast<glm::vec3*>(aBuffer.mPointer + aBuffer.mData.data());
-		for (size_t i = 0; i < vertices.size(); i++) positions[i] = vertices[i].position;
-
-		const int posAccessor = getAccessor(aGltfModel, aBuffer, sizeInBytes, vertices.size());
+		const int posAccessor = saveVertexAttribute<glm::vec3>(aGltfModel, aBuffer, aMesh, TINYGLTF_TYPE_VEC3, [](const vertex_s& aV) { return glm::vec3(aV.position); });
 		tinygltf::Accessor& accessor = aGltfModel.accessors[posAccessor];
-		accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-		accessor.type = TINYGLTF_TYPE_VEC3;
 		accessor.minValues = VEC3_TO_VECTOR(aMesh->getAABB().mMin);
 		accessor.maxValues = VEC3_TO_VECTOR(aMesh->getAABB().mMax);
 		return posAccessor;
 	}
 	int saveColors(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, tamashii::Mesh* aMesh)
 	{
-		const std::vector<vertex_s>& vertices = aMesh->getVerticesVectorRef();
-		const uint64_t sizeInBytes = vertices.size() * sizeof(glm::vec4);
-		const auto colors = reinterpret_cast<glm::vec4*>(aBuffer.mPointer + aBuffer.mData.data());
-		for (size_t i = 0; i < vertices.size(); i++) colors[i] = vertices[i].color_0;
-
-		const int posAccessor = getAccessor(aGltfModel, aBuffer, sizeInBytes, vertices.size());
-		tinygltf::Accessor& accessor = aGltfModel.accessors[posAccessor];
-		accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-		accessor.type = TINYGLTF_TYPE_VEC4;
-		return posAccessor;
+		return saveVertexAttribute<glm::vec4>(aGltfModel, aBuffer, aMesh, TINYGLTF_TYPE_VEC4, [](const vertex_s& aV) { return aV.color_0; });
 	}
 	int saveNormals(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, tamashii::Mesh* aMesh)
 	{
-		const std::vector<vertex_s>& vertices = aMesh->getVerticesVectorRef();
-		const uint64_t sizeInBytes = vertices.size() * sizeof(glm::vec3);
-		const auto normals = reinterpret_cast<glm::vec3*>(aBuffer.mPointer + aBuffer.mData.data());
-		for (size_t i = 0; i < vertices.size(); i++) normals[i] = vertices[i].normal;
-
-		const int posAccessor = getAccessor(aGltfModel, aBuffer, sizeInBytes, vertices.size());
-		tinygltf::Accessor& accessor = aGltfModel.accessors[posAccessor];
-		accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-		accessor.type = TINYGLTF_TYPE_VEC3;
-		return posAccessor;
+		return saveVertexAttribute<glm::vec3>(aGltfModel, aBuffer, aMesh, TINYGLTF_TYPE_VEC3, [](const vertex_s& aV) { return glm::vec3(aV.normal); });
 	}
 	int saveTangents(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, tamashii::Mesh* aMesh)
 	{
-		const std::vector<vertex_s>& vertices = aMesh->getVerticesVectorRef();
-		const uint64_t sizeInBytes = vertices.size() * sizeof(glm::vec4);
-		const auto tangents = reinterpret_cast<glm::vec4*>(aBuffer.mPointer + aBuffer.mData.data());
-		for (size_t i = 0; i < vertices.size(); i++) {
-			tangents[i] = vertices[i].tangent;
-			tangents[i].w = 1;
-		}
-
-		const int posAccessor = getAccessor(aGltfModel, aBuffer, sizeInBytes, vertices.size());
-		tinygltf::Accessor& accessor = aGltfModel.accessors[posAccessor];
-		accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-		accessor.type = TINYGLTF_TYPE_VEC4;
-		return posAccessor;
+		return saveVertexAttribute<glm::vec4>(aGltfModel, aBuffer, aMesh, TINYGLTF_TYPE_VEC4, [](const vertex_s& aV) { return glm::vec4(glm::vec3(aV.tangent), 1); });
 	}
 	int saveUV0s(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, tamashii::Mesh* aMesh)
 	{
-		const std::vector<vertex_s>& vertices = aMesh->getVerticesVectorRef();
-		const uint64_t sizeInBytes = vertices.size() * sizeof(glm::vec2);
-		const auto uv0 = reinterpret_cast<glm::vec2*>(aBuffer.mPointer + aBuffer.mData.data());
-		for (size_t i = 0; i < vertices.size(); i++) uv0[i] = vertices[i].texture_coordinates_0;
-
-		const int posAccessor = getAccessor(aGltfModel, aBuffer, sizeInBytes, vertices.size());
-		tinygltf::Accessor& accessor = aGltfModel.accessors[posAccessor];
-		accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-		accessor.type = TINYGLTF_TYPE_VEC2;
-		return posAccessor;
+		return saveVertexAttribute<glm::vec2>(aGltfModel, aBuffer, aMesh, TINYGLTF_TYPE_VEC2, [](const vertex_s& aV) { return aV.texture_coordinates_0; });
 	}
 	int saveUV1s(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, tamashii::Mesh* aMesh)
 	{
-		const std::vector<vertex_s>& vertices = aMesh->getVerticesVectorRef();
-		const uint64_t sizeInBytes = vertices.size() * sizeof(glm::vec2);
-		const auto uv0 = reinterpret_cast<glm::vec2*>(aBuffer.mPointer + aBuffer.mData.data());
-		for (size_t i = 0; i < vertices.size(); i++) uv0[i] = vertices[i].texture_coordinates_0;
-
-		const int posAccessor = getAccessor(aGltfModel, aBuffer, sizeInBytes, vertices.size());
-		tinygltf::Accessor& accessor = aGltfModel.accessors[posAccessor];
-		accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-		accessor.type = TINYGLTF_TYPE_VEC2;
-		return posAccessor;
+		return saveVertexAttribute<glm::vec2>(aGltfModel, aBuffer, aMesh, TINYGLTF_TYPE_VEC2, [](const vertex_s& aV) { return aV.texture_coordinates_1; });
 	}
 
 	int saveCustomData(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, const tamashii::Mesh::CustomData& aExtraData)
 	{
-		const uint64_t sizeInBytes = aExtraData.bytes();
-		const auto extraData = reinterpret_cast<uint8_t*>(aBuffer.mPointer + aBuffer.mData.data());
-		std::memcpy(extraData, aExtraData.data(), sizeInBytes);
-
-		const int posAccessor = getAccessor(aGltfModel, aBuffer, sizeInBytes, sizeInBytes);
+		const auto data = aExtraData.data<uint8_t>();
+		const int posAccessor = getAccessor<uint8_t>(aGltfModel, aBuffer, aExtraData.bytes(), [data](const uint64_t aIdx) { return data[aIdx]; });
 		tinygltf::Accessor& accessor = aGltfModel.accessors[posAccessor];
 		accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
 		accessor.type = TINYGLTF_TYPE_SCALAR;
@@ -519,6 +436,8 @@ namespace {
 	
 	tinygltf::Primitive exportMesh(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, tamashii::Mesh* aMesh)
 	{
+		if (const auto it = meshToPrimitiveDirectory.find(aMesh); it != meshToPrimitiveDirectory.end()) return it->second;
+
 		tinygltf::Primitive primitive;
 		primitive.mode = topologyToTinygltfMode(aMesh->getTopology());
 
@@ -551,6 +470,7 @@ namespace {
 		}
 		if (aMesh->getMaterial()) primitive.material = materialToIndexDirectory[aMesh->getMaterial()];
 		exportCustomProperties(*aMesh, &primitive.extras);
+		meshToPrimitiveDirectory.insert(std::pair(aMesh, primitive));
 		return primitive;
 	}
     void exportModel(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, tamashii::Model& aModel)
@@ -678,17 +598,13 @@ namespace {
 
 	int writeTimeStepsToBuffer(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, const std::vector<float>& aTimeSteps)
 	{ 
-		const int inCount = static_cast<int>(aTimeSteps.size());
-		const uint64_t inSizeInBytes = inCount * sizeof(aTimeSteps[0]);
-		const auto inData = reinterpret_cast<float*>(aBuffer.mPointer + aBuffer.mData.data());
-		const int inPosAccessor = getAccessor(aGltfModel, aBuffer, inSizeInBytes, inCount);
+		const float* timeSteps = aTimeSteps.data();
+		const int inPosAccessor = getAccessor<float>(aGltfModel, aBuffer, aTimeSteps.size(), [timeSteps](const uint64_t aIdx) { return timeSteps[aIdx]; });
 		float inMin = std::numeric_limits<float>::max();
 		float inMax = 0;
-		for (int i = 0; i < inCount; i++) {
-			const float tts = aTimeSteps[i];
+		for (const float tts : aTimeSteps) {
 			if (tts < inMin) inMin = tts;
 			if (tts > inMax) inMax = tts;
-			inData[i] = tts;
 		}
 		aGltfModel.accessors[inPosAccessor].componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
 		aGltfModel.accessors[inPosAccessor].type = TINYGLTF_TYPE_SCALAR;
@@ -696,6 +612,15 @@ namespace {
 		aGltfModel.accessors[inPosAccessor].maxValues = { static_cast<double>(inMax) };
 		return inPosAccessor;
 	}
+	template<typename T>
+	int writeStepsToBuffer(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, const std::vector<T>& aSteps, const int aType)
+	{
+		const T* steps = aSteps.data();
+		const int outPosAccessor = getAccessor<T>(aGltfModel, aBuffer, aSteps.size(), [steps](const uint64_t aIdx) { return steps[aIdx]; });
+		aGltfModel.accessors[outPosAccessor].componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+		aGltfModel.accessors[outPosAccessor].type = aType;
+		return outPosAccessor;
+	}
 	void exportAnimation(tinygltf::Model& aGltfModel, gltfBuffer& aBuffer, const tamashii::TRS& aTrs, const int aNodeIndex)
 	{
 		const int ac = aTrs.hasTranslationAnimation() + aTrs.hasRotationAnimation() + aTrs.hasScaleAnimation();
@@ -714,13 +639,7 @@ namespace {
 
 			const int inPosAccessor = writeTimeStepsToBuffer(aGltfModel, aBuffer, aTrs.translationTimeSteps);
 
-			const int outCount = static_cast<int>(aTrs.translationSteps.size());
-			const uint64_t outSizeInBytes = outCount * sizeof(aTrs.translationSteps[0]);
-			const auto outData = reinterpret_cast<glm::vec3*>(aBuffer.mPointer + aBuffer.mData.data());
-			const int outPosAccessor = getAccessor(aGltfModel, aBuffer, outSizeInBytes, outCount);
-			for (int i = 0; i < outCount; i++) outData[i] = aTrs.translationSteps[i];
-			aGltfModel.accessors[outPosAccessor].componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-			aGltfModel.accessors[outPosAccessor].type = TINYGLTF_TYPE_VEC3;
+			const int outPosAccessor = writeStepsToBuffer(aGltfModel, aBuffer, aTrs.translationSteps, TINYGLTF_TYPE_VEC3);
 
 			tinygltf::AnimationSampler sampler;
 			sampler.interpolation = interpolationToString(aTrs.translationInterpolation);
@@ -738,13 +657,7 @@ namespace {
 
 			const int inPosAccessor = writeTimeStepsToBuffer(aGltfModel, aBuffer, aTrs.rotationTimeSteps);
 
-			const int outCount = static_cast<int>(aTrs.rotationSteps.size());
-			const uint64_t outSizeInBytes = outCount * sizeof(aTrs.rotationSteps[0]);
-			const auto outData = reinterpret_cast<glm::vec4*>(aBuffer.mPointer + aBuffer.mData.data());
-			const int outPosAccessor = getAccessor(aGltfModel, aBuffer, outSizeInBytes, outCount);
-			for (int i = 0; i < outCount; i++) outData[i] = aTrs.rotationSteps[i];
-			aGltfModel.accessors[outPosAccessor].componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-			aGltfModel.accessors[outPosAccessor].type = TINYGLTF_TYPE_VEC4;
+			const int outPosAccessor = writeStepsToBuffer(aGltfModel, aBuffer, aTrs.rotationSteps, TINYGLTF_TYPE_VEC4);
 
 			tinygltf::AnimationSampler sampler;
 			sampler.interpolation = interpolationToString(aTrs.rotationInterpolation);
@@ -762,13 +675,7 @@ namespace {
 
 			const int inPosAccessor = writeTimeStepsToBuffer(aGltfModel, aBuffer, aTrs.scaleTimeSteps);
 
-			const int outCount = static_cast<int>(aTrs.scaleSteps.size());
-			const uint64_t outSizeInBytes = outCount * sizeof(aTrs.scaleSteps[0]);
-			const auto outData = reinterpret_cast<glm::vec3*>(aBuffer.mPointer + aBuffer.mData.data());
-			const int outPosAccessor = getAccessor(aGltfModel, aBuffer, outSizeInBytes, outCount);
-			for (int i = 0; i < outCount; i++) outData[i] = aTrs.scaleSteps[i];
-			aGltfModel.accessors[outPosAccessor].componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-			aGltfModel.accessors[outPosAccessor].type = TINYGLTF_TYPE_VEC3;
+			const int outPosAccessor = writeStepsToBuffer(aGltfModel, aBuffer, aTrs.scaleSteps, TINYGLTF_TYPE_VEC3);
 
 			tinygltf::AnimationSampler sampler;
 			sampler.interpolation = interpolationToString(aTrs.scaleInterpolation);
@@ -841,6 +748,149 @@ namespace {
 		aGltfModel.scenes.push_back(gltfScene);
 		aGltfModel.defaultScene = 0;
 	}
+	void writeBufferToMemory(const gltfBuffer& aBuffer, std::vector<unsigned char>& aData)
+	{
+		aData.assign(aBuffer.mPointer, 0);
+		
+		std::vector<std::tuple<const BufferWrite*, uint64_t, uint64_t>> jobs;
+		for (const BufferWrite& w : aBuffer.mWrites) {
+			for (uint64_t first = 0; first < w.mCount; first += EXPORT_JOB_ELEMENTS) jobs.emplace_back(&w, first, std::min(EXPORT_JOB_ELEMENTS, w.mCount - first));
+		}
+		ThreadPool::getInstance().parallelFor(0, jobs.size(), [&](const size_t aIdx) {
+			const auto [w, first, count] = jobs[aIdx];
+			w->mWrite(aData.data() + w->mOffset + first * w->mElementSize, first, count);
+		});
+	}
+	// deinterleave the accessors chunk by chunk into a staging block of gltf_export_chunk_size MiB
+	// and append it to the stream, the memory overhead is independent of the scene size
+	bool writeBufferToStream(const gltfBuffer& aBuffer, std::ostream& aStream)
+	{
+		ThreadPool& pool = ThreadPool::getInstance();
+		const uint64_t chunkSize = static_cast<uint64_t>(std::max(1u, var::gltf_export_chunk_size.value())) << 20;
+		std::vector<uint8_t> chunk(chunkSize);
+		const std::array<char, ROUND_UP_CONST> zeros = {};
+
+		uint64_t written = 0;
+		for (const BufferWrite& w : aBuffer.mWrites) {
+			assert(written <= w.mOffset);
+			aStream.write(zeros.data(), static_cast<std::streamsize>(w.mOffset - written));
+			written = w.mOffset;
+
+			const uint64_t chunkElements = std::max<uint64_t>(1, chunkSize / w.mElementSize);
+			if (chunk.size() < chunkElements * w.mElementSize) chunk.resize(chunkElements * w.mElementSize);
+			for (uint64_t first = 0; first < w.mCount; first += chunkElements) {
+				const uint64_t count = std::min(chunkElements, w.mCount - first);
+				const uint64_t slice = (count + pool.threadCount() - 1) / pool.threadCount();
+				pool.parallelFor(0, (count + slice - 1) / slice, [&](const size_t aSlice) {
+					const uint64_t sliceFirst = aSlice * slice;
+					w.mWrite(chunk.data() + sliceFirst * w.mElementSize, first + sliceFirst, std::min(slice, count - sliceFirst));
+				});
+				aStream.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(count * w.mElementSize));
+				written += count * w.mElementSize;
+			}
+		}
+		aStream.write(zeros.data(), static_cast<std::streamsize>(aBuffer.mPointer - written));
+		return aStream.good();
+	}
+	bool writeImageFile(const std::filesystem::path& aOutDir, const tinygltf::Image& aImage)
+	{
+		const std::string file = std::filesystem::path(aOutDir / aImage.uri).make_preferred().string();
+		std::string ext = std::filesystem::path(aImage.uri).extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+		// stb only writes 8 bit per channel
+		if (aImage.bits != 8 || aImage.pixel_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+			spdlog::error("glTF Export: {} has {} bit channels, only 8 bit images can be written as separate files", aImage.uri, aImage.bits);
+			return false;
+		}
+		if (ext == ".png") return stbi_write_png(file.c_str(), aImage.width, aImage.height, aImage.component, aImage.image.data(), 0) != 0;
+		if (ext == ".jpg" || ext == ".jpeg") return stbi_write_jpg(file.c_str(), aImage.width, aImage.height, aImage.component, aImage.image.data(), 100) != 0;
+		if (ext == ".bmp") return stbi_write_bmp(file.c_str(), aImage.width, aImage.height, aImage.component, aImage.image.data()) != 0;
+		return false;
+	}
+	bool writeStreamed(const std::string& aOutputFile, const io::Export::SceneExportSettings aSettings, tinygltf::Model& aModel, const gltfBuffer& aBuffer)
+	{
+		const std::filesystem::path outputDir = std::filesystem::path(aOutputFile).parent_path();
+		const std::string binFile = std::filesystem::path(aOutputFile).stem().string() + ".bin";
+
+		// separate images are written here and their json is added below, tinygltf would embed them
+		std::vector<tinygltf::Image> images;
+		if (!aSettings.mEmbedImages) {
+			images.swap(aModel.images);
+			std::atomic<bool> imagesWritten = true;
+			ThreadPool::getInstance().parallelFor(0, images.size(), [&](const size_t aIdx) {
+				if (!writeImageFile(outputDir, images[aIdx])) {
+					spdlog::error("glTF Export: could not write image {}", images[aIdx].uri);
+					imagesWritten = false;
+				}
+				std::vector<unsigned char>().swap(images[aIdx].image);
+			});
+			// the json would reference a missing file
+			if (!imagesWritten) {
+				images.swap(aModel.images);
+				return false;
+			}
+		}
+
+		tinygltf::TinyGLTF exporter;
+		const tinygltf::WriteImageDataFunction writeImageData = &tinygltf::WriteImageData;
+		tinygltf::FsCallbacks fs = { &tinygltf::FileExists, &tinygltf::ExpandFilePath,
+		&tinygltf::ReadWholeFile, &tinygltf::WriteWholeFile, nullptr };
+		exporter.SetImageWriter(writeImageData, &fs);
+		std::stringstream ss;
+		const bool written = exporter.WriteGltfSceneToStream(&aModel, ss, false, false);
+		if (!aSettings.mEmbedImages) images.swap(aModel.images);
+		if (!written) return false;
+
+		
+		nlohmann::json json = nlohmann::json::parse(ss.str());
+		if (!aSettings.mEmbedImages && !aModel.images.empty()) {
+			nlohmann::json imagesJson = nlohmann::json::array();
+			for (const tinygltf::Image& img : aModel.images) {
+				nlohmann::json image = { { "uri", img.uri } };
+				if (!img.name.empty()) image["name"] = img.name;
+				if (!img.mimeType.empty()) image["mimeType"] = img.mimeType;
+				imagesJson.push_back(std::move(image));
+			}
+			json["images"] = std::move(imagesJson);
+		}
+		if (aBuffer.mPointer) {
+			nlohmann::json buffer = { { "byteLength", aBuffer.mPointer } };
+			if (!aSettings.mWriteBinary) buffer["uri"] = binFile;
+			json["buffers"] = nlohmann::json::array({ buffer });
+		}
+		std::string jsonString = json.dump(aSettings.mWriteBinary ? -1 : 2);
+
+		if (!aSettings.mWriteBinary) {
+			std::ofstream file(aOutputFile, std::ios::binary);
+			file.write(jsonString.data(), static_cast<std::streamsize>(jsonString.size()));
+			if (!file.good()) return false;
+			if (!aBuffer.mPointer) return true;
+			std::ofstream bin(std::filesystem::path(outputDir / binFile).make_preferred().string(), std::ios::binary);
+			return bin.good() && writeBufferToStream(aBuffer, bin);
+		}
+
+		
+		jsonString.resize(rountUpToMultipleOf(jsonString.size(), ROUND_UP_CONST), ' ');
+		const uint64_t totalLength = 12 + 8 + jsonString.size() + (aBuffer.mPointer ? 8 + aBuffer.mPointer : 0);
+		if (totalLength > std::numeric_limits<uint32_t>::max()) {
+			spdlog::error("glTF Export: scene exceeds the 4GB limit of glb files");
+			return false;
+		}
+		const auto writeU32 = [](std::ostream& aStream, const uint32_t aValue) { aStream.write(reinterpret_cast<const char*>(&aValue), sizeof(uint32_t)); };
+		std::ofstream file(aOutputFile, std::ios::binary);
+		writeU32(file, 0x46546C67);
+		writeU32(file, 2);
+		writeU32(file, static_cast<uint32_t>(totalLength));
+		writeU32(file, static_cast<uint32_t>(jsonString.size()));
+		writeU32(file, 0x4E4F534A);
+		file.write(jsonString.data(), static_cast<std::streamsize>(jsonString.size()));
+		if (aBuffer.mPointer) {
+			writeU32(file, static_cast<uint32_t>(aBuffer.mPointer));
+			writeU32(file, 0x004E4942);
+			return file.good() && writeBufferToStream(aBuffer, file);
+		}
+		return file.good();
+	}
 }
 
 bool io::Export::save_scene_gltf(const std::string& aOutputFile, const SceneExportSettings aSettings, const SceneData& aSceneInfo)
@@ -850,6 +900,7 @@ bool io::Export::save_scene_gltf(const std::string& aOutputFile, const SceneExpo
 	textureToIndexDirectory.clear();
 	materialToIndexDirectory.clear();
 	modelToIndexDirectory.clear();
+	meshToPrimitiveDirectory.clear();
 	cameraToIndexDirectory.clear();
 	lightToIndexDirectory.clear();
 	usedImageFilepaths.clear();
@@ -861,11 +912,7 @@ bool io::Export::save_scene_gltf(const std::string& aOutputFile, const SceneExpo
 	cameraToIndexDirectory.reserve(aSceneInfo.mCameras.size());
 	lightToIndexDirectory.reserve(aSceneInfo.mLights.size());
 	
-	const uint64_t dataBufferSize = calcBufferSize(aSceneInfo);
-	tinygltf::Buffer buffer;
-	buffer.uri = std::filesystem::path(aOutputFile).stem().string() + ".bin";
-	buffer.data = std::vector<unsigned char>(dataBufferSize);
-	gltfBuffer dataBuffer = { buffer.data, 0 };
+	gltfBuffer dataBuffer = { 0, {} };
 
 	tinygltf::Model model;
 	model.asset.generator = "Tamashii Export";
@@ -908,30 +955,31 @@ bool io::Export::save_scene_gltf(const std::string& aOutputFile, const SceneExpo
 	if (!aSettings.mExcludeLights) for (auto& light : aSceneInfo.mLights) exportLight(model, *light);
 	if (!aSceneInfo.mSceneGraphs.empty()) exportScene(model, dataBuffer, aSceneInfo.mSceneGraphs[0]);
 
-	assert(dataBuffer.mPointer <= buffer.data.size());
-	if (dataBuffer.mPointer) model.buffers.push_back(buffer);
-
-    tinygltf::TinyGLTF exporter;
-	const tinygltf::WriteImageDataFunction writeImageData = &tinygltf::WriteImageData;
-	tinygltf::FsCallbacks fs = { &tinygltf::FileExists, &tinygltf::ExpandFilePath,
-	&tinygltf::ReadWholeFile, &tinygltf::WriteWholeFile, nullptr };
-	exporter.SetImageWriter(writeImageData, &fs);
-
 	spdlog::info("...using tiny glTF");
 	bool success = false;
-    if (!exporter.WriteGltfSceneToFile(&model, aOutputFile, aSettings.mEmbedImages, aSettings.mEmbedBuffers, true, aSettings.mWriteBinary)) {
-        spdlog::error("Could not save gltf to {}", aOutputFile);
-		success = false;
-    } else
-    {
-        spdlog::info("Scene saved to gltf: {}", aOutputFile);
-		success = true;
-    }
+	if (aSettings.mWriteBinary || !aSettings.mEmbedBuffers) {
+		success = writeStreamed(aOutputFile, aSettings, model, dataBuffer);
+	} else {
+		tinygltf::Buffer buffer;
+		buffer.uri = std::filesystem::path(aOutputFile).stem().string() + ".bin";
+		writeBufferToMemory(dataBuffer, buffer.data);
+		if (dataBuffer.mPointer) model.buffers.push_back(std::move(buffer));
+
+		tinygltf::TinyGLTF exporter;
+		const tinygltf::WriteImageDataFunction writeImageData = &tinygltf::WriteImageData;
+		tinygltf::FsCallbacks fs = { &tinygltf::FileExists, &tinygltf::ExpandFilePath,
+		&tinygltf::ReadWholeFile, &tinygltf::WriteWholeFile, nullptr };
+		exporter.SetImageWriter(writeImageData, &fs);
+		success = exporter.WriteGltfSceneToFile(&model, aOutputFile, aSettings.mEmbedImages, aSettings.mEmbedBuffers, true, aSettings.mWriteBinary);
+	}
+	if (!success) spdlog::error("Could not save gltf to {}", aOutputFile);
+	else spdlog::info("Scene saved to gltf: {}", aOutputFile);
 	
 	imageToIndexDirectory.clear();
 	textureToIndexDirectory.clear();
 	materialToIndexDirectory.clear();
 	modelToIndexDirectory.clear();
+	meshToPrimitiveDirectory.clear();
 	cameraToIndexDirectory.clear();
 	lightToIndexDirectory.clear();
 	usedImageFilepaths.clear();
@@ -1,17 +1,144 @@
 #include <tamashii/core/io/io.hpp>
+#include <tamashii/core/common/vars.hpp>
+#include <tamashii/core/common/thread_pool.hpp>
 #include <stb_image_write.h>
 
+#define TINYEXR_USE_THREAD 1
 #define TINYEXR_IMPLEMENTATION
 #include <tinyexr.h>
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
 T_USE_NAMESPACE
 
+namespace {
+	constexpr uint32_t DEINTERLEAVE_ROWS = 32;
+
+	/**
+	* ImageWriter
+	* Single background thread that writes queued images in submission order
+	**/
+	class ImageWriter {
+	public:
+		static ImageWriter&			getInstance()
+									{
+										static ImageWriter instance;
+										return instance;
+									}
+									ImageWriter(ImageWriter const&) = delete;
+		void						operator=(ImageWriter const&) = delete;
+
+		std::future<bool>			push(std::function<bool()> aTask)
+									{
+										std::packaged_task<bool()> task(std::move(aTask));
+										std::future<bool> future = task.get_future();
+										{
+											const std::lock_guard lock(mMutex);
+											mTasks.emplace_back(std::move(task));
+										}
+										mCondition.notify_one();
+										return future;
+									}
+		void						wait()
+									{
+										std::unique_lock lock(mMutex);
+										mIdle.wait(lock, [this] { return mTasks.empty() && !mBusy; });
+									}
+	private:
+									// the pool is created first so it outlives the writer, pending saves use it
+									ImageWriter() : mStop(false), mBusy(false) { ThreadPool::getInstance(); mThread = std::thread(&ImageWriter::worker, this); }
+									~ImageWriter()
+									{
+										{
+											const std::lock_guard lock(mMutex);
+											mStop = true;
+										}
+										mCondition.notify_all();
+										if (mThread.joinable()) mThread.join();
+									}
+		void						worker()
+									{
+										while (true) {
+											std::packaged_task<bool()> task;
+											{
+												std::unique_lock lock(mMutex);
+												mCondition.wait(lock, [this] { return mStop || !mTasks.empty(); });
+												if (mTasks.empty()) return;
+												task = std::move(mTasks.front());
+												mTasks.pop_front();
+												mBusy = true;
+											}
+											task();
+											{
+												const std::lock_guard lock(mMutex);
+												mBusy = false;
+											}
+											mIdle.notify_all();
+										}
+									}
+
+		std::thread					mThread;
+		std::deque<std::packaged_task<bool()>> mTasks;
+		std::mutex					mMutex;
+		std::condition_variable		mCondition;
+		std::condition_variable		mIdle;
+		bool						mStop;
+		bool						mBusy;
+	};
+
+	// copies pixels [aBegin, aEnd) of the interleaved image into the channel planes, planes that are not exported are nullptr
+	void deinterleave(const float* aPixels, const uint32_t aStride, float* const* aPlanes, const size_t aBegin, const size_t aEnd)
+	{
+		size_t i = aBegin;
+#if defined(__SSE2__) || defined(_M_X64)
+		if (aStride == 4) {
+			for (; i + 4 <= aEnd; i += 4) {
+				const float* src = aPixels + i * 4;
+				__m128 r0 = _mm_loadu_ps(src);
+				__m128 r1 = _mm_loadu_ps(src + 4);
+				__m128 r2 = _mm_loadu_ps(src + 8);
+				__m128 r3 = _mm_loadu_ps(src + 12);
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+				if (aPlanes[0]) _mm_storeu_ps(aPlanes[0] + i, r0);
+				if (aPlanes[1]) _mm_storeu_ps(aPlanes[1] + i, r1);
+				if (aPlanes[2]) _mm_storeu_ps(aPlanes[2] + i, r2);
+				if (aPlanes[3]) _mm_storeu_ps(aPlanes[3] + i, r3);
+			}
+		}
+#endif
+		for (; i < aEnd; i++) {
+			for (uint32_t c = 0; c < aStride; c++) if (aPlanes[c]) aPlanes[c][i] = aPixels[static_cast<size_t>(aStride) * i + c];
+		}
+	}
+}
+
+io::Export::ExrSettings io::Export::ExrSettings::fromVars()
+{
+	ExrSettings settings;
+	const std::string& compression = var::exr_compression.value();
+	if (compression == "piz") settings.mCompression = Compression::PIZ;
+	else if (compression == "zip") settings.mCompression = Compression::ZIP;
+	else if (compression != "none") spdlog::warn("Unknown exr_compression '{}', using none", compression);
+	settings.mHalf = var::exr_half.value();
+	return settings;
+}
+
 void io::Export::save_image_png_8_bit(std::string const& aName, const int aWidth, const int aHeight, const int aChannels, const uint8_t* aPixels)
 {
     stbi_write_png(aName.c_str(), aWidth, aHeight, aChannels, aPixels, aWidth * aChannels);
 }
 
 void io::Export::save_image_exr(std::string const& aName, const int aWidth, const int aHeight, const float* aPixels, const uint32_t aStride, const std::vector<uint8_t>& aOut)
+{
+    save_image_exr(aName, aWidth, aHeight, aPixels, aStride, aOut, ExrSettings::fromVars());
+}
+
+bool io::Export::save_image_exr(std::string const& aName, const int aWidth, const int aHeight, const float* aPixels, const uint32_t aStride, const std::vector<uint8_t>& aOut, const ExrSettings& aSettings)
 {
     EXRHeader header;
     InitEXRHeader(&header);
@@ -19,23 +146,31 @@ void io::Export::save_image_exr(std::string const& aName, const int aWidth, cons
     EXRImage image;
     InitEXRImage(&image);
 
-    const auto dim = static_cast<uint32_t>(aWidth * aHeight);
-    
+    const auto dim = static_cast<size_t>(aWidth) * static_cast<size_t>(aHeight);
+
     image.num_channels = static_cast<int>(aOut.size());
     header.num_channels = static_cast<int>(aOut.size());
 
+    // only the exported channels get a plane
     std::vector<std::vector<float>> images(aStride);
-    for(std::vector<float>& v : images) v.resize(dim);
-
-    
-    for (uint32_t i = 0; i < dim; i++) {
-        for (uint32_t j = 0; j < images.size(); j++)
-        {
-        	images[j][i] = aPixels[aStride * i + j];
+    std::vector<float*> planes(aStride, nullptr);
+    for (const uint8_t v : aOut) {
+        if (v >= aStride) {
+            spdlog::error("Save EXR err: channel {} out of range for stride {}", v, aStride);
+            return false;
         }
+        if (images[v].empty()) images[v].resize(dim);
+        planes[v] = images[v].data();
     }
 
-    
+    const size_t rowBlocks = (static_cast<size_t>(aHeight) + DEINTERLEAVE_ROWS - 1) / DEINTERLEAVE_ROWS;
+    ThreadPool::getInstance().parallelFor(0, rowBlocks, [&](const size_t aBlock) {
+        const size_t begin = aBlock * DEINTERLEAVE_ROWS * aWidth;
+        const size_t end = std::min(dim, (aBlock + 1) * DEINTERLEAVE_ROWS * aWidth);
+        deinterleave(aPixels, aStride, planes.data(), begin, end);
+    });
+
+
     std::vector<EXRChannelInfo> channelInfos(header.num_channels);
     header.channels = channelInfos.data();
 
@@ -57,15 +192,42 @@ void io::Export::save_image_exr(std::string const& aName, const int aWidth, cons
     image.height = aHeight;
 
     std::vector pixelTypes(header.num_channels, TINYEXR_PIXELTYPE_FLOAT);
-    std::vector requestedPixelTypes(header.num_channels, TINYEXR_PIXELTYPE_FLOAT);
+    std::vector requestedPixelTypes(header.num_channels, aSettings.mHalf ? TINYEXR_PIXELTYPE_HALF : TINYEXR_PIXELTYPE_FLOAT);
     header.pixel_types = pixelTypes.data();
     header.requested_pixel_types = requestedPixelTypes.data();
 
+    switch (aSettings.mCompression) {
+        case ExrSettings::Compression::NONE: header.compression_type = TINYEXR_COMPRESSIONTYPE_NONE; break;
+        case ExrSettings::Compression::ZIP: header.compression_type = TINYEXR_COMPRESSIONTYPE_ZIP; break;
+        case ExrSettings::Compression::PIZ: header.compression_type = TINYEXR_COMPRESSIONTYPE_PIZ; break;
+    }
+
     const char* err = nullptr;
     const int ret = SaveEXRImageToFile(&image, &header, aName.c_str(), &err);
     if (ret != TINYEXR_SUCCESS) {
         spdlog::error("Save EXR err: {}", err);
-        FreeEXRErrorMessage(err); 
-        return;
+        FreeEXRErrorMessage(err);
+        return false;
     }
+    return true;
+}
+
+std::future<bool> io::Export::save_image_png_8_bit_async(std::string aName, const int aWidth, const int aHeight, const int aChannels, std::vector<uint8_t> aPixels)
+{
+	return ImageWriter::getInstance().push([name = std::move(aName), aWidth, aHeight, aChannels, pixels = std::move(aPixels)] {
+		return stbi_write_png(name.c_str(), aWidth, aHeight, aChannels, pixels.data(), aWidth * aChannels) != 0;
+	});
+}
+
+std::future<bool> io::Export::save_image_exr_async(std::string aName, const int aWidth, const int aHeight, std::vector<float> aPixels, const uint32_t aStride,
+	std::vector<uint8_t> aOut, const ExrSettings& aSettings)
+{
+	return ImageWriter::getInstance().push([name = std::move(aName), aWidth, aHeight, pixels = std::move(aPixels), aStride, out = std::move(aOut), aSettings] {
+		return save_image_exr(name, aWidth, aHeight, pixels.data(), aStride, out, aSettings);
+	});
+}
+
+void io::Export::wait_for_image_saves()
+{
+	ImageWriter::getInstance().wait();
 }
@@ -7,11 +7,14 @@
 #include <tamashii/core/scene/material.hpp>
 #include <tamashii/core/scene/model.hpp>
 #include <tamashii/core/scene/scene_graph.hpp>
+#include <tamashii/core/common/thread_pool.hpp>
+#include <tamashii/core/common/vars.hpp>
 
 #include <sstream>
 #include <fstream>
 #include <string>
 #include <array>
+#include <algorithm>
 #include <filesystem>
 #include <glm/glm.hpp>
 
@@ -172,17 +175,29 @@ static std::vector<BSP::Texture> loadTextures(std::ifstream& in, int offset, int
 }
 
 static std::vector<BSP::LightMap> loadLightMaps(std::ifstream& in, int offset, int size) {
-	const int lightMapCount = size / (128 * 128 * 3);
+	constexpr int pixelCount = 128 * 128;
+	const int lightMapCount = size / (pixelCount * 3);
 	std::vector<BSP::LightMap> lightMaps(lightMapCount);
 
+	// read the whole lump at once and expand RGB to RGBA per lightmap
+	std::vector<uint8_t> rgb(static_cast<size_t>(lightMapCount) * pixelCount * 3);
 	in.seekg(offset);
+	in.read((char*)rgb.data(), static_cast<std::streamsize>(rgb.size()));
+	if (in.gcount() != static_cast<std::streamsize>(rgb.size())) {
+		spdlog::error("Lightmap lump truncated, read {} of {} bytes", in.gcount(), rgb.size());
+		return {};
+	}
 
-	for (BSP::LightMap& lightMap : lightMaps) {
-		for (int i = 0; i < 128 * 128; i++) {
-			in.read((char*)&lightMap.data[i * 4], 3);
-			lightMap.data[i * 4 + 3] = 255;
+	ThreadPool::getInstance().parallelFor(0, lightMaps.size(), [&](const size_t aIndex) {
+		const uint8_t* src = rgb.data() + aIndex * pixelCount * 3;
+		uint8_t* dst = lightMaps[aIndex].data.data();
+		for (int i = 0; i < pixelCount; i++) {
+			dst[i * 4 + 0] = src[i * 3 + 0];
+			dst[i * 4 + 1] = src[i * 3 + 1];
+			dst[i * 4 + 2] = src[i * 3 + 2];
+			dst[i * 4 + 3] = 255;
 		}
-	}
+	});
 
 	return lightMaps;
 }
@@ -535,10 +550,23 @@ std::unique_ptr<io::SceneData> io::Import::load_bsp(const std::string& aFile) {
 	
 	lightMaps = loadLightMaps(in, header.lumps[LIGHTMAP].offset, header.lumps[LIGHTMAP].size);
 
+	// a short read of any lump leaves the stream failed
+	if (!in) {
+		spdlog::critical("Truncated file '{}'", aFile);
+		return nullptr;
+	}
+
 
 	
 
-	for (const BSP::Face& face : faces) {
+	// every face writes into its own slot, the slots are compacted in face order afterwards
+	// so the result does not depend on the scheduling
+	const int bezierLevel = static_cast<int>(std::max(var::bsp_patch_level.value(), 1u));
+	std::vector<BSPMesh> faceMeshes(faces.size());
+	std::vector<uint8_t> faceUsed(faces.size(), 0);
+	ThreadPool::getInstance().parallelFor(0, faces.size(), [&](const size_t aFaceIndex) {
+		const BSP::Face& face = faces[aFaceIndex];
+		BSPMesh& mesh = faceMeshes[aFaceIndex];
 
 		
 		if (face.type == 1 || face.type == 3) {
@@ -548,15 +576,12 @@ std::unique_ptr<io::SceneData> io::Import::load_bsp(const std::string& aFile) {
 			const int meshVertexOffset = face.meshVertexOffset;
 			const int meshVertexCount = face.meshVertexCount;
 
-			BSPMesh mesh = BSPMesh();
-
 			mesh.texture = face.shader;
 			mesh.lightMap = face.lightMap;
 
 			
-			for (int i = 0; i < vertexCount; i++) {
-				mesh.vertices.push_back(vertices[vertexOffset + i]);
-			}
+			mesh.vertices.assign(vertices.begin() + vertexOffset, vertices.begin() + vertexOffset + vertexCount);
+			mesh.indices.reserve(meshVertexCount);
 
 			
 			for (int i = 0; i < meshVertexCount; i += 3) {
@@ -565,18 +590,18 @@ std::unique_ptr<io::SceneData> io::Import::load_bsp(const std::string& aFile) {
 				mesh.indices.push_back(meshVertices[meshVertexOffset + i + 1].offset);
 			}
 
-			meshes.push_back(mesh);
+			faceUsed[aFaceIndex] = 1;
 		}
 
 		
 		if (face.type == 2) {
-
-			BSPMesh mesh = BSPMesh();
 			mesh.texture = face.shader;
 			mesh.lightMap = face.lightMap;
 
 			int dimX = (face.size[0] - 1) / 2;
 			int dimY = (face.size[1] - 1) / 2;
+			mesh.vertices.reserve(static_cast<size_t>(dimX) * dimY * (bezierLevel + 1) * (bezierLevel + 1));
+			mesh.indices.reserve(static_cast<size_t>(dimX) * dimY * bezierLevel * bezierLevel * 6);
 
 			for (int x = 0, n = 0; n < dimX; n++, x = 2 * n)
 			{
@@ -597,17 +622,22 @@ std::unique_ptr<io::SceneData> io::Import::load_bsp(const std::string& aFile) {
 						vertices[controlOffset + face.size[0] * 2 + 2],
 						mesh.vertices,
 						mesh.indices,
-						3
+						bezierLevel
 					);
 				}
 			}
 
-			meshes.push_back(mesh);
+			faceUsed[aFaceIndex] = 1;
 		}
 
 		
 		if (face.type == 4) {
 		}
+	});
+
+	meshes.reserve(faces.size());
+	for (size_t i = 0; i < faces.size(); i++) {
+		if (faceUsed[i]) meshes.push_back(std::move(faceMeshes[i]));
 	}
 
 
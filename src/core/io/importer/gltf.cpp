@@ -9,6 +9,8 @@
 #include <tamashii/core/scene/light.hpp>
 #include <tamashii/core/topology/topology.hpp>
 #include <tamashii/core/common/vars.hpp>
+#include <tamashii/core/common/thread_pool.hpp>
+#include <tamashii/core/common/profiler.hpp>
 
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -246,162 +248,121 @@ namespace {
 			}
 		}
 	}
+	struct AccessorView {
+		const uint8_t*	mData;
+		size_t			mStride;
+		size_t			mCount;
+		int				mComponentType;
+		int				mType;
+	};
+	AccessorView getAccessorView(const tinygltf::Model& aModel, const int aAccessorsIndex) {
+		const tinygltf::Accessor& accessor = aModel.accessors[aAccessorsIndex];
+		const tinygltf::BufferView& bufferView = aModel.bufferViews[accessor.bufferView];
+		const tinygltf::Buffer& buffer = aModel.buffers[bufferView.buffer];
+		return { &buffer.data[bufferView.byteOffset + accessor.byteOffset], static_cast<size_t>(accessor.ByteStride(bufferView)),
+			accessor.count, accessor.componentType, accessor.type };
+	}
+	// walk a (possibly interleaved) accessor once and hand every element to aStore
+	// the component type is resolved by the caller so the inner loop is branch free
+	template<typename T, typename F>
+	void copyAccessor(std::vector<vertex_s>& aVertices, const AccessorView& aView, F&& aStore) {
+		assert(aVertices.size() == aView.mCount);
+		if (aView.mStride == sizeof(T)) {
+			const auto src = reinterpret_cast<const T*>(aView.mData);
+			for (size_t i = 0; i < aView.mCount; i++) aStore(aVertices[i], src[i]);
+		} else {
+			const uint8_t* src = aView.mData;
+			for (size_t i = 0; i < aView.mCount; i++, src += aView.mStride) aStore(aVertices[i], *reinterpret_cast<const T*>(src));
+		}
+	}
+	template<typename T>
+	void copyIndices(uint32_t* aDst, const AccessorView& aView) {
+		if constexpr (std::is_same_v<T, uint32_t>) {
+			if (aView.mStride == sizeof(T)) {
+				std::memcpy(aDst, aView.mData, aView.mCount * sizeof(T));
+				return;
+			}
+		}
+		const uint8_t* src = aView.mData;
+		for (size_t i = 0; i < aView.mCount; i++, src += aView.mStride) aDst[i] = static_cast<uint32_t>(*reinterpret_cast<const T*>(src));
+	}
+
 	/**
 	* Model
 	**/
 	void loadIndices(Mesh& tmesh, const tinygltf::Model& aModel, const int accessorsIndex) {
 		if (accessorsIndex == -1) return;
-		const tinygltf::Accessor& accessor = aModel.accessors[accessorsIndex];
-		const tinygltf::BufferView& bufferView = aModel.bufferViews[accessor.bufferView];
-		const tinygltf::Buffer& buffer = aModel.buffers[bufferView.buffer];
-		const int byteStride = accessor.ByteStride(bufferView);
+		const AccessorView view = getAccessorView(aModel, accessorsIndex);
 
-		assert((accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE || accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT || accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)
-			&& accessor.type == TINYGLTF_TYPE_SCALAR);
+		assert((view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE || view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT || view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)
+			&& view.mType == TINYGLTF_TYPE_SCALAR);
 
 		std::vector<uint32_t> &indices = tmesh.getIndicesVectorRef();
-		indices.resize(accessor.count);
-		const auto data = const_cast<uint8_t*>(&buffer.data[bufferView.byteOffset + accessor.byteOffset]);
-		for (size_t i = 0; i < accessor.count; i++) {
-			if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
-				const auto idx = &data[i * byteStride];
-				indices[i] = static_cast<uint32_t>(idx[0]);
-			}
-			else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-				const auto idx = reinterpret_cast<const uint16_t*>(&data[i * byteStride]);
-				indices[i] = static_cast<uint32_t>(idx[0]);
-			}
-			else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
-				const auto idx = reinterpret_cast<const uint32_t*>(&data[i * byteStride]);
-				indices[i] = static_cast<uint32_t>(idx[0]);
-			}
-		}
+		indices.resize(view.mCount);
+		if (view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) copyIndices<uint8_t>(indices.data(), view);
+		else if (view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) copyIndices<uint16_t>(indices.data(), view);
+		else if (view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) copyIndices<uint32_t>(indices.data(), view);
 		tmesh.hasIndices(true);
-		assert(indices.size() == accessor.count);
+		assert(indices.size() == view.mCount);
 	}
 
 	void loadPositions(std::vector<vertex_s> &aVertices, const tinygltf::Model& model, const int accessorsIndex) {
 		if (accessorsIndex == -1) return;
-		const tinygltf::Accessor& accessor = model.accessors[accessorsIndex];
-		const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-		const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-		const int byteStride = accessor.ByteStride(bufferView);
+		const AccessorView view = getAccessorView(model, accessorsIndex);
 
-		assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT && accessor.type == TINYGLTF_TYPE_VEC3);
-		const auto data = &buffer.data[bufferView.byteOffset + accessor.byteOffset];
-		for (size_t i = 0; i < accessor.count; i++) {
-			const auto pos = reinterpret_cast<const glm::vec3*>(&data[i * byteStride]);
-			aVertices[i].position = glm::vec4(pos[0], 1);
-		}
-		assert(aVertices.size() == accessor.count);
+		assert(view.mComponentType == TINYGLTF_COMPONENT_TYPE_FLOAT && view.mType == TINYGLTF_TYPE_VEC3);
+		copyAccessor<glm::vec3>(aVertices, view, [](vertex_s& aV, const glm::vec3& aPos) { aV.position = glm::vec4(aPos, 1); });
 	}
 	void loadNormals(std::vector<vertex_s>& aVertices, const tinygltf::Model& model, const int accessorsIndex) {
 		if (accessorsIndex == -1) return;
-		const tinygltf::Accessor& accessor = model.accessors[accessorsIndex];
-		const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-		const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-		const int byteStride = accessor.ByteStride(bufferView);
+		const AccessorView view = getAccessorView(model, accessorsIndex);
 
-		assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT && accessor.type == TINYGLTF_TYPE_VEC3);
-		const auto data = &buffer.data[bufferView.byteOffset + accessor.byteOffset];
-		for (size_t i = 0; i < accessor.count; i++) {
-			const auto normal = reinterpret_cast<const glm::vec3*>(&data[i * byteStride]);
-			aVertices[i].normal = glm::vec4(normal[0], 0);
-		}
-		assert(aVertices.size() == accessor.count);
+		assert(view.mComponentType == TINYGLTF_COMPONENT_TYPE_FLOAT && view.mType == TINYGLTF_TYPE_VEC3);
+		copyAccessor<glm::vec3>(aVertices, view, [](vertex_s& aV, const glm::vec3& aNormal) { aV.normal = glm::vec4(aNormal, 0); });
 	}
 	void loadTangents(std::vector<vertex_s>& aVertices, const tinygltf::Model& model, const int accessorsIndex) {
 		if (accessorsIndex == -1) return;
-		const tinygltf::Accessor& accessor = model.accessors[accessorsIndex];
-		const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-		const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-		const int byteStride = accessor.ByteStride(bufferView);
+		const AccessorView view = getAccessorView(model, accessorsIndex);
 
-		assert((accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT && accessor.type == TINYGLTF_TYPE_VEC4));
-		const auto data = &buffer.data[bufferView.byteOffset + accessor.byteOffset];
-		for (size_t i = 0; i < accessor.count; i++) {
-			const auto tangent = reinterpret_cast<const glm::vec4*>(&data[i * byteStride]);
-			aVertices[i].tangent = tangent[0];
-			aVertices[i].tangent[3] = 0;
-		}
-		assert(aVertices.size() == accessor.count);
+		assert((view.mComponentType == TINYGLTF_COMPONENT_TYPE_FLOAT && view.mType == TINYGLTF_TYPE_VEC4));
+		copyAccessor<glm::vec4>(aVertices, view, [](vertex_s& aV, const glm::vec4& aTangent) { aV.tangent = glm::vec4(glm::vec3(aTangent), 0); });
 	}
-	void loadTexCoords0(std::vector<vertex_s>& aVertices, const tinygltf::Model& model, const int accessorsIndex) {
+	void loadTexCoords(std::vector<vertex_s>& aVertices, const tinygltf::Model& aModel, const int accessorsIndex, glm::vec2 vertex_s::* aTarget) {
 		if (accessorsIndex == -1) return;
-		const tinygltf::Accessor& accessor = model.accessors[accessorsIndex];
-		const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-		const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-		const int byteStride = accessor.ByteStride(bufferView);
-		assert((accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT || accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT || accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
-			&& accessor.type == TINYGLTF_TYPE_VEC2);
-		const auto data = &buffer.data[bufferView.byteOffset + accessor.byteOffset];
-		for (size_t i = 0; i < accessor.count; i++) {
-			if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
-				const auto uv = reinterpret_cast<const glm::vec2*>(&data[i * byteStride]);
-				aVertices[i].texture_coordinates_0 = uv[0];
-			} else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-				const auto uv = reinterpret_cast<const glm::u16vec2*>(&data[i * byteStride]);
-				aVertices[i].texture_coordinates_0 = glm::vec2(uv[0]) / glm::vec2(65535);
-			} else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
-				const auto uv = reinterpret_cast<const glm::u8vec2*>(&data[i * byteStride]);
-				aVertices[i].texture_coordinates_0 = glm::vec2(uv[0]) / glm::vec2(255);
-			}
+		const AccessorView view = getAccessorView(aModel, accessorsIndex);
+		assert((view.mComponentType == TINYGLTF_COMPONENT_TYPE_FLOAT || view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT || view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
+			&& view.mType == TINYGLTF_TYPE_VEC2);
+		if (view.mComponentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+			copyAccessor<glm::vec2>(aVertices, view, [aTarget](vertex_s& aV, const glm::vec2& aUv) { aV.*aTarget = aUv; });
+		} else if (view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+			copyAccessor<glm::u16vec2>(aVertices, view, [aTarget](vertex_s& aV, const glm::u16vec2& aUv) { aV.*aTarget = glm::vec2(aUv) / glm::vec2(65535); });
+		} else if (view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+			copyAccessor<glm::u8vec2>(aVertices, view, [aTarget](vertex_s& aV, const glm::u8vec2& aUv) { aV.*aTarget = glm::vec2(aUv) / glm::vec2(255); });
 		}
-		assert(aVertices.size() == accessor.count);
+	}
+	void loadTexCoords0(std::vector<vertex_s>& aVertices, const tinygltf::Model& model, const int accessorsIndex) {
+		loadTexCoords(aVertices, model, accessorsIndex, &vertex_s::texture_coordinates_0);
 	}
 	void loadTexCoords1(std::vector<vertex_s>& aVertices, const tinygltf::Model& aModel, const int accessorsIndex) {
-		if (accessorsIndex == -1) return;
-		const tinygltf::Accessor& accessor = aModel.accessors[accessorsIndex];
-		const tinygltf::BufferView& bufferView = aModel.bufferViews[accessor.bufferView];
-		const tinygltf::Buffer& buffer = aModel.buffers[bufferView.buffer];
-		const int byteStride = accessor.ByteStride(bufferView);
-		assert((accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT || accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT || accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
-			&& accessor.type == TINYGLTF_TYPE_VEC2);
-		const auto data = &buffer.data[bufferView.byteOffset + accessor.byteOffset];
-		for (size_t i = 0; i < accessor.count; i++) {
-			if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
-				const auto uv = reinterpret_cast<const glm::vec2*>(&data[i * byteStride]);
-				aVertices[i].texture_coordinates_1 = uv[0];
-			}
-			else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-				const auto uv = reinterpret_cast<const glm::u16vec2*>(&data[i * byteStride]);
-				aVertices[i].texture_coordinates_1 = glm::vec2(uv[0]) / glm::vec2(65535);
-			}
-			else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
-				const auto uv = reinterpret_cast<const glm::u8vec2*>(&data[i * byteStride]);
-				aVertices[i].texture_coordinates_1 = glm::vec2(uv[0]) / glm::vec2(255);
-			}
-		}
-		assert(aVertices.size() == accessor.count);
+		loadTexCoords(aVertices, aModel, accessorsIndex, &vertex_s::texture_coordinates_1);
 	}
 	void loadColors0(std::vector<vertex_s>& aVertices, const tinygltf::Model& aModel, const int accessorsIndex) {
 		if (accessorsIndex == -1) return;
-		const tinygltf::Accessor& accessor = aModel.accessors[accessorsIndex];
-		const tinygltf::BufferView& bufferView = aModel.bufferViews[accessor.bufferView];
-		const tinygltf::Buffer& buffer = aModel.buffers[bufferView.buffer];
-		const int byteStride = accessor.ByteStride(bufferView);
-
-		assert((accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT || accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT || 
-			accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) && (accessor.type == TINYGLTF_TYPE_VEC3 || accessor.type == TINYGLTF_TYPE_VEC4));
-		const auto data = &buffer.data[bufferView.byteOffset + accessor.byteOffset];
-		for (size_t i = 0; i < accessor.count; i++) {
-			if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
-				const auto color = reinterpret_cast<const float*>(&data[i * byteStride]);
-				if(accessor.type == TINYGLTF_TYPE_VEC3) aVertices[i].color_0 = glm::vec4(color[0], color[1], color[2], 1);
-				else if (accessor.type == TINYGLTF_TYPE_VEC4) aVertices[i].color_0 = glm::vec4(color[0], color[1], color[2], color[3]);
-			} else if(accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
-			{
-				const auto color = reinterpret_cast<const uint16_t*>(&data[i * byteStride]);
-				if (accessor.type == TINYGLTF_TYPE_VEC3) aVertices[i].color_0 = glm::vec4(color[0], color[1], color[2], 65535) / glm::vec4(65535);
-				else if (accessor.type == TINYGLTF_TYPE_VEC4) aVertices[i].color_0 = glm::vec4(color[0], color[1], color[2], color[3]) / glm::vec4(65535);
-			} else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
-			{
-				const auto color = &data[i * byteStride];
-				if (accessor.type == TINYGLTF_TYPE_VEC3) aVertices[i].color_0 = glm::vec4(color[0], color[1], color[2], 255) / glm::vec4(255);
-				else if (accessor.type == TINYGLTF_TYPE_VEC4) aVertices[i].color_0 = glm::vec4(color[0], color[1], color[2], color[3]) / glm::vec4(255);
-			}
+		const AccessorView view = getAccessorView(aModel, accessorsIndex);
+
+		assert((view.mComponentType == TINYGLTF_COMPONENT_TYPE_FLOAT || view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT || 
+			view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) && (view.mType == TINYGLTF_TYPE_VEC3 || view.mType == TINYGLTF_TYPE_VEC4));
+		const bool rgb = view.mType == TINYGLTF_TYPE_VEC3;
+		if (view.mComponentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+			if (rgb) copyAccessor<glm::vec3>(aVertices, view, [](vertex_s& aV, const glm::vec3& aC) { aV.color_0 = glm::vec4(aC, 1); });
+			else copyAccessor<glm::vec4>(aVertices, view, [](vertex_s& aV, const glm::vec4& aC) { aV.color_0 = aC; });
+		} else if (view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+			if (rgb) copyAccessor<glm::u16vec3>(aVertices, view, [](vertex_s& aV, const glm::u16vec3& aC) { aV.color_0 = glm::vec4(glm::vec3(aC) / glm::vec3(65535), 1); });
+			else copyAccessor<glm::u16vec4>(aVertices, view, [](vertex_s& aV, const glm::u16vec4& aC) { aV.color_0 = glm::vec4(aC) / glm::vec4(65535); });
+		} else if (view.mComponentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+			if (rgb) copyAccessor<glm::u8vec3>(aVertices, view, [](vertex_s& aV, const glm::u8vec3& aC) { aV.color_0 = glm::vec4(glm::vec3(aC) / glm::vec3(255), 1); });
+			else copyAccessor<glm::u8vec4>(aVertices, view, [](vertex_s& aV, const glm::u8vec4& aC) { aV.color_0 = glm::vec4(aC) / glm::vec4(255); });
 		}
-		assert(aVertices.size() == accessor.count);
 	}
 	void loadCustomData(const std::string& aKey, std::map<std::string, tamashii::Mesh::CustomData>& aExtraData, const tinygltf::Model& aModel, const int aAccessorsIndex) {
 		if (aAccessorsIndex == -1) return;
@@ -416,7 +377,7 @@ namespace {
 		aExtraData.emplace(std::make_pair( aKey, std::move(ed) ));
 	}
 
-	void loadVertices(Mesh& tmesh, const tinygltf::Model& aModel, tinygltf::Primitive& aPrimitive) {
+	void loadVertices(Mesh& tmesh, const tinygltf::Model& aModel, const tinygltf::Primitive& aPrimitive) {
 		int idxPosition = -1;
 		int idxNormal = -1;
 		int idxTangent = -1;
@@ -427,7 +388,7 @@ namespace {
 		
 		
 
-		for (std::pair<std::string const, int>& attrib : aPrimitive.attributes) {
+		for (const std::pair<std::string const, int>& attrib : aPrimitive.attributes) {
 			if (attrib.first == "POSITION") idxPosition = attrib.second;
 			else if (attrib.first == "NORMAL") idxNormal = attrib.second;
 			else if (attrib.first == "TANGENT") idxTangent = attrib.second;
@@ -478,35 +439,47 @@ namespace {
 	}
 
 
-	void loadModel(Model& m_dst, tinygltf::Mesh& m_gltf, const tinygltf::Model& model) {
-		
-		aabb_s aabb;
-		for (tinygltf::Primitive& primitive : m_gltf.primitives) {
-			std::shared_ptr tmesh = Mesh::alloc();
-			const int indicesIdx = primitive.indices;
+	void loadPrimitive(Mesh& tmesh, const tinygltf::Primitive& primitive, const tinygltf::Model& model) {
+		const int indicesIdx = primitive.indices;
 
-			tmesh->setTopology(tinygltfModeToTopology(primitive.mode));
-			
-			loadIndices(*tmesh, model, indicesIdx);
-			
-			loadVertices(*tmesh, model, primitive);
-			
-			if (!tmesh->hasNormals() && tmesh->getTopology() == Mesh::Topology::TRIANGLE_LIST) topology::calcNormals(tmesh.get());
-			if (!tmesh->hasTangents() && tmesh->getTopology() == Mesh::Topology::TRIANGLE_LIST && tmesh->hasTexCoords0()) topology::calcMikkTSpaceTangents(tmesh.get());
-			if (!tmesh->hasTangents() && tmesh->getTopology() == Mesh::Topology::TRIANGLE_LIST) topology::calcStarkTangents(tmesh.get());
-			
-			if (primitive.material != -1)  tmesh->setMaterial(materialToStorageDirectory[primitive.material]);
+		tmesh.setTopology(tinygltfModeToTopology(primitive.mode));
+		
+		loadIndices(tmesh, model, indicesIdx);
+		
+		loadVertices(tmesh, model, primitive);
+		
+		if (!tmesh.hasNormals() && tmesh.getTopology() == Mesh::Topology::TRIANGLE_LIST) topology::calcNormals(&tmesh);
+		if (!tmesh.hasTangents()) {
+			const bool normalMapped = primitive.material != -1 && materialToStorageDirectory[primitive.material]->hasNormalTexture();
+			topology::calcTangents(&tmesh, normalMapped);
+		}
+		
+		if (primitive.material != -1)  tmesh.setMaterial(materialToStorageDirectory[primitive.material]);
+		loadCustomProperties(primitive.extras, tmesh);
+	}
 
-			if (m_dst.size() == 0) aabb = tmesh->getAABB();
-			else aabb = aabb.merge(tmesh->getAABB());
-			loadCustomProperties(primitive.extras, *tmesh);
+	// meshes are only allocated here, the primitive data is filled in later by loadPrimitive
+	// this keeps the order of meshes independent of the order in which the workers finish
+	void loadModel(Model& m_dst, const tinygltf::Mesh& m_gltf, std::vector<std::pair<Mesh*, const tinygltf::Primitive*>>& aPrimitives) {
+		for (const tinygltf::Primitive& primitive : m_gltf.primitives) {
+			std::shared_ptr tmesh = Mesh::alloc();
+			aPrimitives.emplace_back(tmesh.get(), &primitive);
 			m_dst.addMesh(tmesh);
 		}
-		m_dst.setAABB(aabb);
-
 		loadCustomProperties(m_gltf.extras, m_dst);
 	}
 
+	void finalizeModel(Model& m_dst) {
+		aabb_s aabb;
+		bool first = true;
+		for (const auto& mesh : m_dst) {
+			if (first) aabb = mesh->getAABB();
+			else aabb = aabb.merge(mesh->getAABB());
+			first = false;
+		}
+		m_dst.setAABB(aabb);
+	}
+
 	
 	void loadCamera(Camera& c_dst, const tinygltf::Camera& c_gltf, tinygltf::Model& model) {
 		if (c_gltf.type == "perspective") {
@@ -832,12 +805,19 @@ void loadScene(io::SceneData& si, tinygltf::Model& aModel, const std::string& aD
 	}
 	
 	if (!aModel.meshes.empty()) spdlog::info("Loading Models:");
+	std::vector<std::pair<Mesh*, const tinygltf::Primitive*>> primitives;
 	for (tinygltf::Mesh& m_gltf : aModel.meshes) {
 		std::shared_ptr<Model> m = Model::alloc(m_gltf.name);
-		loadModel(*m, m_gltf, aModel);
+		loadModel(*m, m_gltf, primitives);
 		meshToStorageDirectory.push_back(m);
 		si.mModels.push_back(m);
-
+	}
+	
+	ThreadPool::getInstance().parallelFor(0, primitives.size(), [&](const size_t aIdx) {
+		loadPrimitive(*primitives[aIdx].first, *primitives[aIdx].second, aModel);
+	});
+	for (const std::shared_ptr<Model>& m : meshToStorageDirectory) {
+		finalizeModel(*m);
 		
 		for (const auto& mesh : *m) {
 			if (mesh->getMaterial() == nullptr) {
@@ -934,6 +914,7 @@ void loadScene(io::SceneData& si, tinygltf::Model& aModel, const std::string& aD
 
 std::unique_ptr<io::SceneData> io::Import::load_scene(const std::string& aFile) const
 {
+	T_PROFILE_SCOPE("import scene");
 	spdlog::info("Load Scene: {}", aFile);
 	std::string ext = std::filesystem::path(aFile).extension().string();
 	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
@@ -2,111 +2,390 @@
 #include <tamashii/core/topology/topology.hpp>
 #include <tamashii/core/scene/model.hpp>
 #include <tamashii/core/scene/material.hpp>
-#define TINYOBJLOADER_IMPLEMENTATION 
-#include <tiny_obj_loader.h>
+#include <tamashii/core/common/thread_pool.hpp>
+#include <tamashii/core/platform/mapped_file.hpp>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
 
 T_USE_NAMESPACE
+namespace {
+	constexpr size_t CHUNK_BYTES = 4 << 20;
+	constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
+	// one triangle corner with zero based indices, NO_INDEX if the attribute is not given
+	struct Corner {
+		uint32_t									mV;
+		uint32_t									mVt;
+		uint32_t									mVn;
+		bool										operator==(const Corner& aOther) const { return mV == aOther.mV && mVt == aOther.mVt && mVn == aOther.mVn; }
+	};
+	struct CornerHash {
+		size_t										operator()(const Corner& aCorner) const
+													{
+														uint64_t h = (static_cast<uint64_t>(aCorner.mV) << 32 | aCorner.mVt) * 0x9E3779B97F4A7C15ull;
+														h ^= (h >> 29) + aCorner.mVn * 0xBF58476D1CE4E5B9ull;
+														return static_cast<size_t>(h ^ (h >> 32));
+													}
+	};
+
+	// a range of whole lines, counts are filled by the first pass and used as offsets by the second
+	struct Chunk {
+		const char*									mBegin;
+		const char*									mEnd;
+		size_t										mPositions = 0;
+		size_t										mTexCoords = 0;
+		size_t										mNormals = 0;
+		size_t										mCorners = 0;
+		bool										mUsesTexCoords = false;
+		bool										mUsesNormals = false;
+		bool										mMissesNormals = false;
+	};
+
+	bool isBlank(const char aC) { return aC == ' ' || aC == '\t' || aC == '\r'; }
+	const char* skipBlank(const char* aFirst, const char* aLast) { while (aFirst != aLast && isBlank(*aFirst)) aFirst++; return aFirst; }
+
+	const char* parseFloat(const char* aFirst, const char* aLast, float& aValue)
+	{
+		aFirst = skipBlank(aFirst, aLast);
+		if (aFirst != aLast && *aFirst == '+') aFirst++;
+		const auto [ptr, ec] = std::from_chars(aFirst, aLast, aValue);
+		return ec == std::errc() ? ptr : nullptr;
+	}
+
+	const char* parseIndex(const char* aFirst, const char* aLast, int64_t& aValue)
+	{
+		const auto [ptr, ec] = std::from_chars(aFirst, aLast, aValue);
+		return ec == std::errc() ? ptr : nullptr;
+	}
+
+	// resolves a one based or negative (relative) obj index against the number of elements defined so far
+	bool resolveIndex(const int64_t aIndex, const size_t aDefined, const size_t aTotal, uint32_t& aOut)
+	{
+		const int64_t index = aIndex > 0 ? aIndex - 1 : static_cast<int64_t>(aDefined) + aIndex;
+		if (aIndex == 0 || index < 0 || index >= static_cast<int64_t>(aTotal)) return false;
+		aOut = static_cast<uint32_t>(index);
+		return true;
+	}
+
+	// the line type of [aFirst, aLast) with aFirst pointing behind the keyword
+	enum class Line { OTHER, POSITION, TEXCOORD, NORMAL, FACE };
+	Line lineType(const char*& aFirst, const char* aLast)
+	{
+		aFirst = skipBlank(aFirst, aLast);
+		const size_t size = aLast - aFirst;
+		if (size < 2) return Line::OTHER;
+		if (aFirst[0] == 'v') {
+			if (isBlank(aFirst[1])) { aFirst += 1; return Line::POSITION; }
+			if (size > 2 && isBlank(aFirst[2])) {
+				if (aFirst[1] == 't') { aFirst += 2; return Line::TEXCOORD; }
+				if (aFirst[1] == 'n') { aFirst += 2; return Line::NORMAL; }
+			}
+		}
+		else if (aFirst[0] == 'f' && isBlank(aFirst[1])) { aFirst += 1; return Line::FACE; }
+		return Line::OTHER;
+	}
+
+	template<typename F>
+	void forEachLine(const char* aFirst, const char* aLast, F&& aFunc)
+	{
+		while (aFirst < aLast) {
+			const char* eol = static_cast<const char*>(std::memchr(aFirst, '\n', aLast - aFirst));
+			if (!eol) eol = aLast;
+			aFunc(aFirst, eol);
+			aFirst = eol + 1;
+		}
+	}
+
+	size_t faceVertexCount(const char* aFirst, const char* aLast)
+	{
+		size_t count = 0;
+		while ((aFirst = skipBlank(aFirst, aLast)) != aLast && *aFirst != '#') {
+			count++;
+			while (aFirst != aLast && !isBlank(*aFirst)) aFirst++;
+		}
+		return count;
+	}
+
+	// first pass, counts the elements of a chunk so every chunk knows where to write in the second pass
+	void countChunk(Chunk& aChunk)
+	{
+		forEachLine(aChunk.mBegin, aChunk.mEnd, [&](const char* aFirst, const char* aLast) {
+			switch (lineType(aFirst, aLast)) {
+			case Line::POSITION: aChunk.mPositions++; break;
+			case Line::TEXCOORD: aChunk.mTexCoords++; break;
+			case Line::NORMAL: aChunk.mNormals++; break;
+			case Line::FACE: {
+				const size_t count = faceVertexCount(aFirst, aLast);
+				if (count >= 3) aChunk.mCorners += 3 * (count - 2);
+				break;
+			}
+			default: break;
+			}
+		});
+	}
+
+	struct Attributes {
+		std::vector<glm::vec3>						mPositions;
+		std::vector<glm::vec3>						mColors;
+		std::vector<glm::vec2>						mTexCoords;
+		std::vector<glm::vec3>						mNormals;
+		std::vector<Corner>							mCorners;
+	};
+
+	// second pass, chunk counts have been turned into offsets; polygons are triangulated as a fan
+	bool parseChunk(Chunk& aChunk, Attributes& aAttributes)
+	{
+		size_t position = aChunk.mPositions, texCoord = aChunk.mTexCoords, normal = aChunk.mNormals, corner = aChunk.mCorners;
+		std::vector<Corner> polygon;
+		bool ok = true;
+		forEachLine(aChunk.mBegin, aChunk.mEnd, [&](const char* aFirst, const char* aLast) {
+			if (!ok) return;
+			switch (lineType(aFirst, aLast)) {
+			case Line::POSITION: {
+				glm::vec3& p = aAttributes.mPositions[position];
+				ok = (aFirst = parseFloat(aFirst, aLast, p.x)) && (aFirst = parseFloat(aFirst, aLast, p.y)) && (aFirst = parseFloat(aFirst, aLast, p.z));
+				// optional w and vertex color
+				float extra[4];
+				int count = 0;
+				while (ok && count < 4 && (aFirst = parseFloat(aFirst, aLast, extra[count]))) count++;
+				if (count >= 3) aAttributes.mColors[position] = glm::vec3(extra[count - 3], extra[count - 2], extra[count - 1]);
+				position++;
+				break;
+			}
+			case Line::TEXCOORD: {
+				glm::vec2& t = aAttributes.mTexCoords[texCoord++];
+				ok = (aFirst = parseFloat(aFirst, aLast, t.x));
+				if (ok && !parseFloat(aFirst, aLast, t.y)) t.y = 0;
+				break;
+			}
+			case Line::NORMAL: {
+				glm::vec3& n = aAttributes.mNormals[normal++];
+				ok = (aFirst = parseFloat(aFirst, aLast, n.x)) && (aFirst = parseFloat(aFirst, aLast, n.y)) && parseFloat(aFirst, aLast, n.z);
+				break;
+			}
+			case Line::FACE: {
+				polygon.clear();
+				while (ok && (aFirst = skipBlank(aFirst, aLast)) != aLast && *aFirst != '#') {
+					Corner c = { NO_INDEX, NO_INDEX, NO_INDEX };
+					int64_t index;
+					const char* ptr = parseIndex(aFirst, aLast, index);
+					ok = ptr && resolveIndex(index, position, aAttributes.mPositions.size(), c.mV);
+					if (ok && ptr != aLast && *ptr == '/') {
+						ptr++;
+						if (ptr != aLast && *ptr != '/') {
+							ptr = parseIndex(ptr, aLast, index);
+							ok = ptr && resolveIndex(index, texCoord, aAttributes.mTexCoords.size(), c.mVt);
+						}
+						if (ok && ptr != aLast && *ptr == '/') {
+							ptr = parseIndex(ptr + 1, aLast, index);
+							ok = ptr && resolveIndex(index, normal, aAttributes.mNormals.size(), c.mVn);
+						}
+					}
+					ok = ok && (ptr == aLast || isBlank(*ptr));
+					aChunk.mUsesTexCoords |= c.mVt != NO_INDEX;
+					aChunk.mUsesNormals |= c.mVn != NO_INDEX;
+					aChunk.mMissesNormals |= c.mVn == NO_INDEX;
+					polygon.push_back(c);
+					aFirst = ptr;
+				}
+				for (size_t i = 2; ok && i < polygon.size(); i++) {
+					aAttributes.mCorners[corner++] = polygon[0];
+					aAttributes.mCorners[corner++] = polygon[i - 1];
+					aAttributes.mCorners[corner++] = polygon[i];
+				}
+				break;
+			}
+			default: break;
+			}
+		});
+		return ok;
+	}
+
+	// assigns every distinct corner a vertex in order of its first occurrence, the result is the same as a serial
+	// hash map pass. Corners are bucketed into shards by hash, each shard is deduplicated by its own thread and
+	// the first occurrences are then ranked with a prefix sum
+	std::vector<Corner> deduplicate(const std::vector<Corner>& aCorners, std::vector<uint32_t>& aIndices)
+	{
+		ThreadPool& pool = ThreadPool::getInstance();
+		const size_t cornerCount = aCorners.size();
+		const size_t shardCount = std::max(pool.threadCount(), 1u);
+		const size_t blockCount = std::max<size_t>(1, std::min<size_t>(pool.threadCount() * 4ull, cornerCount / 4096));
+		const auto blockBegin = [&](const size_t aBlock) { return (cornerCount * aBlock) / blockCount; };
+		const auto shardOf = [&](const Corner& aCorner) { return CornerHash()(aCorner) % shardCount; };
+
+		// bucket corner ids by shard, keeping them in ascending order within a shard
+		std::vector<size_t> offsets(blockCount * shardCount, 0);
+		pool.parallelFor(0, blockCount, [&](const size_t aBlock) {
+			for (size_t i = blockBegin(aBlock); i < blockBegin(aBlock + 1); i++) offsets[aBlock * shardCount + shardOf(aCorners[i])]++;
+		});
+		std::vector<size_t> shardBegin(shardCount + 1, 0);
+		for (size_t shard = 0, sum = 0; shard < shardCount; shard++) {
+			shardBegin[shard] = sum;
+			for (size_t block = 0; block < blockCount; block++) {
+				const size_t count = offsets[block * shardCount + shard];
+				offsets[block * shardCount + shard] = sum;
+				sum += count;
+			}
+			shardBegin[shard + 1] = sum;
+		}
+		std::vector<uint32_t> order(cornerCount);
+		pool.parallelFor(0, blockCount, [&](const size_t aBlock) {
+			for (size_t i = blockBegin(aBlock); i < blockBegin(aBlock + 1); i++) order[offsets[aBlock * shardCount + shardOf(aCorners[i])]++] = static_cast<uint32_t>(i);
+		});
+
+		// per shard dedup, aIndices temporarily holds the shard local vertex id
+		std::vector<std::vector<uint32_t>> firstCorners(shardCount);
+		std::vector<uint8_t> isFirst(cornerCount, 0);
+		pool.parallelFor(0, shardCount, [&](const size_t aShard) {
+			std::unordered_map<Corner, uint32_t, CornerHash> map;
+			map.reserve((shardBegin[aShard + 1] - shardBegin[aShard]) / 4);
+			for (size_t i = shardBegin[aShard]; i < shardBegin[aShard + 1]; i++) {
+				const uint32_t c = order[i];
+				const auto [it, inserted] = map.try_emplace(aCorners[c], static_cast<uint32_t>(firstCorners[aShard].size()));
+				if (inserted) {
+					firstCorners[aShard].push_back(c);
+					isFirst[c] = 1;
+				}
+				aIndices[c] = it->second;
+			}
+		});
+		order = {};
+
+		// rank first occurrences in corner order
+		std::vector<uint32_t> blockRank(blockCount + 1, 0);
+		pool.parallelFor(0, blockCount, [&](const size_t aBlock) {
+			uint32_t count = 0;
+			for (size_t i = blockBegin(aBlock); i < blockBegin(aBlock + 1); i++) count += isFirst[i];
+			blockRank[aBlock + 1] = count;
+		});
+		for (size_t block = 0; block < blockCount; block++) blockRank[block + 1] += blockRank[block];
+		std::vector<uint32_t> rank(cornerCount);
+		pool.parallelFor(0, blockCount, [&](const size_t aBlock) {
+			uint32_t r = blockRank[aBlock];
+			for (size_t i = blockBegin(aBlock); i < blockBegin(aBlock + 1); i++) if (isFirst[i]) rank[i] = r++;
+		});
+
+		std::vector<Corner> vertices(blockRank.back());
+		std::vector<std::vector<uint32_t>> localToGlobal(shardCount);
+		pool.parallelFor(0, shardCount, [&](const size_t aShard) {
+			localToGlobal[aShard].resize(firstCorners[aShard].size());
+			for (size_t local = 0; local < firstCorners[aShard].size(); local++) {
+				const uint32_t c = firstCorners[aShard][local];
+				localToGlobal[aShard][local] = rank[c];
+				vertices[rank[c]] = aCorners[c];
+			}
+		});
+		pool.parallelFor(0, blockCount, [&](const size_t aBlock) {
+			for (size_t i = blockBegin(aBlock); i < blockBegin(aBlock + 1); i++) aIndices[i] = localToGlobal[shardOf(aCorners[i])][aIndices[i]];
+		});
+		return vertices;
+	}
+}
+
 std::unique_ptr<Mesh> io::Import::load_obj_mesh(const std::string& aFile) {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-
-	std::string warn, err;
-	bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, aFile.c_str());
-
-	if (!warn.empty()) spdlog::warn("Obj Loader: {}", warn);
-	if (!err.empty()) spdlog::error("Obj Loader: {}", err);
-	if (!ret) return nullptr;
-
-    uint32_t indicesSize = 0;
-    for (const auto& shape : shapes) indicesSize += shape.mesh.indices.size();
-
-    aabb_s aabb = aabb_s(glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::min()));
-    std::unique_ptr tmesh = Mesh::alloc();
-
-    Material* mat = Material::alloc(DEFAULT_MATERIAL_NAME);
-    tmesh->setMaterial(mat);
-
-    tmesh->setTopology(Mesh::Topology::TRIANGLE_LIST);
-    std::vector<uint32_t>* indices = tmesh->getIndicesVector();
-    indices->reserve(indicesSize);
-
-    
-    for (const auto& shape : shapes)
-    {
-        
-        size_t indexOffset = 0;
-        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
-            size_t fv = shape.mesh.num_face_vertices[f];
-            if (fv != 3) {
-                spdlog::error("Obj Loader: faces != 3 not supported");
-                return nullptr;
-            }
-
-            for (size_t v = 0; v < fv; v++) {
-                tinyobj::index_t idx = shape.mesh.indices[indexOffset + v];
-                indices->push_back(idx.vertex_index);
-            }
-            indexOffset += fv;
-        }
-    }
-    if (!indices->empty()) tmesh->hasIndices(true);
-
-    std::vector<vertex_s>* vertices = tmesh->getVerticesVector();
-    vertices->reserve(attrib.vertices.size());
-
-    size_t vCount = 0;
-    for (size_t vOffset = 0; vOffset < attrib.vertices.size(); vOffset+=3) {
-        vertex_s vd = {};
-        tinyobj::real_t vx = attrib.vertices[3u * vCount + 0u];
-        tinyobj::real_t vy = attrib.vertices[3u * vCount + 1u];
-        tinyobj::real_t vz = attrib.vertices[3u * vCount + 2u];
-        vd.position = glm::vec4(vx, vy, vz, 1);
-
-        
-        if (vd.position.x < aabb.mMin.x) aabb.mMin.x = vd.position.x;
-        if (vd.position.y < aabb.mMin.y) aabb.mMin.y = vd.position.y;
-        if (vd.position.z < aabb.mMin.z) aabb.mMin.z = vd.position.z;
-        
-        if (vd.position.x > aabb.mMax.x) aabb.mMax.x = vd.position.x;
-        if (vd.position.y > aabb.mMax.y) aabb.mMax.y = vd.position.y;
-        if (vd.position.z > aabb.mMax.z) aabb.mMax.z = vd.position.z;
-
-        
-        /*if (!attrib.normals.empty()) {
-            tinyobj::real_t nx = attrib.normals[3u * vCount + 0u];
-            tinyobj::real_t ny = attrib.normals[3u * vCount + 1u];
-            tinyobj::real_t nz = attrib.normals[3u * vCount + 2u];
-            vd.normal = glm::vec4(nx, ny, nz, 0);
-        }*/
-
-        
-        if (!attrib.texcoords.empty()) {
-            tinyobj::real_t tx = attrib.texcoords[2u * vCount + 0u];
-            tinyobj::real_t ty = attrib.texcoords[2u * vCount + 1u];
-            vd.texture_coordinates_0 = glm::vec2(tx, ty);
-        }
-
-        if (!attrib.colors.empty()) {
-            tinyobj::real_t red = attrib.colors[3u * vCount + 0u];
-            tinyobj::real_t green = attrib.colors[3u * vCount + 1u];
-            tinyobj::real_t blue = attrib.colors[3u * vCount + 2u];
-            vd.color_0 = glm::vec4(red, green, blue, 1);
-        }
-        vertices->push_back(vd);
-
-        vCount++;
-    }
-
-    if (!attrib.vertices.empty()) tmesh->hasPositions(true);
-    
-    if (!attrib.texcoords.empty()) tmesh->hasTexCoords0(true);
-    if (!attrib.colors.empty()) tmesh->hasColors0(true);
-
-
-    if (!tmesh->hasNormals() && tmesh->getTopology() == Mesh::Topology::TRIANGLE_LIST) topology::calcNormals(tmesh.get());
-    if (!tmesh->hasTangents() && tmesh->getTopology() == Mesh::Topology::TRIANGLE_LIST) topology::calcMikkTSpaceTangents(tmesh.get());
-    tmesh->setAABB(aabb);
+	MappedFile file;
+	if (!file.open(aFile)) {
+		spdlog::error("Obj Loader: could not open {}", aFile);
+		return nullptr;
+	}
+	ThreadPool& pool = ThreadPool::getInstance();
+
+	// split into chunks of whole lines
+	std::vector<Chunk> chunks;
+	const char* begin = file.data();
+	const char* end = file.data() + file.size();
+	while (begin < end) {
+		const char* split = begin + std::min<size_t>(CHUNK_BYTES, end - begin);
+		if (split != end) {
+			const void* eol = std::memchr(split, '\n', end - split);
+			split = eol ? static_cast<const char*>(eol) + 1 : end;
+		}
+		chunks.push_back({ begin, split });
+		begin = split;
+	}
+
+	pool.parallelFor(0, chunks.size(), [&](const size_t aChunk) { countChunk(chunks[aChunk]); });
+	Attributes attributes;
+	{
+		size_t positions = 0, texCoords = 0, normals = 0, corners = 0;
+		for (Chunk& chunk : chunks) {
+			positions += std::exchange(chunk.mPositions, positions);
+			texCoords += std::exchange(chunk.mTexCoords, texCoords);
+			normals += std::exchange(chunk.mNormals, normals);
+			corners += std::exchange(chunk.mCorners, corners);
+		}
+		attributes.mPositions.resize(positions);
+		attributes.mColors.resize(positions, glm::vec3(1));
+		attributes.mTexCoords.resize(texCoords);
+		attributes.mNormals.resize(normals);
+		attributes.mCorners.resize(corners);
+	}
+	std::atomic_bool ok = true;
+	pool.parallelFor(0, chunks.size(), [&](const size_t aChunk) { if (!parseChunk(chunks[aChunk], attributes)) ok = false; });
+	if (!ok) {
+		spdlog::error("Obj Loader: could not parse {}", aFile);
+		return nullptr;
+	}
+	const bool usesTexCoords = std::any_of(chunks.begin(), chunks.end(), [](const Chunk& aChunk) { return aChunk.mUsesTexCoords; });
+	const bool usesNormals = std::any_of(chunks.begin(), chunks.end(), [](const Chunk& aChunk) { return aChunk.mUsesNormals; });
+	const bool allNormals = usesNormals && std::none_of(chunks.begin(), chunks.end(), [](const Chunk& aChunk) { return aChunk.mMissesNormals; });
+
+	std::unique_ptr tmesh = Mesh::alloc();
+	Material* mat = Material::alloc(DEFAULT_MATERIAL_NAME);
+	tmesh->setMaterial(mat);
+	tmesh->setTopology(Mesh::Topology::TRIANGLE_LIST);
+
+	std::vector<uint32_t>* indices = tmesh->getIndicesVector();
+	std::vector<vertex_s>* vertices = tmesh->getVerticesVector();
+	indices->resize(attributes.mCorners.size());
+	// without texture coordinates and normals a vertex is just its position, as in the file
+	std::vector<Corner> unique;
+	if (usesTexCoords || usesNormals) unique = deduplicate(attributes.mCorners, *indices);
+	else {
+		pool.parallelFor(0, indices->size(), [&](const size_t aIndex) { (*indices)[aIndex] = attributes.mCorners[aIndex].mV; });
+		unique.resize(attributes.mPositions.size());
+		for (uint32_t i = 0; i < unique.size(); i++) unique[i] = { i, NO_INDEX, NO_INDEX };
+	}
+	attributes.mCorners = {};
+
+	vertices->resize(unique.size());
+	const size_t blockCount = (unique.size() + (1 << 16) - 1) >> 16;
+	std::vector<aabb_s> blockAabbs(blockCount, aabb_s(glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::min())));
+	pool.parallelFor(0, blockCount, [&](const size_t aBlock) {
+		aabb_s& aabb = blockAabbs[aBlock];
+		for (size_t i = aBlock << 16; i < std::min(unique.size(), (aBlock + 1) << 16); i++) {
+			const Corner& c = unique[i];
+			vertex_s vd = {};
+			vd.position = glm::vec4(attributes.mPositions[c.mV], 1);
+			vd.color_0 = glm::vec4(attributes.mColors[c.mV], 1);
+			if (c.mVt != NO_INDEX) vd.texture_coordinates_0 = attributes.mTexCoords[c.mVt];
+			if (c.mVn != NO_INDEX) vd.normal = glm::vec4(attributes.mNormals[c.mVn], 0);
+			aabb.mMin = glm::min(aabb.mMin, glm::vec3(vd.position));
+			aabb.mMax = glm::max(aabb.mMax, glm::vec3(vd.position));
+			(*vertices)[i] = vd;
+		}
+	});
+	aabb_s aabb = aabb_s(glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::min()));
+	for (const aabb_s& blockAabb : blockAabbs) {
+		aabb.mMin = glm::min(aabb.mMin, blockAabb.mMin);
+		aabb.mMax = glm::max(aabb.mMax, blockAabb.mMax);
+	}
+
+	if (!indices->empty()) tmesh->hasIndices(true);
+	if (!vertices->empty()) {
+		tmesh->hasPositions(true);
+		tmesh->hasColors0(true);
+	}
+	if (usesTexCoords) tmesh->hasTexCoords0(true);
+	if (allNormals) tmesh->hasNormals(true);
+
+	if (!tmesh->hasNormals() && tmesh->getTopology() == Mesh::Topology::TRIANGLE_LIST) topology::calcNormals(tmesh.get());
+	if (!tmesh->hasTangents()) topology::calcTangents(tmesh.get());
+	tmesh->setAABB(aabb);
 
 	return tmesh;
 }
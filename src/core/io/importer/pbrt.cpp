@@ -4,203 +4,543 @@
 #include <tamashii/core/scene/material.hpp>
 #include <tamashii/core/scene/model.hpp>
 #include <tamashii/core/scene/scene_graph.hpp>
-#include <tamashii/core/io/io.hpp>
 #include <tamashii/core/common/math.hpp>
-#include <fstream>
+#include <tamashii/core/common/thread_pool.hpp>
+#include <tamashii/core/platform/mapped_file.hpp>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <future>
 #include <stack>
 #include <filesystem>
+#include <string_view>
 
 
 T_USE_NAMESPACE
 namespace {
+	constexpr size_t PARALLEL_ARRAY_BYTES = 1 << 20;
+	constexpr size_t VERTEX_BLOCK_SIZE = 1 << 16;
+	constexpr std::array<std::string_view, 18> PARAMETER_TYPES = { "integer", "float", "point2", "vector2", "point3", "vector3",
+		"normal3", "point", "vector", "normal", "color", "rgb", "xyz", "blackbody", "spectrum", "bool", "string", "texture" };
+
+	bool isSpace(const char aC) { return aC == ' ' || aC == '\n' || aC == '\t' || aC == '\r'; }
+	bool isDelimiter(const char aC) { return isSpace(aC) || aC == '"' || aC == '[' || aC == ']' || aC == '#'; }
+
+	template<typename T>
+	const char* parseNumber(const char* aFirst, const char* aLast, T& aValue)
+	{
+		if (aFirst != aLast && *aFirst == '+') aFirst++;
+		if constexpr (std::is_same_v<T, uint32_t>) {
+			int64_t value = 0;
+			const auto [ptr, ec] = std::from_chars(aFirst, aLast, value);
+			aValue = static_cast<uint32_t>(value);
+			return ec == std::errc() ? ptr : nullptr;
+		} else {
+			const auto [ptr, ec] = std::from_chars(aFirst, aLast, aValue);
+			return ec == std::errc() ? ptr : nullptr;
+		}
+	}
+
+	template<typename T>
+	bool parseBlock(const char* aFirst, const char* aLast, std::vector<T>& aValues)
+	{
+		const char* p = aFirst;
+		while (true) {
+			while (p != aLast && isSpace(*p)) p++;
+			if (p == aLast) return true;
+			if (*p == '#') {
+				while (p != aLast && *p != '\n') p++;
+				continue;
+			}
+			T value;
+			p = parseNumber(p, aLast, value);
+			if (!p) return false;
+			aValues.push_back(value);
+		}
+	}
 
-	std::string getNextWord(std::string& s) {
-		std::string::size_type p1 = 0;
-		std::string::size_type p2 = 0;
-		const std::string delimiters_front = " \n\t\"[]";
-		std::string delimitersBack = " \"]";
-
-		p1 = s.find_first_not_of(delimiters_front, p1);
-		
-		const std::string::size_type temp = s.find_first_of('\"');
-		if (temp != std::string::npos && p1 == (temp + 1)) {
-			delimitersBack.erase(std::remove(delimitersBack.begin(), delimitersBack.end(), ' '), delimitersBack.end());
+	// large arrays are cut at whitespace into blocks that are converted on the thread pool
+	template<typename T>
+	bool parseArray(const std::string_view aText, std::vector<T>& aValues)
+	{
+		ThreadPool& pool = ThreadPool::getInstance();
+		if (aText.size() < PARALLEL_ARRAY_BYTES || pool.threadCount() < 2 || aText.find('#') != std::string_view::npos) {
+			return parseBlock(aText.data(), aText.data() + aText.size(), aValues);
 		}
-		if (p1 == std::string::npos) return "";
-		p2 = s.find_first_of(delimitersBack, p1);
-		if (p2 == std::string::npos) p2 = s.size();
-		std::string re = s.substr(p1, (p2 - p1));
-		if (s.size() == p2) {
-			s = "";
-			return re;
+
+		const size_t blockCount = pool.threadCount() * 4ull;
+		std::vector<const char*> bounds(blockCount + 1);
+		bounds.front() = aText.data();
+		bounds.back() = aText.data() + aText.size();
+		for (size_t i = 1; i < blockCount; i++) {
+			const char* p = std::max(aText.data() + (aText.size() * i) / blockCount, bounds[i - 1]);
+			while (p != bounds.back() && !isSpace(*p)) p++;
+			bounds[i] = p;
 		}
-		s = s.substr(p2+1, (s.size() - p2));
-		return re;
+
+		std::vector<std::vector<T>> blocks(blockCount);
+		std::vector<uint8_t> valid(blockCount);
+		pool.parallelFor(0, blockCount, [&](const size_t aIdx) {
+			blocks[aIdx].reserve(static_cast<size_t>(bounds[aIdx + 1] - bounds[aIdx]) / 6);
+			valid[aIdx] = parseBlock(bounds[aIdx], bounds[aIdx + 1], blocks[aIdx]);
+		});
+		if (std::find(valid.begin(), valid.end(), 0) != valid.end()) return false;
+
+		std::vector<size_t> offsets(blockCount + 1, aValues.size());
+		for (size_t i = 0; i < blockCount; i++) offsets[i + 1] = offsets[i] + blocks[i].size();
+		aValues.resize(offsets.back());
+		pool.parallelFor(0, blockCount, [&](const size_t aIdx) {
+			std::copy(blocks[aIdx].begin(), blocks[aIdx].end(), aValues.begin() + static_cast<ptrdiff_t>(offsets[aIdx]));
+		});
+		return true;
 	}
-}
 
-std::unique_ptr<io::SceneData> io::Import::load_pbrt(std::string const& aFile) {
-	std::ifstream f(aFile);
-	std::string path = std::filesystem::path(aFile).parent_path().string();
+	struct Param {
+		std::string						mType;
+		std::string						mName;
+		std::vector<float>				mFloats;
+		std::vector<uint32_t>			mIntegers;
+		std::vector<std::string>		mStrings;
+
+		[[nodiscard]] float float1(const float aDefault = 0.0f) const { return mFloats.empty() ? aDefault : mFloats.front(); }
+		[[nodiscard]] glm::vec3 float3() const { return mFloats.size() < 3 ? glm::vec3(0.0f) : glm::vec3(mFloats[0], mFloats[1], mFloats[2]); }
+		[[nodiscard]] std::string string1() const { return mStrings.empty() ? "" : mStrings.front(); }
+	};
+
+	struct TriangleMesh {
+		std::vector<vertex_s>			mVertices;
+		std::vector<uint32_t>			mIndices;
+		aabb_s							mAABB;
+		bool							mHasIndices = false;
+		bool							mHasNormals = false;
+		bool							mHasTexCoords = false;
+	};
+
+	struct ParsedFile;
+	struct Directive {
+		std::string						mName;
+		std::vector<std::string>		mArgs;
+		std::vector<float>				mValues;
+		std::vector<Param>				mParams;
+		std::unique_ptr<TriangleMesh>	mTriangleMesh;
+		std::future<std::unique_ptr<ParsedFile>> mInclude;
+
+		[[nodiscard]] std::string arg(const size_t aIdx) const { return aIdx < mArgs.size() ? mArgs[aIdx] : ""; }
+		[[nodiscard]] Param* find(const std::string_view aName)
+		{
+			for (Param& p : mParams) if (p.mName == aName) return &p;
+			return nullptr;
+		}
+	};
+
+	struct ParsedFile {
+		std::string						mFile;
+		std::vector<Directive>			mDirectives;
+	};
+
+	std::unique_ptr<TriangleMesh> buildTriangleMesh(Directive& aDirective)
+	{
+		auto mesh = std::make_unique<TriangleMesh>();
+		const Param* positions = aDirective.find("P");
+		const Param* normals = aDirective.find("N");
+		const Param* uvs = aDirective.find("uv");
+		if (!uvs) uvs = aDirective.find("st");
+		if (Param* indices = aDirective.find("indices")) {
+			mesh->mHasIndices = true;
+			mesh->mIndices = std::move(indices->mIntegers);
+		}
 
-	std::unique_ptr<SceneData> scene = SceneData::alloc();
-	std::shared_ptr tscene = Node::alloc("pbrt scene");
-	Node& rootNode = tscene->addChildNode("root");
-	Node& cameraNode = rootNode.addChildNode("camera");
-	Node& geometryNode = rootNode.addChildNode("geometry");
-	std::stack<glm::mat4> transforms; 
-	transforms.push(glm::mat4(1.0f));
-
-	std::string line;
-	float value;
-	int pos;
-	
-	while (f.good()) {
-		std::getline(f, line);
-		const std::string lineType = getNextWord(line);
-		if (lineType == "Transform") {
-			for (int i = 0; i < 4; i++) {
-				for (int j = 0; j < 4; j++) {
-					transforms.top()[i][j] = std::stof(getNextWord(line));
+		const size_t vertexCount = positions ? positions->mFloats.size() / 3 : 0;
+		mesh->mHasNormals = normals && normals->mFloats.size() >= vertexCount * 3;
+		mesh->mHasTexCoords = uvs && uvs->mFloats.size() >= vertexCount * 2;
+		mesh->mVertices.resize(vertexCount);
+
+		const size_t blockCount = (vertexCount + VERTEX_BLOCK_SIZE - 1) / VERTEX_BLOCK_SIZE;
+		std::vector<aabb_s> aabbs(blockCount);
+		ThreadPool::getInstance().parallelFor(0, blockCount, [&](const size_t aBlock) {
+			const size_t end = std::min(vertexCount, (aBlock + 1) * VERTEX_BLOCK_SIZE);
+			for (size_t i = aBlock * VERTEX_BLOCK_SIZE; i < end; i++) {
+				vertex_s& v = mesh->mVertices[i];
+				const float* p = &positions->mFloats[i * 3];
+				v.position = glm::vec4(p[0], p[1], p[2], 1.0f);
+				v.normal = mesh->mHasNormals ? glm::vec4(normals->mFloats[i * 3], normals->mFloats[i * 3 + 1], normals->mFloats[i * 3 + 2], 0.0f) : glm::vec4(0.0f);
+				v.tangent = glm::vec4(0.0f);
+				v.texture_coordinates_0 = mesh->mHasTexCoords ? glm::vec2(uvs->mFloats[i * 2], uvs->mFloats[i * 2 + 1]) : glm::vec2(0.0f);
+				v.texture_coordinates_1 = glm::vec2(0.0f);
+				v.color_0 = glm::vec4(0.0f);
+				aabbs[aBlock].set(glm::vec3(v.position));
+			}
+		});
+		for (const aabb_s& aabb : aabbs) mesh->mAABB.set(aabb);
+
+		aDirective.mParams.clear();
+		return mesh;
+	}
+
+	std::unique_ptr<ParsedFile> parseFile(const std::string& aFile, const std::filesystem::path& aDirectory);
+
+	class Parser {
+	public:
+		Parser(ParsedFile& aFile, const std::string_view aText, std::filesystem::path aDirectory) :
+			mFile(aFile), mText(aText), mPos(0), mDirectory(std::move(aDirectory)) {}
+
+		bool parse()
+		{
+			while (true) {
+				skipSpace();
+				if (atEnd()) return true;
+				if (isDelimiter(peek())) {
+					spdlog::error("pbrt: unexpected '{}' in {} at byte {}", peek(), mFile.mFile, mPos);
+					return false;
 				}
+				Directive directive;
+				directive.mName = std::string(bareToken());
+				if (!parseArguments(directive) || !parseParams(directive)) {
+					spdlog::error("pbrt: could not parse '{}' in {} at byte {}", directive.mName, mFile.mFile, mPos);
+					return false;
+				}
+
+				if (directive.mName == "Include" || directive.mName == "Import") {
+					std::string file = std::filesystem::path(directive.arg(0)).is_absolute() ? directive.arg(0) :
+						(mDirectory / directive.arg(0)).make_preferred().string();
+					directive.mInclude = ThreadPool::getInstance().submit([file, directory = mDirectory] { return parseFile(file, directory); });
+				}
+				else if (directive.mName == "Shape" && directive.arg(0) == "trianglemesh") {
+					directive.mTriangleMesh = buildTriangleMesh(directive);
+				}
+				mFile.mDirectives.push_back(std::move(directive));
 			}
-			transforms.top() = glm::transpose(transforms.top());
-			transforms.top()[2] *= glm::vec4(-1);
-			transforms.top() = glm::transpose(transforms.top());
 		}
-		if (lineType == "Camera") {
-			bool cam_type_perspective = false;
-			float fov;
-			std::string arg;
-			while (!(arg = getNextWord(line)).empty()) {
-				if (arg == "perspective") cam_type_perspective = true;
-				else if (arg == "float fov") fov = std::stof(getNextWord(line));
+
+	private:
+		[[nodiscard]] bool atEnd() const { return mPos >= mText.size(); }
+		[[nodiscard]] char peek() const { return mText[mPos]; }
+
+		void skipSpace()
+		{
+			while (!atEnd()) {
+				if (isSpace(peek())) mPos++;
+				else if (peek() == '#') {
+					mPos = mText.find('\n', mPos);
+					if (mPos == std::string_view::npos) mPos = mText.size();
+				}
+				else break;
 			}
+		}
 
-			std::shared_ptr<Camera> cam{ Camera::alloc() };
-			cam->setName("Camera");
-			if(cam_type_perspective) cam->initPerspectiveCamera(glm::radians(fov), 1.0f, 0.1f, 10000.0f);
+		std::string_view bareToken()
+		{
+			const size_t start = mPos;
+			while (!atEnd() && !isDelimiter(peek())) mPos++;
+			return mText.substr(start, mPos - start);
+		}
 
-			Node& node = cameraNode.addChildNode("node");
-			node.setCamera(cam);
-			geometryNode.setModelMatrix(transforms.top());
+		bool quotedToken(std::string_view& aToken)
+		{
+			const size_t end = mText.find('"', mPos + 1);
+			if (end == std::string_view::npos) return false;
+			aToken = mText.substr(mPos + 1, end - mPos - 1);
+			mPos = end + 1;
+			return true;
 		}
-		if (lineType == "WorldBegin") {
-			transforms.pop();
-			transforms.push(glm::dmat4(1.0));
-			break;
+
+		[[nodiscard]] bool isNumberStart() const
+		{
+			const char c = peek();
+			return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
 		}
-	}
 
-	std::shared_ptr<Model> tmodel;
-	Material* tmaterial = nullptr;
-	Light* tlight = nullptr;
-	std::map<std::string, Texture*> textureMap;
-	std::map<std::string, Material*> materialMap;
-	
-	bool skip = false;
-	bool attribute = false;
-	auto color = glm::vec4(0);
-	while (f.good()) {
-		std::getline(f, line);
-
-		const std::string line_type = getNextWord(line);
-
-		if (line_type == "TransformBegin") {
-			transforms.push(glm::dmat4(1.0));
+		static bool isParamDeclaration(const std::string_view aToken)
+		{
+			const size_t first = aToken.find_first_not_of(' ');
+			if (first == std::string_view::npos) return false;
+			const size_t split = aToken.find(' ', first);
+			if (split == std::string_view::npos || aToken.find_first_not_of(' ', split) == std::string_view::npos) return false;
+			const std::string_view type = aToken.substr(first, split - first);
+			return std::find(PARAMETER_TYPES.begin(), PARAMETER_TYPES.end(), type) != PARAMETER_TYPES.end();
 		}
-		else if (line_type == "TransformEnd") {
-			transforms.pop();
+
+		template<typename T>
+		bool bracketNumbers(std::vector<T>& aValues)
+		{
+			const size_t end = mText.find(']', mPos);
+			if (end == std::string_view::npos) return false;
+			const bool ok = parseArray(mText.substr(mPos + 1, end - mPos - 1), aValues);
+			mPos = end + 1;
+			return ok;
 		}
-		else if (line_type == "Transform") {
-			for (int i = 0; i < 4; i++) {
-				for (int j = 0; j < 4; j++) {
-					transforms.top()[i][j] = std::stof(getNextWord(line));
+
+		template<typename T>
+		bool singleNumber(std::vector<T>& aValues)
+		{
+			const std::string_view token = bareToken();
+			T value;
+			if (parseNumber(token.data(), token.data() + token.size(), value) != token.data() + token.size()) return false;
+			aValues.push_back(value);
+			return true;
+		}
+
+		// leading strings and numbers, e.g. Shape "trianglemesh", Transform [ ... ] or Translate x y z
+		bool parseArguments(Directive& aDirective)
+		{
+			while (true) {
+				skipSpace();
+				if (atEnd()) return true;
+				if (peek() == '"') {
+					const size_t start = mPos;
+					std::string_view token;
+					if (!quotedToken(token)) return false;
+					if (isParamDeclaration(token)) {
+						mPos = start;
+						return true;
+					}
+					aDirective.mArgs.emplace_back(token);
+				}
+				else if (peek() == '[') {
+					if (!bracketNumbers(aDirective.mValues)) return false;
+				}
+				else if (isNumberStart()) {
+					if (!singleNumber(aDirective.mValues)) return false;
 				}
+				else return true;
 			}
-			
 		}
 
-		else if (line_type == "AttributeBegin") {
-			transforms.push(glm::dmat4(1.0));
-			skip = true;
-			attribute = true;
+		template<typename T>
+		bool parseValues(std::vector<T>& aValues)
+		{
+			if (peek() == '[') return bracketNumbers(aValues);
+			return singleNumber(aValues);
 		}
-		else if (line_type == "AttributeEnd") {
-			transforms.pop();
-			color = glm::vec4(0);
-			skip = false;
-			attribute = false;
+
+		bool parseStrings(std::vector<std::string>& aValues)
+		{
+			std::string_view token;
+			if (peek() != '[') {
+				if (peek() != '"') aValues.emplace_back(bareToken());
+				else if (!quotedToken(token)) return false;
+				else aValues.emplace_back(token);
+				return true;
+			}
+			mPos++;
+			while (true) {
+				skipSpace();
+				if (atEnd()) return false;
+				if (peek() == ']') {
+					mPos++;
+					return true;
+				}
+				if (peek() != '"') aValues.emplace_back(bareToken());
+				else if (!quotedToken(token)) return false;
+				else aValues.emplace_back(token);
+			}
 		}
-		
-
-		else if (line_type == "AreaLightSource") {
-			/*tlight = new SurfaceLight();
-			scene.lights.push_back(tlight);
-			Node* Node = Node::alloc("light node");
-			Node->setLight(tlight);
-			tRootNode->addChildNode(Node);*/
-			std::string arg;
-			while (!(arg = getNextWord(line)).empty()) {
-				if (arg == "rgb L") {
-					color.x = std::stof(getNextWord(line));
-					color.y = std::stof(getNextWord(line));
-					color.z = std::stof(getNextWord(line));
-					color.w = 1;
-					
+
+		bool parseParams(Directive& aDirective)
+		{
+			while (true) {
+				skipSpace();
+				if (atEnd() || peek() != '"') return true;
+				std::string_view declaration;
+				if (!quotedToken(declaration) || !isParamDeclaration(declaration)) return false;
+
+				Param& param = aDirective.mParams.emplace_back();
+				const size_t first = declaration.find_first_not_of(' ');
+				const size_t split = declaration.find(' ', first);
+				const size_t name = declaration.find_first_not_of(' ', split);
+				param.mType = std::string(declaration.substr(first, split - first));
+				param.mName = std::string(declaration.substr(name, declaration.find_last_not_of(' ') + 1 - name));
+
+				skipSpace();
+				if (atEnd()) return false;
+				size_t valueStart = mPos;
+				if (peek() == '[') {
+					valueStart++;
+					while (valueStart < mText.size() && isSpace(mText[valueStart])) valueStart++;
 				}
+				const bool strings = param.mType == "string" || param.mType == "texture" || param.mType == "bool" ||
+					(valueStart < mText.size() && mText[valueStart] == '"');
+
+				bool ok;
+				if (strings) ok = parseStrings(param.mStrings);
+				else if (param.mType == "integer") ok = parseValues(param.mIntegers);
+				else ok = parseValues(param.mFloats);
+				if (!ok) return false;
 			}
 		}
 
-		else if (line_type == "Texture") {
-			const std::string texture_name = getNextWord(line);
-			getNextWord(line);
-			getNextWord(line);
-			const std::string texture_type = getNextWord(line);
-			if (texture_type == "string filename") {
-				const std::string texture_filepath = std::filesystem::path(path + "/" + getNextWord(line)).make_preferred().string();
-				spdlog::info("Load Image: {}", texture_filepath);
-				Image* img = load_image_8_bit(texture_filepath, 4);
-				img->needsMipMaps(true);
-				scene->mImages.push_back(img);
-
-				Texture* tex = Texture::alloc();
-				tex->sampler = { Sampler::Filter::LINEAR, Sampler::Filter::LINEAR, Sampler::Filter::LINEAR,
-					Sampler::Wrap::REPEAT, Sampler::Wrap::REPEAT, Sampler::Wrap::REPEAT, 0, std::numeric_limits<float>::max() };
-				tex->texCoordIndex = 0;
-				tex->image = img;
-				textureMap.insert({ texture_name, tex });
-				scene->mTextures.push_back(tex);
+		ParsedFile&						mFile;
+		std::string_view				mText;
+		size_t							mPos;
+		std::filesystem::path			mDirectory;
+	};
+
+	// Include'd files are parsed on the thread pool, relative paths resolve against the directory of the main file
+	std::unique_ptr<ParsedFile> parseFile(const std::string& aFile, const std::filesystem::path& aDirectory)
+	{
+		MappedFile mapped;
+		if (!mapped.open(aFile)) {
+			spdlog::error("pbrt: could not open {}", aFile);
+			return nullptr;
+		}
+		auto file = std::make_unique<ParsedFile>();
+		file->mFile = aFile;
+		Parser parser(*file, mapped.view(), aDirectory);
+		if (!parser.parse()) return nullptr;
+		return file;
+	}
+
+	class SceneBuilder {
+	public:
+		SceneBuilder(io::SceneData& aScene, Node& aCameraNode, Node& aGeometryNode, std::string aPath) :
+			mScene(aScene), mCameraNode(aCameraNode), mGeometryNode(aGeometryNode), mPath(std::move(aPath)),
+			mWorld(false), mFailed(false), mMaterial(nullptr), mColor(0.0f)
+		{
+			mTransforms.push(glm::mat4(1.0f));
+		}
+
+		// returns false once WorldEnd was reached or an included file could not be parsed
+		bool apply(ParsedFile& aFile)
+		{
+			for (Directive& d : aFile.mDirectives) {
+				if (d.mInclude.valid()) {
+					const std::unique_ptr<ParsedFile> included = d.mInclude.get();
+					if (!included) {
+						mFailed = true;
+						return false;
+					}
+					if (!apply(*included)) return false;
+				}
+				else if (!mWorld) applyOption(d);
+				else if (!applyWorld(d)) return false;
 			}
+			return true;
 		}
-		else if (line_type == "MakeNamedMaterial") {
-			const std::string material_name = getNextWord(line);
+		[[nodiscard]] bool failed() const { return mFailed; }
+
+	private:
+		void setTransform(const Directive& aDirective)
+		{
+			if (aDirective.mValues.size() < 16) return;
+			for (int i = 0; i < 4; i++) {
+				for (int j = 0; j < 4; j++) {
+					mTransforms.top()[i][j] = aDirective.mValues[i * 4 + j];
+				}
+			}
+		}
+
+		void applyOption(Directive& aDirective)
+		{
+			if (aDirective.mName == "Transform") {
+				setTransform(aDirective);
+				mTransforms.top() = glm::transpose(mTransforms.top());
+				mTransforms.top()[2] *= glm::vec4(-1);
+				mTransforms.top() = glm::transpose(mTransforms.top());
+			}
+			else if (aDirective.mName == "Camera") {
+				const Param* fov = aDirective.find("fov");
+				std::shared_ptr<Camera> cam{ Camera::alloc() };
+				cam->setName("Camera");
+				if (aDirective.arg(0) == "perspective") cam->initPerspectiveCamera(glm::radians(fov ? fov->float1(90.0f) : 90.0f), 1.0f, 0.1f, 10000.0f);
+
+				Node& node = mCameraNode.addChildNode("node");
+				node.setCamera(cam);
+				mGeometryNode.setModelMatrix(mTransforms.top());
+			}
+			else if (aDirective.mName == "WorldBegin") {
+				mTransforms.pop();
+				mTransforms.push(glm::mat4(1.0f));
+				mWorld = true;
+			}
+		}
+
+		bool applyWorld(Directive& aDirective)
+		{
+			const std::string& type = aDirective.mName;
+			if (type == "TransformBegin" || type == "AttributeBegin") {
+				mTransforms.push(glm::mat4(1.0f));
+			}
+			else if (type == "TransformEnd" || type == "AttributeEnd") {
+				if (mTransforms.size() > 1) mTransforms.pop();
+				if (type == "AttributeEnd") mColor = glm::vec4(0);
+			}
+			else if (type == "Transform") {
+				setTransform(aDirective);
+			}
+			else if (type == "AreaLightSource") {
+				if (const Param* l = aDirective.find("L"); l && l->mType == "rgb") mColor = glm::vec4(l->float3(), 1);
+			}
+			else if (type == "Texture") {
+				const Param* filename = aDirective.find("filename");
+				if (filename && !filename->mStrings.empty()) loadTexture(aDirective.arg(0), filename->string1());
+			}
+			else if (type == "MakeNamedMaterial") {
+				makeMaterial(aDirective);
+			}
+			else if (type == "NamedMaterial") {
+				const auto it = mMaterialMap.find(aDirective.arg(0));
+				mMaterial = it != mMaterialMap.end() ? it->second : nullptr;
+			}
+			else if (type == "Shape") {
+				if (aDirective.arg(0) == "plymesh") loadPlyMesh(aDirective);
+				else if (aDirective.mTriangleMesh) addTriangleMesh(*aDirective.mTriangleMesh);
+			}
+			else if (type == "WorldEnd") {
+				return false;
+			}
+			return true;
+		}
+
+		Texture* findTexture(const Param& aParam)
+		{
+			const auto it = mTextureMap.find(aParam.string1());
+			return it != mTextureMap.end() ? it->second : nullptr;
+		}
+
+		void loadTexture(const std::string& aName, const std::string& aFile)
+		{
+			const std::string texture_filepath = std::filesystem::path(mPath + "/" + aFile).make_preferred().string();
+			spdlog::info("Load Image: {}", texture_filepath);
+			Image* img = io::Import::load_image_8_bit(texture_filepath, 4);
+			if (!img) return;
+			img->needsMipMaps(true);
+			mScene.mImages.push_back(img);
+
+			Texture* tex = Texture::alloc();
+			tex->sampler = { Sampler::Filter::LINEAR, Sampler::Filter::LINEAR, Sampler::Filter::LINEAR,
+				Sampler::Wrap::REPEAT, Sampler::Wrap::REPEAT, Sampler::Wrap::REPEAT, 0, std::numeric_limits<float>::max() };
+			tex->texCoordIndex = 0;
+			tex->image = img;
+			mTextureMap.insert({ aName, tex });
+			mScene.mTextures.push_back(tex);
+		}
+
+		void makeMaterial(Directive& aDirective)
+		{
+			const std::string material_name = aDirective.arg(0);
 			spdlog::info("Load Material: {}", material_name);
 
 			Material* mat = Material::alloc(material_name);
-			scene->mMaterials.push_back(mat);
-			materialMap.insert({ material_name, mat });
+			mScene.mMaterials.push_back(mat);
+			mMaterialMap.insert({ material_name, mat });
 
 			bool uber = false;
-			std::string arg;
-			while (!(arg = getNextWord(line)).empty()) {
-				if (arg == "string type") {
-					std::string type = getNextWord(line);
+			for (const Param& param : aDirective.mParams) {
+				if (param.mName == "type") {
+					const std::string type = param.string1();
+					uber = false;
 					if (type == "mirror") {
 						mat->setMetallicFactor(1);
 						mat->setRoughnessFactor(0);
-						uber = false;
 					}
 					else if (type == "metal") {
 						mat->setMetallicFactor(1);
 						mat->setRoughnessFactor(0.01f);
-						uber = false;
 					}
 					else if (type == "glass") {
 						mat->setMetallicFactor(0);
 						mat->setRoughnessFactor(0);
 						mat->setTransmissionFactor(1);
-						uber = false;
 					}
 					else if (type == "uber") {
 						mat->setMetallicFactor(0);
@@ -208,236 +548,131 @@ std::unique_ptr<io::SceneData> io::Import::load_pbrt(std::string const& aFile) {
 						mat->setTransmissionFactor(0);
 						uber = true;
 					}
-					else if (type == "matt") {
+					else if (type == "matt" || type == "substrate") {
 						mat->setMetallicFactor(0);
 						mat->setRoughnessFactor(1);
-						uber = false;
 					}
-					else if (type == "substrate") {
-						mat->setMetallicFactor(0);
-						mat->setRoughnessFactor(1);
-						uber = false;
-					} else uber = false;
 				}
-				else if (arg == "texture Kd") {
-					Texture* tex = textureMap[getNextWord(line)];
-					tex->image->setSRGB(true);
-					mat->setBaseColorTexture(tex);
-				} else if (arg == "texture opacity") {
-					Texture* tex = textureMap[getNextWord(line)];
-					for(uint8_t &c : tex->image->getDataVector()) c = 255 - c;
-					mat->setTransmissionTexture(tex);
-					mat->setTransmissionFactor(1);
-				} else if (arg == "rgb Kd") {
-					glm::vec4 c;
-					c.x = std::stof(getNextWord(line));
-					c.y = std::stof(getNextWord(line));
-					c.z = std::stof(getNextWord(line));
-					c.w = 1;
-					mat->setBaseColorFactor(c);
+				else if (param.mName == "Kd" && param.mType == "texture") {
+					if (Texture* tex = findTexture(param)) {
+						tex->image->setSRGB(true);
+						mat->setBaseColorTexture(tex);
+					}
+				}
+				else if (param.mName == "opacity" && param.mType == "texture") {
+					if (Texture* tex = findTexture(param)) {
+						for (uint8_t& c : tex->image->getDataVector()) c = 255 - c;
+						mat->setTransmissionTexture(tex);
+						mat->setTransmissionFactor(1);
+					}
 				}
-				else if (arg == "rgb Ks") {
-					glm::vec3 c;
-					c.x = std::stof(getNextWord(line));
-					c.y = std::stof(getNextWord(line));
-					c.z = std::stof(getNextWord(line));
-					mat->setSpecularColorFactor(c);
+				else if (param.mName == "Kd" && param.mType == "rgb") {
+					mat->setBaseColorFactor(glm::vec4(param.float3(), 1));
 				}
-				else if (arg == "rgb Ks") {
+				else if (param.mName == "Ks" && param.mType == "rgb") {
+					mat->setSpecularColorFactor(param.float3());
 				}
-				else if (arg == "rgb opacity") {
-					glm::vec3 o;
-					o.x = std::stof(getNextWord(line));
-					o.y = std::stof(getNextWord(line));
-					o.z = std::stof(getNextWord(line));
-					mat->setTransmissionFactor(1.0f - glm::compMax(o));
+				else if (param.mName == "opacity" && param.mType == "rgb") {
+					mat->setTransmissionFactor(1.0f - glm::compMax(param.float3()));
 				}
-				else if (arg == "float uroughness") {
-					mat->setRoughnessFactor(std::stof(getNextWord(line)));
+				else if (param.mName == "uroughness") {
+					mat->setRoughnessFactor(param.float1());
 				}
-				else if (arg == "eta") {
-					mat->setIOR(std::stof(getNextWord(line)));
+				else if (param.mName == "eta" && !param.mFloats.empty()) {
+					mat->setIOR(param.float1());
 				}
 			}
 			if (uber) mat->setBaseColorFactor(glm::vec4(1.0f));
 		}
-		else if (line_type == "NamedMaterial") {
-			tmaterial = materialMap[getNextWord(line)];
-			/*if (tmodel) {
-				scene.models.push_back(tmodel);
-				Node* Node = Node::alloc("node");
-				Node->setModel(tmodel);
-				tRootNode->addChildNode(Node);
-				tmodel = nullptr;
-			}
 
-			tmodel = modelManager.alloc("");
-			tmodel->setIndex(modelManager.size());
-			modelManager.add(tmodel);
-			tmaterial = material_map[getNextWord(line)];*/
+		void loadPlyMesh(Directive& aDirective)
+		{
+			const Param* filename = aDirective.find("filename");
+			if (!filename || filename->mStrings.empty()) return;
+			const std::filesystem::path mesh_filepath = std::filesystem::path(mPath + "/" + filename->string1()).make_preferred();
+			std::shared_ptr<Mesh> tmesh = io::Import::load_mesh(mesh_filepath.string());
+			if (!tmesh) return;
+			if (mMaterial) tmesh->setMaterial(mMaterial);
+			std::shared_ptr<Model> tmodel = Model::alloc(mesh_filepath.filename().string());
+			mScene.mModels.push_back(tmodel);
+			Node& node = mGeometryNode.addChildNode("node");
+			node.setModel(tmodel);
+
+			aabb_s aabb = tmodel->getAABB();
+			aabb.set(tmesh->getAABB());
+			tmodel->setAABB(aabb);
+			tmodel->addMesh(tmesh);
 		}
-		else if (line_type == "Shape") {
-			const std::string shape_type = getNextWord(line);
-			if (shape_type == "plymesh") {
-				const std::string mesh_type = getNextWord(line);
-				if (mesh_type == "string filename") {
-					const std::filesystem::path mesh_filepath = std::filesystem::path(path + "/" + getNextWord(line)).make_preferred();
-					std::shared_ptr<Mesh> tmesh = Import::load_mesh(mesh_filepath.string());
-					if(tmaterial) tmesh->setMaterial(tmaterial);
-					tmodel = Model::alloc(mesh_filepath.filename().string());
-					scene->mModels.push_back(tmodel);
-					Node& node = geometryNode.addChildNode("node");
-					node.setModel(tmodel);
-					
-
-					aabb_s aabb = tmodel->getAABB();
-					aabb.set(tmesh->getAABB());
-					tmodel->setAABB(aabb);
-					tmodel->addMesh(tmesh);
-					tmodel = nullptr;
-				}
+
+		void addTriangleMesh(TriangleMesh& aTriangleMesh)
+		{
+			std::shared_ptr<Mesh> tmesh = Mesh::alloc();
+			tmesh->setTopology(Mesh::Topology::TRIANGLE_LIST);
+			tmesh->hasPositions(true);
+			tmesh->hasIndices(aTriangleMesh.mHasIndices);
+			tmesh->hasNormals(aTriangleMesh.mHasNormals);
+			tmesh->hasTexCoords0(aTriangleMesh.mHasTexCoords);
+			tmesh->setAABB(aTriangleMesh.mAABB);
+			tmesh->getIndicesVectorRef() = std::move(aTriangleMesh.mIndices);
+			tmesh->getVerticesVectorRef() = std::move(aTriangleMesh.mVertices);
+
+			if (mMaterial) {
+				Material* mat = Material::alloc("temp");
+				mScene.mMaterials.push_back(mat);
+				*mat = *mMaterial;
+				const glm::vec3 vec = mColor;
+				mat->setEmissionFactor(vec);
+				tmesh->setMaterial(mat);
 			}
-			else if (shape_type == "trianglemesh") {
-				std::vector<uint32_t> indices;
-				std::vector<float> vertices;
-				std::vector<float> normals;
-				std::vector<float> uvs;
-
-				std::shared_ptr<Mesh> tmesh = Mesh::alloc();
-				tmesh->setTopology(Mesh::Topology::TRIANGLE_LIST);
-
-				std::string arg;
-				while (!(arg = getNextWord(line)).empty()) {
-					if (arg == "integer indices") {
-						tmesh->hasIndices(true);
-						while (!(arg = getNextWord(line)).empty()) {
-							try {
-								indices.push_back(static_cast<uint32_t>(std::stof(arg)));
-							}
-							catch (const std::exception&) {
-								break;
-							}
-						}
-					}
-					if (arg == "point P") {
-						while (!(arg = getNextWord(line)).empty()) {
-							try {
-								vertices.push_back({ std::stof(arg) });
-							}
-							catch (const std::exception&) {
-								break;
-							}
-						}
-					}
-					if (arg == "normal N") {
-						tmesh->hasNormals(true);
-						while (!(arg = getNextWord(line)).empty()) {
-							try {
-								normals.push_back({ std::stof(arg) });
-							}
-							catch (const std::exception&) {
-								break;
-							}
-						}
-					}
-					if (arg == "float uv") {
-						tmesh->hasTexCoords0(true);
-						while (!(arg = getNextWord(line)).empty()) {
-							try {
-								uvs.push_back({ std::stof(arg) });
-							}
-							catch (const std::exception&) {
-								break;
-							}
-						}
-					}
-				}
-				const size_t vertexCount = vertices.size() / 3;
-
-				std::vector<vertex_s> v;
-				v.reserve(vertexCount);
-
-				aabb_s aabb;
-				for (size_t i = 0; i < vertexCount; i++) {
-					aabb.set(reinterpret_cast<glm::vec3*>(vertices.data())[i]);
-					v.push_back({ glm::vec4(reinterpret_cast<glm::vec3*>(vertices.data())[i],1),
-								glm::vec4(reinterpret_cast<glm::vec3*>(normals.data())[i],0),
-								glm::vec4(0),
-								glm::vec2(reinterpret_cast<glm::vec2*>(uvs.data())[i])});
-				}
-				tmesh->setAABB(aabb);
-
-				
-				tmesh->setIndices(indices);
-				tmesh->setVertices(v);
-
-				if (tmaterial) {
-					Material* mat = Material::alloc("temp");
-					scene->mMaterials.push_back(mat);
-					*mat = *tmaterial;
-                    glm::vec3 vec = color;
-                    mat->setEmissionFactor(vec);
-					tmesh->setMaterial(mat);
-				}
 
-				tmodel = Model::alloc("");
-				scene->mModels.push_back(tmodel);
+			std::shared_ptr<Model> tmodel = Model::alloc("");
+			mScene.mModels.push_back(tmodel);
 
-				glm::vec3 scale;
-				glm::quat rotation;
-				glm::vec3 translation;
-				ASSERT(math::decomposeTransform(transforms.top(), translation, rotation, scale), "decompose error");
+			glm::vec3 scale;
+			glm::quat rotation;
+			glm::vec3 translation;
+			ASSERT(math::decomposeTransform(mTransforms.top(), translation, rotation, scale), "decompose error");
 
-				Node& node = geometryNode.addChildNode("node");
-				node.setModel(tmodel);
-				node.setRotation(glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w));
-				node.setScale(glm::vec3(scale.x, scale.y, scale.z));
-				node.setTranslation(glm::vec3(translation.x, translation.y, translation.z));
+			Node& node = mGeometryNode.addChildNode("node");
+			node.setModel(tmodel);
+			node.setRotation(glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w));
+			node.setScale(glm::vec3(scale.x, scale.y, scale.z));
+			node.setTranslation(glm::vec3(translation.x, translation.y, translation.z));
 
-				aabb.set(tmesh->getAABB());
-				tmodel->setAABB(aabb);
-				tmodel->addMesh(tmesh);
-				tmodel = nullptr;
-			}
-			else if (shape_type == "sphere") {
-				
-				
-				
-				
-				
-
-				
-				
-				
-				
-				
-
-				
-				
-				
-				
-				
-				
-
-				
-				
-				
-				
-				
-				
-			}
+			aabb_s aabb = aTriangleMesh.mAABB;
+			aabb.set(tmesh->getAABB());
+			tmodel->setAABB(aabb);
+			tmodel->addMesh(tmesh);
 		}
 
-		else if (line_type == "WorldEnd") {
-			if (tmodel) {
-				scene->mModels.push_back(tmodel);
-				Node& node = geometryNode.addChildNode("node");
-				node.setModel(tmodel);
-				tmodel = nullptr;
-			}
-			break;
-		}
-	}
+		io::SceneData&					mScene;
+		Node&							mCameraNode;
+		Node&							mGeometryNode;
+		std::string						mPath;
+		std::stack<glm::mat4>			mTransforms;
+		bool							mWorld;
+		bool							mFailed;
+		Material*						mMaterial;
+		glm::vec4						mColor;
+		std::map<std::string, Texture*>	mTextureMap;
+		std::map<std::string, Material*> mMaterialMap;
+	};
+}
+
+std::unique_ptr<io::SceneData> io::Import::load_pbrt(std::string const& aFile) {
+	const std::filesystem::path directory = std::filesystem::path(aFile).parent_path();
+
+	std::unique_ptr<SceneData> scene = SceneData::alloc();
+	std::shared_ptr tscene = Node::alloc("pbrt scene");
+	Node& rootNode = tscene->addChildNode("root");
+	Node& cameraNode = rootNode.addChildNode("camera");
+	Node& geometryNode = rootNode.addChildNode("geometry");
+
+	const std::unique_ptr<ParsedFile> file = parseFile(aFile, directory);
+	if (!file) return nullptr;
+	SceneBuilder builder(*scene, cameraNode, geometryNode, directory.string());
+	builder.apply(*file);
+	if (builder.failed()) return nullptr;
 	scene->mSceneGraphs.push_back(tscene);
 	return scene;
 }
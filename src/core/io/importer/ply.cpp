@@ -139,8 +139,7 @@ std::unique_ptr<Mesh> io::Import::load_ply_mesh(const std::string& aFile) {
 
 		
 		if (!tmesh->hasNormals() && tmesh->getTopology() == Mesh::Topology::TRIANGLE_LIST) topology::calcNormals(tmesh.get());
-		if (!tmesh->hasTangents() && tmesh->hasTexCoords0() && tmesh->getTopology() == Mesh::Topology::TRIANGLE_LIST) topology::calcMikkTSpaceTangents(tmesh.get());
-		if (!tmesh->hasTangents()) topology::calcStarkTangents(tmesh.get());
+		if (!tmesh->hasTangents()) topology::calcTangents(tmesh.get());
 		
 		Material* mat = Material::alloc(DEFAULT_MATERIAL_NAME);
 		tmesh->setMaterial(mat);
@@ -1,4 +1,5 @@
 #include <tamashii/core/io/io.hpp>
+#include <tamashii/core/common/profiler.hpp>
 #include <tamashii/core/scene/light.hpp>
 #include <tamashii/core/scene/model.hpp>
 
@@ -6,6 +7,7 @@ T_USE_NAMESPACE
 
 std::unique_ptr<Model> io::Import::load_model(const std::string& aFile)
 {
+	T_PROFILE_SCOPE("import model");
 	spdlog::info("Load Model: {}", aFile);
 	std::string ext = std::filesystem::path(aFile).extension().string();
 	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
@@ -21,6 +23,7 @@ std::unique_ptr<Model> io::Import::load_model(const std::string& aFile)
 
 std::unique_ptr<Mesh> io::Import::load_mesh(const std::string& aFile)
 {
+	T_PROFILE_SCOPE("import mesh");
 	spdlog::info("Load Mesh: {}", aFile);
 	std::string ext = std::filesystem::path(aFile).extension().string();
 	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
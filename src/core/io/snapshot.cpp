@@ -0,0 +1,284 @@
+#include <tamashii/core/io/snapshot.hpp>
+#include <tamashii/core/common/thread_pool.hpp>
+#include <miniz.h>
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+
+T_USE_NAMESPACE
+
+namespace {
+	constexpr std::array<char, 8> MAGIC = { 'T', 'S', 'N', 'A', 'P', 'S', 'H', 'T' };
+	constexpr uint32_t VERSION = 2;
+	constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+	constexpr uint64_t ALIGNMENT = 64;
+	constexpr size_t NAME_SIZE = 48;
+
+	// all integers and section data in native byte order, files from a machine with the other order are rejected
+	struct FileHeader {
+		std::array<char, 8>	mMagic;
+		uint32_t			mVersion;
+		uint32_t			mByteOrder;
+		uint32_t			mMetaCount;
+		uint32_t			mSectionCount;
+		uint32_t			mChunkSize;
+	};
+	struct MetaEntry {
+		char				mKey[NAME_SIZE];
+		uint64_t			mValue;
+	};
+	struct SectionEntry {
+		char				mName[NAME_SIZE];
+		uint32_t			mCompression;
+		uint32_t			mElementSize;
+		uint64_t			mSize;
+		uint64_t			mChunkCount;
+		uint64_t			mChunkTableOffset;
+	};
+	struct ChunkEntry {
+		uint64_t			mOffset;
+		uint64_t			mStoredSize;
+	};
+
+	uint64_t align(const uint64_t aValue) { return (aValue + ALIGNMENT - 1) & ~(ALIGNMENT - 1); }
+
+	void copyName(char (&aDst)[NAME_SIZE], const std::string& aName)
+	{
+		std::memset(aDst, 0, NAME_SIZE);
+		std::memcpy(aDst, aName.data(), std::min(aName.size(), NAME_SIZE - 1));
+	}
+
+	// byte i of element e goes to plane i, groups equal bytes of floats for the deflate stage
+	void shuffle(const uint8_t* aSrc, uint8_t* aDst, const size_t aSize, const uint32_t aElementSize)
+	{
+		const size_t count = aSize / aElementSize;
+		for (size_t e = 0; e < count; e++) for (uint32_t b = 0; b < aElementSize; b++) aDst[b * count + e] = aSrc[e * aElementSize + b];
+		std::memcpy(aDst + count * aElementSize, aSrc + count * aElementSize, aSize - count * aElementSize);
+	}
+	void unshuffle(const uint8_t* aSrc, uint8_t* aDst, const size_t aSize, const uint32_t aElementSize)
+	{
+		const size_t count = aSize / aElementSize;
+		for (size_t e = 0; e < count; e++) for (uint32_t b = 0; b < aElementSize; b++) aDst[e * aElementSize + b] = aSrc[b * count + e];
+		std::memcpy(aDst + count * aElementSize, aSrc + count * aElementSize, aSize - count * aElementSize);
+	}
+}
+
+bool io::Snapshot::write(const std::string& aFile, const std::map<std::string, uint64_t>& aMeta, const std::vector<Section>& aSections,
+	const Compression aCompression, uint32_t aChunkSize)
+{
+	aChunkSize = std::max(static_cast<uint32_t>(ALIGNMENT), aChunkSize / static_cast<uint32_t>(ALIGNMENT) * static_cast<uint32_t>(ALIGNMENT));
+	for (const auto& [key, value] : aMeta) if (key.size() >= NAME_SIZE) { spdlog::error("Snapshot: meta key '{}' too long", key); return false; }
+	for (const Section& s : aSections) if (s.mName.size() >= NAME_SIZE) { spdlog::error("Snapshot: section name '{}' too long", s.mName); return false; }
+
+	// encode all chunks before anything is written, so the layout is known
+	struct Encoded {
+		std::vector<std::vector<uint8_t>>	mChunks;	// empty vector: chunk is stored raw
+		std::vector<ChunkEntry>				mTable;
+	};
+	std::vector<Encoded> encoded(aSections.size());
+	std::atomic<bool> failed = false;
+	for (size_t i = 0; i < aSections.size(); i++) {
+		const Section& s = aSections[i];
+		const uint64_t chunkCount = (s.mSize + aChunkSize - 1) / aChunkSize;
+		encoded[i].mChunks.resize(chunkCount);
+		encoded[i].mTable.resize(chunkCount);
+		if (aCompression == Compression::NONE) continue;
+		ThreadPool::getInstance().parallelFor(0, chunkCount, [&](const size_t aChunk) {
+			const uint64_t begin = aChunk * aChunkSize;
+			const size_t rawSize = static_cast<size_t>(std::min<uint64_t>(aChunkSize, s.mSize - begin));
+			std::vector<uint8_t> shuffled(rawSize);
+			shuffle(static_cast<const uint8_t*>(s.mData) + begin, shuffled.data(), rawSize, std::max(1u, s.mElementSize));
+			std::vector<uint8_t> out(mz_compressBound(static_cast<mz_ulong>(rawSize)));
+			mz_ulong outSize = static_cast<mz_ulong>(out.size());
+			const int ret = mz_compress2(out.data(), &outSize, shuffled.data(), static_cast<mz_ulong>(rawSize), MZ_BEST_SPEED);
+			if (ret != MZ_OK) failed = true;
+			else if (outSize < rawSize) {
+				out.resize(outSize);
+				encoded[i].mChunks[aChunk] = std::move(out);
+			}
+		});
+	}
+	if (failed) {
+		spdlog::error("Snapshot: compression failed for {}", aFile);
+		return false;
+	}
+
+	uint64_t offset = sizeof(FileHeader) + aMeta.size() * sizeof(MetaEntry) + aSections.size() * sizeof(SectionEntry);
+	std::vector<SectionEntry> sectionEntries(aSections.size());
+	for (size_t i = 0; i < aSections.size(); i++) {
+		SectionEntry& e = sectionEntries[i];
+		copyName(e.mName, aSections[i].mName);
+		e.mCompression = static_cast<uint32_t>(aCompression);
+		e.mElementSize = aSections[i].mElementSize;
+		e.mSize = aSections[i].mSize;
+		e.mChunkCount = encoded[i].mTable.size();
+		e.mChunkTableOffset = offset;
+		offset += e.mChunkCount * sizeof(ChunkEntry);
+	}
+	for (size_t i = 0; i < aSections.size(); i++) {
+		offset = align(offset);
+		for (size_t c = 0; c < encoded[i].mTable.size(); c++) {
+			const uint64_t rawSize = std::min<uint64_t>(aChunkSize, aSections[i].mSize - c * aChunkSize);
+			ChunkEntry& chunk = encoded[i].mTable[c];
+			chunk.mOffset = offset;
+			chunk.mStoredSize = encoded[i].mChunks[c].empty() ? rawSize : encoded[i].mChunks[c].size();
+			offset += chunk.mStoredSize;
+		}
+	}
+
+	std::ofstream out(aFile, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) {
+		spdlog::error("Snapshot: failed to open {}", aFile);
+		return false;
+	}
+	const FileHeader header = { MAGIC, VERSION, BYTE_ORDER_MARK, static_cast<uint32_t>(aMeta.size()), static_cast<uint32_t>(aSections.size()), aChunkSize };
+	out.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+	for (const auto& [key, value] : aMeta) {
+		MetaEntry e{};
+		copyName(e.mKey, key);
+		e.mValue = value;
+		out.write(reinterpret_cast<const char*>(&e), sizeof(MetaEntry));
+	}
+	out.write(reinterpret_cast<const char*>(sectionEntries.data()), static_cast<std::streamsize>(sectionEntries.size() * sizeof(SectionEntry)));
+	for (const Encoded& e : encoded) out.write(reinterpret_cast<const char*>(e.mTable.data()), static_cast<std::streamsize>(e.mTable.size() * sizeof(ChunkEntry)));
+
+	constexpr std::array<char, ALIGNMENT> zeros{};
+	for (size_t i = 0; i < aSections.size(); i++) {
+		for (size_t c = 0; c < encoded[i].mTable.size(); c++) {
+			const ChunkEntry& chunk = encoded[i].mTable[c];
+			const auto pos = static_cast<uint64_t>(out.tellp());
+			if (pos < chunk.mOffset) out.write(zeros.data(), static_cast<std::streamsize>(chunk.mOffset - pos));
+			const char* data = encoded[i].mChunks[c].empty() ? static_cast<const char*>(aSections[i].mData) + c * aChunkSize
+				: reinterpret_cast<const char*>(encoded[i].mChunks[c].data());
+			out.write(data, static_cast<std::streamsize>(chunk.mStoredSize));
+		}
+	}
+	if (!out.good()) {
+		spdlog::error("Snapshot: failed to write {}", aFile);
+		return false;
+	}
+	return true;
+}
+
+bool io::Snapshot::open(const std::string& aFile)
+{
+	close();
+	if (!mFile.open(aFile)) {
+		spdlog::error("Snapshot: failed to open {}", aFile);
+		return false;
+	}
+	const char* data = mFile.data();
+	const uint64_t fileSize = mFile.size();
+	auto fail = [&](const char* aReason) {
+		spdlog::error("Snapshot: {} ({})", aReason, aFile);
+		close();
+		return false;
+	};
+
+	FileHeader header;
+	if (fileSize < sizeof(FileHeader)) return fail("file too small");
+	std::memcpy(&header, data, sizeof(FileHeader));
+	if (header.mMagic != MAGIC) return fail("not a snapshot file");
+	if (header.mVersion != VERSION) return fail("unsupported version");
+	if (header.mByteOrder != BYTE_ORDER_MARK) return fail("written with a different byte order");
+	if (header.mChunkSize == 0) return fail("invalid chunk size");
+
+	uint64_t offset = sizeof(FileHeader);
+	if (offset + header.mMetaCount * sizeof(MetaEntry) + header.mSectionCount * sizeof(SectionEntry) > fileSize) return fail("truncated header");
+	for (uint32_t i = 0; i < header.mMetaCount; i++, offset += sizeof(MetaEntry)) {
+		MetaEntry e;
+		std::memcpy(&e, data + offset, sizeof(MetaEntry));
+		e.mKey[NAME_SIZE - 1] = '\0';
+		mMeta[e.mKey] = e.mValue;
+	}
+	for (uint32_t i = 0; i < header.mSectionCount; i++, offset += sizeof(SectionEntry)) {
+		SectionEntry e;
+		std::memcpy(&e, data + offset, sizeof(SectionEntry));
+		e.mName[NAME_SIZE - 1] = '\0';
+		if (e.mCompression > static_cast<uint32_t>(Compression::DEFLATE)) return fail("unknown compression");
+		if (e.mChunkTableOffset + e.mChunkCount * sizeof(ChunkEntry) > fileSize) return fail("truncated chunk table");
+		if (e.mChunkCount != (e.mSize + header.mChunkSize - 1) / header.mChunkSize) return fail("inconsistent chunk count");
+
+		SectionInfo info{ static_cast<Compression>(e.mCompression), e.mElementSize, e.mSize, header.mChunkSize, {} };
+		info.mChunks.resize(e.mChunkCount);
+		for (uint64_t c = 0; c < e.mChunkCount; c++) {
+			ChunkEntry chunk;
+			std::memcpy(&chunk, data + e.mChunkTableOffset + c * sizeof(ChunkEntry), sizeof(ChunkEntry));
+			if (chunk.mOffset + chunk.mStoredSize > fileSize) return fail("truncated data");
+			info.mChunks[c] = { chunk.mOffset, chunk.mStoredSize };
+		}
+		mSections[e.mName] = std::move(info);
+	}
+	return true;
+}
+
+void io::Snapshot::close()
+{
+	mFile.close();
+	mMeta.clear();
+	mSections.clear();
+}
+
+std::optional<uint64_t> io::Snapshot::meta(const std::string& aKey) const
+{
+	const auto it = mMeta.find(aKey);
+	if (it == mMeta.end()) return std::nullopt;
+	return it->second;
+}
+
+bool io::Snapshot::has(const std::string& aSection) const
+{
+	return mSections.contains(aSection);
+}
+
+uint64_t io::Snapshot::size(const std::string& aSection) const
+{
+	const auto it = mSections.find(aSection);
+	return it == mSections.end() ? 0 : it->second.mSize;
+}
+
+const void* io::Snapshot::view(const std::string& aSection) const
+{
+	const auto it = mSections.find(aSection);
+	if (it == mSections.end() || it->second.mCompression != Compression::NONE) return nullptr;
+	if (it->second.mChunks.empty()) return mFile.data();
+	return mFile.data() + it->second.mChunks.front().first;
+}
+
+bool io::Snapshot::read(const std::string& aSection, void* aOut, const uint64_t aSize) const
+{
+	const auto it = mSections.find(aSection);
+	if (it == mSections.end()) {
+		spdlog::error("Snapshot: no section {}", aSection);
+		return false;
+	}
+	const SectionInfo& info = it->second;
+	if (info.mSize != aSize) {
+		spdlog::error("Snapshot: section {} has {} bytes, expected {}", aSection, info.mSize, aSize);
+		return false;
+	}
+
+	std::atomic<bool> failed = false;
+	ThreadPool::getInstance().parallelFor(0, info.mChunks.size(), [&](const size_t aChunk) {
+		const auto [offset, storedSize] = info.mChunks[aChunk];
+		const uint64_t begin = aChunk * info.mChunkSize;
+		const size_t rawSize = static_cast<size_t>(std::min(info.mChunkSize, info.mSize - begin));
+		uint8_t* dst = static_cast<uint8_t*>(aOut) + begin;
+		const auto* src = reinterpret_cast<const uint8_t*>(mFile.data() + offset);
+		if (storedSize == rawSize) {
+			std::memcpy(dst, src, rawSize);
+			return;
+		}
+		std::vector<uint8_t> shuffled(rawSize);
+		mz_ulong outSize = static_cast<mz_ulong>(rawSize);
+		if (mz_uncompress(shuffled.data(), &outSize, src, static_cast<mz_ulong>(storedSize)) != MZ_OK || outSize != rawSize) {
+			failed = true;
+			return;
+		}
+		unshuffle(shuffled.data(), dst, rawSize, std::max(1u, info.mElementSize));
+	});
+	if (failed) spdlog::error("Snapshot: corrupt data in section {}", aSection);
+	return !failed;
+}
@@ -0,0 +1,50 @@
+#include <tamashii/core/platform/mapped_file.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+T_USE_NAMESPACE
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& aFile)
+{
+    close();
+    const int fd = ::open(aFile.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat st {};
+    if (fstat(fd, &st) == -1) {
+        ::close(fd);
+        return false;
+    }
+    mSize = static_cast<size_t>(st.st_size);
+    if (mSize == 0) {
+        ::close(fd);
+        mOpenEmpty = true;
+        return true;
+    }
+
+    void* ptr = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        mSize = 0;
+        return false;
+    }
+    madvise(ptr, mSize, MADV_SEQUENTIAL);
+    mData = static_cast<const char*>(ptr);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData) munmap(const_cast<char*>(mData), mSize);
+    mData = nullptr;
+    mSize = 0;
+    mOpenEmpty = false;
+}
@@ -0,0 +1,63 @@
+#include <tamashii/core/platform/mapped_file.hpp>
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+
+T_USE_NAMESPACE
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& aFile)
+{
+    close();
+    HANDLE file = CreateFileA(aFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+    mSize = static_cast<size_t>(size.QuadPart);
+    if (mSize == 0) {
+        CloseHandle(file);
+        mOpenEmpty = true;
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        mSize = 0;
+        return false;
+    }
+    const void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!ptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        mSize = 0;
+        return false;
+    }
+    mFile = file;
+    mMapping = mapping;
+    mData = static_cast<const char*>(ptr);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData) UnmapViewOfFile(mData);
+    if (mMapping) CloseHandle(mMapping);
+    if (mFile) CloseHandle(mFile);
+    mData = nullptr;
+    mMapping = nullptr;
+    mFile = nullptr;
+    mSize = 0;
+    mOpenEmpty = false;
+}
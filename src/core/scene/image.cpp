@@ -25,7 +25,7 @@ void Image::init(uint32_t const &aWidth, uint32_t const &aHeight, const Format a
 	mSizeInBytes = aWidth * aHeight * textureFormatToBytes(aFormat);
 	
 	mData.resize(mSizeInBytes);
-	std::memcpy(mData.data(), aData, mSizeInBytes);
+	if (aData) std::memcpy(mData.data(), aData, mSizeInBytes);
 }
 
 uint32_t Image::getWidth() const
@@ -250,7 +250,8 @@ void Mesh::CustomData::free()
 
 Mesh::Mesh(const std::string_view aName) : Asset(Type::MESH, aName), mTopology(Topology::UNKNOWN), mHasIndices(false), mHasPositions(false), mHasNormals(false),
                                            mHasTangents(false), mHasTextureCoordinates0(false), mHasTextureCoordinates1(false), 
-                                           mHasColors0(false), mMaterial(nullptr) {}
+                                           mHasColors0(false), mIndices(std::make_shared<std::vector<uint32_t>>()),
+                                           mVertices(std::make_shared<std::vector<vertex_s>>()), mMaterial(nullptr) {}
 
 Mesh::~Mesh()
 {
@@ -271,22 +272,59 @@ Mesh::Topology Mesh::getTopology() const
 { return mTopology; }
 
 uint32_t* Mesh::getIndicesArray()
-{ return mIndices.data(); }
+{ return getIndicesVectorRef().data(); }
+
+const uint32_t* Mesh::getIndicesArray() const
+{ return mIndices->data(); }
 
 std::vector<uint32_t>* Mesh::getIndicesVector()
-{ return &mIndices; }
+{ return &getIndicesVectorRef(); }
+
+const std::vector<uint32_t>* Mesh::getIndicesVector() const
+{ return mIndices.get(); }
 
 std::vector<uint32_t>& Mesh::getIndicesVectorRef()
-{ return mIndices; }
+{
+	detachIndices();
+	return *mIndices;
+}
+
+const std::vector<uint32_t>& Mesh::getIndicesVectorRef() const
+{ return *mIndices; }
 
 vertex_s* Mesh::getVerticesArray()
-{ return mVertices.data(); }
+{ return getVerticesVectorRef().data(); }
+
+const vertex_s* Mesh::getVerticesArray() const
+{ return mVertices->data(); }
 
 std::vector<vertex_s>* Mesh::getVerticesVector()
-{ return &mVertices; }
+{ return &getVerticesVectorRef(); }
+
+const std::vector<vertex_s>* Mesh::getVerticesVector() const
+{ return mVertices.get(); }
 
 std::vector<vertex_s>& Mesh::getVerticesVectorRef()
-{ return mVertices; }
+{
+	detachVertices();
+	return *mVertices;
+}
+
+const std::vector<vertex_s>& Mesh::getVerticesVectorRef() const
+{ return *mVertices; }
+
+bool Mesh::sharesGeometryWith(const Mesh& aMesh) const
+{ return mVertices == aMesh.mVertices || mIndices == aMesh.mIndices; }
+
+void Mesh::detachIndices()
+{
+	if (mIndices.use_count() > 1) mIndices = std::make_shared<std::vector<uint32_t>>(*mIndices);
+}
+
+void Mesh::detachVertices()
+{
+	if (mVertices.use_count() > 1) mVertices = std::make_shared<std::vector<vertex_s>>(*mVertices);
+}
 
 Mesh::CustomData* Mesh::addCustomData(const std::string& aKey)
 {
@@ -313,10 +351,10 @@ const std::map<std::string, Mesh::CustomData>& Mesh::getCustomDataMap() const
 { return mCustomData; }
 
 size_t Mesh::getIndexCount() const
-{ return mIndices.size(); }
+{ return mIndices->size(); }
 
 size_t Mesh::getVertexCount() const
-{ return mVertices.size(); }
+{ return mVertices->size(); }
 
 size_t Mesh::getPrimitiveCount() const
 {
@@ -370,10 +408,10 @@ void Mesh::setTopology(const Topology aTopology)
 { mTopology = aTopology; }
 
 void Mesh::setIndices(const std::vector<uint32_t>& aIndices)
-{ mIndices = aIndices; }
+{ mIndices = std::make_shared<std::vector<uint32_t>>(aIndices); }
 
 void Mesh::setVertices(const std::vector<vertex_s>& aVertices)
-{ mVertices = aVertices; }
+{ mVertices = std::make_shared<std::vector<vertex_s>>(aVertices); }
 
 void Mesh::setMaterial(Material* aMaterial)
 { mMaterial = aMaterial; }
@@ -406,38 +444,40 @@ triangle_s Mesh::getTriangle(const uint32_t aIndex, const glm::mat4* aModelMatri
 {
 	const uint32_t idx = aIndex * 3;
 	triangle_s triangle = {};
+	const std::vector<uint32_t>& indices = *mIndices;
+	const std::vector<vertex_s>& vertices = *mVertices;
 	uint32_t idx0 = idx + 0, idx1 = idx + 1, idx2 = idx + 2;
 	if (hasIndices()) {
-		idx0 = mIndices[idx0];
-		idx1 = mIndices[idx1];
-		idx2 = mIndices[idx2];
+		idx0 = indices[idx0];
+		idx1 = indices[idx1];
+		idx2 = indices[idx2];
 	}
 	if (aModelMatrix) {
 		const glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(*aModelMatrix)));
-		triangle.mVert[0] = (*aModelMatrix) * mVertices[idx0].position;
-		triangle.mVert[1] = (*aModelMatrix) * mVertices[idx1].position;
-		triangle.mVert[2] = (*aModelMatrix) * mVertices[idx2].position;
-		triangle.mN[0] = normalMat * mVertices[idx0].normal;
-		triangle.mN[1] = normalMat * mVertices[idx1].normal;
-		triangle.mN[2] = normalMat * mVertices[idx2].normal;
-		triangle.mT[0] = normalMat * mVertices[idx0].tangent;
-		triangle.mT[1] = normalMat * mVertices[idx1].tangent;
-		triangle.mT[2] = normalMat * mVertices[idx2].tangent;
+		triangle.mVert[0] = (*aModelMatrix) * vertices[idx0].position;
+		triangle.mVert[1] = (*aModelMatrix) * vertices[idx1].position;
+		triangle.mVert[2] = (*aModelMatrix) * vertices[idx2].position;
+		triangle.mN[0] = normalMat * vertices[idx0].normal;
+		triangle.mN[1] = normalMat * vertices[idx1].normal;
+		triangle.mN[2] = normalMat * vertices[idx2].normal;
+		triangle.mT[0] = normalMat * vertices[idx0].tangent;
+		triangle.mT[1] = normalMat * vertices[idx1].tangent;
+		triangle.mT[2] = normalMat * vertices[idx2].tangent;
 	}
 	else {
-		triangle.mVert[0] = mVertices[idx0].position;
-		triangle.mVert[1] = mVertices[idx1].position;
-		triangle.mVert[2] = mVertices[idx2].position;
-		triangle.mN[0] = mVertices[idx0].normal;
-		triangle.mN[1] = mVertices[idx1].normal;
-		triangle.mN[2] = mVertices[idx2].normal;
-		triangle.mT[0] = mVertices[idx0].tangent;
-		triangle.mT[1] = mVertices[idx1].tangent;
-		triangle.mT[2] = mVertices[idx2].tangent;
+		triangle.mVert[0] = vertices[idx0].position;
+		triangle.mVert[1] = vertices[idx1].position;
+		triangle.mVert[2] = vertices[idx2].position;
+		triangle.mN[0] = vertices[idx0].normal;
+		triangle.mN[1] = vertices[idx1].normal;
+		triangle.mN[2] = vertices[idx2].normal;
+		triangle.mT[0] = vertices[idx0].tangent;
+		triangle.mT[1] = vertices[idx1].tangent;
+		triangle.mT[2] = vertices[idx2].tangent;
 	}
-	triangle.mUV0[0] = mVertices[idx0].texture_coordinates_0;
-	triangle.mUV0[1] = mVertices[idx1].texture_coordinates_0;
-	triangle.mUV0[2] = mVertices[idx2].texture_coordinates_0;
+	triangle.mUV0[0] = vertices[idx0].texture_coordinates_0;
+	triangle.mUV0[1] = vertices[idx1].texture_coordinates_0;
+	triangle.mUV0[2] = vertices[idx2].texture_coordinates_0;
 
 	const glm::vec3 dir01 = triangle.mVert[1] - triangle.mVert[0];
 	const glm::vec3 dir02 = triangle.mVert[2] - triangle.mVert[0];
@@ -450,8 +490,8 @@ triangle_s Mesh::getTriangle(const uint32_t aIndex, const glm::mat4* aModelMatri
 void Mesh::clear()
 {
 	mTopology = Topology::UNKNOWN;
-	mIndices.clear();
-	mVertices.clear();
+	mIndices = std::make_shared<std::vector<uint32_t>>();
+	mVertices = std::make_shared<std::vector<vertex_s>>();
 	mHasIndices = false;
 	mHasPositions = false;
 	mHasNormals = false;
@@ -9,11 +9,11 @@
 
 T_USE_NAMESPACE
 
-void Ref::updateSceneGraphNodesFromModelMatrix(const bool aFlipY) const
+void Ref::updateSceneGraphNodesFromModelMatrix(const std::vector<TRS*>& aTransforms, const bool aFlipY) const
 {
-	if (transforms.empty()) return;
+	if (aTransforms.empty()) return;
 	glm::mat4 sg_model_matrix(1.0f);
-	for (const TRS* trs : transforms) {
+	for (const TRS* trs : aTransforms) {
 		sg_model_matrix *= trs->getMatrix(0);
 	}
 
@@ -35,7 +35,7 @@ void Ref::updateSceneGraphNodesFromModelMatrix(const bool aFlipY) const
 	const bool trsNeedsUpdate = (translationNeedsUpdate || scaleNeedsUpdate || rotationNeedsUpdate);
 	if (!trsNeedsUpdate) return;
 
-	TRS* trs = transforms.front();
+	TRS* trs = aTransforms.front();
 	if (translationNeedsUpdate)
 	{
 		const glm::vec3 diff = c_translation - sg_translation;
@@ -14,10 +14,12 @@
 #include <tamashii/core/common/common.hpp>
 #include <tamashii/core/common/vars.hpp>
 
+#include <algorithm>
+
 
 T_USE_NAMESPACE
 
-RenderScene::RenderScene() : mReady{ false }, mSceneGraph{ nullptr }, mCurrentCamera{ nullptr }, mSelection{}, mPlayAnimation{ false }, mAnimationCycleTime{ 0 }, mAnimationTime{ 0 }, mUpdateRequests{}
+RenderScene::RenderScene() : mReady{ false }, mSceneGraph{ nullptr }, mCurrentCamera{ nullptr }, mSelection{}, mPlayAnimation{ false }, mAnimationCycleTime{ 0 }, mAnimationTime{ 0 }, mTransformsDirty{ false }, mUpdateRequests{}
 {
 	
 	mDefaultCamera = std::make_shared<Camera>();
@@ -29,7 +31,7 @@ RenderScene::RenderScene() : mReady{ false }, mSceneGraph{ nullptr }, mCurrentCa
 	mDefaultCameraRef->camera = mDefaultCamera;
 	dynamic_cast<RefCameraPrivate&>(*mDefaultCameraRef).default_camera = true;
 	mDefaultCameraRef->ref_camera_index = static_cast<int>(mRefCameras.size());
-	mRefCameras.emplace_back(mDefaultCameraRef);
+	mDefaultCameraRef->handle = mRefCameras.insert(mDefaultCameraRef);
 
 	mCurrentCamera = mRefCameras.front();
 	for (const auto& rc : mRefCameras) {
@@ -143,9 +145,15 @@ void RenderScene::destroy()
 	mRefModels.clear();
 	mRefLights.clear();
 	mRefCameras.clear();
+	mAssetRefCount.clear();
+	mTransformNodes.clear();
+	mFreeTransformNodes.clear();
+	mAnimatedTransformNodes.clear();
+	mTransformsDirty = false;
 
 	
-	mRefCameras.push_back(mDefaultCameraRef);
+	mDefaultCameraRef->ref_camera_index = static_cast<int>(mRefCameras.size());
+	mDefaultCameraRef->handle = mRefCameras.insert(mDefaultCameraRef);
 }
 
 void RenderScene::readyToRender(const bool aReady)
@@ -156,7 +164,8 @@ bool RenderScene::readyToRender() const
 
 std::shared_ptr<RefLight> RenderScene::addLightRef(const std::shared_ptr<Light>& aLight, const glm::vec3 aPosition, const glm::vec4 aRotation, const glm::vec3 aScale)
 {
-	mLights.push_back(aLight);
+	// listed once, a light with refs is already in the list
+	if (!mAssetRefCount.contains(aLight.get()) && std::find(mLights.begin(), mLights.end(), aLight) == mLights.end()) mLights.push_back(aLight);
 
 	Node& node = mSceneGraph->addChildNode("refLight");
 	node.setTranslation(aPosition);
@@ -167,13 +176,15 @@ std::shared_ptr<RefLight> RenderScene::addLightRef(const std::shared_ptr<Light>&
 	auto refLight = std::make_shared<RefLight>();
 	refLight->light = node.getLight();
 	refLight->ref_light_index = static_cast<int>(mRefLights.size());
-	refLight->transforms.push_back(&node.getTRS());
 	refLight->model_matrix *= node.getTRS().getMatrix(std::fmod(mAnimationTime, mAnimationCycleTime));
+	refLight->transform_node = addTransformNode(&node.getTRS(), -1, false, refLight->model_matrix);
+	retainTransformNode(refLight->transform_node);
 	const glm::vec4 dir = refLight->model_matrix * refLight->light->getDefaultDirection();
 	const glm::vec4 pos = refLight->model_matrix * glm::vec4(0, 0, 0, 1);
 	refLight->direction = glm::normalize(glm::vec3(dir));
 	refLight->position = glm::vec3(pos);
-	mRefLights.emplace_back(refLight);
+	refLight->handle = mRefLights.insert(refLight);
+	mAssetRefCount[refLight->light.get()]++;
 
 	mSelection.reference = refLight;
 	mNewlyAddedRef.emplace_back(refLight);
@@ -198,8 +209,9 @@ void RenderScene::addMaterial(Material* aMaterial)
 
 std::shared_ptr<RefModel> RenderScene::addModelRef(const std::shared_ptr<Model>& aModel, const glm::vec3 aPosition, const glm::vec4 aRotation, const glm::vec3 aScale)
 {
-	mModels.push_back(aModel);
-	
+	// listed once, a model with refs is already in the list
+	if (!mAssetRefCount.contains(aModel.get()) && std::find(mModels.begin(), mModels.end(), aModel) == mModels.end()) mModels.push_back(aModel);
+
 	Node& node = mSceneGraph->addChildNode("refModel");
 	node.setTranslation(aPosition);
 	node.setRotation(aRotation);
@@ -209,15 +221,17 @@ std::shared_ptr<RefModel> RenderScene::addModelRef(const std::shared_ptr<Model>&
 	auto refModel = std::make_shared<RefModel>();
 	refModel->model = node.getModel();
 	refModel->ref_model_index = static_cast<int>(mRefModels.size());
-	refModel->transforms.push_back(&node.getTRS());
 	refModel->model_matrix *= node.getTRS().getMatrix(std::fmod(mAnimationTime, mAnimationCycleTime));
+	refModel->transform_node = addTransformNode(&node.getTRS(), -1, false, refModel->model_matrix);
+	retainTransformNode(refModel->transform_node);
 	for (const auto& me : *refModel->model) {
 		addMaterial(me->getMaterial());
 		auto refMesh = std::make_shared<RefMesh>();
 		refMesh->mesh = me;
 		refModel->refMeshes.push_back(refMesh);
 	}
-	mRefModels.emplace_back(refModel);
+	refModel->handle = mRefModels.insert(refModel);
+	mAssetRefCount[refModel->model.get()]++;
 
 	mSelection.reference = refModel;
 	mNewlyAddedRef.emplace_back(refModel);
@@ -230,54 +244,74 @@ std::shared_ptr<RefModel> RenderScene::addModelRef(const std::shared_ptr<Model>&
 
 void RenderScene::removeModel(std::shared_ptr<RefModel> const& aRefModel)
 {
-	const auto it = std::find(mRefModels.begin(), mRefModels.end(), aRefModel);
-	if (it != mRefModels.end())
-	{
-		mRefModels.erase(it);
-		mNewlyRemovedRef.push_back(aRefModel);
-		for (uint32_t i = 0; i < mRefModels.size(); i++) mRefModels[i]->ref_model_index = static_cast<int>(i);
+	const auto* stored = mRefModels.get(aRefModel->handle);
+	if (!stored || *stored != aRefModel) return;
 
-		
-		const auto* modelPtr = aRefModel->model.get();
-		uint32_t count = 0;
-		for (const auto& refModel : mRefModels) if (modelPtr == refModel->model.get()) count++;
-		if(count == 0) {
-			const auto it2 = std::find(mModels.begin(), mModels.end(), aRefModel->model);
-			if (it2 != mModels.end()) {
-				mNewlyRemovedAsset.push_back(aRefModel->model);
-				mModels.erase(it2);
-			}
-		}
+	const uint32_t moved = mRefModels.erase(aRefModel->handle);
+	if (moved < mRefModels.size()) mRefModels[moved]->ref_model_index = static_cast<int>(moved);
+	aRefModel->ref_model_index = -1;
+	releaseTransformNode(aRefModel->transform_node);
+	aRefModel->transform_node = -1;
+	mNewlyRemovedRef.push_back(aRefModel);
 
-		mUpdateRequests.mModelInstances = true;
-		mUpdateRequests.mModelGeometries = true;
-		for (const auto mesh : *aRefModel->model) mUpdateRequests.mLights |= mesh->getMaterial()->isLight();
+	
+	const auto count = mAssetRefCount.find(aRefModel->model.get());
+	if (count != mAssetRefCount.end() && --count->second == 0) {
+		mAssetRefCount.erase(count);
+		const auto it = std::find(mModels.begin(), mModels.end(), aRefModel->model);
+		if (it != mModels.end()) {
+			mNewlyRemovedAsset.push_back(aRefModel->model);
+			mModels.erase(it);
+		}
 	}
+
+	mUpdateRequests.mModelInstances = true;
+	mUpdateRequests.mModelGeometries = true;
+	for (const auto mesh : *aRefModel->model) mUpdateRequests.mLights |= mesh->getMaterial()->isLight();
 }
 
 void RenderScene::removeLight(const std::shared_ptr<RefLight>& aRefLight)
 {
-	const auto it = std::find(mRefLights.begin(), mRefLights.end(), aRefLight);
-	if (it != mRefLights.end())
-	{
-		mRefLights.erase(it);
-		mNewlyRemovedRef.push_back(aRefLight);
-		for (uint32_t i = 0; i < mRefLights.size(); i++) mRefLights[i]->ref_light_index = static_cast<int>(i);
+	const auto* stored = mRefLights.get(aRefLight->handle);
+	if (!stored || *stored != aRefLight) return;
 
-		
-		const auto* lightPtr = aRefLight->light.get();
-		uint32_t count = 0;
-		for (const auto& refLight : mRefLights) if (lightPtr == refLight->light.get()) count++;
-		if (count == 0) {
-			const auto it2 = std::find(mLights.begin(), mLights.end(), aRefLight->light);
-			if (it2 != mLights.end()) {
-				mNewlyRemovedAsset.push_back(aRefLight->light);
-				mLights.erase(it2);
-			}
-		}
+	const uint32_t moved = mRefLights.erase(aRefLight->handle);
+	if (moved < mRefLights.size()) mRefLights[moved]->ref_light_index = static_cast<int>(moved);
+	aRefLight->ref_light_index = -1;
+	releaseTransformNode(aRefLight->transform_node);
+	aRefLight->transform_node = -1;
+	mNewlyRemovedRef.push_back(aRefLight);
 
-		mUpdateRequests.mLights = true;
+	
+	const auto count = mAssetRefCount.find(aRefLight->light.get());
+	if (count != mAssetRefCount.end() && --count->second == 0) {
+		mAssetRefCount.erase(count);
+		const auto it = std::find(mLights.begin(), mLights.end(), aRefLight->light);
+		if (it != mLights.end()) {
+			mNewlyRemovedAsset.push_back(aRefLight->light);
+			mLights.erase(it);
+		}
 	}
+
+	mUpdateRequests.mLights = true;
+}
+
+std::shared_ptr<RefModel> RenderScene::getModelRef(const SlotHandle aHandle) const
+{
+	const auto* ref = mRefModels.get(aHandle);
+	return ref ? *ref : nullptr;
+}
+
+std::shared_ptr<RefLight> RenderScene::getLightRef(const SlotHandle aHandle) const
+{
+	const auto* ref = mRefLights.get(aHandle);
+	return ref ? *ref : nullptr;
+}
+
+std::shared_ptr<RefCamera> RenderScene::getCameraRef(const SlotHandle aHandle) const
+{
+	const auto* ref = mRefCameras.get(aHandle);
+	return ref ? *ref : nullptr;
 }
 
 void RenderScene::requestImageUpdate()
@@ -301,6 +335,9 @@ void RenderScene::requestLightUpdate()
 void RenderScene::requestCameraUpdate()
 { mUpdateRequests.mCamera = true; }
 
+void RenderScene::requestTransformUpdate()
+{ mTransformsDirty = true; }
+
 void RenderScene::intersect(const glm::vec3 aOrigin, const glm::vec3 aDirection, const IntersectionSettings aSettings, Intersection *aHitInfo) const
 {
 	float t = std::numeric_limits<float>::max();
@@ -406,15 +443,15 @@ void RenderScene::update(const float aMilliseconds)
 	
 	
 	const float relativeTime = std::fmod(mAnimationTime, mAnimationCycleTime);
+	updateTransforms(relativeTime);
+	const auto worldMatrix = [this](const Ref& aRef) -> glm::mat4
+	{ return aRef.transform_node < 0 ? glm::mat4(1.0f) : mTransformNodes[aRef.transform_node].mWorld; };
 	
 	for (const auto& refModel : mRefModels) {
 		
 		if (refModel->animated) {
 			mUpdateRequests.mModelInstances |= true;
-			refModel->model_matrix = glm::mat4(1.0f);
-			for (const TRS *trs : refModel->transforms) {
-				refModel->model_matrix *= trs->getMatrix(relativeTime);
-			}
+			refModel->model_matrix = worldMatrix(*refModel);
 		}
 	}
 	
@@ -422,10 +459,7 @@ void RenderScene::update(const float aMilliseconds)
 		
 		if (refLight->animated) {
 			mUpdateRequests.mLights |= true;
-			refLight->model_matrix = glm::mat4(1);
-			for (const TRS *trs : refLight->transforms) {
-				refLight->model_matrix *= trs->getMatrix(relativeTime);
-			}
+			refLight->model_matrix = worldMatrix(*refLight);
 			refLight->direction = glm::normalize(glm::vec3(refLight->model_matrix * refLight->light->getDefaultDirection()));
 			refLight->position = glm::vec3(refLight->model_matrix * glm::vec4(0, 0, 0, 1));
 		}
@@ -435,10 +469,7 @@ void RenderScene::update(const float aMilliseconds)
 		if (dynamic_cast<RefCameraPrivate&>(*refCamera).default_camera) continue;
 		if (refCamera->animated) {
 			mUpdateRequests.mCamera |= true;
-			refCamera->model_matrix = glm::mat4(1);
-			for (const TRS *trs : refCamera->transforms) {
-				refCamera->model_matrix *= trs->getMatrix(relativeTime);
-			}
+			refCamera->model_matrix = worldMatrix(*refCamera);
 			dynamic_cast<RefCameraPrivate&>(*refCamera).setModelMatrix(refCamera->model_matrix, true);
 		}
 	}
@@ -512,7 +543,7 @@ std::string RenderScene::getSceneFileName()
 { return mSceneFile; }
 
 std::deque<std::shared_ptr<RefCamera>>& RenderScene::getAvailableCameras()
-{ return mRefCameras; }
+{ return mRefCameras.values(); }
 
 RefCamera& RenderScene::getCurrentCamera() const
 {
@@ -553,15 +584,15 @@ Selection& RenderScene::getSelection()
 
 std::deque<std::shared_ptr<RefModel>>& RenderScene::getModelList()
 {
-	return mRefModels;
+	return mRefModels.values();
 }
 
 std::deque<std::shared_ptr<RefLight>>& RenderScene::getLightList()
-{ return mRefLights; }
+{ return mRefLights.values(); }
 
 std::deque<std::shared_ptr<RefCamera>>& RenderScene::getCameraList()
 {
-	return mRefCameras;
+	return mRefCameras.values();
 }
 
 float RenderScene::getCurrentTime() const
@@ -571,14 +602,15 @@ float RenderScene::getCycleTime() const
 { return mAnimationCycleTime; }
 
 SceneBackendData RenderScene::getSceneData()
-{ return { mImages, mTextures, mModels, mMaterials, mRefModels, mRefLights, mRefCameras }; }
+{ return { mImages, mTextures, mModels, mMaterials, mRefModels.values(), mRefLights.values(), mRefCameras.values() }; }
 
 io::SceneData RenderScene::getSceneInfo()
 {
 	
-	for (const auto& refLight : mRefLights) refLight->updateSceneGraphNodesFromModelMatrix();
-	for (const auto& refCamera : mRefCameras) refCamera->updateSceneGraphNodesFromModelMatrix(refCamera->y_flipped);
-	for (const auto& refModel : mRefModels) refModel->updateSceneGraphNodesFromModelMatrix();
+	for (const auto& refLight : mRefLights) refLight->updateSceneGraphNodesFromModelMatrix(getTransforms(*refLight));
+	for (const auto& refCamera : mRefCameras) refCamera->updateSceneGraphNodesFromModelMatrix(getTransforms(*refCamera), refCamera->y_flipped);
+	for (const auto& refModel : mRefModels) refModel->updateSceneGraphNodesFromModelMatrix(getTransforms(*refModel));
+	requestTransformUpdate();
 
 	io::SceneData si = {};
 	si.mCycleTime = mAnimationCycleTime;
@@ -606,6 +638,7 @@ void RenderScene::filterSceneInfo(io::SceneData& aSceneInfo)
 				aSceneInfo.mModels.emplace_back(m);
 			}
 			else {
+				// the copied meshes share vertices and indices with the original until one of them is modified
 				auto copiedModel = std::make_shared<Model>(*aNode->getModel());
 				aSceneInfo.mModels.emplace_back(copiedModel);
 				aNode->setModel(copiedModel);
@@ -655,17 +688,74 @@ void RenderScene::filterSceneInfo(io::SceneData& aSceneInfo)
 	}
 }
 
-void RenderScene::traverseSceneGraph(Node& aNode, glm::mat4 aMatrix, const bool aAnimatedPath) {
+int RenderScene::addTransformNode(TRS* aTrs, const int aParent, const bool aAnimated, const glm::mat4& aWorld)
+{
+	uint32_t index;
+	// a free node is only reused if it keeps the parent in front of it
+	if (!mFreeTransformNodes.empty() && static_cast<int>(mFreeTransformNodes.back()) > aParent) {
+		index = mFreeTransformNodes.back();
+		mFreeTransformNodes.pop_back();
+		mTransformNodes[index] = { aTrs, aParent, 0, aWorld };
+	}
+	else {
+		index = static_cast<uint32_t>(mTransformNodes.size());
+		mTransformNodes.push_back({ aTrs, aParent, 0, aWorld });
+	}
+	retainTransformNode(aParent);
+	if (aAnimated) mAnimatedTransformNodes.push_back(index);
+	return static_cast<int>(index);
+}
+
+void RenderScene::retainTransformNode(const int aIndex)
+{
+	if (aIndex >= 0) mTransformNodes[aIndex].mUsers++;
+}
+
+void RenderScene::releaseTransformNode(int aIndex)
+{
+	while (aIndex >= 0 && --mTransformNodes[aIndex].mUsers == 0) {
+		TransformNode& node = mTransformNodes[aIndex];
+		const int parent = node.mParent;
+		node.mTrs = nullptr;
+		node.mParent = -1;
+		std::erase(mAnimatedTransformNodes, static_cast<uint32_t>(aIndex));
+		mFreeTransformNodes.push_back(static_cast<uint32_t>(aIndex));
+		aIndex = parent;
+	}
+}
+
+std::vector<TRS*> RenderScene::getTransforms(const Ref& aRef) const
+{
+	std::vector<TRS*> transforms;
+	for (int index = aRef.transform_node; index >= 0; index = mTransformNodes[index].mParent) transforms.push_back(mTransformNodes[index].mTrs);
+	std::reverse(transforms.begin(), transforms.end());
+	return transforms;
+}
+
+void RenderScene::updateTransforms(const float aTime)
+{
+	// parents are stored before their children, so a single pass in order is enough
+	const auto update = [this, aTime](TransformNode& aNode)
+	{
+		const glm::mat4 parent = aNode.mParent < 0 ? glm::mat4(1.0f) : mTransformNodes[aNode.mParent].mWorld;
+		aNode.mWorld = parent * aNode.mTrs->getMatrix(aTime);
+	};
+	if (mTransformsDirty) {
+		for (TransformNode& node : mTransformNodes) if (node.mTrs) update(node);
+		mTransformsDirty = false;
+	}
+	else for (const uint32_t index : mAnimatedTransformNodes) update(mTransformNodes[index]);
+}
+
+void RenderScene::traverseSceneGraph(Node& aNode, glm::mat4 aMatrix, const bool aAnimatedPath, int aTransformNode) {
 	const bool animated_node = aAnimatedPath || aNode.hasAnimation();
 	
 	static std::deque<Node*> nodeHistory;
 	nodeHistory.push_back(&aNode);
 	
-	static std::deque<TRS*> trsHistory;
 	if (aNode.hasLocalTransform()) {
-		trsHistory.push_back(&aNode.getTRS());
-		
-		aMatrix *= trsHistory.back()->getMatrix(std::fmod(mAnimationTime, mAnimationCycleTime));
+		aMatrix *= aNode.getTRS().getMatrix(std::fmod(mAnimationTime, mAnimationCycleTime));
+		aTransformNode = addTransformNode(&aNode.getTRS(), aTransformNode, animated_node, aMatrix);
 	}
 	
 	if (aNode.hasModel()) {
@@ -674,13 +764,15 @@ void RenderScene::traverseSceneGraph(Node& aNode, glm::mat4 aMatrix, const bool
 		refModel->ref_model_index = static_cast<int>(mRefModels.size());
 		refModel->model_matrix = aMatrix;
 		refModel->animated = animated_node;
-		refModel->transforms = trsHistory;
+		refModel->transform_node = aTransformNode;
+		retainTransformNode(aTransformNode);
 		for (const auto& me : *refModel->model) {
 			auto refMesh = std::make_shared<RefMesh>();
 			refMesh->mesh = me;
 			refModel->refMeshes.push_back(refMesh);
 		}
-		mRefModels.emplace_back(std::move(refModel));
+		mAssetRefCount[refModel->model.get()]++;
+		refModel->handle = mRefModels.insert(refModel);
 	}
 	
 	if (aNode.hasCamera()) {
@@ -689,8 +781,9 @@ void RenderScene::traverseSceneGraph(Node& aNode, glm::mat4 aMatrix, const bool
 		refCamera->camera = aNode.getCamera();
 		refCamera->ref_camera_index = static_cast<int>(mRefCameras.size());
 		refCamera->animated = animated_node;
-		refCamera->transforms = trsHistory;
-		mRefCameras.emplace_back(std::move(refCamera));
+		refCamera->transform_node = aTransformNode;
+		retainTransformNode(aTransformNode);
+		refCamera->handle = mRefCameras.insert(refCamera);
 	}
 	
 	if (aNode.hasLight()) {
@@ -703,16 +796,16 @@ void RenderScene::traverseSceneGraph(Node& aNode, glm::mat4 aMatrix, const bool
 		refLight->position = glm::vec3(pos);
 		refLight->model_matrix = aMatrix;
 		refLight->animated = animated_node;
-		refLight->transforms = trsHistory;
-		mRefLights.emplace_back(std::move(refLight));
+		refLight->transform_node = aTransformNode;
+		retainTransformNode(aTransformNode);
+		mAssetRefCount[refLight->light.get()]++;
+		refLight->handle = mRefLights.insert(refLight);
 	}
 	
 	for (auto& n : aNode) {
-		traverseSceneGraph(*n, aMatrix, animated_node);
+		traverseSceneGraph(*n, aMatrix, animated_node, aTransformNode);
 	}
 	
-	if (aNode.hasLocalTransform()) trsHistory.pop_back();
-	
 	nodeHistory.pop_back();
 }
 
@@ -1,5 +1,7 @@
 #include <tamashii/core/topology/topology.hpp>
 #include <tamashii/core/scene/model.hpp>
+#include <tamashii/core/common/vars.hpp>
+#include <tamashii/core/common/thread_pool.hpp>
 
 
 T_USE_NAMESPACE
@@ -20,3 +22,80 @@ void topology::calcStarkTangents(Mesh* aMesh)
 	}
 	aMesh->hasTangents(true);
 }
+
+topology::TangentMethod topology::selectTangentMethod(const bool aNeedsExact)
+{
+	const std::string& method = var::tangent_method.value();
+	if (method == "fast") return TangentMethod::FAST;
+	if (method == "auto") return aNeedsExact ? TangentMethod::MIKKTSPACE : TangentMethod::FAST;
+	if (method != "mikktspace") spdlog::warn("Tangents: unknown tangent_method '{}', using mikktspace", method);
+	return TangentMethod::MIKKTSPACE;
+}
+
+void topology::calcTangents(Mesh* aMesh, const bool aNeedsExact)
+{
+	if (aMesh->getTopology() != Mesh::Topology::TRIANGLE_LIST) return;
+	if (!aMesh->hasTexCoords0()) {
+		calcStarkTangents(aMesh);
+		return;
+	}
+	if (selectTangentMethod(aNeedsExact) == TangentMethod::MIKKTSPACE) calcMikkTSpaceTangents(aMesh);
+	else calcFastTangents(aMesh);
+}
+
+void topology::calcFastTangents(Mesh* aMesh)
+{
+	if (aMesh->getTopology() != Mesh::Topology::TRIANGLE_LIST)
+	{
+		spdlog::error("FastTangents: currently only implemented for TRIANGLE_LIST");
+		return;
+	}
+
+	vertex_s* vertices = aMesh->getVerticesArray();
+	const uint32_t* indices = aMesh->hasIndices() ? std::as_const(*aMesh).getIndicesArray() : nullptr;
+	const size_t vertexCount = aMesh->getVertexCount();
+	const size_t faceCount = aMesh->getPrimitiveCount();
+
+	// uv gradients of every triangle, not normalized so larger triangles weigh more
+	std::vector<glm::vec3> tangents(vertexCount, glm::vec3(0));
+	std::vector<glm::vec3> bitangents(vertexCount, glm::vec3(0));
+	for (size_t f = 0; f < faceCount; f++) {
+		uint32_t idx[3];
+		for (uint32_t i = 0; i < 3; i++) idx[i] = indices ? indices[f * 3 + i] : static_cast<uint32_t>(f * 3 + i);
+		const vertex_s& v0 = vertices[idx[0]];
+		const vertex_s& v1 = vertices[idx[1]];
+		const vertex_s& v2 = vertices[idx[2]];
+		const glm::vec3 e1 = glm::vec3(v1.position - v0.position);
+		const glm::vec3 e2 = glm::vec3(v2.position - v0.position);
+		const glm::vec2 d1 = v1.texture_coordinates_0 - v0.texture_coordinates_0;
+		const glm::vec2 d2 = v2.texture_coordinates_0 - v0.texture_coordinates_0;
+		const float det = d1.x * d2.y - d2.x * d1.y;
+		if (det == 0.0f) continue;
+		const float r = 1.0f / det;
+		const glm::vec3 t = (e1 * d2.y - e2 * d1.y) * r;
+		const glm::vec3 b = (e2 * d1.x - e1 * d2.x) * r;
+		for (const uint32_t i : idx) {
+			tangents[i] += t;
+			bitangents[i] += b;
+		}
+	}
+
+	auto finalize = [&](const size_t aIdx) {
+		vertex_s& v = vertices[aIdx];
+		const glm::vec3 n = glm::vec3(v.normal);
+		glm::vec3 t = tangents[aIdx] - n * glm::dot(n, tangents[aIdx]);
+		const float len = glm::length(t);
+		if (!(len > 0.0f)) {
+			v.tangent = { calcStarkTangent(n), 1 };
+			return;
+		}
+		t /= len;
+		const float sign = glm::dot(glm::cross(n, t), bitangents[aIdx]) < 0.0f ? -1.0f : 1.0f;
+		v.tangent = { t, sign };
+	};
+	constexpr size_t chunk = 4096;
+	ThreadPool::getInstance().parallelFor(0, (vertexCount + chunk - 1) / chunk, [&](const size_t aChunk) {
+		for (size_t i = aChunk * chunk; i < std::min(vertexCount, (aChunk + 1) * chunk); i++) finalize(i);
+	});
+	aMesh->hasTangents(true);
+}
@@ -30,7 +30,7 @@ void topology::calcSmoothNormals(Mesh* aMesh)
 	}
 
 	vertex_s* vertices = aMesh->getVerticesArray();
-	const uint32_t* indices = aMesh->getIndicesArray();
+	const uint32_t* indices = std::as_const(*aMesh).getIndicesArray();
 	std::vector<std::deque<glm::vec3>> normals;
 	normals.resize(aMesh->getVertexCount());
 	for (uint32_t i = 0; i < aMesh->getIndexCount(); i += 3) {
@@ -1,20 +1,39 @@
 #include <tamashii/core/topology/topology.hpp>
 #include <mikktspace.h>
 #include <tamashii/core/scene/model.hpp>
+#include <tamashii/core/common/vars.hpp>
+#include <tamashii/core/common/thread_pool.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
 
 T_BEGIN_NAMESPACE
 class MikkTSpaceTangents {
 
 public:
+    // a set of triangles of one mesh, the callbacks read the raw arrays instead of going through the mesh
+    struct Job {
+        vertex_s*               mVertices;
+        const uint32_t*         mIndices;   // nullptr for meshes without indices
+        const uint32_t*         mFaces;     // nullptr if face i of the job is triangle i of the mesh
+        int                     mFaceCount;
+    };
+
     MikkTSpaceTangents();
     void calculate(Mesh* aMesh);
 
 private:
+    void run(Job& aJob);
+    static std::vector<std::vector<uint32_t>> splitComponents(const Mesh* aMesh);
 
     SMikkTSpaceInterface iface{};
-    SMikkTSpaceContext mContext{};
 
-    static int get_vertex_index(const SMikkTSpaceContext* aContext, int iFace, int iVert);
+    static uint32_t get_vertex_index(const Job* aJob, int iFace, int iVert);
 
     static int get_num_faces(const SMikkTSpaceContext* aContext);
     static int get_num_vertices_of_face(const SMikkTSpaceContext* aContext, int iFace);
@@ -56,94 +75,171 @@ MikkTSpaceTangents::MikkTSpaceTangents()
     iface.m_getPosition = get_position;
     iface.m_getTexCoord = get_tex_coords;
     iface.m_setTSpaceBasic = set_tspace_basic;
-
-    mContext.m_pInterface = &iface;
 }
 
 void MikkTSpaceTangents::calculate(Mesh* aMesh) {
-    mContext.m_pUserData = aMesh;
-
-    genTangSpaceDefault(&this->mContext);
+    vertex_s* vertices = aMesh->getVerticesArray();
+    const uint32_t* indices = aMesh->hasIndices() ? std::as_const(*aMesh).getIndicesArray() : nullptr;
+    const size_t faceCount = aMesh->getPrimitiveCount();
+
+    const uint32_t splitSize = tamashii::var::tangent_split_size.value();
+    std::vector<std::vector<uint32_t>> batches;
+    if (splitSize && faceCount > splitSize && ThreadPool::getInstance().threadCount() > 1) batches = splitComponents(aMesh);
+
+    if (batches.size() <= 1) {
+        Job job{ vertices, indices, nullptr, static_cast<int>(faceCount) };
+        run(job);
+    } else {
+        ThreadPool::getInstance().parallelFor(0, batches.size(), [&](const size_t aIdx) {
+            Job job{ vertices, indices, batches[aIdx].data(), static_cast<int>(batches[aIdx].size()) };
+            run(job);
+        });
+    }
     aMesh->hasTangents(true);
 }
 
-int MikkTSpaceTangents::get_num_faces(const SMikkTSpaceContext* aContext) {
-	const Mesh* working_mesh = static_cast<Mesh*> (aContext->m_pUserData);
+void MikkTSpaceTangents::run(Job& aJob) {
+    SMikkTSpaceContext context{};
+    context.m_pInterface = &iface;
+    context.m_pUserData = &aJob;
+    genTangSpaceDefault(&context);
+}
+
+// MikkTSpace only shares tangents between corners with identical position, normal and uv, so triangles that are not
+// connected through such welded vertices are independent. Different components never write to the same vertex, since
+// a shared index always means a shared welded vertex. The components are packed into a few batches of similar size.
+std::vector<std::vector<uint32_t>> MikkTSpaceTangents::splitComponents(const Mesh* aMesh) {
+    using Key = std::array<float, 8>;
+    struct KeyHash {
+        size_t operator()(const Key& aKey) const {
+            size_t h = 0;
+            for (const float f : aKey) {
+                uint32_t bits;
+                std::memcpy(&bits, &f, sizeof(float));
+                h ^= std::hash<uint32_t>()(bits) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            }
+            return h;
+        }
+    };
+
+    const vertex_s* vertices = aMesh->getVerticesArray();
+    const size_t vertexCount = aMesh->getVertexCount();
+    const size_t faceCount = aMesh->getPrimitiveCount();
+    const uint32_t* indices = aMesh->hasIndices() ? aMesh->getIndicesArray() : nullptr;
+
+    // + 0.0f turns -0 into +0, MikkTSpace compares with ==
+    std::vector<uint32_t> weld(vertexCount);
+    std::unordered_map<Key, uint32_t, KeyHash> welded;
+    welded.reserve(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        const vertex_s& v = vertices[i];
+        const Key key = { v.position.x + 0.0f, v.position.y + 0.0f, v.position.z + 0.0f, v.normal.x + 0.0f, v.normal.y + 0.0f,
+            v.normal.z + 0.0f, v.texture_coordinates_0.x + 0.0f, v.texture_coordinates_0.y + 0.0f };
+        weld[i] = welded.try_emplace(key, static_cast<uint32_t>(welded.size())).first->second;
+    }
+
+    std::vector<uint32_t> parent(welded.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](uint32_t aX) {
+        while (parent[aX] != aX) aX = parent[aX] = parent[parent[aX]];
+        return aX;
+    };
+    auto corner = [indices, &weld](const size_t aFace, const size_t aVert) {
+        const size_t c = aFace * 3 + aVert;
+        return weld[indices ? indices[c] : c];
+    };
+    for (size_t f = 0; f < faceCount; f++) {
+        const uint32_t r0 = find(corner(f, 0));
+        const uint32_t r1 = find(corner(f, 1));
+        const uint32_t r2 = find(corner(f, 2));
+        parent[r1] = r0;
+        parent[find(r2)] = r0;
+    }
+
+    std::unordered_map<uint32_t, uint32_t> rootToComponent;
+    std::vector<std::vector<uint32_t>> components;
+    for (size_t f = 0; f < faceCount; f++) {
+        const auto [it, inserted] = rootToComponent.try_emplace(find(corner(f, 0)), static_cast<uint32_t>(components.size()));
+        if (inserted) components.emplace_back();
+        components[it->second].push_back(static_cast<uint32_t>(f));
+    }
+    if (components.size() <= 1) return {};
+
+    // largest components first, each goes to the currently smallest batch
+    const size_t batchCount = std::min(components.size(), static_cast<size_t>(ThreadPool::getInstance().threadCount()) * 4);
+    std::sort(components.begin(), components.end(), [](const auto& aA, const auto& aB) { return aA.size() > aB.size(); });
+    std::vector<std::vector<uint32_t>> batches(batchCount);
+    using Load = std::pair<size_t, size_t>;
+    std::priority_queue<Load, std::vector<Load>, std::greater<>> loads;
+    for (size_t i = 0; i < batchCount; i++) loads.emplace(0, i);
+    for (std::vector<uint32_t>& c : components) {
+        auto [load, idx] = loads.top();
+        loads.pop();
+        std::vector<uint32_t>& batch = batches[idx];
+        if (batch.empty()) batch = std::move(c);
+        else batch.insert(batch.end(), c.begin(), c.end());
+        loads.emplace(batch.size(), idx);
+    }
+    return batches;
+}
 
-    const int i_size = static_cast<int>(working_mesh->getPrimitiveCount());
-    return i_size;
+int MikkTSpaceTangents::get_num_faces(const SMikkTSpaceContext* aContext) {
+    return static_cast<const Job*>(aContext->m_pUserData)->mFaceCount;
 }
 
 int MikkTSpaceTangents::get_num_vertices_of_face(const SMikkTSpaceContext* aContext,
     const int iFace) {
-	const Mesh* working_mesh = static_cast<Mesh*> (aContext->m_pUserData);
-
-    if (working_mesh->getTopology() == Mesh::Topology::TRIANGLE_LIST) {
-        return 3;
-    }
-    throw std::logic_error("no vertices with less than 3 and more than 3 supported");
+    return 3;
 }
 
 void MikkTSpaceTangents::get_position(const SMikkTSpaceContext* aContext,
     float* outpos,
     const int iFace, const int iVert) {
+    const Job* job = static_cast<const Job*>(aContext->m_pUserData);
+    const glm::vec4& position = job->mVertices[get_vertex_index(job, iFace, iVert)].position;
 
-    Mesh* workingMesh = static_cast<Mesh*> (aContext->m_pUserData);
-
-    const auto index = get_vertex_index(aContext, iFace, iVert);
-    const auto vertex = workingMesh->getVerticesArray()[index];
-
-    outpos[0] = vertex.position.x;
-    outpos[1] = vertex.position.y;
-    outpos[2] = vertex.position.z;
+    outpos[0] = position.x;
+    outpos[1] = position.y;
+    outpos[2] = position.z;
 }
 
 void MikkTSpaceTangents::get_normal(const SMikkTSpaceContext* aContext,
     float* outnormal,
     const int iFace, const int iVert) {
-    Mesh* workingMesh = static_cast<Mesh*> (aContext->m_pUserData);
+    const Job* job = static_cast<const Job*>(aContext->m_pUserData);
+    const glm::vec4& normal = job->mVertices[get_vertex_index(job, iFace, iVert)].normal;
 
-    const auto index = get_vertex_index(aContext, iFace, iVert);
-    const auto vertex = workingMesh->getVerticesArray()[index];
-
-    outnormal[0] = vertex.normal.x;
-    outnormal[1] = vertex.normal.y;
-    outnormal[2] = vertex.normal.z;
+    outnormal[0] = normal.x;
+    outnormal[1] = normal.y;
+    outnormal[2] = normal.z;
 }
 
 void MikkTSpaceTangents::get_tex_coords(const SMikkTSpaceContext* aContext,
     float* outuv,
     const int iFace, const int iVert) {
-    Mesh* workingMesh = static_cast<Mesh*> (aContext->m_pUserData);
-
-    const auto index = get_vertex_index(aContext, iFace, iVert);
-    const auto vertex = workingMesh->getVerticesArray()[index];
+    const Job* job = static_cast<const Job*>(aContext->m_pUserData);
+    const glm::vec2& uv = job->mVertices[get_vertex_index(job, iFace, iVert)].texture_coordinates_0;
 
-    outuv[0] = vertex.texture_coordinates_0.x;
-    outuv[1] = vertex.texture_coordinates_0.y;
+    outuv[0] = uv.x;
+    outuv[1] = uv.y;
 }
 
 void MikkTSpaceTangents::set_tspace_basic(const SMikkTSpaceContext* aContext,
     const float* tangentu,
     const float fSign, const int iFace, const int iVert) {
-    Mesh* workingMesh = static_cast<Mesh*> (aContext->m_pUserData);
+    const Job* job = static_cast<const Job*>(aContext->m_pUserData);
+    glm::vec4& tangent = job->mVertices[get_vertex_index(job, iFace, iVert)].tangent;
 
-    const auto index = get_vertex_index(aContext, iFace, iVert);
-    auto* vertex = &workingMesh->getVerticesArray()[index];
-
-    vertex->tangent.x = tangentu[0];
-    vertex->tangent.y = tangentu[1];
-    vertex->tangent.z = tangentu[2];
-    vertex->tangent.w = fSign;
+    tangent.x = tangentu[0];
+    tangent.y = tangentu[1];
+    tangent.z = tangentu[2];
+    tangent.w = fSign;
 }
 
-int MikkTSpaceTangents::get_vertex_index(const SMikkTSpaceContext* aContext, const int iFace, const int iVert) {
-    Mesh* workingMesh = static_cast<Mesh*> (aContext->m_pUserData);
-
-    const auto faceSize = get_num_vertices_of_face(aContext, iFace);
-
-    const auto indicesIndex = (iFace * faceSize) + iVert;
+uint32_t MikkTSpaceTangents::get_vertex_index(const Job* aJob, const int iFace, const int iVert) {
+    const uint32_t face = aJob->mFaces ? aJob->mFaces[iFace] : static_cast<uint32_t>(iFace);
+    const uint32_t indicesIndex = face * 3 + static_cast<uint32_t>(iVert);
 
-    if (workingMesh->hasIndices()) return workingMesh->getIndicesArray()[indicesIndex];
+    if (aJob->mIndices) return aJob->mIndices[indicesIndex];
     else return indicesIndex;
 }
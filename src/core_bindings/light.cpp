@@ -57,12 +57,7 @@ bool python::Light::isAttached() const
     }
 
     checkValidity();
-    const auto& lightList = Common::getInstance().getRenderSystem()->getMainScene()->getLightList();
-    for (const auto& l : lightList)
-    {
-        if (l == lightRef) return true;
-    }
-    return false;
+    return Common::getInstance().getRenderSystem()->getMainScene()->getLightRef(lightRef->handle) == lightRef;
 }
 
 const RefLight& python::Light::refLight() const {
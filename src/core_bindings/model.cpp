@@ -120,12 +120,7 @@ bool python::Model::isAttached() const
     }
 
     checkValidity();
-    const auto& modelList = Common::getInstance().getRenderSystem()->getMainScene()->getModelList();
-    for (const auto& m : modelList)
-    {
-        if (m == modelRef) return true;
-    }
-    return false;
+    return Common::getInstance().getRenderSystem()->getMainScene()->getModelRef(modelRef->handle) == modelRef;
 }
 
 const RefModel& python::Model::refModel() const
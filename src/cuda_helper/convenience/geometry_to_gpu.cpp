@@ -56,13 +56,13 @@ void GeometryDataCuda::loadScene(const tamashii::scene_s aScene)
 					mMeshToBOffset.insert(std::pair(mesh, offsets));
 					
 					if (mesh->hasIndices()) {
-						cudaMemcpy(mIndexBuffer, offsets.mIndexByteOffset + mesh->getIndicesArray(), mesh->getIndexCount() * sizeof(uint32_t), cudaMemcpyHostToDevice);
+						cudaMemcpy(mIndexBuffer, offsets.mIndexByteOffset + std::as_const(*mesh).getIndicesArray(), mesh->getIndexCount() * sizeof(uint32_t), cudaMemcpyHostToDevice);
 						offsets.mIndexOffset += mesh->getIndexCount();
 						offsets.mIndexByteOffset += mesh->getIndexCount() * sizeof(uint32_t);
 						if (offsets.mIndexOffset > mMaxIndexCount) spdlog::error("Indices count > buffer size");
 					}
 					
-					cudaMemcpy(mVertexBuffer, offsets.mVertexByteOffset + mesh->getVerticesArray(), mesh->getVertexCount() * sizeof(vertex_s), cudaMemcpyHostToDevice);
+					cudaMemcpy(mVertexBuffer, offsets.mVertexByteOffset + std::as_const(*mesh).getVerticesArray(), mesh->getVertexCount() * sizeof(vertex_s), cudaMemcpyHostToDevice);
 					offsets.mVertexOffset += mesh->getVertexCount();
 					offsets.mVertexByteOffset += mesh->getVertexCount() * sizeof(vertex_s);
 					if (offsets.mVertexOffset > mMaxVertexCount) spdlog::error("Vertices count > buffer size");
@@ -150,6 +150,7 @@ void DefaultPathTracer::prepare(RenderInfo_s& aRenderInfo) {
 		frameData.globalDescriptor.addStorageBuffer(GLOBAL_DESC_VERTEX_BUFFER_BINDING, rvk::Shader::Stage::RAYGEN | rvk::Shader::Stage::ANY_HIT);
 		frameData.globalDescriptor.addStorageBuffer(GLOBAL_DESC_MATERIAL_BUFFER_BINDING, rvk::Shader::Stage::RAYGEN | rvk::Shader::Stage::ANY_HIT);
 		frameData.globalDescriptor.addStorageBuffer(GLSL_GLOBAL_LIGHT_DATA_BINDING, rvk::Shader::Stage::RAYGEN | rvk::Shader::Stage::INTERSECTION);
+		frameData.globalDescriptor.addStorageBuffer(GLSL_GLOBAL_LIGHT_TREE_BINDING, rvk::Shader::Stage::RAYGEN);
 		frameData.globalDescriptor.addAccelerationStructureKHR(GLOBAL_DESC_AS_BINDING, rvk::Shader::Stage::RAYGEN);
 		frameData.globalDescriptor.addStorageImage(GLSL_GLOBAL_RT_OUT_IMAGE_BINDING, rvk::Shader::Stage::RAYGEN);
 		frameData.globalDescriptor.addStorageImage(GLSL_GLOBAL_RT_ACC_IMAGE_BINDING, rvk::Shader::Stage::RAYGEN);
@@ -160,6 +161,7 @@ void DefaultPathTracer::prepare(RenderInfo_s& aRenderInfo) {
 		frameData.globalDescriptor.setBuffer(GLOBAL_DESC_UBO_BINDING, &frameData.globalUniformBuffer);
 		frameData.globalDescriptor.setBuffer(GLOBAL_DESC_MATERIAL_BUFFER_BINDING, mGpuMd.getMaterialBuffer());
 		frameData.globalDescriptor.setBuffer(GLSL_GLOBAL_LIGHT_DATA_BINDING, mGpuLd.getLightBuffer());
+		frameData.globalDescriptor.setBuffer(GLSL_GLOBAL_LIGHT_TREE_BINDING, mGpuLd.getLightTreeBuffer());
 		frameData.globalDescriptor.setImage(GLSL_GLOBAL_RT_OUT_IMAGE_BINDING, &frameData.rtImage);
 		frameData.globalDescriptor.setImage(GLSL_GLOBAL_RT_ACC_IMAGE_BINDING, &mData->rtImageAccumulate);
 		frameData.globalDescriptor.setImage(GLSL_GLOBAL_RT_ACC_C_IMAGE_BINDING, &mData->rtImageAccumulateCount);
@@ -243,6 +245,7 @@ void DefaultPathTracer::sceneLoad(SceneBackendData aScene) {
 		mFrameData[idx].globalDescriptor.setAccelerationStructureKHR(GLOBAL_DESC_AS_BINDING, mGpuTlas[idx].getTlas());
 		mFrameData[idx].globalDescriptor.update();
 	}
+	mGpuBlas.bufferChanged();
 
 	
 	mGlobalUbo.shade = !aScene.refLights.empty();
@@ -329,6 +332,15 @@ void DefaultPathTracer::drawView(ViewDef_s* aViewDef) {
 		SingleTimeCommand stc = mRoot.singleTimeCommand();
 		mGpuLd.update(&stc, aViewDef->scene, &mGpuTd, &mGpuBlas);
 	}
+	// the index and vertex buffer are replaced when they had to grow
+	if (mGpuBlas.bufferChanged()) {
+		mRoot.device.waitIdle();
+		for (uint32_t idx = 0; idx < mRoot.frameCount(); idx++) {
+			mFrameData[idx].globalDescriptor.setBuffer(GLOBAL_DESC_INDEX_BUFFER_BINDING, mGpuBlas.getIndexBuffer());
+			mFrameData[idx].globalDescriptor.setBuffer(GLOBAL_DESC_VERTEX_BUFFER_BINDING, mGpuBlas.getVertexBuffer());
+			mFrameData[idx].globalDescriptor.update();
+		}
+	}
 	if (aViewDef->updates.any() || mRecalculate) {
 		mRecalculate = false;
 		mGlobalUbo.accumulatedFrames = 0;
@@ -367,6 +379,8 @@ void DefaultPathTracer::drawView(ViewDef_s* aViewDef) {
 	mGlobalUbo.size[0] = static_cast<float>(aViewDef->target_size.x); mGlobalUbo.size[1] = static_cast<float>(aViewDef->target_size.y);
 	mGlobalUbo.frameIndex = static_cast<float>(aViewDef->frame_index);
 	mGlobalUbo.light_count = mGpuLd.getLightCount();
+	mGlobalUbo.light_tree_node_count = mGpuLd.getLightTree().getTreeNodeCount();
+	mGlobalUbo.light_tree_infinite_count = mGpuLd.getLightTree().getInfiniteLightCount();
 	
 	if (mGlobalUbo.accumulate) mGlobalUbo.accumulatedFrames += mGlobalUbo.pixelSamplesPerFrame;
 	else mGlobalUbo.accumulatedFrames = mGlobalUbo.pixelSamplesPerFrame;
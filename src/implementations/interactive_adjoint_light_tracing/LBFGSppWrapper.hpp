@@ -2,6 +2,7 @@
 #include "LBFGSpp/LBFGS.h"
 #include "cmaes/CMAMinimizer.h"
 #include "light_trace_opti.hpp"
+#include <tamashii/core/common/profiler.hpp>
 
 template <typename VectorType> 
 class OptimWrapperBase{
@@ -20,9 +21,12 @@ public:
 
     Real			operator()(VectorType& aParams, VectorType& aGrads)
 					{
+						// the time between two evaluations inside optimize is the optimizer step
+						T_PROFILE_SCOPE("evaluate");
 						mSim->forward(aParams, mRadianceBufferOut);
 						Real phi = mSim->backward(aGrads);
 				        ++mEvals;
+						mSim->adaptiveRaysStep(phi < mBestObjectiveValue);
 				        if( phi < mBestObjectiveValue ){
 							mSim->addCurrentStateToHistory(aParams);
 				            mBestObjectiveValue = phi;
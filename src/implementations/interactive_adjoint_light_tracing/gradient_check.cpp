@@ -0,0 +1,294 @@
+#include "gradient_check.hpp"
+#include "light_trace_opti.hpp"
+#include "objectivefunction.hpp"
+#include "parameter.hpp"
+
+#include <tamashii/core/common/thread_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string_view>
+
+T_USE_NAMESPACE
+
+namespace {
+	constexpr double REL_ERROR_FLOOR = 1e-8;
+	// components far below the largest one are judged relative to it, otherwise rounding noise in phi dominates
+	constexpr double REL_ERROR_GRADIENT_SCALE = 1e-2;
+
+	// value of --gradientCheck (as "--gradientCheck value" or "--gradientCheck=value") without a full parse,
+	// so the var callbacks only run once in Common::init when the regular application starts
+	std::string gradientCheckArgument(const int aArgc, char* aArgv[])
+	{
+		constexpr std::string_view option = "--gradientCheck";
+		for (int i = 1; i < aArgc; i++) {
+			const std::string_view arg = aArgv[i];
+			if (!arg.starts_with(option)) continue;
+			if (arg.size() == option.size()) return i + 1 < aArgc ? aArgv[i + 1] : "";
+			if (arg[option.size()] == '=') return std::string(arg.substr(option.size() + 1));
+		}
+		return "";
+	}
+
+	double millisecondsSince(const std::chrono::high_resolution_clock::time_point aStart)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - aStart).count();
+	}
+
+	std::string jsonNumber(const double aValue)
+	{
+		if (!std::isfinite(aValue)) return "null";
+		std::ostringstream ss;
+		ss << std::setprecision(std::numeric_limits<double>::max_digits10) << aValue;
+		return ss.str();
+	}
+
+	std::string jsonString(const std::string& aValue)
+	{
+		std::string s = "\"";
+		for (const char c : aValue) {
+			if (c == '"' || c == '\\') s += '\\';
+			s += c;
+		}
+		return s + "\"";
+	}
+
+	GradientCheck::Evaluator objectiveEvaluator(const std::shared_ptr<ObjectiveFunction>& aObjective)
+	{
+		return [aObjective](const Eigen::VectorXd& aParams, uint32_t, Eigen::VectorXd* aGradient) {
+			Eigen::VectorXf x = aParams.cast<float>();
+			Eigen::VectorXf dx;
+			const double phi = (*aObjective)(x, dx);
+			if (aGradient) *aGradient = dx.cast<double>();
+			return phi;
+		};
+	}
+
+	// smooth test function of the inner and outer cone angle, pushed through the tanh parameterization
+	GradientCheck::Evaluator coneAngleEvaluator(const bool aEdgeActive)
+	{
+		return [aEdgeActive](const Eigen::VectorXd& aParams, uint32_t, Eigen::VectorXd* aGradient) {
+			ConeAngleTanhParameterization cone;
+			cone.setActiveParams(true, aEdgeActive);
+			double inner = 0.0, outer = 0.0;
+			cone.paramsToValues(aParams[0], aParams[1], inner, outer);
+			const double phi = 0.7 * inner - 0.3 * outer + 0.5 * inner * outer;
+			if (aGradient) {
+				aGradient->resize(2);
+				cone.derivativeChain((*aGradient)[0], (*aGradient)[1], 0.7 + 0.5 * outer, -0.3 + 0.5 * inner, aParams[0], aParams[1]);
+			}
+			return phi;
+		};
+	}
+}
+
+GradientCheck::Report GradientCheck::run(const std::string& aName, const Evaluator& aEvaluator, const Eigen::VectorXd& aParams,
+	const std::vector<Parameter>& aChecked, const Settings& aSettings)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	std::vector<Parameter> checked = aChecked;
+	if (checked.empty()) {
+		for (Eigen::Index k = 0; k < aParams.size(); k++) checked.push_back({ k, "p" + std::to_string(k) });
+	}
+
+	const size_t n = checked.size();
+	const bool central = aSettings.mScheme == Scheme::CENTRAL;
+	const size_t evaluations = 1 + n * (central ? 2 : 1);
+	std::vector<double> phis(evaluations);
+	std::vector<double> milliseconds(evaluations);
+	Eigen::VectorXd gradient;
+
+	// evaluation 0 is the unperturbed one, then +h for every parameter, then -h for the central scheme
+	const auto evaluate = [&](const size_t aIdx) {
+		const auto begin = std::chrono::high_resolution_clock::now();
+		if (aIdx == 0) phis[0] = aEvaluator(aParams, aSettings.mSeed, &gradient);
+		else {
+			Eigen::VectorXd params = aParams;
+			params[checked[(aIdx - 1) % n].mIndex] += aIdx <= n ? aSettings.mStepSize : -aSettings.mStepSize;
+			phis[aIdx] = aEvaluator(params, aSettings.mSeed, nullptr);
+		}
+		milliseconds[aIdx] = millisecondsSince(begin);
+	};
+	if (aSettings.mConcurrent) ThreadPool::getInstance().parallelFor(0, evaluations, evaluate);
+	else for (size_t i = 0; i < evaluations; i++) evaluate(i);
+
+	Report report{ aName, aSettings, phis[0], 0.0, 0.0, 0.0, 0.0, static_cast<uint32_t>(evaluations), true, {} };
+	double gradientNorm = 0.0;
+	double relErrorFloor = REL_ERROR_FLOOR;
+	for (const Parameter& p : checked) {
+		if (p.mIndex < gradient.size()) relErrorFloor = std::max(relErrorFloor, REL_ERROR_GRADIENT_SCALE * std::abs(gradient[p.mIndex]));
+	}
+	for (size_t i = 0; i < n; i++) {
+		const Eigen::Index k = checked[i].mIndex;
+		Entry entry{ checked[i].mName, aParams[k], std::numeric_limits<double>::quiet_NaN(), 0.0, 0.0, 0.0, milliseconds[1 + i] };
+		if (central) {
+			entry.mFdGradient = (phis[1 + i] - phis[1 + n + i]) / (2.0 * aSettings.mStepSize);
+			entry.mMilliseconds += milliseconds[1 + n + i];
+		}
+		else entry.mFdGradient = (phis[1 + i] - phis[0]) / aSettings.mStepSize;
+
+		if (k < gradient.size()) {
+			entry.mGradient = gradient[k];
+			entry.mAbsError = std::abs(entry.mGradient - entry.mFdGradient);
+			entry.mRelError = entry.mAbsError / std::max({ std::abs(entry.mGradient), std::abs(entry.mFdGradient), relErrorFloor });
+			gradientNorm += entry.mGradient * entry.mGradient;
+		}
+		else {
+			entry.mAbsError = entry.mRelError = std::numeric_limits<double>::infinity();
+		}
+		report.mErrorNorm += entry.mAbsError * entry.mAbsError;
+		report.mMaxRelError = std::max(report.mMaxRelError, entry.mRelError);
+		if (!(entry.mRelError <= aSettings.mTolerance)) {
+			report.mPassed = false;
+			spdlog::warn("gradient check {}: {} supplied {} fin.diff {} (rel. error {})", aName, entry.mName, entry.mGradient, entry.mFdGradient, entry.mRelError);
+		}
+		report.mEntries.push_back(entry);
+	}
+	report.mErrorNorm = std::sqrt(report.mErrorNorm);
+	report.mRelErrorNorm = report.mErrorNorm / std::max(std::sqrt(gradientNorm), REL_ERROR_FLOOR);
+	report.mMilliseconds = millisecondsSince(start);
+	spdlog::info("gradient check {}: {} ({} params, {} evaluations, max rel. error {}, {} ms)", aName, report.mPassed ? "passed" : "FAILED",
+		n, evaluations, report.mMaxRelError, report.mMilliseconds);
+	return report;
+}
+
+std::vector<GradientCheck::Report> GradientCheck::runCpuSuite(const Settings& aSettings)
+{
+	constexpr int gridSize = 8;
+	constexpr int channels = 3;
+	const int vertexCount = gridSize * gridSize;
+	std::mt19937 rng(aSettings.mSeed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	Eigen::MatrixXf coords(vertexCount, 3);
+	for (int y = 0; y < gridSize; y++) {
+		for (int x = 0; x < gridSize; x++) {
+			coords.row(y * gridSize + x) = Eigen::Vector3f(static_cast<float>(x), static_cast<float>(y), 0.2f * unit(rng)) / static_cast<float>(gridSize - 1);
+		}
+	}
+	Eigen::MatrixXi elems(2 * (gridSize - 1) * (gridSize - 1), 3);
+	for (int y = 0, e = 0; y < gridSize - 1; y++) {
+		for (int x = 0; x < gridSize - 1; x++) {
+			const int v = y * gridSize + x;
+			elems.row(e++) = Eigen::Vector3i(v, v + 1, v + gridSize + 1);
+			elems.row(e++) = Eigen::Vector3i(v, v + gridSize + 1, v + gridSize);
+		}
+	}
+	Eigen::VectorXf areas = Eigen::VectorXf::Zero(vertexCount);
+	for (int e = 0; e < elems.rows(); e++) {
+		const Eigen::Vector3f a = coords.row(elems(e, 0)), b = coords.row(elems(e, 1)), c = coords.row(elems(e, 2));
+		const float area = 0.5f * (b - a).cross(c - a).norm();
+		for (int i = 0; i < 3; i++) areas[elems(e, i)] += area / 3.0f;
+	}
+
+	const auto random = [&](const float aMin, const float aMax) { return aMin + (aMax - aMin) * unit(rng); };
+	Eigen::VectorXf weights = Eigen::VectorXf::NullaryExpr(vertexCount, [&] { return random(0.5f, 1.0f); });
+	Eigen::VectorXf colors = Eigen::VectorXf::NullaryExpr(vertexCount * 3, [&] { return random(0.2f, 1.0f); });
+	Eigen::VectorXf channelWeights = Eigen::VectorXf::NullaryExpr(channels, [&] { return random(0.5f, 1.5f); });
+	const Eigen::Matrix<float, -1, -1, Eigen::RowMajor> target1 = Eigen::MatrixXf::NullaryExpr(vertexCount, 1, [&] { return random(0.0f, 1.0f); });
+	const Eigen::Matrix<float, -1, -1, Eigen::RowMajor> target3 = Eigen::MatrixXf::NullaryExpr(vertexCount, channels, [&] { return random(0.0f, 1.0f); });
+	const Eigen::VectorXd radiance1 = Eigen::VectorXd::NullaryExpr(vertexCount, [&] { return static_cast<double>(random(0.0f, 1.0f)); });
+	const Eigen::VectorXd radiance3 = Eigen::VectorXd::NullaryExpr(vertexCount * channels, [&] { return static_cast<double>(random(0.0f, 1.0f)); });
+
+	// the objectives are evaluated in float and are quadratic in the radiance, a wide central step is exact up to rounding
+	Settings objectiveSettings = aSettings;
+	objectiveSettings.mScheme = Scheme::CENTRAL;
+	objectiveSettings.mStepSize = std::max(aSettings.mStepSize, 1e-2);
+	objectiveSettings.mConcurrent = true;
+	Settings coneSettings = aSettings;
+	coneSettings.mConcurrent = true;
+
+	std::vector<Report> reports;
+	reports.push_back(run("objective_simple", objectiveEvaluator(std::make_shared<SimpleObjectiveFunction>(weights, areas, target1)),
+		radiance1, {}, objectiveSettings));
+	reports.push_back(run("objective_multi_channel", objectiveEvaluator(std::make_shared<MultiChannelObjectiveFunction>(weights, areas, channelWeights, colors, target3)),
+		radiance3, {}, objectiveSettings));
+	reports.push_back(run("objective_consistent_mass", objectiveEvaluator(std::make_shared<ConsistentMassMultiChannelObjectiveFunction>(weights, elems, coords, channelWeights, colors, target3)),
+		radiance3, {}, objectiveSettings));
+	reports.push_back(run("cone_angle_inner", coneAngleEvaluator(false), Eigen::Vector2d(20.0, 0.0),
+		{ { 0, LightOptParams::name(LightOptParams::CONE_INNER) } }, coneSettings));
+	reports.push_back(run("cone_angle_inner_edge", coneAngleEvaluator(true), Eigen::Vector2d(20.0, -30.0),
+		{ { 0, LightOptParams::name(LightOptParams::CONE_INNER) }, { 1, LightOptParams::name(LightOptParams::CONE_EDGE) } }, coneSettings));
+	return reports;
+}
+
+GradientCheck::Settings GradientCheck::settingsFromVars()
+{
+	Settings settings;
+	settings.mStepSize = static_cast<double>(LightTraceOptimizer::vars::gradientCheckStepSize.value());
+	settings.mTolerance = static_cast<double>(LightTraceOptimizer::vars::gradientCheckTolerance.value());
+	return settings;
+}
+
+std::string GradientCheck::toJson(const std::vector<Report>& aReports)
+{
+	std::ostringstream ss;
+	bool passed = true;
+	ss << "{\n\t\"reports\": [";
+	for (size_t r = 0; r < aReports.size(); r++) {
+		const Report& report = aReports[r];
+		passed &= report.mPassed;
+		ss << (r ? "," : "") << "\n\t\t{\n";
+		ss << "\t\t\t\"name\": " << jsonString(report.mName) << ",\n";
+		ss << "\t\t\t\"scheme\": " << (report.mSettings.mScheme == Scheme::CENTRAL ? "\"central\"" : "\"forward\"") << ",\n";
+		ss << "\t\t\t\"step_size\": " << jsonNumber(report.mSettings.mStepSize) << ",\n";
+		ss << "\t\t\t\"tolerance\": " << jsonNumber(report.mSettings.mTolerance) << ",\n";
+		ss << "\t\t\t\"seed\": " << report.mSettings.mSeed << ",\n";
+		ss << "\t\t\t\"concurrent\": " << (report.mSettings.mConcurrent ? "true" : "false") << ",\n";
+		ss << "\t\t\t\"phi\": " << jsonNumber(report.mPhi) << ",\n";
+		ss << "\t\t\t\"error_norm\": " << jsonNumber(report.mErrorNorm) << ",\n";
+		ss << "\t\t\t\"rel_error_norm\": " << jsonNumber(report.mRelErrorNorm) << ",\n";
+		ss << "\t\t\t\"max_rel_error\": " << jsonNumber(report.mMaxRelError) << ",\n";
+		ss << "\t\t\t\"evaluations\": " << report.mEvaluations << ",\n";
+		ss << "\t\t\t\"milliseconds\": " << jsonNumber(report.mMilliseconds) << ",\n";
+		ss << "\t\t\t\"passed\": " << (report.mPassed ? "true" : "false") << ",\n";
+		ss << "\t\t\t\"parameters\": [";
+		for (size_t e = 0; e < report.mEntries.size(); e++) {
+			const Entry& entry = report.mEntries[e];
+			ss << (e ? "," : "") << "\n\t\t\t\t{ \"name\": " << jsonString(entry.mName) <<
+				", \"value\": " << jsonNumber(entry.mValue) <<
+				", \"gradient\": " << jsonNumber(entry.mGradient) <<
+				", \"fd_gradient\": " << jsonNumber(entry.mFdGradient) <<
+				", \"abs_error\": " << jsonNumber(entry.mAbsError) <<
+				", \"rel_error\": " << jsonNumber(entry.mRelError) <<
+				", \"milliseconds\": " << jsonNumber(entry.mMilliseconds) << " }";
+		}
+		ss << "\n\t\t\t]\n\t\t}";
+	}
+	ss << "\n\t],\n\t\"passed\": " << (passed ? "true" : "false") << "\n}\n";
+	return ss.str();
+}
+
+bool GradientCheck::writeJson(const std::vector<Report>& aReports, const std::string& aFile)
+{
+	std::ofstream file(aFile);
+	if (!file.is_open()) {
+		spdlog::error("gradient check: could not write {}", aFile);
+		return false;
+	}
+	file << toJson(aReports);
+	spdlog::info("gradient check: report written to {}", aFile);
+	return true;
+}
+
+std::optional<int> GradientCheck::runCommandLine(const int aArgc, char* aArgv[])
+{
+	if (gradientCheckArgument(aArgc, aArgv) != "cpu") return std::nullopt;
+	// the application does not start on this path, so this is the only parse
+	try { ccli::parseArgs(aArgc, aArgv); }
+	catch (ccli::CCLIError& e) {
+		spdlog::error("Could not parse command line arguments: {}", e.message());
+		return 1;
+	}
+
+	const std::vector<Report> reports = runCpuSuite(settingsFromVars());
+	const bool written = writeJson(reports, LightTraceOptimizer::vars::gradientCheckOutput.value());
+	const bool passed = std::all_of(reports.begin(), reports.end(), [](const Report& aReport) { return aReport.mPassed; });
+	return written && passed ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+/*
+GradientCheck compares a supplied gradient with a finite difference approximation of the objective.
+Every evaluation of one check uses the same random seed (common random numbers), so the Monte Carlo noise
+of the light tracer largely cancels in the differences. Evaluators that are safe to call concurrently
+have all perturbations evaluated in parallel on the thread pool.
+*/
+class GradientCheck {
+public:
+	enum class Scheme { FORWARD, CENTRAL };
+
+	using Evaluator = std::function<double(const Eigen::VectorXd& aParams, uint32_t aSeed, Eigen::VectorXd* aGradient)>;
+
+	struct Parameter {
+		Eigen::Index mIndex;
+		std::string	mName;
+	};
+
+	struct Settings {
+		Scheme		mScheme;
+		double		mStepSize;
+		double		mTolerance;
+		uint32_t	mSeed;
+		bool		mConcurrent;
+					Settings() : mScheme(Scheme::CENTRAL), mStepSize(1e-4), mTolerance(1e-2), mSeed(0), mConcurrent(false) {}
+	};
+
+	struct Entry {
+		std::string	mName;
+		double		mValue;
+		double		mGradient;
+		double		mFdGradient;
+		double		mAbsError;
+		double		mRelError;
+		double		mMilliseconds;
+	};
+
+	struct Report {
+		std::string	mName;
+		Settings	mSettings;
+		double		mPhi;
+		double		mErrorNorm;
+		double		mRelErrorNorm;
+		double		mMaxRelError;
+		double		mMilliseconds;
+		uint32_t	mEvaluations;
+		bool		mPassed;
+		std::vector<Entry> mEntries;
+	};
+
+					// perturbs the entries listed in aChecked, or every entry of aParams if it is empty
+	static Report	run(const std::string& aName, const Evaluator& aEvaluator, const Eigen::VectorXd& aParams,
+						const std::vector<Parameter>& aChecked, const Settings& aSettings);
+
+					// checks of the cpu side of the gradient chain (objective functions, parameterizations), needs no gpu
+	static std::vector<Report> runCpuSuite(const Settings& aSettings);
+
+	static Settings	settingsFromVars();
+	static std::string toJson(const std::vector<Report>& aReports);
+	static bool		writeJson(const std::vector<Report>& aReports, const std::string& aFile);
+
+					// handles gradientCheck=cpu before any renderer is created, returns the exit code if it ran
+	static std::optional<int> runCommandLine(int aArgc, char* aArgv[]);
+};
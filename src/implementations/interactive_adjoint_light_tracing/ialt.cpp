@@ -4,9 +4,15 @@
 #include <tamashii/core/common/common.hpp>
 #include <tamashii/core/common/vars.hpp>
 #include <tamashii/core/common/input.hpp>
+#include <tamashii/core/io/io.hpp>
+#include <tamashii/core/common/thread_pool.hpp>
 #include <tamashii/core/scene/model.hpp>
 #include "../../../assets/shader/ialt/defines.h"
 
+#include <array>
+#include <chrono>
+#include <future>
+
 T_USE_NAMESPACE
 RVK_USE_NAMESPACE
 
@@ -371,6 +377,8 @@ void InteractiveAdjointLightTracing::sceneLoad(tamashii::SceneBackendData aScene
 	mData->mDescriptorDrawOnMesh.setBuffer(DRAW_DESC_TARGET_RADIANCE_BUFFER_BINDING, mLto.getTargetRadianceBuffer());
 	mData->mDescriptorDrawOnMesh.setBuffer(DRAW_DESC_TARGET_RADIANCE_WEIGHTS_BUFFER_BINDING, mLto.getTargetRadianceWeightsBuffer());
 	mData->mDescriptorDrawOnMesh.update();
+	// the descriptors use the current geometry buffers
+	mData->mGpuBlas.bufferChanged();
 
 	for (uint32_t idx = 0; idx < mRoot.frameCount(); idx++) {
 		VkFrameData& frameData = mFrameData[idx];
@@ -392,6 +400,13 @@ void InteractiveAdjointLightTracing::sceneLoad(tamashii::SceneBackendData aScene
 			aLto->runPredefinedTestCase(ialt, aScene, testname, aRadianceBufferOut);
 		});
 	}
+	if (LightTraceOptimizer::vars::gradientCheck.value() == "scene") {
+		startOptimizerThread([](InteractiveAdjointLightTracing*, LightTraceOptimizer* aLto, rvk::Buffer* aRadianceBufferOut, unsigned int, float, int) {
+			const GradientCheck::Report report = aLto->gradientCheck(GradientCheck::settingsFromVars(), aRadianceBufferOut);
+			GradientCheck::writeJson({ report }, LightTraceOptimizer::vars::gradientCheckOutput.value());
+			Common::getInstance().queueShutdown();
+		});
+	}
 }
 
 void InteractiveAdjointLightTracing::sceneUnload(tamashii::SceneBackendData aScene) {
@@ -473,6 +488,13 @@ void InteractiveAdjointLightTracing::drawView(tamashii::ViewDef_s* aViewDef) {
 	}
 	if (aViewDef->updates.mModelGeometries) {
 		mData->mGpuBlas.update(&stc, aViewDef->scene);
+		// the index and vertex buffer are replaced when they had to grow
+		if (mData->mGpuBlas.bufferChanged()) {
+			mRoot.device.waitIdle();
+			mData->mDescriptorDrawOnMesh.setBuffer(DRAW_DESC_VERTEX_BUFFER_BINDING, mData->mGpuBlas.getVertexBuffer());
+			mData->mDescriptorDrawOnMesh.update();
+			mLto.geometryBuffersChanged();
+		}
 
 		
 		
@@ -531,9 +553,9 @@ void InteractiveAdjointLightTracing::drawView(tamashii::ViewDef_s* aViewDef) {
 				for (const auto& mesh : model->refMeshes) {
 					if (mesh.get() != info.mRefMeshHit) offsets += mesh->mesh->getVertexCount();
 					else {
-						offsets.x += mesh->mesh->getIndicesArray()[3u * info.mPrimitiveIndex + 0];
-						offsets.y += mesh->mesh->getIndicesArray()[3u * info.mPrimitiveIndex + 1];
-						offsets.z += mesh->mesh->getIndicesArray()[3u * info.mPrimitiveIndex + 2];
+						offsets.x += std::as_const(*mesh->mesh).getIndicesArray()[3u * info.mPrimitiveIndex + 0];
+						offsets.y += std::as_const(*mesh->mesh).getIndicesArray()[3u * info.mPrimitiveIndex + 1];
+						offsets.z += std::as_const(*mesh->mesh).getIndicesArray()[3u * info.mPrimitiveIndex + 2];
 						stop = true;
 					}
 					if (stop) break;
@@ -583,6 +605,18 @@ void InteractiveAdjointLightTracing::drawUI(tamashii::UiConf_s* aUiConf) {
 			if (ImGui::SliderInt("##xRay", &xRays, 1, 10000, "xRays: %d")) LightTraceOptimizer::vars::numRaysXperLight.value(xRays);
 			ImGui::SameLine();
 			if (ImGui::SliderInt("##yRay", &yRays, 0, 10000, "yRays: %d")) LightTraceOptimizer::vars::numRaysYperLight.value(yRays);
+			int allocation = static_cast<int>(LightTraceOptimizer::vars::rayAllocation.value());
+			if (ImGui::Combo("##rayAlloc", &allocation, "Rays: equal\0Rays: flux\0Rays: flux+var\0")) LightTraceOptimizer::vars::rayAllocation.value(allocation);
+			ImGui::SameLine();
+			bool deterministic = LightTraceOptimizer::vars::deterministicAccumulation.value();
+			if (ImGui::Checkbox("Deterministic", &deterministic)) LightTraceOptimizer::vars::deterministicAccumulation.value(deterministic);
+			bool adaptive = LightTraceOptimizer::vars::adaptiveRays.value();
+			if (ImGui::Checkbox("Adaptive", &adaptive)) LightTraceOptimizer::vars::adaptiveRays.value(adaptive);
+			if (adaptive) {
+				ImGui::SameLine();
+				float snr = LightTraceOptimizer::vars::adaptiveRaysSnr.value();
+				if (ImGui::DragFloat("##adaptiveSnr", &snr, 0.1f, 0.1f, 1000.0f, "snr: %.1f")) LightTraceOptimizer::vars::adaptiveRaysSnr.value(snr);
+			}
 		}
 		if (fwdPT || bwdPT) {
 			int triRays = LightTraceOptimizer::vars::numRaysPerTriangle.value();
@@ -656,6 +690,15 @@ void InteractiveAdjointLightTracing::drawUI(tamashii::UiConf_s* aUiConf) {
 		{
 			mLto.setTargetWeights(weight);
 		}
+		static float smoothing = LightTraceOptimizer::vars::targetSmoothing.value();
+		ImGui::PushItemWidth(110);
+		ImGui::DragFloat("##smoothing", &smoothing, 1e-4f, 0.0f, 10.0f, "Alpha: %.3g");
+		ImGui::PopItemWidth();
+		ImGui::SameLine();
+		if (ImGui::Button("Smooth Target", ImVec2(ImGui::GetContentRegionAvail().x, 0.0f)))
+		{
+			if (mLto.smoothTarget(smoothing)) mLto.buildObjectiveFunction(Common::getInstance().getRenderSystem()->getMainScene().get()->getSceneData());
+		}
 		ImGui::DragFloat("##IS", &mOptimizerStepSize, 0.01f, 0.01f, 5.0f, "Optim step size: %.3g");
 		if(ImGui::DragInt("##IB", &mLto.bounces(), 1, 0, 10, "Bounces: %d")) aUiConf->scene->requestLightUpdate();
 
@@ -1029,6 +1072,22 @@ void InteractiveAdjointLightTracing::useCurrentRadianceAsTarget(const bool clear
 	mLto.copyTargetToMesh(Common::getInstance().getRenderSystem()->getMainScene().get()->getSceneData());
 }
 
+bool InteractiveAdjointLightTracing::saveSnapshot(const std::string& aFile, const bool aCompress)
+{
+	return mLto.saveSnapshot(aFile, aCompress);
+}
+
+bool InteractiveAdjointLightTracing::loadSnapshot(const std::string& aFile)
+{
+	bool targetLoaded;
+	if (!mLto.loadSnapshot(aFile, &targetLoaded)) return false;
+	if (targetLoaded) {
+		mLto.buildObjectiveFunction(Common::getInstance().getRenderSystem()->getMainScene().get()->getSceneData());
+		mLto.copyTargetToMesh(Common::getInstance().getRenderSystem()->getMainScene().get()->getSceneData());
+	}
+	return true;
+}
+
 InteractiveAdjointLightTracing::OptimizerResult InteractiveAdjointLightTracing::runOptimizer(const LightTraceOptimizer::Optimizers optimizerType, const float stepSize, int maxIterations)
 {
 	auto result= mLto.optimize(optimizerType, &mData->mRadianceBufferCopy, stepSize, maxIterations );
@@ -1037,6 +1096,86 @@ InteractiveAdjointLightTracing::OptimizerResult InteractiveAdjointLightTracing::
 	return { .history = history, .lastPhi = result.lastPhi };
 }
 
+std::vector<InteractiveAdjointLightTracing::OptimizationJobResult> InteractiveAdjointLightTracing::runOptimizationJobs(
+	const std::vector<OptimizationJob>& aJobs, const std::function<void(const OptimizationJobResult&)>& aOnResult)
+{
+	std::vector<OptimizationJobResult> results;
+	if (aJobs.empty() || !mSceneLoaded) return results;
+	// the jobs swap target and parameters of the optimizer that is shared with the optimizer thread
+	if (mLto.optimizationRunning() || mOptimizationJobsRunning.exchange(true)) {
+		spdlog::error("ialt: an optimization is already running, the jobs are not started");
+		return results;
+	}
+
+	// targets read from snapshot files go through two pooled host buffers, the next one is read while the current job runs
+	struct TargetSlot {
+		std::vector<float>	mTarget;
+		std::vector<float>	mWeights;
+	};
+	std::array<TargetSlot, 2> pool;
+	std::array<std::future<bool>, 2> pending;
+	// the reads write into the pool, so they are waited for before it goes away, also when a job throws
+	struct Finish {
+		std::array<std::future<bool>, 2>&	mPending;
+		std::atomic<bool>&					mRunning;
+		~Finish()
+		{
+			for (std::future<bool>& f : mPending) if (f.valid()) f.wait();
+			mRunning = false;
+		}
+	} finish{ pending, mOptimizationJobsRunning };
+	const SceneBackendData scene = Common::getInstance().getRenderSystem()->getMainScene().get()->getSceneData();
+
+	auto prefetch = [&](const size_t aJob) {
+		if (aJob >= aJobs.size() || !aJobs[aJob].mTarget.empty()) return;
+		TargetSlot& slot = pool[aJob % 2];
+		pending[aJob % 2] = ThreadPool::getInstance().submit([this, &slot, file = aJobs[aJob].mTargetFile] {
+			return mLto.readSnapshotTarget(file, slot.mTarget, slot.mWeights);
+		});
+	};
+
+	TargetSlot original;
+	mLto.downloadTarget(original.mTarget, original.mWeights);
+	mLto.updateParamsFromScene();
+	Eigen::VectorXd startParams = mLto.getCurrentParams();
+	Eigen::VectorXd lastParams = startParams;
+
+	results.reserve(aJobs.size());
+	prefetch(0);
+	for (size_t i = 0; i < aJobs.size(); i++) {
+		const OptimizationJob& job = aJobs[i];
+		const auto start = std::chrono::high_resolution_clock::now();
+		OptimizationJobResult& result = results.emplace_back();
+		result.mName = job.mName;
+		result.mIndex = i;
+
+		bool ready;
+		if (job.mTarget.empty()) ready = pending[i % 2].get() && mLto.uploadTarget(pool[i % 2].mTarget, pool[i % 2].mWeights);
+		else ready = mLto.uploadTarget(job.mTarget, job.mWeights);
+		prefetch(i + 1);
+
+		if (ready) {
+			mLto.applyParameterVector(job.mWarmStart ? lastParams : startParams);
+			mLto.buildObjectiveFunction(scene);
+			const LBFGSppWrapperResult r = mLto.optimize(job.mOptimizer, &mData->mRadianceBufferCopy, job.mStepSize, job.mMaxIterations);
+			result.mSuccess = true;
+			result.mParams = mLto.getCurrentParams();
+			result.mHistory = mLto.exportHistory();
+			result.mBestPhi = r.bestObjectiveValue;
+			result.mLastPhi = r.lastPhi;
+			lastParams = result.mParams;
+		}
+		else spdlog::error("ialt: skipping job {} '{}', target could not be loaded", i, job.mName);
+		result.mSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		if (aOnResult) aOnResult(result);
+	}
+	mLto.uploadTarget(original.mTarget, original.mWeights);
+	mLto.buildObjectiveFunction(scene);
+	mLto.copyTargetToMesh(scene);
+	mLto.forward(startParams, &mData->mRadianceBufferCopy);
+	return results;
+}
+
 void InteractiveAdjointLightTracing::clearGradVis()
 {
 	SingleTimeCommand stc = mRoot.singleTimeCommand();
@@ -1049,29 +1188,95 @@ std::unique_ptr<tamashii::Image> InteractiveAdjointLightTracing::getFrameImage()
 {
 	SingleTimeCommand stc = mRoot.singleTimeCommand();
 	const VkExtent3D extent = mFrameData[mRoot.currentIndex()].mColor.getExtent();
-	std::vector<glm::vec4> img_data(extent.width * extent.height);
-	mFrameData[mRoot.currentIndex()].mColor.STC_DownloadData2D(&stc, extent.width, extent.height, 16, img_data.data());
 
-	const auto img = new tamashii::Image("");
-	img->init(extent.width, extent.height, tamashii::Image::Format::RGBA32_FLOAT, img_data.data());
-	return std::unique_ptr<tamashii::Image>{img};
+	auto img = std::make_unique<tamashii::Image>("");
+	img->init(extent.width, extent.height, tamashii::Image::Format::RGBA32_FLOAT, nullptr);
+	mFrameData[mRoot.currentIndex()].mColor.STC_DownloadData2D(&stc, extent.width, extent.height, 16, img->getData());
+	return img;
 }
 
 std::unique_ptr<tamashii::Image> InteractiveAdjointLightTracing::getGradImage()
 {
+	SingleTimeCommand stc = mRoot.singleTimeCommand();
+	const VkExtent3D extent = mData.value().mDerivVisImageAccumulate.getExtent();
+
+	auto img = std::make_unique<tamashii::Image>("");
+	img->init(extent.width, extent.height, tamashii::Image::Format::RGBA32_FLOAT, nullptr);
+	mData->mDerivVisImageAccumulate.STC_DownloadData2D(&stc, extent.width, extent.height, 16, img->getData());
+	return img;
+}
 
+bool InteractiveAdjointLightTracing::saveFrameImage(const std::string& aFile, const bool aAsync)
+{
+	SingleTimeCommand stc = mRoot.singleTimeCommand();
+	const VkExtent3D extent = mFrameData[mRoot.currentIndex()].mColor.getExtent();
+	std::vector<float> pixels(static_cast<size_t>(extent.width) * extent.height * 4);
+	mFrameData[mRoot.currentIndex()].mColor.STC_DownloadData2D(&stc, extent.width, extent.height, 16, pixels.data());
+	return saveImage(aFile, extent.width, extent.height, std::move(pixels), 1.0f, aAsync);
+}
+
+bool InteractiveAdjointLightTracing::saveGradImage(const std::string& aFile, const float aScale, const bool aAsync)
+{
 	SingleTimeCommand stc = mRoot.singleTimeCommand();
 	const VkExtent3D extent = mData.value().mDerivVisImageAccumulate.getExtent();
+	std::vector<float> pixels(static_cast<size_t>(extent.width) * extent.height * 4);
+	mData->mDerivVisImageAccumulate.STC_DownloadData2D(&stc, extent.width, extent.height, 16, pixels.data());
+	return saveImage(aFile, extent.width, extent.height, std::move(pixels), aScale, aAsync);
+}
 
-	std::vector<glm::vec4> img_data(extent.width * extent.height);
-	mData->mDerivVisImageAccumulate.STC_DownloadData2D(&stc, extent.width, extent.height, 16, img_data.data());
-	
-	
-	
+bool InteractiveAdjointLightTracing::saveImage(const std::string& aFile, const uint32_t aWidth, const uint32_t aHeight, std::vector<float>&& aRgba, const float aScale, const bool aAsync)
+{
+	std::string ext = std::filesystem::path(aFile).extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	const int w = static_cast<int>(aWidth);
+	const int h = static_cast<int>(aHeight);
+	collectImageSaves(false);
+
+	if (ext == ".exr") {
+		if (aScale != 1.0f) for (float& v : aRgba) v *= aScale;
+		if (aAsync) {
+			const std::lock_guard lock(mImageSavesMutex);
+			mImageSaves.emplace_back(aFile, tamashii::io::Export::save_image_exr_async(aFile, w, h, std::move(aRgba)));
+			return true;
+		}
+		return tamashii::io::Export::save_image_exr(aFile, w, h, aRgba.data(), 4, { 3, 2, 1, 0 } /*A B G R*/, tamashii::io::Export::ExrSettings::fromVars());
+	}
+	if (ext == ".png") {
+		std::vector<uint8_t> bytes(aRgba.size());
+		for (size_t i = 0; i < aRgba.size(); i++) bytes[i] = static_cast<uint8_t>(glm::clamp(aRgba[i] * aScale, 0.0f, 1.0f) * 255.0f + 0.5f);
+		if (aAsync) {
+			const std::lock_guard lock(mImageSavesMutex);
+			mImageSaves.emplace_back(aFile, tamashii::io::Export::save_image_png_8_bit_async(aFile, w, h, 4, std::move(bytes)));
+			return true;
+		}
+		tamashii::io::Export::save_image_png_8_bit(aFile, w, h, 4, bytes.data());
+		return true;
+	}
+	spdlog::error("Export image format not supported: {}", aFile);
+	return false;
+}
 
-	const auto img = new tamashii::Image("");
-	img->init(extent.width, extent.height, tamashii::Image::Format::RGBA32_FLOAT, img_data.data());
-	return std::unique_ptr<tamashii::Image>{img};
+bool InteractiveAdjointLightTracing::waitForImageSaves()
+{
+	return collectImageSaves(true);
+}
+
+bool InteractiveAdjointLightTracing::collectImageSaves(const bool aWait)
+{
+	const std::lock_guard lock(mImageSavesMutex);
+	bool success = true;
+	for (auto it = mImageSaves.begin(); it != mImageSaves.end();) {
+		if (!aWait && it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			++it;
+			continue;
+		}
+		if (!it->second.get()) {
+			spdlog::error("Could not save image: {}", it->first);
+			success = false;
+		}
+		it = mImageSaves.erase(it);
+	}
+	return success;
 }
 
 
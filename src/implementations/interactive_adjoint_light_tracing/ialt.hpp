@@ -9,7 +9,10 @@
 
 #include "light_trace_opti.hpp"
 
+#include <atomic>
 #include <thread>
+#include <future>
+#include <mutex>
 
 class InteractiveAdjointLightTracing final : public tamashii::RenderBackendImplementation {
 public:
@@ -17,6 +20,27 @@ public:
 		std::deque<Eigen::VectorXd> history;
 		double lastPhi;
 	};
+	// one target of a batch, the target comes from mTarget or, if that is empty, from the snapshot mTargetFile
+	struct OptimizationJob {
+		std::string					mName;
+		std::string					mTargetFile;
+		std::vector<float>			mTarget;
+		std::vector<float>			mWeights;		// empty: every weight 1
+		LightTraceOptimizer::Optimizers mOptimizer = LightTraceOptimizer::LBFGS;
+		float						mStepSize = 1.0f;
+		int							mMaxIterations = 100;
+		bool						mWarmStart = false;	// start from the result of the previous job instead of the batch start
+	};
+	struct OptimizationJobResult {
+		std::string					mName;
+		size_t						mIndex = 0;
+		bool						mSuccess = false;
+		Eigen::VectorXd				mParams;
+		std::deque<Eigen::VectorXd>	mHistory;
+		double						mBestPhi = 0;
+		double						mLastPhi = 0;
+		double						mSeconds = 0;
+	};
 
 					InteractiveAdjointLightTracing(const tamashii::VulkanRenderRoot& aRoot) : mRoot{ aRoot }, mLights{nullptr},
 						mLto {aRoot}, mSceneLoaded{ false },
@@ -63,7 +87,14 @@ public:
 	void			runForward(const Eigen::Map<Eigen::VectorXd>&);
 	double			runBackward(Eigen::VectorXd&);
 	void			useCurrentRadianceAsTarget(bool clearWeights);
+	bool			saveSnapshot(const std::string& aFile, bool aCompress);
+	bool			loadSnapshot(const std::string& aFile);
 	OptimizerResult runOptimizer(LightTraceOptimizer::Optimizers, float, int);
+					// runs the jobs back to back on the loaded scene, aOnResult is called as each job finishes
+					// target, weights and light parameters are restored afterwards, no jobs are run while
+					// another optimization or job run is in progress
+	std::vector<OptimizationJobResult> runOptimizationJobs(const std::vector<OptimizationJob>& aJobs,
+						const std::function<void(const OptimizationJobResult&)>& aOnResult = {});
 
 	void			showTarget(const bool b) { mShowTarget = b; }
 	void			clearGradVis();
@@ -81,7 +112,14 @@ public:
 
 	std::unique_ptr<tamashii::Image>	getFrameImage();
 	std::unique_ptr<tamashii::Image>	getGradImage();
+										// .exr or .png, async saves go to the background io thread
+	bool								saveFrameImage(const std::string& aFile, bool aAsync = false);
+	bool								saveGradImage(const std::string& aFile, float aScale = 1.0f, bool aAsync = false);
+										// blocks until the async saves are written and logs the failed ones, false if any failed
+	bool								waitForImageSaves();
 private:
+	bool								saveImage(const std::string& aFile, uint32_t aWidth, uint32_t aHeight, std::vector<float>&& aRgba, float aScale, bool aAsync);
+	bool								collectImageSaves(bool aWait);
 	tamashii::VulkanRenderRoot mRoot;
 
 	
@@ -138,6 +176,8 @@ private:
 	std::vector<VkFrameData>								mFrameData;
 	std::deque<std::shared_ptr<tamashii::RefLight>>		*mLights;
 	LightTraceOptimizer										mLto;
+	std::vector<std::pair<std::string, std::future<bool>>>	mImageSaves;
+	std::mutex												mImageSavesMutex;
 
 	bool													mSceneLoaded;
 	bool													mShowTarget;
@@ -165,6 +205,8 @@ private:
 
 
 	std::thread												mOptimizerThread;
+															// set while runOptimizationJobs runs, a second run is rejected
+	std::atomic<bool>										mOptimizationJobsRunning = false;
 	std::vector<std::string>								mOptimizerChoices;
 	uint8_t													mOptimizerChoice;
 	float													mOptimizerStepSize;
@@ -1,5 +1,8 @@
 #include "light_trace_opti.hpp"
 #include <tamashii/core/common/common.hpp>
+#include <tamashii/core/common/thread_pool.hpp>
+#include <tamashii/core/common/profiler.hpp>
+#include <tamashii/core/io/snapshot.hpp>
 #include <tamashii/core/scene/ref_entities.hpp>
 #include <tamashii/core/scene/light.hpp>
 #include <tamashii/core/scene/model.hpp>
@@ -17,6 +20,9 @@
 
 #include <sstream>
 #include <fstream>
+#include <atomic>
+#include <numeric>
+#include <limits>
 
 #include "ialt.hpp"
 
@@ -24,6 +30,13 @@
 #define M_PI (3.14159265358979323846264338327950288)
 #endif
 
+// per vertex radiance basis, stored in snapshots: 0 rgb, 1 spherical harmonics, 2 hemispherical harmonics
+#ifdef IALT_USE_SPHERICAL_HARMONICS
+constexpr uint64_t SNAPSHOT_BASIS = USE_HSH ? 2 : 1;
+#else
+constexpr uint64_t SNAPSHOT_BASIS = 0;
+#endif
+
 T_USE_NAMESPACE
 
 ccli::Var<bool>			LightTraceOptimizer::vars::objFuncOnGpu("", "objFuncOnGpu", true, ccli::Flag::ConfigRead, "Calculate objective function on gpu.");
@@ -50,6 +63,21 @@ ccli::Var<float>		LightTraceOptimizer::vars::useAABBconstraint("", "useAABBconst
 ccli::Var<uint32_t>		LightTraceOptimizer::vars::shOrder("", "shOrder", 5, ccli::Flag::ConfigRead, "Order of spherical harmonic space (will result in 3*(order+1)^2 coefficients per vertex");
 ccli::Var<bool>			LightTraceOptimizer::vars::unphysicalNicePreview("","unphysicalNicePreview", false, ccli::Flag::ConfigRead, "Use unphysical but nice looking preview (default off).");
 ccli::Var<float>		LightTraceOptimizer::vars::useIntensityPenalty("", "useIntensityPenalty", -1.0f, ccli::Flag::ConfigRead, "Penalize intensities of lights to encourage energy-efficient solutions using the specified penalty factor (default < 0.0 ==> off ).");
+ccli::Var<std::string>	LightTraceOptimizer::vars::gradientCheck("", "gradientCheck", /*empty by default*/"", ccli::Flag::ConfigRead, "Run a finite difference gradient check and quit: 'cpu' (no gpu needed) or 'scene' (light tracer on the loaded scene).");
+ccli::Var<std::string>	LightTraceOptimizer::vars::gradientCheckOutput("", "gradientCheckOutput", "gradient_check.json", ccli::Flag::ConfigRead, "Json report written by the gradient check.");
+ccli::Var<float>		LightTraceOptimizer::vars::gradientCheckStepSize("", "gradientCheckStepSize", 1e-4f, ccli::Flag::ConfigRead, "Finite difference step size of the gradient check.");
+ccli::Var<float>		LightTraceOptimizer::vars::gradientCheckTolerance("", "gradientCheckTolerance", 1e-2f, ccli::Flag::ConfigRead, "Largest relative error per parameter the gradient check accepts.");
+ccli::Var<uint32_t>		LightTraceOptimizer::vars::rayAllocation("", "rayAllocation", 0, ccli::Flag::ConfigRead, "Distribution of the light tracing rays over the lights: 0 equal per light, 1 proportional to emitted flux, 2 proportional to flux and gradient variance.");
+ccli::Var<float>		LightTraceOptimizer::vars::rayAllocationMinShare("", "rayAllocationMinShare", 0.1f, ccli::Flag::ConfigRead, "Share of the equal per light ray count every light keeps with adaptive ray allocation.");
+ccli::Var<float>		LightTraceOptimizer::vars::targetSmoothing("", "targetSmoothing", 1e-3f, ccli::Flag::ConfigRead, "Default strength alpha of the laplacian target smoothing (in units of area).");
+ccli::Var<uint32_t>		LightTraceOptimizer::vars::targetSmoothingDirectLimit("", "targetSmoothingDirectLimit", 1000000, ccli::Flag::ConfigRead, "Largest vertex count the target smoothing factorizes directly, larger meshes use preconditioned conjugate gradients.");
+ccli::Var<bool>			LightTraceOptimizer::vars::deterministicAccumulation("", "deterministicAccumulation", false, ccli::Flag::ConfigRead, "Accumulate radiance, light derivatives and objective in a fixed order so runs with constRandSeed are bitwise reproducible (light tracing only).");
+ccli::Var<uint32_t>		LightTraceOptimizer::vars::fixedPointBits("", "fixedPointBits", 32, ccli::Flag::ConfigRead, "Fractional bits of the 64 bit fixed point values used by deterministicAccumulation.");
+ccli::Var<bool>			LightTraceOptimizer::vars::adaptiveRays("", "adaptiveRays", false, ccli::Flag::ConfigRead, "Adapt the light tracing rays per light during optimization so the gradient reaches adaptiveRaysSnr (light tracing with rayAllocation 0 only).");
+ccli::Var<float>		LightTraceOptimizer::vars::adaptiveRaysSnr("", "adaptiveRaysSnr", 16.0f, ccli::Flag::ConfigRead, "Target signal to noise ratio |g|^2 / E|g - E[g]|^2 of the gradient for adaptiveRays.");
+ccli::Var<uint32_t>		LightTraceOptimizer::vars::adaptiveRaysBatches("", "adaptiveRaysBatches", 4, ccli::Flag::ConfigRead, "Number of independent batches the backward pass is split into to estimate the gradient variance.");
+ccli::Var<float>		LightTraceOptimizer::vars::adaptiveRaysMinScale("", "adaptiveRaysMinScale", 0.0625f, ccli::Flag::ConfigRead, "Smallest factor adaptiveRays applies to numRaysYperLight, optimizations start here.");
+ccli::Var<float>		LightTraceOptimizer::vars::adaptiveRaysMaxScale("", "adaptiveRaysMaxScale", 2.0f, ccli::Flag::ConfigRead, "Largest factor adaptiveRays applies to numRaysYperLight.");
 
 void LightTraceOptimizer::vars::initVars() {
 	tamashii::var::default_implementation.value("ialt");
@@ -70,6 +98,28 @@ constexpr float SQRT4PI = 3.54490770181103f;
 namespace {
 	ConeAngleTanhParameterization coneAngleParameterization;
 
+	// sums in a fixed binary tree, the result only depends on the values and not on the thread count
+	double pairwiseSum(const double* aValues, const size_t aCount)
+	{
+		constexpr size_t leaf = 64;
+		constexpr size_t block = 65536;
+		if (aCount <= leaf) {
+			double sum = 0.0;
+			for (size_t i = 0; i < aCount; i++) sum += aValues[i];
+			return sum;
+		}
+		if (aCount > block) {
+			const size_t blocks = (aCount + block - 1) / block;
+			std::vector<double> blockSums(blocks);
+			tamashii::ThreadPool::getInstance().parallelFor(0, blocks, [&](const size_t aBlock) {
+				blockSums[aBlock] = pairwiseSum(aValues + aBlock * block, std::min(block, aCount - aBlock * block));
+			});
+			return pairwiseSum(blockSums.data(), blocks);
+		}
+		const size_t half = aCount / 2;
+		return pairwiseSum(aValues, half) + pairwiseSum(aValues + half, aCount - half);
+	}
+
 	void TestOfficeTargetHardcoded(Eigen::SparseMatrix<float>& aA, Eigen::Ref<Eigen::MatrixXf> aRadianceTarget, const tamashii::SceneBackendData& aScene, Eigen::Ref<Eigen::VectorXf> aVtxArea, const uint32_t aEntriesPerVertex){
 #ifdef IALT_USE_SPHERICAL_HARMONICS
 		spdlog::warn("Using a hardcoded target intended for diffuse-only calculation with spherical harmonics - this may result in unwanted behaviour");
@@ -137,39 +187,57 @@ namespace {
 
 	double vectorCotan(const Eigen::Vector3f& aA, const Eigen::Vector3f& aB){ 
 		const double ab = aA.dot(aB), aa = aA.squaredNorm(), bb = aB.squaredNorm();
-		return sqrt(ab * ab / (aa * bb - ab * ab)) * (ab >= 0 ? 1.0 : -1.0);
+		const double crossSq = aa * bb - ab * ab;
+		if (crossSq <= 0.0) return 0.0;
+		return sqrt(ab * ab / crossSq) * (ab >= 0 ? 1.0 : -1.0);
 	}
 	void cotanLaplacian(Eigen::SparseMatrix<double>& aLap, const Eigen::MatrixXf& aCoords, const Eigen::MatrixXi& aElems){
-		std::vector<Eigen::Triplet<double>> lapTriplets;
-		lapTriplets.reserve(9 * aElems.rows());
-
-		for (uint32_t k = 0; k < aElems.rows(); ++k) {
-			const int32_t adof = aElems(k, 0), bdof = aElems(k, 1), cdof = aElems(k, 2);
-			Eigen::Vector3f a(aCoords.row(adof)), b(aCoords.row(bdof)), c(aCoords.row(cdof));
-
-			const double cot1 = vectorCotan(a - c, b - c);
-			const double cot2 = vectorCotan(b - a, c - a);
-			const double cot3 = vectorCotan(c - b, a - b);
-
-			
-			lapTriplets.emplace_back(Eigen::Triplet(adof, adof, 0.5 * (cot1 + cot3)));
-			lapTriplets.emplace_back(Eigen::Triplet(adof, bdof, 0.5 * (-cot1)));
-			lapTriplets.emplace_back(Eigen::Triplet(adof, cdof, 0.5 * (-cot3)));
-
-			
-			lapTriplets.emplace_back(Eigen::Triplet(bdof, adof, 0.5 * (-cot1)));
-			lapTriplets.emplace_back(Eigen::Triplet(bdof, bdof, 0.5 * (cot1 + cot2)));
-			lapTriplets.emplace_back(Eigen::Triplet(bdof, cdof, 0.5 * (-cot2)));
-
-			
-			lapTriplets.emplace_back(Eigen::Triplet(cdof, adof, 0.5 * (-cot3)));
-			lapTriplets.emplace_back(Eigen::Triplet(cdof, bdof, 0.5 * (-cot2)));
-			lapTriplets.emplace_back(Eigen::Triplet(cdof, cdof, 0.5 * (cot2 + cot3)));
+		constexpr size_t elemsPerTask = 4096;
+		const size_t elemCount = aElems.rows();
+		const size_t vertexCount = aCoords.rows();
+		std::vector<Eigen::Triplet<double>> lapTriplets(9 * elemCount + vertexCount);
+
+		ThreadPool::getInstance().parallelFor(0, (elemCount + elemsPerTask - 1) / elemsPerTask, [&](const size_t aTask) {
+			const size_t end = std::min(elemCount, (aTask + 1) * elemsPerTask);
+			for (size_t k = aTask * elemsPerTask; k < end; ++k) {
+				const int32_t adof = aElems(k, 0), bdof = aElems(k, 1), cdof = aElems(k, 2);
+				Eigen::Vector3f a(aCoords.row(adof)), b(aCoords.row(bdof)), c(aCoords.row(cdof));
+
+				const double cot1 = vectorCotan(a - c, b - c);
+				const double cot2 = vectorCotan(b - a, c - a);
+				const double cot3 = vectorCotan(c - b, a - b);
+
+				Eigen::Triplet<double>* t = &lapTriplets[9 * k];
+				t[0] = Eigen::Triplet(adof, adof, 0.5 * (cot1 + cot3));
+				t[1] = Eigen::Triplet(adof, bdof, 0.5 * (-cot1));
+				t[2] = Eigen::Triplet(adof, cdof, 0.5 * (-cot3));
+
+				t[3] = Eigen::Triplet(bdof, adof, 0.5 * (-cot1));
+				t[4] = Eigen::Triplet(bdof, bdof, 0.5 * (cot1 + cot2));
+				t[5] = Eigen::Triplet(bdof, cdof, 0.5 * (-cot2));
+
+				t[6] = Eigen::Triplet(cdof, adof, 0.5 * (-cot3));
+				t[7] = Eigen::Triplet(cdof, bdof, 0.5 * (-cot2));
+				t[8] = Eigen::Triplet(cdof, cdof, 0.5 * (cot2 + cot3));
+			}
+		});
+		// explicit zero diagonal so vertices without triangles still get a stored diagonal entry
+		for (size_t i = 0; i < vertexCount; ++i) {
+			lapTriplets[9 * elemCount + i] = Eigen::Triplet<double>(static_cast<int>(i), static_cast<int>(i), 0.0);
 		}
 
-		aLap.resize(aCoords.rows(), aCoords.rows());
+		aLap.resize(vertexCount, vertexCount);
 		aLap.setFromTriplets(lapTriplets.begin(), lapTriplets.end());
 	}
+
+	uint64_t topologyHash(const Eigen::MatrixXi& aElems, const Eigen::Index aVertexCount){
+		uint64_t hash = 14695981039346656037ull;
+		const auto mix = [&hash](const uint64_t aValue) { hash = (hash ^ aValue) * 1099511628211ull; };
+		mix(static_cast<uint64_t>(aVertexCount));
+		mix(static_cast<uint64_t>(aElems.rows()));
+		for (Eigen::Index i = 0; i < aElems.size(); ++i) mix(static_cast<uint32_t>(aElems.data()[i]));
+		return hash == 0 ? 1 : hash;
+	}
 }
 
 void LightTraceOptimizer::init(tamashii::TextureDataVulkan* aGpuTd, tamashii::MaterialDataVulkan* aGpuMd, tamashii::LightDataVulkan* aGpuLd, tamashii::GeometryDataBlasVulkan* aGpuBlas, tamashii::GeometryDataTlasVulkan* aGpuTlas)
@@ -193,6 +261,9 @@ void LightTraceOptimizer::init(tamashii::TextureDataVulkan* aGpuTd, tamashii::Ma
 	mAdjointDescriptor.addStorageBuffer(ADJOINT_DESC_LIGHT_DERIVATIVES_BUFFER_BINDING, rvk::Shader::Stage::RAYGEN);
 	mAdjointDescriptor.addStorageBuffer(ADJOINT_DESC_LIGHT_TEXTURE_DERIVATIVES_BUFFER_BINDING, rvk::Shader::Stage::RAYGEN);
 	mAdjointDescriptor.addStorageBuffer(ADJOINT_DESC_TRIANGLE_BUFFER_BINDING, rvk::Shader::Stage::RAYGEN);
+	mAdjointDescriptor.addStorageBuffer(ADJOINT_DESC_LIGHT_RAY_OFFSETS_BUFFER_BINDING, rvk::Shader::Stage::RAYGEN);
+	mAdjointDescriptor.addStorageBuffer(ADJOINT_DESC_LIGHT_ALIAS_TABLE_BUFFER_BINDING, rvk::Shader::Stage::RAYGEN);
+	mAdjointDescriptor.addStorageBuffer(ADJOINT_DESC_RADIANCE_FIXED_BUFFER_BINDING, rvk::Shader::Stage::RAYGEN);
 	mAdjointDescriptor.finish(false);
 
 	mObjFuncDescriptor.reserve(3);
@@ -203,6 +274,7 @@ void LightTraceOptimizer::init(tamashii::TextureDataVulkan* aGpuTd, tamashii::Ma
 	mObjFuncDescriptor.addStorageBuffer(OBJ_DESC_CHANNEL_WEIGHTS_BUFFER_BINDING, rvk::Shader::Stage::COMPUTE);
 	mObjFuncDescriptor.addStorageBuffer(OBJ_DESC_PHI_BUFFER_BINDING, rvk::Shader::Stage::COMPUTE);
 	mObjFuncDescriptor.addStorageBuffer(OBJ_DESC_VERTEX_COLOR_BUFFER_BINDING, rvk::Shader::Stage::COMPUTE);
+	mObjFuncDescriptor.addStorageBuffer(OBJ_DESC_RADIANCE_FIXED_BUFFER_BINDING, rvk::Shader::Stage::COMPUTE);
 	mObjFuncDescriptor.finish(false);
 
 	uint32_t constData[3] = { sphericalHarmonicOrder, entries_per_vertex, (uint32_t)(LightTraceOptimizer::vars::unphysicalNicePreview.asBool().value()) };
@@ -281,9 +353,20 @@ void LightTraceOptimizer::init(tamashii::TextureDataVulkan* aGpuTd, tamashii::Ma
 	mObjFuncShader.finish();
 	mObjFuncPipeline.setShader(&mObjFuncShader);
 	mObjFuncPipeline.addDescriptorSet({ &mObjFuncDescriptor });
-	mObjFuncPipeline.addPushConstant(rvk::Shader::Stage::COMPUTE, 0, sizeof(uint32_t));
+	mObjFuncPipeline.addPushConstant(rvk::Shader::Stage::COMPUTE, 0, 2 * sizeof(uint32_t));
 	mObjFuncPipeline.finish();
 
+	mResolveShader.addStage(rvk::Shader::Source::GLSL, rvk::Shader::Stage::COMPUTE, IALT_SHADER_DIR "accumulate_resolve.comp", shaderDefines);
+	mResolveShader.addConstant(0, 0, 4u, 0u);
+	mResolveShader.addConstant(0, 1, 4u, 4u);
+	mResolveShader.addConstant(0, 2, 4u, 8u);
+	mResolveShader.setConstantData(0, constData, 12u);
+	mResolveShader.finish();
+	mResolvePipeline.setShader(&mResolveShader);
+	mResolvePipeline.addDescriptorSet({ &mObjFuncDescriptor });
+	mResolvePipeline.addPushConstant(rvk::Shader::Stage::COMPUTE, 0, sizeof(uint32_t) + sizeof(float));
+	mResolvePipeline.finish();
+
 	mChannelWeightsBuffer.create(rvk::Buffer::Use::STORAGE | rvk::Buffer::Use::UPLOAD, entries_per_vertex * sizeof(float), rvk::Buffer::Location::DEVICE);
 	mPhiBuffer.create(rvk::Buffer::Use::STORAGE | rvk::Buffer::Use::DOWNLOAD, sizeof(double), rvk::Buffer::Location::DEVICE);
 	mCpuBuffer.create(rvk::Buffer::Use::UPLOAD | rvk::Buffer::Use::DOWNLOAD, std::max(sizeof(double), sizeof(AdjointInfo_s)), rvk::Buffer::Location::HOST_COHERENT);
@@ -412,6 +495,113 @@ void LightTraceOptimizer::copyRadianceToTarget() const
 	stc.end();
 }
 
+bool LightTraceOptimizer::smoothTarget(const float aAlpha)
+{
+	if (!mSceneReady || !mVertexCount || aAlpha <= 0.0f) return false;
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
+	Eigen::Matrix<float, -1, -1, Eigen::RowMajor> target; target.resize(static_cast<Eigen::Index>(mVertexCount), entries_per_vertex);
+	Eigen::VectorXf targetWeights; targetWeights.resize(static_cast<Eigen::Index>(mVertexCount));
+	mTargetRadianceBuffer.STC_DownloadData(&stc, target.data());
+	mTargetRadianceWeightsBuffer.STC_DownloadData(&stc, targetWeights.data());
+
+	if (!updateSmoothingOperator(targetWeights, aAlpha)) return false;
+
+	
+	Eigen::MatrixXd rhs = mSmoothingMass.asDiagonal() * target.cast<double>();
+	Eigen::MatrixXd result = target.cast<double>();
+	solveSmoothing(rhs, result);
+
+	target = result.cast<float>();
+	mTargetRadianceBuffer.STC_UploadData(&stc, target.data(), mVertexCount * entries_per_vertex * sizeof(float));
+
+	const auto ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	spdlog::info("Target smoothed with alpha {} ({} vertices, {} channels, {}) in {:.1f} ms", aAlpha, mVertexCount, entries_per_vertex,
+		mSmoothingDirect ? "direct" : "cg", ms);
+	return true;
+}
+
+bool LightTraceOptimizer::updateSmoothingOperator(const Eigen::VectorXf& aWeights, const double aAlpha)
+{
+	// the symbolic analysis only depends on the mesh topology, alpha and the weights only need a numeric factorization
+	constexpr double minMassFactor = 1e-6;
+	const auto vertexCount = static_cast<Eigen::Index>(mVertexCount);
+	if (mCoords.rows() != vertexCount || mVtxArea.size() != vertexCount) return false;
+
+	// empty after every geometry update
+	if (mLaplacian.rows() != vertexCount) {
+		mLaplacianTopology = topologyHash(mElems, vertexCount);
+		cotanLaplacian(mLaplacian, mCoords, mElems);
+		mLaplacian.makeCompressed();
+		mLaplacianDiagonal.resize(vertexCount);
+		for (Eigen::Index col = 0; col < mLaplacian.outerSize(); ++col) {
+			for (Eigen::Index k = mLaplacian.outerIndexPtr()[col]; k < mLaplacian.outerIndexPtr()[col + 1]; ++k) {
+				if (mLaplacian.innerIndexPtr()[k] == col) { mLaplacianDiagonal[col] = k; break; }
+			}
+		}
+		mAplusAlphaL = mLaplacian;
+		mSmoothingFactorized = false;
+	}
+
+	Eigen::VectorXd mass(vertexCount);
+	for (Eigen::Index i = 0; i < vertexCount; ++i) {
+		mass[i] = static_cast<double>(mVtxArea[i]) * std::max(static_cast<double>(aWeights[i]), minMassFactor);
+	}
+	if (mSmoothingFactorized && aAlpha == mSmoothingAlpha && mass == mSmoothingMass) return true;
+	mSmoothingMass = std::move(mass);
+	mSmoothingAlpha = aAlpha;
+
+	double* values = mAplusAlphaL.valuePtr();
+	const double* lapValues = mLaplacian.valuePtr();
+	for (Eigen::Index k = 0; k < mLaplacian.nonZeros(); ++k) values[k] = aAlpha * lapValues[k];
+	for (Eigen::Index i = 0; i < vertexCount; ++i) values[mLaplacianDiagonal[i]] += mSmoothingMass[i];
+
+	mSmoothingDirect = vertexCount <= static_cast<Eigen::Index>(vars::targetSmoothingDirectLimit.value());
+	if (!mSmoothingDirect) {
+		mSmoothingFactorized = true;
+		return true;
+	}
+
+	if (mLaplacianTopology != mSmoothingTopology) {
+		mSmoothingSolver.analyzePattern(mAplusAlphaL);
+		mSmoothingTopology = mLaplacianTopology;
+	}
+	mSmoothingSolver.factorize(mAplusAlphaL);
+	if (mSmoothingSolver.info() != Eigen::Success) {
+		spdlog::error("Target smoothing: factorization failed");
+		mSmoothingTopology = 0;
+		mSmoothingFactorized = false;
+		return false;
+	}
+	mSmoothingFactorized = true;
+	return true;
+}
+
+void LightTraceOptimizer::solveSmoothing(const Eigen::MatrixXd& aRhs, Eigen::MatrixXd& aResult)
+{
+	// channels are independent right hand sides, blocks of them are solved in parallel
+	constexpr Eigen::Index channelsPerTask = 4;
+	const Eigen::Index blockCount = (aRhs.cols() + channelsPerTask - 1) / channelsPerTask;
+	std::atomic<uint32_t> notConverged = 0;
+	ThreadPool::getInstance().parallelFor(0, blockCount, [&](const size_t aBlock) {
+		const Eigen::Index first = static_cast<Eigen::Index>(aBlock) * channelsPerTask;
+		const Eigen::Index count = std::min(channelsPerTask, aRhs.cols() - first);
+		if (mSmoothingDirect) {
+			aResult.middleCols(first, count) = mSmoothingSolver.solve(aRhs.middleCols(first, count));
+			return;
+		}
+		
+		Eigen::ConjugateGradient<Eigen::SparseMatrix<double>, Eigen::Lower | Eigen::Upper> cg(mAplusAlphaL);
+		cg.setTolerance(1e-6);
+		for (Eigen::Index c = first; c < first + count; ++c) {
+			aResult.col(c) = cg.solveWithGuess(aRhs.col(c), aResult.col(c));
+			if (cg.info() != Eigen::Success) ++notConverged;
+		}
+	});
+	if (notConverged) spdlog::warn("Target smoothing: cg did not converge for {} channels", notConverged.load());
+}
+
 void LightTraceOptimizer::copyTargetToMesh(const tamashii::SceneBackendData& aScene) const
 {
 	std::vector<float> targetRadiance(mVertexCount * entries_per_vertex);
@@ -420,36 +610,51 @@ void LightTraceOptimizer::copyTargetToMesh(const tamashii::SceneBackendData& aSc
 	mTargetRadianceBuffer.STC_DownloadData(&stc, targetRadiance.data());
 	mTargetRadianceWeightsBuffer.STC_DownloadData(&stc, targetRadianceWeights.data());
 
+	const std::vector<Mesh*> meshes = sceneMeshes(aScene);
+	// copied models share their vertices, every mesh gets its own colors
+	for (Mesh* mesh : meshes) mesh->detachVertices();
+	ThreadPool::getInstance().parallelFor(0, meshes.size(), [&](const size_t aIdx) {
+		const uint64_t offset = mMeshVertexOffsets.at(meshes[aIdx]);
+		copyTargetSliceToMesh(meshes[aIdx], targetRadiance.data() + offset * entries_per_vertex, targetRadianceWeights.data() + offset);
+	});
+}
+
+void LightTraceOptimizer::copyTargetToMesh(Mesh* aMesh) const
+{
+	const auto it = mMeshVertexOffsets.find(aMesh);
+	if (it == mMeshVertexOffsets.end()) return;
+	const uint64_t count = aMesh->getVertexCount();
+	std::vector<float> targetRadiance(count * entries_per_vertex);
+	std::vector<float> targetRadianceWeights(count);
+	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
+	mTargetRadianceBuffer.STC_DownloadData(&stc, targetRadiance.data(), targetRadiance.size() * sizeof(float), it->second * entries_per_vertex * sizeof(float));
+	mTargetRadianceWeightsBuffer.STC_DownloadData(&stc, targetRadianceWeights.data(), targetRadianceWeights.size() * sizeof(float), it->second * sizeof(float));
+	copyTargetSliceToMesh(aMesh, targetRadiance.data(), targetRadianceWeights.data());
+}
+
+void LightTraceOptimizer::copyTargetSliceToMesh(Mesh* aMesh, const float* aRadiance, const float* aWeights) const
+{
+	aMesh->hasColors0(true);
+	if (entries_per_vertex != 3) {
+		Mesh::CustomData* radData = aMesh->getCustomData(EXPORT_RADIANCE_ID);
+		if (!radData) radData = aMesh->addCustomData(EXPORT_RADIANCE_ID);
+		Mesh::CustomData* radInfoData = aMesh->getCustomData(EXPORT_RADIANCE_INFO_ID);
+		if (!radInfoData) radInfoData = aMesh->addCustomData(EXPORT_RADIANCE_INFO_ID);
+
+		auto* radInfoPtr = radInfoData->alloc<uint32_t>(2);
+		radInfoPtr[0] = entries_per_vertex;
+		radInfoPtr[1] = sphericalHarmonicOrder;
+
+		auto* radPtr = radData->alloc<float>(aMesh->getVertexCount() * entries_per_vertex);
+		std::memcpy(radPtr, aRadiance, aMesh->getVertexCount() * entries_per_vertex * sizeof(float));
+	}
+
 	size_t rIndex = 0;
 	size_t wIndex = 0;
-	for (const auto refModel : aScene.models) {
-		for (const auto& refMesh : refModel->getMeshList()) {
-			refMesh->hasColors0(true);
-			if (entries_per_vertex != 3) {
-				Mesh::CustomData* radData = refMesh->getCustomData(EXPORT_RADIANCE_ID);
-				if (!radData) radData = refMesh->addCustomData(EXPORT_RADIANCE_ID);
-				Mesh::CustomData* radInfoData = refMesh->getCustomData(EXPORT_RADIANCE_INFO_ID);
-				if (!radInfoData) radInfoData = refMesh->addCustomData(EXPORT_RADIANCE_INFO_ID);
-
-				auto* radInfoPtr = radInfoData->alloc<uint32_t>(2);
-				radInfoPtr[0] = entries_per_vertex;
-				radInfoPtr[1] = sphericalHarmonicOrder;
-
-				auto* radPtr = radData->alloc<float>(refMesh->getVertexCount() * entries_per_vertex);
-				std::memcpy(radPtr, rIndex + targetRadiance.data(), refMesh->getVertexCount() * entries_per_vertex * sizeof(float));
-			}
-
-			for (vertex_s& v : *refMesh->getVerticesVector()) {
-				v.color_0 = glm::vec4(
-					targetRadiance[rIndex + 0],
-					targetRadiance[rIndex + 1],
-					targetRadiance[rIndex + 2],
-					targetRadianceWeights[wIndex]
-				);
-				rIndex += entries_per_vertex;
-				wIndex++;
-			}
-		}
+	for (vertex_s& v : *aMesh->getVerticesVector()) {
+		v.color_0 = glm::vec4(aRadiance[rIndex + 0], aRadiance[rIndex + 1], aRadiance[rIndex + 2], aWeights[wIndex]);
+		rIndex += entries_per_vertex;
+		wIndex++;
 	}
 }
 
@@ -458,115 +663,233 @@ void LightTraceOptimizer::copyMeshToTarget(const tamashii::SceneBackendData& aSc
 	std::vector<float> targetRadiance(mVertexCount * entries_per_vertex);
 	std::vector<float> targetRadianceWeights(mVertexCount);
 
-	size_t rIndex = 0;
-	size_t wIndex = 0;
-	for (const auto refModel : aScene.models) {
-		for (const auto& refMesh : refModel->getMeshList()) {
-			if (entries_per_vertex != 3) {
-				Mesh::CustomData* radData = refMesh->getCustomData(EXPORT_RADIANCE_ID);
-				Mesh::CustomData* radInfoData = refMesh->getCustomData(EXPORT_RADIANCE_INFO_ID);
-				if (radData && radInfoData) {
-					const auto* radInfoPtr = radInfoData->data<uint32_t>();
-					if (radInfoPtr[0] == entries_per_vertex || radInfoPtr[1] == sphericalHarmonicOrder) {
-						const auto* radDataPtr = radData->data<float>();
-						assert(radData->bytes() == refMesh->getVertexCount() * entries_per_vertex * sizeof(float));
-						std::memcpy(targetRadiance.data() + rIndex, radDataPtr, refMesh->getVertexCount() * entries_per_vertex * sizeof(float));
-					}
-					else spdlog::warn("ialt: can not use radiance data because 'sh order' or 'entries per vertex' is different");
+	const std::vector<Mesh*> meshes = sceneMeshes(aScene);
+	ThreadPool::getInstance().parallelFor(0, meshes.size(), [&](const size_t aIdx) {
+		const Mesh* mesh = meshes[aIdx];
+		size_t rIndex = mMeshVertexOffsets.at(mesh) * entries_per_vertex;
+		size_t wIndex = mMeshVertexOffsets.at(mesh);
+		if (entries_per_vertex != 3) {
+			const Mesh::CustomData* radData = mesh->getCustomData(EXPORT_RADIANCE_ID);
+			const Mesh::CustomData* radInfoData = mesh->getCustomData(EXPORT_RADIANCE_INFO_ID);
+			if (radData && radInfoData) {
+				const auto* radInfoPtr = radInfoData->data<uint32_t>();
+				if (radInfoPtr[0] == entries_per_vertex || radInfoPtr[1] == sphericalHarmonicOrder) {
+					const auto* radDataPtr = radData->data<float>();
+					assert(radData->bytes() == mesh->getVertexCount() * entries_per_vertex * sizeof(float));
+					std::memcpy(targetRadiance.data() + rIndex, radDataPtr, mesh->getVertexCount() * entries_per_vertex * sizeof(float));
 				}
+				else spdlog::warn("ialt: can not use radiance data because 'sh order' or 'entries per vertex' is different");
 			}
+		}
 
-			for (const vertex_s& v : *refMesh->getVerticesVector()) {
-				targetRadiance[rIndex + 0] = v.color_0.x;
-				targetRadiance[rIndex + 1] = v.color_0.y;
-				targetRadiance[rIndex + 2] = v.color_0.z;
-				targetRadianceWeights[wIndex] = v.color_0.w;
-				rIndex += entries_per_vertex;
-				wIndex++;
-			}
+		for (const vertex_s& v : *std::as_const(*mesh).getVerticesVector()) {
+			targetRadiance[rIndex + 0] = v.color_0.x;
+			targetRadiance[rIndex + 1] = v.color_0.y;
+			targetRadiance[rIndex + 2] = v.color_0.z;
+			targetRadianceWeights[wIndex] = v.color_0.w;
+			rIndex += entries_per_vertex;
+			wIndex++;
 		}
-	}
+	});
 	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
 	mTargetRadianceBuffer.STC_UploadData(&stc, targetRadiance.data());
 	mTargetRadianceWeightsBuffer.STC_UploadData(&stc, targetRadianceWeights.data());
 }
 
+// the same color for every vertex, higher sh coefficients are cleared
 void LightTraceOptimizer::setTargetRadianceBufferForScene(std::optional<glm::vec3> c,
                                                           const std::optional<float> w) const
 {
-	std::vector<float> color(mVertexCount * entries_per_vertex);
-	std::vector<float> weights(mVertexCount);
-
-	size_t rIndex = 0;
-	size_t wIndex = 0;
-	for (const auto& refModel : *mModels) {
-		for (const auto& refMesh : refModel->refMeshes) {
-			size_t cidx = rIndex;
-			size_t widx = wIndex;
-			for (const vertex_s& v : *refMesh->mesh->getVerticesVector()) {
-				if (c.has_value()) {
-					color[cidx + 0] = c->x;
-					color[cidx + 1] = c->y;
-					color[cidx + 2] = c->z;
-				}
-				if (w.has_value()) weights[widx] = w.value();
-				cidx += entries_per_vertex;
-				widx++;
+	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
+	if (c.has_value()) {
+		std::vector<float> color(mVertexCount * entries_per_vertex);
+		constexpr size_t chunk = 1 << 16;
+		ThreadPool::getInstance().parallelFor(0, (mVertexCount + chunk - 1) / chunk, [&](const size_t aChunk) {
+			for (size_t i = aChunk * chunk; i < std::min<size_t>(mVertexCount, (aChunk + 1) * chunk); i++) {
+				color[i * entries_per_vertex + 0] = c->x;
+				color[i * entries_per_vertex + 1] = c->y;
+				color[i * entries_per_vertex + 2] = c->z;
 			}
-			
+		});
+		mTargetRadianceBuffer.STC_UploadData(&stc, color.data(), mVertexCount * entries_per_vertex * sizeof(float));
+	}
+	if (w.has_value()) {
+		uint32_t floatBits = 0;
+		std::memcpy(&floatBits, &w.value(), sizeof(float));
+		stc.begin();
+		mTargetRadianceWeightsBuffer.CMD_FillBuffer(stc.buffer(), floatBits);
+		stc.end();
+	}
+	copyTargetToMesh(Common::getInstance().getRenderSystem()->getMainScene().get()->getSceneData());
+}
 
-			rIndex = cidx;
-			wIndex = widx;
+// only the slice of the mesh is uploaded and copied back to its vertex colors
+void LightTraceOptimizer::setTargetRadianceBufferForMesh(const tamashii::RefMesh* mesh, const std::optional<glm::vec3> c, const std::optional<float> w) const
+{
+	const auto it = mMeshVertexOffsets.find(mesh->mesh.get());
+	if (it == mMeshVertexOffsets.end()) return;
+	const size_t count = mesh->mesh->getVertexCount();
+
+	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
+	if (c.has_value()) {
+		std::vector<float> color(count * entries_per_vertex);
+		for (size_t i = 0; i < count; i++) {
+			color[i * entries_per_vertex + 0] = c->x;
+			color[i * entries_per_vertex + 1] = c->y;
+			color[i * entries_per_vertex + 2] = c->z;
 		}
+		mTargetRadianceBuffer.STC_UploadData(&stc, color.data(), color.size() * sizeof(float), it->second * entries_per_vertex * sizeof(float));
+	}
+	if (w.has_value()) {
+		const std::vector<float> weights(count, w.value());
+		mTargetRadianceWeightsBuffer.STC_UploadData(&stc, weights.data(), weights.size() * sizeof(float), it->second * sizeof(float));
+	}
+	copyTargetToMesh(mesh->mesh.get());
+}
+
+std::vector<Mesh*> LightTraceOptimizer::sceneMeshes(const tamashii::SceneBackendData& aScene) const
+{
+	std::vector<Mesh*> meshes;
+	for (const auto& model : aScene.models) {
+		for (const auto& mesh : model->getMeshList()) if (mMeshVertexOffsets.contains(mesh.get())) meshes.push_back(mesh.get());
 	}
+	return meshes;
+}
 
+bool LightTraceOptimizer::saveSnapshot(const std::string& aFile, const bool aCompress) const
+{
+	if (!mSceneReady) return false;
 	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
-	if (c.has_value()) mTargetRadianceBuffer.STC_UploadData(&stc, color.data(), mVertexCount * entries_per_vertex * sizeof(float));
-	if (w.has_value()) mTargetRadianceWeightsBuffer.STC_UploadData(&stc, weights.data(), mVertexCount * sizeof(float));
-	copyTargetToMesh(Common::getInstance().getRenderSystem()->getMainScene().get()->getSceneData());
+	std::vector<float> radiance(mVertexCount * entries_per_vertex);
+	std::vector<float> target(mVertexCount * entries_per_vertex);
+	std::vector<float> targetWeights(mVertexCount);
+	mRadianceBuffer.STC_DownloadData(&stc, radiance.data(), radiance.size() * sizeof(float));
+	mTargetRadianceBuffer.STC_DownloadData(&stc, target.data(), target.size() * sizeof(float));
+	mTargetRadianceWeightsBuffer.STC_DownloadData(&stc, targetWeights.data(), targetWeights.size() * sizeof(float));
+
+	const std::map<std::string, uint64_t> meta = {
+		{ "vertex_count", mVertexCount },
+		{ "entries_per_vertex", entries_per_vertex },
+		{ "sh_order", sphericalHarmonicOrder },
+		{ "basis", SNAPSHOT_BASIS }
+	};
+	const std::vector<tamashii::io::Snapshot::Section> sections = {
+		{ "radiance", radiance.data(), radiance.size() * sizeof(float), sizeof(float) },
+		{ "target", target.data(), target.size() * sizeof(float), sizeof(float) },
+		{ "target_weights", targetWeights.data(), targetWeights.size() * sizeof(float), sizeof(float) }
+	};
+	const bool ok = tamashii::io::Snapshot::write(aFile, meta, sections, aCompress ? tamashii::io::Snapshot::Compression::DEFLATE : tamashii::io::Snapshot::Compression::NONE);
+	if (ok) spdlog::info("Snapshot saved: {}", aFile);
+	return ok;
 }
 
-void LightTraceOptimizer::setTargetRadianceBufferForMesh(const tamashii::RefMesh* mesh, const std::optional<glm::vec3> c, const std::optional<float> w) const
+bool LightTraceOptimizer::loadSnapshot(const std::string& aFile, bool* aTargetLoaded)
 {
-	size_t rIndex = 0;
-	size_t wIndex = 0;
-	for (const auto& refModel : *mModels) {
-		for (const auto& refMesh : refModel->refMeshes) {
-			const size_t count = refMesh->mesh->getVertexCount();
-			if(refMesh.get() == mesh)
-			{
-				const size_t byteOffsetColor = rIndex * sizeof(float);
-				const size_t byteOffsetWeights = wIndex * sizeof(float);
-				const size_t byteSizeColor = count * entries_per_vertex * sizeof(float);
-				const size_t byteSizeWeights = count * sizeof(float);
-
-				std::vector<float> color(count * entries_per_vertex);
-				std::vector<float> weights(count);
-
-				uint32_t cidx = 0;
-				uint32_t widx = 0;
-				for (const vertex_s& v : *refMesh->mesh->getVerticesVector()) {
-					if (c.has_value()) {
-						color[cidx + 0] = c->x;
-						color[cidx + 1] = c->y;
-						color[cidx + 2] = c->z;
-					}
-					if (w.has_value()) weights[widx] = w.value();
-					cidx += entries_per_vertex;
-					widx++;
-				}
+	if (aTargetLoaded) *aTargetLoaded = false;
+	if (!mSceneReady) return false;
+	tamashii::io::Snapshot snapshot;
+	if (!snapshot.open(aFile) || !snapshotMatchesScene(snapshot, aFile)) return false;
+
+	// every section is decoded before the first upload so a broken file leaves the buffers untouched,
+	// uncompressed sections are uploaded straight from the mapping
+	struct Pending {
+		const rvk::Buffer*	mBuffer;
+		const void*			mData;
+		uint64_t			mSize;
+		std::vector<float>	mDecoded;
+	};
+	std::vector<Pending> pending;
+	pending.reserve(3);
+	auto decode = [&](const std::string& aSection, const rvk::Buffer& aBuffer, const uint64_t aCount, const bool aRequired) {
+		if (!snapshot.has(aSection)) {
+			if (aRequired) spdlog::error("Snapshot {} has no {} section", aFile, aSection);
+			return !aRequired;
+		}
+		const uint64_t size = aCount * sizeof(float);
+		if (snapshot.size(aSection) != size) {
+			spdlog::error("Snapshot {}: section {} has {} bytes, expected {}", aFile, aSection, snapshot.size(aSection), size);
+			return false;
+		}
+		Pending& p = pending.emplace_back(Pending{ &aBuffer, snapshot.view(aSection), size, {} });
+		if (p.mData) return true;
+		p.mDecoded.resize(aCount);
+		if (!snapshot.read(aSection, p.mDecoded.data(), size)) {
+			spdlog::error("Snapshot {}: could not read section {}", aFile, aSection);
+			return false;
+		}
+		p.mData = p.mDecoded.data();
+		return true;
+	};
+	if (!decode("radiance", mRadianceBuffer, mVertexCount * entries_per_vertex, true)
+		|| !decode("target", mTargetRadianceBuffer, mVertexCount * entries_per_vertex, false)
+		|| !decode("target_weights", mTargetRadianceWeightsBuffer, mVertexCount, false)) return false;
 
-				rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
-				if (c.has_value()) mTargetRadianceBuffer.STC_UploadData(&stc, color.data(), byteSizeColor, byteOffsetColor);
-				if (w.has_value()) mTargetRadianceWeightsBuffer.STC_UploadData(&stc, weights.data(), byteSizeWeights, byteOffsetWeights);
-				copyTargetToMesh(Common::getInstance().getRenderSystem()->getMainScene().get()->getSceneData());
-				return;
-			}
+	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
+	for (const Pending& p : pending) p.mBuffer->STC_UploadData(&stc, p.mData, p.mSize);
+	if (aTargetLoaded) *aTargetLoaded = snapshot.has("target");
+	spdlog::info("Snapshot loaded: {}", aFile);
+	return true;
+}
 
-			rIndex += entries_per_vertex * count;
-			wIndex += count;
-		}
+bool LightTraceOptimizer::snapshotMatchesScene(const tamashii::io::Snapshot& aSnapshot, const std::string& aFile) const
+{
+	if (aSnapshot.meta("vertex_count") != mVertexCount || aSnapshot.meta("entries_per_vertex") != static_cast<uint64_t>(entries_per_vertex)
+		|| aSnapshot.meta("sh_order") != static_cast<uint64_t>(sphericalHarmonicOrder)) {
+		spdlog::error("Snapshot {} does not match the scene ({} vertices, {} entries per vertex)", aFile, mVertexCount, entries_per_vertex);
+		return false;
+	}
+	if (aSnapshot.meta("basis") != SNAPSHOT_BASIS) {
+		spdlog::error("Snapshot {} was stored in a different radiance basis (expected {})", aFile, SNAPSHOT_BASIS == 2 ? "HSH" : SNAPSHOT_BASIS == 1 ? "SH" : "RGB");
+		return false;
 	}
+	return true;
+}
+
+bool LightTraceOptimizer::readSnapshotTarget(const std::string& aFile, std::vector<float>& aTarget, std::vector<float>& aWeights) const
+{
+	tamashii::io::Snapshot snapshot;
+	if (!snapshot.open(aFile) || !snapshotMatchesScene(snapshot, aFile)) return false;
+	if (!snapshot.has("target")) {
+		spdlog::error("Snapshot {} has no target", aFile);
+		return false;
+	}
+	aTarget.resize(mVertexCount * entries_per_vertex);
+	if (!snapshot.read("target", aTarget.data(), aTarget.size() * sizeof(float))) return false;
+	if (!snapshot.has("target_weights")) {
+		aWeights.clear();
+		return true;
+	}
+	aWeights.resize(mVertexCount);
+	return snapshot.read("target_weights", aWeights.data(), aWeights.size() * sizeof(float));
+}
+
+void LightTraceOptimizer::downloadTarget(std::vector<float>& aTarget, std::vector<float>& aWeights) const
+{
+	aTarget.resize(mVertexCount * entries_per_vertex);
+	aWeights.resize(mVertexCount);
+	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
+	mTargetRadianceBuffer.STC_DownloadData(&stc, aTarget.data(), aTarget.size() * sizeof(float));
+	mTargetRadianceWeightsBuffer.STC_DownloadData(&stc, aWeights.data(), aWeights.size() * sizeof(float));
+}
+
+bool LightTraceOptimizer::uploadTarget(const std::vector<float>& aTarget, const std::vector<float>& aWeights) const
+{
+	if (aTarget.size() != mVertexCount * entries_per_vertex || (!aWeights.empty() && aWeights.size() != mVertexCount)) {
+		spdlog::error("ialt: target needs {} values and {} weights, got {} and {}", mVertexCount * entries_per_vertex, mVertexCount, aTarget.size(), aWeights.size());
+		return false;
+	}
+	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
+	mTargetRadianceBuffer.STC_UploadData(&stc, aTarget.data(), aTarget.size() * sizeof(float));
+	if (!aWeights.empty()) mTargetRadianceWeightsBuffer.STC_UploadData(&stc, aWeights.data(), aWeights.size() * sizeof(float));
+	else {
+		constexpr float one = 1.0f;
+		uint32_t floatBits = 0;
+		std::memcpy(&floatBits, &one, sizeof(float));
+		stc.begin();
+		mTargetRadianceWeightsBuffer.CMD_FillBuffer(stc.buffer(), floatBits);
+		stc.end();
+	}
+	return true;
 }
 
 rvk::Buffer* LightTraceOptimizer::getTargetRadianceBuffer()
@@ -589,6 +912,13 @@ rvk::Descriptor* LightTraceOptimizer::getAdjointDescriptor()
 	return &mAdjointDescriptor;
 }
 
+void LightTraceOptimizer::geometryBuffersChanged()
+{
+	mAdjointDescriptor.setBuffer(ADJOINT_DESC_INDEX_BUFFER_BINDING, mGpuBlas->getIndexBuffer());
+	mAdjointDescriptor.setBuffer(ADJOINT_DESC_VERTEX_BUFFER_BINDING, mGpuBlas->getVertexBuffer());
+	mAdjointDescriptor.update();
+}
+
 LightOptParams& LightTraceOptimizer::optimizationParametersByLightRef(const Ref& ref)
 {
 	updateLightParamsIfNecessary();
@@ -627,6 +957,13 @@ void LightTraceOptimizer::sceneLoad(const tamashii::SceneBackendData aScene, con
 	mMaterials = &aScene.materials;
 	mVertexCount = aVertexCount;
 
+	// the radiance buffers are indexed like the vertex buffer, which is dense and in scene order
+	mMeshVertexOffsets.clear();
+	for (const auto& model : aScene.models) {
+		for (const auto& mesh : model->getMeshList()) mMeshVertexOffsets[mesh.get()] = mGpuBlas->getOffset(mesh.get()).mVertexOffset;
+	}
+	if (mGpuBlas->getOffset().mVertexOffset != mVertexCount) spdlog::error("ialt: vertex buffer holds {} vertices, the scene {}", mGpuBlas->getOffset().mVertexOffset, mVertexCount);
+
 	
 	mTriangleCount = 0;
 	for (const auto refModel : aScene.refModels) {
@@ -658,6 +995,11 @@ void LightTraceOptimizer::sceneLoad(const tamashii::SceneBackendData aScene, con
 	importLightSettings();
 
 	mRadianceBuffer.create(rvk::Buffer::Use::STORAGE | rvk::Buffer::Use::VERTEX, mVertexCount * entries_per_vertex * sizeof(float), rvk::Buffer::Location::DEVICE);
+	// the fixed point radiance is only allocated in full while deterministic accumulation is on
+	mRadianceFixedBuffer.create(rvk::Buffer::Use::STORAGE, (vars::deterministicAccumulation ? mVertexCount * entries_per_vertex : 1) * sizeof(int64_t), rvk::Buffer::Location::DEVICE);
+	const uint64_t objFuncGroups = ((mVertexCount + OBJ_FUNC_WORKGROUP_SIZE - 1) / OBJ_FUNC_WORKGROUP_SIZE) * entries_per_vertex;
+	mPhiBuffer.destroy();
+	mPhiBuffer.create(rvk::Buffer::Use::STORAGE | rvk::Buffer::Use::DOWNLOAD, (1 + objFuncGroups) * sizeof(double), rvk::Buffer::Location::DEVICE);
 	mTargetRadianceBuffer.create(rvk::Buffer::Use::STORAGE | rvk::Buffer::Use::VERTEX, mVertexCount * entries_per_vertex * sizeof(float), rvk::Buffer::Location::DEVICE);
 	mTargetRadianceWeightsBuffer.create(rvk::Buffer::Use::STORAGE | rvk::Buffer::Use::VERTEX, mVertexCount * sizeof(float), rvk::Buffer::Location::DEVICE);
 
@@ -764,6 +1106,29 @@ void LightTraceOptimizer::sceneLoad(const tamashii::SceneBackendData aScene, con
 	mInfoBuffer.STC_UploadData(&stc, &afi, sizeof(afi));
 
 	mLightDerivativesBuffer.create(rvk::Buffer::Use::STORAGE | rvk::Buffer::Use::UPLOAD, std::max(1u, mGpuLd->getLightCount()) * sizeof(LightGrads), rvk::Buffer::Location::DEVICE);
+	mLightRayOffsetsBuffer.create(rvk::Buffer::Use::STORAGE | rvk::Buffer::Use::UPLOAD, (mGpuLd->getLightCount() + 1) * sizeof(uint32_t), rvk::Buffer::Location::DEVICE);
+
+	
+	mEmitterArea.clear();
+	for (const auto& refModel : aScene.refModels) {
+		for (const auto& refMesh : refModel->refMeshes) {
+			if (!refMesh->mesh->getMaterial()->isLight()) continue;
+			const Mesh& mesh = *refMesh->mesh;
+			const vertex_s* vertices = mesh.getVerticesArray();
+			const uint32_t* indices = mesh.hasIndices() ? mesh.getIndicesArray() : nullptr;
+			double area = 0.0;
+			for (size_t t = 0; t < refMesh->mesh->getPrimitiveCount(); ++t) {
+				const size_t i0 = indices ? indices[3 * t] : 3 * t;
+				const size_t i1 = indices ? indices[3 * t + 1] : 3 * t + 1;
+				const size_t i2 = indices ? indices[3 * t + 2] : 3 * t + 2;
+				const glm::vec3 v0 = glm::vec3(refModel->model_matrix * vertices[i0].position);
+				const glm::vec3 v1 = glm::vec3(refModel->model_matrix * vertices[i1].position);
+				const glm::vec3 v2 = glm::vec3(refModel->model_matrix * vertices[i2].position);
+				area += 0.5 * glm::length(glm::cross(v1 - v0, v2 - v0));
+			}
+			mEmitterArea[refMesh.get()] = area;
+		}
+	}
 
 
 	
@@ -803,6 +1168,9 @@ void LightTraceOptimizer::sceneLoad(const tamashii::SceneBackendData aScene, con
 	mAdjointDescriptor.setBuffer(ADJOINT_DESC_LIGHT_DERIVATIVES_BUFFER_BINDING, &mLightDerivativesBuffer);
 	mAdjointDescriptor.setBuffer(ADJOINT_DESC_LIGHT_TEXTURE_DERIVATIVES_BUFFER_BINDING, &mLightTextureDerivativesBuffer);
 	mAdjointDescriptor.setBuffer(ADJOINT_DESC_TRIANGLE_BUFFER_BINDING, &mTriangleBuffer);
+	mAdjointDescriptor.setBuffer(ADJOINT_DESC_LIGHT_RAY_OFFSETS_BUFFER_BINDING, &mLightRayOffsetsBuffer);
+	mAdjointDescriptor.setBuffer(ADJOINT_DESC_LIGHT_ALIAS_TABLE_BUFFER_BINDING, mGpuLd->getAliasTableBuffer());
+	mAdjointDescriptor.setBuffer(ADJOINT_DESC_RADIANCE_FIXED_BUFFER_BINDING, &mRadianceFixedBuffer);
 	mAdjointDescriptor.update();
 
 	mObjFuncDescriptor.setBuffer(OBJ_DESC_RADIANCE_BUFFER_BINDING, &mRadianceBuffer);
@@ -812,6 +1180,7 @@ void LightTraceOptimizer::sceneLoad(const tamashii::SceneBackendData aScene, con
 	mObjFuncDescriptor.setBuffer(OBJ_DESC_CHANNEL_WEIGHTS_BUFFER_BINDING, &mChannelWeightsBuffer);
 	mObjFuncDescriptor.setBuffer(OBJ_DESC_PHI_BUFFER_BINDING, &mPhiBuffer);
 	mObjFuncDescriptor.setBuffer(OBJ_DESC_VERTEX_COLOR_BUFFER_BINDING, &mVertexColorBuffer);
+	mObjFuncDescriptor.setBuffer(OBJ_DESC_RADIANCE_FIXED_BUFFER_BINDING, &mRadianceFixedBuffer);
 	mObjFuncDescriptor.update();
 
 	clearHistory();
@@ -822,6 +1191,7 @@ void LightTraceOptimizer::sceneUnload(tamashii::SceneBackendData aScene)
 {
 	mSceneReady = false;
 	mRadianceBuffer.destroy();
+	mRadianceFixedBuffer.destroy();
 	mTargetRadianceBuffer.destroy();
 	mTargetRadianceWeightsBuffer.destroy();
 	mVertexAreaBuffer.destroy();
@@ -829,6 +1199,14 @@ void LightTraceOptimizer::sceneUnload(tamashii::SceneBackendData aScene)
 	mLightDerivativesBuffer.destroy();
 	mLightTextureDerivativesBuffer.destroy();
 	mTriangleBuffer.destroy();
+	mLightRayOffsetsBuffer.destroy();
+	mEmitterArea.clear();
+	mRayAllocation = {};
+
+	
+	mLaplacian.resize(0, 0);
+	mLaplacianDiagonal.clear();
+	mSmoothingFactorized = false;
 }
 
 void LightTraceOptimizer::destroy()
@@ -847,6 +1225,8 @@ void LightTraceOptimizer::destroy()
 	mBackwardPTPipeline.destroy();
 	mObjFuncShader.destroy();
 	mObjFuncPipeline.destroy();
+	mResolveShader.destroy();
+	mResolvePipeline.destroy();
 	mInfoBuffer.destroy();
 	mChannelWeightsBuffer.destroy();
 	mPhiBuffer.destroy();
@@ -941,6 +1321,7 @@ void LightTraceOptimizer::exportLightSettings()
 LBFGSppWrapperResult LightTraceOptimizer::optimize(const uint32_t aOptimizer, rvk::Buffer* aRadianceBufferOut, float aStepSize, int aMaxIters) {
 	if (!mGpuLd->getLightCount())
 		return { 0, 0 };
+	T_PROFILE_SCOPE("optimize");
 
 	optimizationRunning(true);
 	mForwardTimeCount = 0;
@@ -950,13 +1331,8 @@ LBFGSppWrapperResult LightTraceOptimizer::optimize(const uint32_t aOptimizer, rv
 	const auto start = std::chrono::high_resolution_clock::now();
 	clearHistory();
 	
-	if (mLightDerivativesBuffer.getSize() < sizeof(LightGrads) * mGpuLd->getLightCount()) {
-		
-		mLightDerivativesBuffer.destroy();
-		mLightDerivativesBuffer.create(rvk::Buffer::Use::STORAGE, mGpuLd->getLightCount() * sizeof(LightGrads), rvk::Buffer::Location::DEVICE);
-		mAdjointDescriptor.setBuffer(ADJOINT_DESC_LIGHT_DERIVATIVES_BUFFER_BINDING, &mLightDerivativesBuffer);
-		mAdjointDescriptor.update();
-	}
+	ensureLightDerivativesBuffer();
+	beginAdaptiveRays();
 
 	lightsToParameterVector(mParams); 
 
@@ -1047,6 +1423,12 @@ LBFGSppWrapperResult LightTraceOptimizer::optimize(const uint32_t aOptimizer, rv
 	spdlog::info("\tavg. forward time:\t\t{} milliseconds", (mForwardTimeSum / mForwardTimeCount) / 1000.0f);
 	spdlog::info("\tavg. backward time:\t\t{} milliseconds", (mBackwardTimeSum / mBackwardTimeCount) / 1000.0f);
 	spdlog::info("\ttotal time:\t\t\t{} seconds ", static_cast<float>(time.count()) / 1000000.0f);
+	spdlog::info("\tlt rays traced in total:\t{} rays", mTracedRays);
+	if (mAdaptiveRays.mActive) {
+		const auto raysX = static_cast<uint64_t>(vars::numRaysXperLight.value());
+		spdlog::info("\tadaptive rays per light:\t{} to {} (last {}, {} decisions, last snr {:.3g})", raysX * mAdaptiveRays.mLowestY,
+			raysX * mAdaptiveRays.mHighestY, raysX * mAdaptiveRays.mRaysY, mAdaptiveRays.mDecisions, mAdaptiveRays.mSnr);
+	}
 	if(vars::usePathTracing[0]) spdlog::info("\tpt forward rays spawned per iteration:\t{} rays", vars::numRaysPerTriangle * mLights->size() * mTriangleCount);
 	else spdlog::info("\tlt forward rays spawned per iteration:\t{} rays", vars::numRaysXperLight * vars::numRaysYperLight * mLights->size());
 	if (vars::usePathTracing[1]) spdlog::info("\tpt backward rays spawned per iteration:\t{} rays", vars::numRaysPerTriangle * mLights->size() * mTriangleCount);
@@ -1061,12 +1443,60 @@ LBFGSppWrapperResult LightTraceOptimizer::optimize(const uint32_t aOptimizer, rv
 	spdlog::info("\ttriangle count:\t\t\t{}", mTriangleCount);
 	spdlog::info("\tlight count:\t\t\t{}", mLights->size());
 
+	endAdaptiveRays();
 	forward(mParams, aRadianceBufferOut); 
 	optimizationRunning(false);
 
 	return { .bestObjectiveValue = result.bestObjectiveValue, .lastPhi = result.lastPhi };
 }
 
+GradientCheck::Report LightTraceOptimizer::gradientCheck(const GradientCheck::Settings& aSettings, rvk::Buffer* aRadianceBufferOut)
+{
+	if (!mGpuLd->getLightCount()) {
+		spdlog::warn("gradient check: scene has no lights");
+		return { "scene", aSettings, 0.0, 0.0, 0.0, 0.0, 0.0, 0, false, {} };
+	}
+
+	optimizationRunning(true);
+	ensureLightDerivativesBuffer();
+	lightsToParameterVector(mParams);
+	lightTextureToParameterVector(mParams);
+
+	// names follow the layout of lightsToParameterVector, emissive texture texels are not checked
+	std::vector<GradientCheck::Parameter> checked;
+	uint32_t lightIndex = 0;
+	for (const auto& pair : mLightParams) {
+		const std::string prefix = (pair.first->type == Ref::Type::Light ? "light" : "mesh") + std::to_string(lightIndex) + ".";
+		for (uint32_t k = 0; k < LightOptParams::MAX_PARAMS; ++k) {
+			if (pair.second.mOptimize[k]) checked.push_back({ LightOptParams::getParameterIndex(lightIndex, k), prefix + LightOptParams::names[k] });
+		}
+		lightIndex++;
+	}
+
+	// one device and shared buffers, so evaluations run one after another but all with the same seed
+	GradientCheck::Settings settings = aSettings;
+	settings.mConcurrent = false;
+	const bool constRandSeed = vars::constRandSeed.value();
+	const uint32_t fwdSimCount = mFwdSimCount;
+	vars::constRandSeed.value(true);
+	const GradientCheck::Evaluator evaluator = [this, aRadianceBufferOut](const Eigen::VectorXd& aParams, const uint32_t aSeed, Eigen::VectorXd* aGradient) {
+		Eigen::VectorXd params = aParams;
+		Eigen::VectorXd grads;
+		mFwdSimCount = aSeed;
+		forward(params, aRadianceBufferOut);
+		const double phi = backward(grads);
+		if (aGradient) *aGradient = grads;
+		return phi;
+	};
+	GradientCheck::Report report = GradientCheck::run("scene", evaluator, mParams, checked, settings);
+
+	vars::constRandSeed.value(constRandSeed);
+	mFwdSimCount = fwdSimCount;
+	forward(mParams, aRadianceBufferOut);
+	optimizationRunning(false);
+	return report;
+}
+
 void LightTraceOptimizer::optimizationRunning(const bool aRun)
 {
 	std::lock_guard guard(mOptimizationMutex); mOptimizationRunning = aRun;
@@ -1077,9 +1507,17 @@ bool LightTraceOptimizer::optimizationRunning()
 	std::lock_guard guard(mOptimizationMutex); return mOptimizationRunning;
 }
 
+void LightTraceOptimizer::applyParameterVector(Eigen::VectorXd& aParams)
+{
+	parameterVectorToLights(aParams);
+	parameterVectorToLightTexture(aParams);
+}
+
 void LightTraceOptimizer::forward(Eigen::VectorXd& aParams, rvk::Buffer* aRadianceBufferOut)
 {
 	if (!mSceneReady || !mGpuLd->getLightCount()) return;
+	T_PROFILE_SCOPE("forward");
+	ScopedTimer setupTimer("forward setup");
 	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
 
 	std::stringstream pstr; pstr << aParams.segment(0,std::min(aParams.size(),(Eigen::Index)20)).transpose();
@@ -1091,21 +1529,35 @@ void LightTraceOptimizer::forward(Eigen::VectorXd& aParams, rvk::Buffer* aRadian
 	parameterVectorToLightTexture(aParams);
 
 	AdjointInfo_s afi{};
-	afi.seed = mFwdSimCount;
+	afi.seed = mAdaptiveRays.mSeed = mFwdSimCount;
 	if (!vars::constRandSeed) ++mFwdSimCount;
 	afi.light_count = mGpuLd->getLightCount();
 	afi.bounces = mBounces;
 	afi.triangle_count = static_cast<uint32_t>(mTriangleCount);
 	afi.tri_rays = vars::numRaysPerTriangle.value();
 	afi.sam_rays = vars::numSamples.value();
+	afi.ray_count = updateRayAllocation();
+	mDeterministic = vars::deterministicAccumulation.value() && !mForwardPT && !mBackwardPT;
+	mFixedPointScale = std::ldexp(1.0f, static_cast<int>(std::clamp(vars::fixedPointBits.value(), 1u, 62u)));
+	if (mDeterministic) ensureRadianceFixedBuffer();
+	afi.deterministic = mDeterministic;
+	afi.fixed_point_scale = mFixedPointScale;
 	std::memcpy(mCpuBuffer.getMemoryPointer(), &afi, sizeof(afi));
+	setupTimer.stop();
 
 	const auto start = std::chrono::high_resolution_clock::now();
+	ScopedTimer recordTimer("forward record");
 	stc.begin();
 	mCpuBuffer.CMD_CopyBuffer(stc.buffer(), &mInfoBuffer, 0u, sizeof(AdjointInfo_s));
 	stc.buffer()->cmdBufferMemoryBarrier(&mInfoBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
-	mRadianceBuffer.CMD_FillBuffer(stc.buffer(), 0);
-	stc.buffer()->cmdBufferMemoryBarrier(&mRadianceBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+	if (mDeterministic) {
+		mRadianceFixedBuffer.CMD_FillBuffer(stc.buffer(), 0);
+		stc.buffer()->cmdBufferMemoryBarrier(&mRadianceFixedBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	}
+	else {
+		mRadianceBuffer.CMD_FillBuffer(stc.buffer(), 0);
+		stc.buffer()->cmdBufferMemoryBarrier(&mRadianceBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+	}
 
 	if (mForwardPT) {
 		mForwardPTPipeline.CMD_BindDescriptorSets(stc.buffer(), { mGpuTd->getDescriptor(), &mAdjointDescriptor });
@@ -1116,7 +1568,20 @@ void LightTraceOptimizer::forward(Eigen::VectorXd& aParams, rvk::Buffer* aRadian
 	{
 		mForwardPipeline.CMD_BindDescriptorSets(stc.buffer(), { mGpuTd->getDescriptor(), &mAdjointDescriptor });
 		mForwardPipeline.CMD_BindPipeline(stc.buffer());
-		mForwardPipeline.CMD_TraceRays(stc.buffer(), vars::numRaysXperLight, vars::numRaysYperLight, static_cast<uint32_t>(mGpuLd->getLightCount()));
+		if (mRayAllocation.mRayCount) mForwardPipeline.CMD_TraceRays(stc.buffer(), mRayAllocation.mWidth, mRayAllocation.mHeight, 1);
+		else mForwardPipeline.CMD_TraceRays(stc.buffer(), vars::numRaysXperLight, raysYperLight(), static_cast<uint32_t>(mGpuLd->getLightCount()));
+		mTracedRays += mRayAllocation.mRayCount ? mRayAllocation.mRayCount : static_cast<uint64_t>(vars::numRaysXperLight) * raysYperLight() * mGpuLd->getLightCount();
+	}
+	if (mDeterministic) {
+		stc.buffer()->cmdBufferMemoryBarrier(&mRadianceFixedBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		mResolvePipeline.CMD_BindDescriptorSets(stc.buffer(), { &mObjFuncDescriptor });
+		mResolvePipeline.CMD_BindPipeline(stc.buffer());
+		const auto vertexCount = static_cast<uint32_t>(mVertexCount);
+		mResolvePipeline.CMD_SetPushConstant(stc.buffer(), rvk::Shader::Stage::COMPUTE, 0, sizeof(uint32_t), &vertexCount);
+		mResolvePipeline.CMD_SetPushConstant(stc.buffer(), rvk::Shader::Stage::COMPUTE, sizeof(uint32_t), sizeof(float), &mFixedPointScale);
+		const uint32_t dispatchSizeX = (vertexCount / OBJ_FUNC_WORKGROUP_SIZE) + (vertexCount % OBJ_FUNC_WORKGROUP_SIZE ? 1u : 0u);
+		mResolvePipeline.CMD_Dispatch(stc.buffer(), dispatchSizeX, entries_per_vertex);
+		stc.buffer()->cmdBufferMemoryBarrier(&mRadianceBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
 	}
 	
 	
@@ -1137,7 +1602,10 @@ void LightTraceOptimizer::forward(Eigen::VectorXd& aParams, rvk::Buffer* aRadian
 		mRadianceBuffer.CMD_CopyBuffer(stc.buffer(), aRadianceBufferOut);
 
 	}
+	recordTimer.stop();
+	ScopedTimer waitTimer("forward gpu wait");
 	stc.end();
+	waitTimer.stop();
 	mForwardTimeCount++;
 	mForwardTimeSum += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
 	
@@ -1193,6 +1661,7 @@ void LightTraceOptimizer::forward(Eigen::VectorXd& aParams, rvk::Buffer* aRadian
 double LightTraceOptimizer::backward(Eigen::VectorXd& aDerivParams)
 {
 	if (!mSceneReady || !mGpuLd->getLightCount()) return 0;
+	T_PROFILE_SCOPE("backward");
 	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
 
 	const auto start = std::chrono::high_resolution_clock::now();
@@ -1205,13 +1674,17 @@ double LightTraceOptimizer::backward(Eigen::VectorXd& aDerivParams)
 		x.resize(static_cast<Eigen::Index>(mVertexCount * entries_per_vertex)); x.setZero(); 
 		dx.resizeLike(x); dx.setZero();
 
+		ScopedTimer downloadTimer("backward download radiance");
 		mRadianceBuffer.STC_DownloadData(&stc, x.data(), x.size() * sizeof(float)); 
+		downloadTimer.stop();
 
 		
 		
 
 		
+		ScopedTimer objectiveTimer("backward objective");
 		phi = static_cast<double>((*mObjFcn)(x, dx)); 
+		objectiveTimer.stop();
 
 		
 		
@@ -1226,21 +1699,24 @@ double LightTraceOptimizer::backward(Eigen::VectorXd& aDerivParams)
 		
 
 		
+		ScopedTimer uploadTimer("backward upload adjoint");
 		mRadianceBuffer.STC_UploadData(&stc, dx.data(), dx.size() * sizeof(float)); 
-		stc.begin();
+		uploadTimer.stop();
 	}
-	else {
-		stc.begin();
+	ScopedTimer recordTimer("backward record");
+	stc.begin();
+	if (vars::objFuncOnGpu) {
 		mPhiBuffer.CMD_FillBuffer(stc.buffer(), 0);
 		stc.buffer()->cmdBufferMemoryBarrier(&mPhiBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
 		mObjFuncPipeline.CMD_BindDescriptorSets(stc.buffer(), { &mObjFuncDescriptor });
 		mObjFuncPipeline.CMD_BindPipeline(stc.buffer());
-		const auto vertexCount = static_cast<uint32_t>(mVertexCount);
-		mObjFuncPipeline.CMD_SetPushConstant(stc.buffer(), rvk::Shader::Stage::COMPUTE, 0, sizeof(uint32_t), &vertexCount);
+		const uint32_t pushConstants[2] = { static_cast<uint32_t>(mVertexCount), mDeterministic };
+		const uint32_t vertexCount = pushConstants[0];
+		mObjFuncPipeline.CMD_SetPushConstant(stc.buffer(), rvk::Shader::Stage::COMPUTE, 0, sizeof(pushConstants), pushConstants);
 		const uint32_t dispatchSizeX = (vertexCount / OBJ_FUNC_WORKGROUP_SIZE) + (vertexCount % OBJ_FUNC_WORKGROUP_SIZE ? 1u : 0u);
 		mObjFuncPipeline.CMD_Dispatch(stc.buffer(), dispatchSizeX, entries_per_vertex);
 		stc.buffer()->cmdBufferMemoryBarrier(&mPhiBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
-		mPhiBuffer.CMD_CopyBuffer(stc.buffer(), &mCpuBuffer);
+		if (!mDeterministic) mPhiBuffer.CMD_CopyBuffer(stc.buffer(), &mCpuBuffer, 0, sizeof(double));
 		stc.buffer()->cmdBufferMemoryBarrier(&mRadianceBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
 	}
 
@@ -1256,32 +1732,58 @@ double LightTraceOptimizer::backward(Eigen::VectorXd& aDerivParams)
 		mBackwardPTPipeline.CMD_BindPipeline(stc.buffer());
 		mBackwardPTPipeline.CMD_TraceRays(stc.buffer(), mTriangleCount, vars::numRaysPerTriangle, mGpuLd->getLightCount());
 	}
-	else
+	else if (!mAdaptiveRays.mActive)
 	{
 		mBackwardPipeline.CMD_BindDescriptorSets(stc.buffer(), { mGpuTd->getDescriptor(), &mAdjointDescriptor });
 		mBackwardPipeline.CMD_BindPipeline(stc.buffer());
-		mBackwardPipeline.CMD_TraceRays(stc.buffer(), vars::numRaysXperLight, vars::numRaysYperLight, mGpuLd->getLightCount());
+		if (mRayAllocation.mRayCount) mBackwardPipeline.CMD_TraceRays(stc.buffer(), mRayAllocation.mWidth, mRayAllocation.mHeight, 1);
+		else mBackwardPipeline.CMD_TraceRays(stc.buffer(), vars::numRaysXperLight, raysYperLight(), mGpuLd->getLightCount());
+		mTracedRays += mRayAllocation.mRayCount ? mRayAllocation.mRayCount : static_cast<uint64_t>(vars::numRaysXperLight) * raysYperLight() * mGpuLd->getLightCount();
 	}
+	recordTimer.stop();
 
+	ScopedTimer waitTimer("backward gpu wait");
 	stc.end();
-	if (vars::objFuncOnGpu) {
+	waitTimer.stop();
+	ScopedTimer phiTimer("backward download objective");
+	if (vars::objFuncOnGpu && mDeterministic) {
+		const auto vertexCount = static_cast<uint32_t>(mVertexCount);
+		const uint32_t groups = ((vertexCount / OBJ_FUNC_WORKGROUP_SIZE) + (vertexCount % OBJ_FUNC_WORKGROUP_SIZE ? 1u : 0u)) * entries_per_vertex;
+		std::vector<double> partials(1 + groups);
+		mPhiBuffer.STC_DownloadData(&stc, partials.data(), partials.size() * sizeof(double));
+		phi = pairwiseSum(partials.data() + 1, groups);
+	}
+	else if (vars::objFuncOnGpu) {
 		const auto phiPtr = reinterpret_cast<double*>(mCpuBuffer.getMemoryPointer());
 		phi = *phiPtr;
 	}
+	phiTimer.stop();
 
-	lightDerivativesToVector(aDerivParams);
+	ScopedTimer gradientTimer("backward gradient");
+	const bool batched = !mBackwardPT && mAdaptiveRays.mActive;
+	if (batched) backwardBatched(stc, aDerivParams);
+	else lightDerivativesToVector(aDerivParams);
+	if (!mBackwardPT) updateRayAllocationStatistics(aDerivParams);
+	gradientTimer.stop();
 
 	
+	ScopedTimer constraintTimer("backward constraints");
 	double phiC = 0.0;
 	for (LightConstraint* lc : mConstraints)
 	{
 		phiC += lc->evalAndAddToGradient(aDerivParams); 
 	}
+	constraintTimer.stop();
 
 	const Eigen::VectorXd derivParams = aDerivParams;
 	LightOptParams::reduceVectorToActiveParams(aDerivParams, derivParams, mLightParams);
 
+	const Eigen::Index lightParamCount = aDerivParams.size();
+	ScopedTimer textureTimer("backward texture gradient");
 	double phiT = lightTextureDerivativesToVector(aDerivParams); 
+	textureTimer.stop();
+	// the texture derivatives accumulate over all batches, each normalized by its own ray count
+	if (batched) aDerivParams.tail(aDerivParams.size() - lightParamCount) /= static_cast<double>(mAdaptiveRays.mBatches);
 
 	mBackwardTimeCount++;
 	mBackwardTimeSum += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
@@ -1333,6 +1835,248 @@ std::deque<Eigen::VectorXd> LightTraceOptimizer::exportHistory()
 	return hist;
 }
 
+void LightTraceOptimizer::ensureLightDerivativesBuffer()
+{
+	if (mLightDerivativesBuffer.getSize() < sizeof(LightGrads) * mGpuLd->getLightCount()) {
+		
+		mLightDerivativesBuffer.destroy();
+		mLightDerivativesBuffer.create(rvk::Buffer::Use::STORAGE, mGpuLd->getLightCount() * sizeof(LightGrads), rvk::Buffer::Location::DEVICE);
+		mAdjointDescriptor.setBuffer(ADJOINT_DESC_LIGHT_DERIVATIVES_BUFFER_BINDING, &mLightDerivativesBuffer);
+		mAdjointDescriptor.update();
+	}
+}
+
+void LightTraceOptimizer::ensureRadianceFixedBuffer()
+{
+	const uint64_t size = mVertexCount * entries_per_vertex * sizeof(int64_t);
+	if (mRadianceFixedBuffer.getSize() >= size) return;
+	mRoot.device.waitIdle();
+	mRadianceFixedBuffer.destroy();
+	mRadianceFixedBuffer.create(rvk::Buffer::Use::STORAGE, size, rvk::Buffer::Location::DEVICE);
+	mAdjointDescriptor.setBuffer(ADJOINT_DESC_RADIANCE_FIXED_BUFFER_BINDING, &mRadianceFixedBuffer);
+	mAdjointDescriptor.update();
+	mObjFuncDescriptor.setBuffer(OBJ_DESC_RADIANCE_FIXED_BUFFER_BINDING, &mRadianceFixedBuffer);
+	mObjFuncDescriptor.update();
+}
+
+void LightTraceOptimizer::fixedPointToDouble(void* aData, const size_t aCount) const
+{
+	// the buffers hold int64 values in deterministic mode, converted in place
+	const auto bits = static_cast<int64_t*>(aData);
+	const auto values = static_cast<double*>(aData);
+	for (size_t i = 0; i < aCount; i++) {
+		int64_t fixed;
+		std::memcpy(&fixed, bits + i, sizeof(int64_t));
+		const double value = static_cast<double>(fixed) / static_cast<double>(mFixedPointScale);
+		std::memcpy(values + i, &value, sizeof(double));
+	}
+}
+
+double LightTraceOptimizer::estimateLightFlux(const tamashii::Ref* aRef) const
+{
+	// mirrors the flux of one light sample in generateLightRay (ialt_unified.glsl) times the number of samples
+	const auto luminance = [](const glm::vec3 aColor) { return std::max(0.0f, 0.2126f * aColor.x + 0.7152f * aColor.y + 0.0722f * aColor.z); };
+	if (aRef->type == Ref::Type::Mesh) {
+		const auto* refMesh = static_cast<const RefMesh*>(aRef);
+		const Material* material = refMesh->mesh->getMaterial();
+		const auto it = mEmitterArea.find(const_cast<tamashii::Ref*>(aRef));
+		const double area = it != mEmitterArea.end() ? it->second : 0.0;
+		return M_PI * area * material->getEmissionStrength() * luminance(material->getEmissionFactor());
+	}
+	const Light& light = *static_cast<const RefLight*>(aRef)->light;
+	double flux = light.getIntensity() * luminance(light.getColor());
+	if (light.getType() == Light::Type::SPOT) flux *= 0.5 * (1.0 - std::cos(static_cast<const SpotLight&>(light).getOuterConeAngle()));
+	else if (light.getType() == Light::Type::SURFACE) flux *= 0.25;
+	return flux;
+}
+
+uint32_t LightTraceOptimizer::updateRayAllocation()
+{
+	const uint32_t lightCount = mGpuLd->getLightCount();
+	const uint64_t raysPerLight = static_cast<uint64_t>(vars::numRaysXperLight.value()) * vars::numRaysYperLight.value();
+	mRayAllocation.mRayCount = 0;
+	if (vars::rayAllocation.value() == 0 || lightCount < 2 || !raysPerLight || lightCount != mLightParams.size()) return 0;
+
+	
+	std::vector<double> flux(lightCount, 0.0), deviation(lightCount, 0.0);
+	const bool useVariance = vars::rayAllocation.value() == 2 && mRayAllocation.mGradSamples >= 2 &&
+		mRayAllocation.mGradSqNorm.size() == static_cast<Eigen::Index>(lightCount) && mRayAllocation.mRays.size() == lightCount;
+	uint32_t lightIndex = 0;
+	for (const auto& [ref, params] : mLightParams) {
+		const int gpuIndex = ref->type == Ref::Type::Mesh ? mGpuLd->getIndex(static_cast<RefMesh*>(ref)) : mGpuLd->getIndex(static_cast<RefLight*>(ref));
+		if (gpuIndex >= 0 && static_cast<uint32_t>(gpuIndex) < lightCount) {
+			flux[gpuIndex] = estimateLightFlux(ref);
+			if (useVariance) {
+				
+				const double variance = std::max(0.0, mRayAllocation.mGradSqNorm[lightIndex] - mRayAllocation.mGradMean.col(lightIndex).squaredNorm());
+				deviation[gpuIndex] = std::sqrt(variance * mRayAllocation.mRays[gpuIndex]);
+			}
+		}
+		lightIndex++;
+	}
+	const double fluxSum = std::accumulate(flux.begin(), flux.end(), 0.0);
+	const double deviationSum = std::accumulate(deviation.begin(), deviation.end(), 0.0);
+	if (!(fluxSum > 0.0) || !std::isfinite(fluxSum)) return 0;
+	
+	std::vector<double> weights(lightCount);
+	for (uint32_t i = 0; i < lightCount; ++i) {
+		weights[i] = flux[i] / fluxSum;
+		if (deviationSum > 0.0 && std::isfinite(deviationSum)) weights[i] = 0.5 * weights[i] + 0.5 * deviation[i] / deviationSum;
+	}
+
+	
+	const uint64_t budget = std::min<uint64_t>(raysPerLight * lightCount, std::numeric_limits<uint32_t>::max());
+	const uint64_t minRays = std::clamp<uint64_t>(static_cast<uint64_t>(std::ceil(vars::rayAllocationMinShare.value() * raysPerLight)), 1, budget / lightCount);
+	const uint64_t spare = budget - minRays * lightCount;
+	mRayAllocation.mRays.resize(lightCount);
+	mRayAllocation.mOffsets.resize(lightCount + 1);
+	mRayAllocation.mOffsets[0] = 0;
+	for (uint32_t i = 0; i < lightCount; ++i) {
+		mRayAllocation.mRays[i] = static_cast<uint32_t>(minRays + static_cast<uint64_t>(static_cast<double>(spare) * weights[i]));
+		mRayAllocation.mOffsets[i + 1] = mRayAllocation.mOffsets[i] + mRayAllocation.mRays[i];
+	}
+
+	if (mLightRayOffsetsBuffer.getSize() < mRayAllocation.mOffsets.size() * sizeof(uint32_t)) {
+		mLightRayOffsetsBuffer.destroy();
+		mLightRayOffsetsBuffer.create(rvk::Buffer::Use::STORAGE | rvk::Buffer::Use::UPLOAD, mRayAllocation.mOffsets.size() * sizeof(uint32_t), rvk::Buffer::Location::DEVICE);
+		mAdjointDescriptor.setBuffer(ADJOINT_DESC_LIGHT_RAY_OFFSETS_BUFFER_BINDING, &mLightRayOffsetsBuffer);
+		mAdjointDescriptor.update();
+	}
+	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
+	mLightRayOffsetsBuffer.STC_UploadData(&stc, mRayAllocation.mOffsets.data(), mRayAllocation.mOffsets.size() * sizeof(uint32_t));
+
+	mRayAllocation.mRayCount = mRayAllocation.mOffsets.back();
+	mRayAllocation.mWidth = std::max(1u, vars::numRaysXperLight.value());
+	mRayAllocation.mHeight = (mRayAllocation.mRayCount + mRayAllocation.mWidth - 1) / mRayAllocation.mWidth;
+	return mRayAllocation.mRayCount;
+}
+
+void LightTraceOptimizer::updateRayAllocationStatistics(const Eigen::VectorXd& aDerivParams)
+{
+	// exponential moving averages of the per light gradient and its squared norm, their difference estimates the gradient variance
+	constexpr double decay = 0.7;
+	const auto lightCount = static_cast<Eigen::Index>(mLightParams.size());
+	if (aDerivParams.size() < lightCount * LightOptParams::MAX_PARAMS) return;
+	const Eigen::Map<const Eigen::MatrixXd> grads(aDerivParams.data(), LightOptParams::MAX_PARAMS, lightCount);
+	if (mRayAllocation.mGradMean.cols() != lightCount) {
+		mRayAllocation.mGradMean = grads;
+		mRayAllocation.mGradSqNorm = grads.colwise().squaredNorm().transpose();
+		mRayAllocation.mGradSamples = 1;
+		return;
+	}
+	mRayAllocation.mGradMean = decay * mRayAllocation.mGradMean + (1.0 - decay) * grads;
+	mRayAllocation.mGradSqNorm = decay * mRayAllocation.mGradSqNorm + (1.0 - decay) * grads.colwise().squaredNorm().transpose();
+	mRayAllocation.mGradSamples++;
+}
+
+uint32_t LightTraceOptimizer::raysYperLight() const
+{
+	return mAdaptiveRays.mActive ? mAdaptiveRays.mRaysY : vars::numRaysYperLight.value();
+}
+
+void LightTraceOptimizer::beginAdaptiveRays()
+{
+	mTracedRays = 0;
+	mAdaptiveRays = {};
+	if (!vars::adaptiveRays) return;
+	if (mForwardPT || mBackwardPT || vars::rayAllocation.value() != 0) {
+		spdlog::warn("adaptiveRays needs light tracing with rayAllocation 0, using the fixed ray count");
+		return;
+	}
+
+	// every batch gets the same share of the y rays, the bounds are multiples of the batch count
+	const uint32_t batches = std::max(2u, vars::adaptiveRaysBatches.value());
+	const auto scaled = [batches](const float aScale) {
+		const double rays = std::max(0.0, static_cast<double>(aScale) * vars::numRaysYperLight.value());
+		return std::max(batches, static_cast<uint32_t>(std::min(rays, static_cast<double>(std::numeric_limits<uint32_t>::max() / 2)) / batches) * batches);
+	};
+	mAdaptiveRays.mActive = true;
+	mAdaptiveRays.mBatches = batches;
+	mAdaptiveRays.mMinY = scaled(vars::adaptiveRaysMinScale.value());
+	mAdaptiveRays.mMaxY = std::max(mAdaptiveRays.mMinY, scaled(vars::adaptiveRaysMaxScale.value()));
+	mAdaptiveRays.mRaysY = mAdaptiveRays.mPendingY = mAdaptiveRays.mLowestY = mAdaptiveRays.mHighestY = mAdaptiveRays.mMinY;
+}
+
+void LightTraceOptimizer::endAdaptiveRays()
+{
+	mAdaptiveRays.mActive = false;
+}
+
+void LightTraceOptimizer::adaptiveRaysStep(const bool aImproved)
+{
+	if (!mAdaptiveRays.mActive) return;
+	// line searches compare objective values, so the ray count only changes between accepted steps or when progress stalls
+	if (!aImproved && ++mAdaptiveRays.mStalls < 3) return;
+	mAdaptiveRays.mStalls = 0;
+	mAdaptiveRays.mRaysY = mAdaptiveRays.mPendingY;
+	mAdaptiveRays.mLowestY = std::min(mAdaptiveRays.mLowestY, mAdaptiveRays.mRaysY);
+	mAdaptiveRays.mHighestY = std::max(mAdaptiveRays.mHighestY, mAdaptiveRays.mRaysY);
+}
+
+void LightTraceOptimizer::backwardBatched(rvk::SingleTimeCommand& aStc, Eigen::VectorXd& aDerivParams)
+{
+	const uint32_t batches = mAdaptiveRays.mBatches;
+	const uint32_t batchY = mAdaptiveRays.mRaysY / batches;
+	const uint32_t lightCount = mGpuLd->getLightCount();
+	constexpr uint64_t seedOffset = offsetof(AdjointInfo_s, seed);
+	const uint32_t baseSeed = mAdaptiveRays.mSeed;
+
+	// the batch with the forward seed runs last, so the info buffer is left as the forward pass wrote it
+	std::vector<Eigen::VectorXd> grads(batches);
+	for (uint32_t i = 1; i <= batches; i++) {
+		const uint32_t batch = i % batches;
+		const uint32_t seed = baseSeed ^ (batch * 0x9E3779B9u);
+		std::memcpy(static_cast<uint8_t*>(mCpuBuffer.getMemoryPointer()) + seedOffset, &seed, sizeof(uint32_t));
+
+		aStc.begin();
+		mCpuBuffer.CMD_CopyBuffer(aStc.buffer(), &mInfoBuffer, seedOffset, sizeof(uint32_t), seedOffset);
+		aStc.buffer()->cmdBufferMemoryBarrier(&mInfoBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		if (i > 1) {
+			mLightDerivativesBuffer.CMD_FillBuffer(aStc.buffer(), 0);
+			aStc.buffer()->cmdBufferMemoryBarrier(&mLightDerivativesBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		}
+		mBackwardPipeline.CMD_BindDescriptorSets(aStc.buffer(), { mGpuTd->getDescriptor(), &mAdjointDescriptor });
+		mBackwardPipeline.CMD_BindPipeline(aStc.buffer());
+		mBackwardPipeline.CMD_TraceRays(aStc.buffer(), vars::numRaysXperLight, batchY, lightCount);
+		aStc.end();
+		mTracedRays += static_cast<uint64_t>(vars::numRaysXperLight) * batchY * lightCount;
+		lightDerivativesToVector(grads[batch]);
+	}
+
+	// every batch is normalized by its own ray count, their mean is the estimate of the full ray count
+	aDerivParams = grads[0];
+	for (uint32_t b = 1; b < batches; b++) aDerivParams += grads[b];
+	aDerivParams /= static_cast<double>(batches);
+	updateAdaptiveRays(grads);
+}
+
+void LightTraceOptimizer::updateAdaptiveRays(const std::vector<Eigen::VectorXd>& aBatchGrads)
+{
+	const auto batches = static_cast<double>(aBatchGrads.size());
+	Eigen::VectorXd mean = Eigen::VectorXd::Zero(aBatchGrads.front().size());
+	for (const Eigen::VectorXd& g : aBatchGrads) mean += g;
+	mean /= batches;
+	double variance = 0.0;
+	for (const Eigen::VectorXd& g : aBatchGrads) variance += (g - mean).squaredNorm();
+	// unbiased sample variance of one batch, divided by the batch count for the variance of the mean
+	variance /= (batches - 1.0) * batches;
+	const double signal = mean.squaredNorm();
+	if (!(variance > 0.0) || !std::isfinite(variance) || !std::isfinite(signal)) return;
+
+	// the variance falls with 1/rays, so the ratio to the target gives the ray count, at most doubled or halved per decision
+	mAdaptiveRays.mSnr = signal / variance;
+	const double factor = std::clamp(static_cast<double>(vars::adaptiveRaysSnr.value()) / mAdaptiveRays.mSnr, 0.5, 2.0);
+	const uint32_t batchCount = mAdaptiveRays.mBatches;
+	const auto rays = static_cast<uint32_t>(std::clamp(factor * mAdaptiveRays.mRaysY, static_cast<double>(mAdaptiveRays.mMinY), static_cast<double>(mAdaptiveRays.mMaxY)));
+	const uint32_t pending = std::clamp(rays / batchCount * batchCount, mAdaptiveRays.mMinY, mAdaptiveRays.mMaxY);
+	if (pending != mAdaptiveRays.mPendingY) {
+		mAdaptiveRays.mDecisions++;
+		spdlog::info("adaptive rays: snr {:.3g} (target {}), rays per light {} -> {}", mAdaptiveRays.mSnr, vars::adaptiveRaysSnr.value(),
+			static_cast<uint64_t>(vars::numRaysXperLight) * mAdaptiveRays.mRaysY, static_cast<uint64_t>(vars::numRaysXperLight) * pending);
+	}
+	mAdaptiveRays.mPendingY = pending;
+}
+
 void LightTraceOptimizer::fillFiniteDiffRadianceBuffer(const tamashii::RefLight* aRefLight, const LightOptParams::PARAMS aParam, const float aH,
 	rvk::Buffer* aFdRadianceBufferOut, rvk::Buffer* aFd2RadianceBufferOut)
 {
@@ -1397,13 +2141,13 @@ void LightTraceOptimizer::sceneMeshToEigenArrays(const SceneBackendData& aScene)
 		for (const auto& refMesh : refModel->refMeshes) {
 			glm::mat4 modelMatrix = refModel->model_matrix; 
 			for (uint32_t j = 0; j < refMesh->mesh->getVertexCount(); ++j) {
-				glm::vec4 p = modelMatrix * refMesh->mesh->getVerticesArray()[j].position;
+				glm::vec4 p = modelMatrix * std::as_const(*refMesh->mesh).getVerticesArray()[j].position;
 				mCoords(nextNode, 0) = p[0];
 				mCoords(nextNode, 1) = p[1];
 				mCoords(nextNode, 2) = p[2];
 
-				glm::vec4 normal = glm::vec4(glm::mat3(transpose(inverse(modelMatrix))) * glm::vec3(refMesh->mesh->getVerticesArray()[j].normal ), 1.0f);
-				glm::vec4 tangent= glm::vec4(glm::mat3(transpose(inverse(modelMatrix))) * glm::vec3(refMesh->mesh->getVerticesArray()[j].tangent), 1.0f);
+				glm::vec4 normal = glm::vec4(glm::mat3(transpose(inverse(modelMatrix))) * glm::vec3(std::as_const(*refMesh->mesh).getVerticesArray()[j].normal ), 1.0f);
+				glm::vec4 tangent= glm::vec4(glm::mat3(transpose(inverse(modelMatrix))) * glm::vec3(std::as_const(*refMesh->mesh).getVerticesArray()[j].tangent), 1.0f);
 
 				mVertexNormalTangent(nextNode, 0) = normal[0];
 				mVertexNormalTangent(nextNode, 1) = normal[1];
@@ -1423,13 +2167,19 @@ void LightTraceOptimizer::sceneMeshToEigenArrays(const SceneBackendData& aScene)
 		for (const auto& refMesh : refModel->refMeshes) {
 			for (uint32_t j = 0; j < refMesh->mesh->getPrimitiveCount(); ++j) {
 				for (uint32_t i = 0; i < nNodesPerElem; ++i) {
-					mElems(nextElem, i) = refMesh->mesh->getIndicesArray()[nNodesPerElem * j + i] + nodeIDoffsetPerMesh[meshCount];
+					mElems(nextElem, i) = std::as_const(*refMesh->mesh).getIndicesArray()[nNodesPerElem * j + i] + nodeIDoffsetPerMesh[meshCount];
 				}
 				++nextElem;
 			}
 			++meshCount;
 		}
 	}
+
+	// the cotan weights depend on the coordinates, the smoothing operator is rebuilt on its next use
+	// (the symbolic analysis is kept while the topology stays the same)
+	mLaplacian.resize(0, 0);
+	mLaplacianDiagonal.clear();
+	mSmoothingFactorized = false;
 }
 
 void LightTraceOptimizer::writeLegacyVTKpointData(Eigen::MatrixXi& aElems, Eigen::MatrixXf& aCoords, const rvk::Buffer* aDataBuffer,
@@ -1649,6 +2399,7 @@ void LightTraceOptimizer::lightDerivativesToVector(Eigen::VectorXd& aDerivParams
 	rvk::SingleTimeCommand stc = mRoot.singleTimeCommand();
 	std::vector<LightGrads> lightDerivsHost; lightDerivsHost.assign(mGpuLd->getLightCount(), LightGrads());
 	mLightDerivativesBuffer.STC_DownloadData(&stc, lightDerivsHost.data(), mGpuLd->getLightCount() * sizeof(LightGrads));
+	if (mDeterministic) fixedPointToDouble(lightDerivsHost.data(), lightDerivsHost.size() * sizeof(LightGrads) / sizeof(double));
 
 	aDerivParams.resize(LightOptParams::MAX_PARAMS * mGpuLd->getLightCount());
 	aDerivParams.setZero();
@@ -2005,6 +2756,9 @@ void LightTraceOptimizer::parameterVectorToLights(Eigen::VectorXd& aParams) {
 	mGpuLd->update(&stc, mLights, mGpuTd, mModels, mGpuBlas);
 	
 	mGpuMd->update(&stc, *mMaterials, mGpuTd); 
+	// the alias tables grow when emitters change
+	mAdjointDescriptor.setBuffer(ADJOINT_DESC_LIGHT_ALIAS_TABLE_BUFFER_BINDING, mGpuLd->getAliasTableBuffer());
+	mAdjointDescriptor.update();
 }
 
 
@@ -2136,6 +2890,7 @@ double LightTraceOptimizer::lightTextureDerivativesToVector(Eigen::VectorXd& aDe
 	
 	Eigen::VectorXd lightTexDerivsHost; lightTexDerivsHost.resize( mLightTextureDerivativesBuffer.getSize()/sizeof(double) ); lightTexDerivsHost.setZero();
 	mLightTextureDerivativesBuffer.STC_DownloadData(&stc, lightTexDerivsHost.data(), mLightTextureDerivativesBuffer.getSize());
+	if (mDeterministic) fixedPointToDouble(lightTexDerivsHost.data(), lightTexDerivsHost.size());
 	
 
 	
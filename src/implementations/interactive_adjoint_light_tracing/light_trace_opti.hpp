@@ -8,14 +8,17 @@
 #include <tamashii/renderer_vk/render_backend.hpp>
 
 #include "parameter.hpp"
+#include "gradient_check.hpp"
 
 #include <Eigen/Dense>
 #include <map>
+#include <unordered_map>
 
 constexpr char const* EXPORT_RADIANCE_ID = "radiance_data";
 constexpr char const* EXPORT_RADIANCE_INFO_ID = "radiance_data_info";
 
 
+namespace tamashii::io { class Snapshot; }
 class ObjectiveFunction;
 class LightConstraint;
 class LightOptParams;
@@ -64,6 +67,21 @@ public:
 		static ccli::Var<uint32_t> shOrder;
 		static ccli::Var<bool> unphysicalNicePreview;
 		static ccli::Var<float> useIntensityPenalty;
+		static ccli::Var<std::string> gradientCheck;
+		static ccli::Var<std::string> gradientCheckOutput;
+		static ccli::Var<float> gradientCheckStepSize;
+		static ccli::Var<float> gradientCheckTolerance;
+		static ccli::Var<uint32_t> rayAllocation;
+		static ccli::Var<float> rayAllocationMinShare;
+		static ccli::Var<float> targetSmoothing;
+		static ccli::Var<uint32_t> targetSmoothingDirectLimit;
+		static ccli::Var<bool> deterministicAccumulation;
+		static ccli::Var<uint32_t> fixedPointBits;
+		static ccli::Var<bool> adaptiveRays;
+		static ccli::Var<float> adaptiveRaysSnr;
+		static ccli::Var<uint32_t> adaptiveRaysBatches;
+		static ccli::Var<float> adaptiveRaysMinScale;
+		static ccli::Var<float> adaptiveRaysMaxScale;
 
 		static void initVars();
 	};
@@ -72,12 +90,14 @@ public:
 						mGpuTd{ nullptr }, mGpuMd{ nullptr }, mGpuLd{ nullptr }, mGpuBlas{ nullptr }, mGpuTlas{ nullptr },
 						mAdjointDescriptor{ &aRoot.device }, mObjFuncDescriptor{ &aRoot.device }, mForwardShader{ &aRoot.device }, mForwardPipeline{ &aRoot.device },
 						mForwardPTShader{ &aRoot.device }, mForwardPTPipeline{ &aRoot.device }, mBackwardShader{ &aRoot.device }, mBackwardPipeline{ &aRoot.device }, mBackwardPTShader{ &aRoot.device }, mBackwardPTPipeline{ &aRoot.device },
-						mObjFuncShader{ &aRoot.device }, mObjFuncPipeline{ &aRoot.device }, mInfoBuffer{ &aRoot.device },
-						mRadianceBuffer{ &aRoot.device }, mTargetRadianceBuffer{ &aRoot.device }, mTargetRadianceWeightsBuffer{ &aRoot.device },
+						mObjFuncShader{ &aRoot.device }, mObjFuncPipeline{ &aRoot.device },
+						mResolveShader{ &aRoot.device }, mResolvePipeline{ &aRoot.device }, mInfoBuffer{ &aRoot.device },
+						mRadianceBuffer{ &aRoot.device }, mRadianceFixedBuffer{ &aRoot.device }, mTargetRadianceBuffer{ &aRoot.device }, mTargetRadianceWeightsBuffer{ &aRoot.device },
 						mVertexAreaBuffer{ &aRoot.device }, mVertexColorBuffer{ &aRoot.device },
 						mLightDerivativesBuffer{ &aRoot.device }, mLightTextureDerivativesBuffer{ &aRoot.device }, mChannelWeightsBuffer{ &aRoot.device },
-						mTriangleBuffer{ &aRoot.device }, mPhiBuffer{ &aRoot.device }, mCpuBuffer{ &aRoot.device }, mVertexCount{ 0 }, mTriangleCount{ 0 }, mBounces{ 2 },
-						mFwdSimCount{ 0 }, mObjFcn{ nullptr }, mOptimizationRunning{ false }, mCurrentHistoryIndex{ -1 }, mForwardPT{ false }, mBackwardPT{ false } {}
+						mTriangleBuffer{ &aRoot.device }, mLightRayOffsetsBuffer{ &aRoot.device }, mPhiBuffer{ &aRoot.device }, mCpuBuffer{ &aRoot.device }, mVertexCount{ 0 }, mTriangleCount{ 0 }, mBounces{ 2 },
+						mFwdSimCount{ 0 }, mObjFcn{ nullptr }, mOptimizationRunning{ false }, mCurrentHistoryIndex{ -1 }, mForwardPT{ false }, mBackwardPT{ false },
+						mDeterministic{ false }, mFixedPointScale{ 1.0f } {}
 
 					~LightTraceOptimizer() = default;
 
@@ -95,6 +115,9 @@ public:
 
 	void			forward(Eigen::VectorXd& aParams, rvk::Buffer* aRadianceBufferOut = nullptr);
 	double			backward(Eigen::VectorXd& aDerivParams);
+					// called by the optimizer wrappers after every evaluation, applies the ray count chosen by the adaptive
+					// controller once an evaluation improved the objective or the optimizer stalls
+	void			adaptiveRaysStep(bool aImproved);
 
 					
 	void			addCurrentStateToHistory(const Eigen::VectorXd& aParams);
@@ -106,6 +129,7 @@ public:
 
 					
 	void			fillFiniteDiffRadianceBuffer(const tamashii::RefLight* aRefLight, LightOptParams::PARAMS aParam, float aH, rvk::Buffer* aFdRadianceBufferOut, rvk::Buffer* aFd2RadianceBufferOut);
+	GradientCheck::Report gradientCheck(const GradientCheck::Settings& aSettings, rvk::Buffer* aRadianceBufferOut = nullptr);
 
 	Eigen::VectorXd& getCurrentParams(){return mParams;}
 	void			updateParamsFromScene(){
@@ -118,14 +142,29 @@ public:
 	void			setTargetWeights(float aAlpha);
 	void			buildObjectiveFunction(tamashii::SceneBackendData aScene);
 	void			copyRadianceToTarget() const;
+					// solves (A + alpha*L) x = A t for every target channel, A: weighted vertex areas, L: cotan laplacian
+	bool			smoothTarget(float aAlpha);
 	void			copyTargetToMesh(const tamashii::SceneBackendData& aScene) const;
+					// downloads only the slice of aMesh
+	void			copyTargetToMesh(tamashii::Mesh* aMesh) const;
 	void			copyMeshToTarget(const tamashii::SceneBackendData& aScene) const;
+					// binary snapshot of radiance, target and target weights with the sh layout, see io::Snapshot
+	bool			saveSnapshot(const std::string& aFile, bool aCompress) const;
+					// returns false if the file does not match the vertex count and sh layout of the loaded scene
+	bool			loadSnapshot(const std::string& aFile, bool* aTargetLoaded = nullptr);
+					// host side only, safe to call from worker threads
+	bool			readSnapshotTarget(const std::string& aFile, std::vector<float>& aTarget, std::vector<float>& aWeights) const;
+	void			downloadTarget(std::vector<float>& aTarget, std::vector<float>& aWeights) const;
+					// aTarget holds entries_per_vertex floats per vertex, empty aWeights sets every weight to 1
+	bool			uploadTarget(const std::vector<float>& aTarget, const std::vector<float>& aWeights) const;
 	void			setTargetRadianceBufferForScene(std::optional<glm::vec3>, std::optional<float>) const;
 	void			setTargetRadianceBufferForMesh(const tamashii::RefMesh*, std::optional<glm::vec3>, std::optional<float>) const;
 	rvk::Buffer*	getTargetRadianceBuffer();
 	rvk::Buffer*	getTargetRadianceWeightsBuffer();
 	rvk::Buffer*	getChannelWeightsBuffer();
 	rvk::Descriptor*getAdjointDescriptor();
+					// rebinds the index and vertex buffer after the geometry buffers were replaced
+	void			geometryBuffersChanged();
 	LightOptParams& optimizationParametersByLightRef(const tamashii::Ref&);
 
 	rvk::Buffer*	getVtxTextureColorBuffer();
@@ -144,13 +183,35 @@ public:
 
 	void			lightsToParameterVector(Eigen::VectorXd& aParams);
 	void			parameterVectorToLights(Eigen::VectorXd& aParams);
+					// lights and emissive textures
+	void			applyParameterVector(Eigen::VectorXd& aParams);
 
 private:
 	void			updateLightParamsIfNecessary();
+	void			ensureLightDerivativesBuffer();
+	double			estimateLightFlux(const tamashii::Ref* aRef) const;
+					// returns the total ray count of the adaptive allocation, 0 if every light gets numRaysXperLight*numRaysYperLight rays
+	uint32_t		updateRayAllocation();
+	void			updateRayAllocationStatistics(const Eigen::VectorXd& aDerivParams);
+					// light tracing rays per light in y, numRaysYperLight unless the adaptive controller is running
+	uint32_t		raysYperLight() const;
+	void			beginAdaptiveRays();
+	void			endAdaptiveRays();
+					// traces the backward pass in batches with their own seeds, returns the mean light gradient and feeds
+					// the variance of the batch means to the controller
+	void			backwardBatched(rvk::SingleTimeCommand& aStc, Eigen::VectorXd& aDerivParams);
+	void			updateAdaptiveRays(const std::vector<Eigen::VectorXd>& aBatchGrads);
+	bool			updateSmoothingOperator(const Eigen::VectorXf& aWeights, double aAlpha);
+	void			solveSmoothing(const Eigen::MatrixXd& aRhs, Eigen::MatrixXd& aResult);
 	void			sceneMeshToEigenArrays(const tamashii::SceneBackendData& aScene);
 	void			writeLegacyVTKpointData(Eigen::MatrixXi& aElems, Eigen::MatrixXf& aCoords, const rvk::Buffer* aDataBuffer,
 	                                        const std::string& aFilename, const std::string& aDataname);
 	void			lightDerivativesToVector(Eigen::VectorXd& aDerivParams);
+	void			ensureRadianceFixedBuffer();
+	void			fixedPointToDouble(void* aData, size_t aCount) const;
+	bool			snapshotMatchesScene(const tamashii::io::Snapshot& aSnapshot, const std::string& aFile) const;
+	void			copyTargetSliceToMesh(tamashii::Mesh* aMesh, const float* aRadiance, const float* aWeights) const;
+	std::vector<tamashii::Mesh*> sceneMeshes(const tamashii::SceneBackendData& aScene) const;
 
 	void			lightTextureToParameterVector(Eigen::VectorXd& aParams);
 	void			parameterVectorToLightTexture(Eigen::VectorXd& aParams);
@@ -187,9 +248,12 @@ private:
 	rvk::RTPipeline									mBackwardPTPipeline;
 	rvk::CShader									mObjFuncShader;
 	rvk::CPipeline									mObjFuncPipeline;
+	rvk::CShader									mResolveShader;
+	rvk::CPipeline									mResolvePipeline;
 
 	rvk::Buffer										mInfoBuffer;
 	rvk::Buffer										mRadianceBuffer;
+	rvk::Buffer										mRadianceFixedBuffer;
 	rvk::Buffer										mTargetRadianceBuffer;
 	rvk::Buffer										mTargetRadianceWeightsBuffer;
 	rvk::Buffer										mVertexAreaBuffer;
@@ -198,10 +262,40 @@ private:
 	rvk::Buffer										mLightTextureDerivativesBuffer;
 	rvk::Buffer										mChannelWeightsBuffer;
 	rvk::Buffer										mTriangleBuffer;
+	rvk::Buffer										mLightRayOffsetsBuffer;
 	rvk::Buffer										mPhiBuffer;
 	rvk::Buffer										mCpuBuffer;
 
+	struct RayAllocation {
+		std::vector<uint32_t>						mRays;
+		std::vector<uint32_t>						mOffsets;
+		uint32_t									mRayCount = 0;
+		uint32_t									mWidth = 0;
+		uint32_t									mHeight = 0;
+		Eigen::MatrixXd								mGradMean;
+		Eigen::VectorXd								mGradSqNorm;
+		uint32_t									mGradSamples = 0;
+	}												mRayAllocation;
+	std::map<tamashii::Ref*, double>				mEmitterArea;
+
+	struct AdaptiveRays {
+		bool										mActive = false;
+		uint32_t									mBatches = 1;
+		uint32_t									mRaysY = 0;			// used by the current evaluations
+		uint32_t									mPendingY = 0;		// chosen from the last gradient variance estimate
+		uint32_t									mMinY = 0;
+		uint32_t									mMaxY = 0;
+		uint32_t									mLowestY = 0;
+		uint32_t									mHighestY = 0;
+		uint32_t									mStalls = 0;
+		uint32_t									mDecisions = 0;
+		uint32_t									mSeed = 0;			// of the last forward pass, batch 0 of the backward pass uses it too
+		double										mSnr = 0.0;
+	}												mAdaptiveRays;
+	uint64_t										mTracedRays = 0;	// light tracing rays of the current optimization, forward and backward
+
 	uint64_t										mVertexCount;
+	std::unordered_map<const tamashii::Mesh*, uint64_t> mMeshVertexOffsets;	// first vertex of each mesh in the radiance buffers
 	uint64_t										mTriangleCount;
 	int												mBounces;
 	uint32_t										mFwdSimCount; 
@@ -213,8 +307,16 @@ private:
 	Eigen::VectorXf									mVtxArea;
 
 	
+	Eigen::SparseMatrix<double>						mLaplacian;
+	std::vector<Eigen::Index>						mLaplacianDiagonal;
 	Eigen::SparseMatrix<double>						mAplusAlphaL;
-	Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>, Eigen::Upper | Eigen::Lower> mSmoothingSolver;
+	Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>, Eigen::Lower> mSmoothingSolver;
+	uint64_t										mLaplacianTopology = 0;
+	uint64_t										mSmoothingTopology = 0;
+	bool											mSmoothingDirect = false;
+	bool											mSmoothingFactorized = false;
+	double											mSmoothingAlpha = 0.0;
+	Eigen::VectorXd									mSmoothingMass;
 	
 	
 	
@@ -230,6 +332,9 @@ private:
 
 	bool											mForwardPT;
 	bool											mBackwardPT;
+													// accumulation mode and fixed point scale of the last forward pass, backward uses the same
+	bool											mDeterministic;
+	float											mFixedPointScale;
 	
 	uint32_t										mForwardTimeCount = 0;
 	uint32_t										mBackwardTimeCount = 0;
@@ -13,6 +13,7 @@ int main(int argc, char* argv[]) {
 	
 	tamashii::registerBackend(std::make_shared<VulkanRenderBackendInteractiveAdjointLightTracing>());
 	LightTraceOptimizer::vars::initVars();
+	if (const std::optional<int> exitCode = GradientCheck::runCommandLine(argc, argv)) return exitCode.value();
 
 	
 	tamashii::run(argc, argv);
@@ -4,6 +4,7 @@
 #include <tamashii/tamashii.hpp>
 #include <tamashii/core/common/common.hpp>
 #include <tamashii/core/common/vars.hpp>
+#include <tamashii/core/io/io.hpp>
 #include <tamashii/bindings/bindings.hpp>
 #include <tamashii/bindings/core_module.hpp>
 #include <tamashii/bindings/exports.hpp>
@@ -205,6 +206,13 @@ NB_MODULE(pyialt, m) {
         return python::Image<float>{ vectorHandle->data(), 3, shape, owner };
         });
 
+    ialt->def("saveFrameImage", [](const IALT& self, const std::string& path, const bool async) {
+        Common::getInstance().frame();
+        return self.handle()->saveFrameImage(path, async);
+        }, "path"_a, "async"_a = false);
+
+    ialt->def("waitForImageSaves", [](const IALT& self) { return self.handle()->waitForImageSaves(); });
+
     ialt->def("getTargetImage", [](const IALT& self) {
         self.handle()->showTarget(true);
         Common::getInstance().frame();
@@ -276,6 +284,18 @@ NB_MODULE(pyialt, m) {
         size_t shape[3] = { img->getWidth(), img->getHeight(), 4 };
         return python::Image<float>{ vectorHandle->data(), 3, shape, owner };
         });
+    exports.light().def("saveGradImage", [](const python::Light& light, const LightOptParams::PARAMS param, const size_t spp, const std::string& path, const bool async) {
+	    const auto ialt = IALT().checkCurrent().handle();
+        auto& refLight = light.refLight();
+        ialt->clearGradVis();
+        ialt->showGradVis({ { const_cast<tamashii::RefLight*>(&refLight), param } });
+
+        for (size_t i = 0; i < spp; i++) Common::getInstance().frame();
+        ialt->showGradVis({});
+        Common::getInstance().frame();
+
+        return ialt->saveGradImage(path, 1.0f / static_cast<float>(spp), async);
+        }, "param"_a, "spp"_a, "path"_a, "async"_a = false);
     exports.light().def("getFDGradImage", [](const python::Light& light, const LightOptParams::PARAMS param, const size_t spp, const float h) {
 	    const auto ialt = IALT().checkCurrent().handle();
         auto& refLight = light.refLight();
@@ -363,6 +383,14 @@ NB_MODULE(pyialt, m) {
         IALT().checkCurrent().handle()->useCurrentRadianceAsTarget(clearWeights);
     }, "clearWeights"_a);
 
+    ialt->def("saveSnapshot", [](IALT& self, const std::string& path, const bool compress) {
+        return IALT().checkCurrent().handle()->saveSnapshot(path, compress);
+    }, "path"_a, "compress"_a = true);
+
+    ialt->def("loadSnapshot", [](IALT& self, const std::string& path) {
+        return IALT().checkCurrent().handle()->loadSnapshot(path);
+    }, "path"_a);
+
     ialt->def("optimize", [](IALT& self, LightTraceOptimizer::Optimizers optimizerType, const float stepSize, const int maxIterations) {
             auto result = IALT().checkCurrent().handle()->runOptimizer(optimizerType, stepSize, maxIterations);
 
@@ -376,6 +404,42 @@ NB_MODULE(pyialt, m) {
             return std::tuple<PyHistory, double> { pyHistory, result.lastPhi };
         }, "optimizerType"_a, "stepSize"_a = 1.0, "maxIterations"_a = 100);
 
+    nb::class_<InteractiveAdjointLightTracing::OptimizationJob>(m, "OptimizationJob")
+        .def(nb::init())
+        .def_rw("name", &InteractiveAdjointLightTracing::OptimizationJob::mName)
+        .def_rw("targetFile", &InteractiveAdjointLightTracing::OptimizationJob::mTargetFile)
+        .def_rw("target", &InteractiveAdjointLightTracing::OptimizationJob::mTarget)
+        .def_rw("weights", &InteractiveAdjointLightTracing::OptimizationJob::mWeights)
+        .def_rw("optimizer", &InteractiveAdjointLightTracing::OptimizationJob::mOptimizer)
+        .def_rw("stepSize", &InteractiveAdjointLightTracing::OptimizationJob::mStepSize)
+        .def_rw("maxIterations", &InteractiveAdjointLightTracing::OptimizationJob::mMaxIterations)
+        .def_rw("warmStart", &InteractiveAdjointLightTracing::OptimizationJob::mWarmStart);
+
+    ialt->def("runJobs", [](IALT& self, const std::vector<InteractiveAdjointLightTracing::OptimizationJob>& jobs, nb::object callback) {
+            auto toPython = [](InteractiveAdjointLightTracing::OptimizationJobResult result) {
+                nb::list history;
+                for (auto& p : result.mHistory) history.append(eigenVectorToPythonVector(std::move(p), "History Item"));
+                nb::dict d;
+                d["name"] = result.mName;
+                d["index"] = result.mIndex;
+                d["success"] = result.mSuccess;
+                d["params"] = eigenVectorToPythonVector(std::move(result.mParams), "Job parameter capsule");
+                d["history"] = history;
+                d["bestPhi"] = result.mBestPhi;
+                d["lastPhi"] = result.mLastPhi;
+                d["seconds"] = result.mSeconds;
+                return d;
+            };
+
+            nb::list results;
+            self.checkCurrent().handle()->runOptimizationJobs(jobs, [&](const InteractiveAdjointLightTracing::OptimizationJobResult& result) {
+                nb::dict d = toPython(result);
+                if (!callback.is_none()) callback(d);
+                results.append(d);
+            });
+            return results;
+        }, "jobs"_a, "callback"_a = nb::none());
+
     CoreModule::exitCallback([]() {
         ialt.reset();
     });
@@ -4,11 +4,13 @@
 #include <tamashii/core/scene/ref_entities.hpp>
 #include <tamashii/core/scene/model.hpp>
 #include <tamashii/core/scene/light.hpp>
+#include <tamashii/core/common/profiler.hpp>
 
 T_USE_NAMESPACE
 
-GeometryDataVulkan::GeometryDataVulkan(rvk::LogicalDevice* aDevice) : mDevice(aDevice),
-                                                                      mMaxIndexCount(0), mMaxVertexCount(0), mIndexBuffer(aDevice), mVertexBuffer(aDevice)
+GeometryDataVulkan::GeometryDataVulkan(rvk::LogicalDevice* aDevice) : mDevice(aDevice), mIndexBufferUsageFlags(0), mVertexBufferUsageFlags(0),
+                                                                      mIndexBuffer(std::make_unique<rvk::Buffer>(aDevice)), mVertexBuffer(std::make_unique<rvk::Buffer>(aDevice)),
+                                                                      mBufferResized(false)
 {}
 
 GeometryDataVulkan::~GeometryDataVulkan()
@@ -19,83 +21,176 @@ void GeometryDataVulkan::prepare(const uint32_t aMaxIndices,
                                const uint32_t aIndexBufferUsageFlags,
                                const uint32_t aVertexBufferUsageFlags)
 {
+	mIndexBufferUsageFlags = aIndexBufferUsageFlags;
+	mVertexBufferUsageFlags = aVertexBufferUsageFlags;
+	mIndexRanges.reset(std::max(1u, aMaxIndices));
+	mVertexRanges.reset(std::max(1u, aMaxVertices));
 	unloadScene();
-	mMaxIndexCount = std::max(1u, aMaxIndices);
-	mMaxVertexCount = std::max(1u, aMaxVertices);
-	mIndexBuffer.create(aIndexBufferUsageFlags, mMaxIndexCount * sizeof(uint32_t), rvk::Buffer::Location::DEVICE);
-	mVertexBuffer.create(aVertexBufferUsageFlags, mMaxVertexCount * sizeof(vertex_s), rvk::Buffer::Location::DEVICE);
+	mIndexBuffer->create(aIndexBufferUsageFlags, mIndexRanges.capacity() * sizeof(uint32_t), rvk::Buffer::Location::DEVICE);
+	mVertexBuffer->create(aVertexBufferUsageFlags, mVertexRanges.capacity() * sizeof(vertex_s), rvk::Buffer::Location::DEVICE);
+	mBufferResized = true;
 }
 void GeometryDataVulkan::destroy()
 {
-	mIndexBuffer.destroy();
-	mVertexBuffer.destroy();
-	mMaxIndexCount = 0;
-	mMaxVertexCount = 0;
+	mIndexBuffer->destroy();
+	mVertexBuffer->destroy();
+	mIndexRanges.reset(0);
+	mVertexRanges.reset(0);
 	unloadScene();
 }
 void GeometryDataVulkan::loadScene(rvk::SingleTimeCommand* aStc, const tamashii::SceneBackendData aScene)
 {
 	unloadScene();
-	
+	update(aStc, aScene);
+}
+
+void GeometryDataVulkan::update(rvk::SingleTimeCommand* aStc, const SceneBackendData aScene)
+{
+	T_PROFILE_SCOPE("upload geometry");
+	const auto countGeometry = [](const Model& aModel)
 	{
-		
-		uint32_t mcount = 0;
-		uint32_t icount = 0;
-		uint32_t vcount = 0;
-		for (auto& model : aScene.models) {
-			for (const auto& mesh : *model) {
-				mcount++;
-				if (mesh->hasIndices()) icount += mesh->getIndexCount();
-				vcount += mesh->getVertexCount();
-			}
+		ModelRange_s range = {};
+		for (const auto& mesh : aModel) {
+			if (mesh->hasIndices()) range.mIndexCount += static_cast<uint32_t>(mesh->getIndexCount());
+			range.mVertexCount += static_cast<uint32_t>(mesh->getVertexCount());
+		}
+		return range;
+	};
+
+	// the per vertex buffers of the implementations (radiance, area, ...) follow the layout of a fresh load: models
+	// in scene order, their meshes in sequence, no gaps. Known models keep their ranges while they still match that
+	// layout and new models are appended, otherwise (a model left, changed its size or moved) all ranges are rebuilt
+	bool rebuild = false;
+	bool appended = false;
+	size_t known = 0;
+	uint32_t indexEnd = 0;
+	uint32_t vertexEnd = 0;
+	std::unordered_map<Model*, ModelRange_s> required(aScene.models.size());
+	for (auto& model : aScene.models) {
+		ModelRange_s range = countGeometry(*model);
+		range.mIndexOffset = indexEnd;
+		range.mVertexOffset = vertexEnd;
+		indexEnd += range.mIndexCount;
+		vertexEnd += range.mVertexCount;
+		const auto it = mModelRanges.find(model.get());
+		if (it == mModelRanges.end()) appended = true;
+		else {
+			known++;
+			const ModelRange_s& r = it->second;
+			rebuild |= appended || r.mIndexOffset != range.mIndexOffset || r.mIndexCount != range.mIndexCount
+				|| r.mVertexOffset != range.mVertexOffset || r.mVertexCount != range.mVertexCount;
+		}
+		required.emplace(model.get(), range);
+	}
+	rebuild |= known != mModelRanges.size();
+	if (rebuild) {
+		mModelRanges.clear();
+		mIndexRanges.reset(mIndexRanges.capacity());
+		mVertexRanges.reset(mVertexRanges.capacity());
+	}
+
+	// new models get ranges, the buffers grow by whole chunks when nothing fits
+	const uint64_t indexCapacity = mIndexRanges.capacity();
+	const uint64_t vertexCapacity = mVertexRanges.capacity();
+	const auto allocate = [](RangeAllocator& aRanges, const uint32_t aCount, const uint32_t aChunkSize) -> uint32_t
+	{
+		if (!aCount) return 0;
+		uint64_t offset = aRanges.allocate(aCount);
+		if (offset == RangeAllocator::INVALID) {
+			const uint64_t capacity = aRanges.capacity() + aCount;
+			aRanges.grow((capacity + aChunkSize - 1) / aChunkSize * aChunkSize);
+			offset = aRanges.allocate(aCount);
+		}
+		return static_cast<uint32_t>(offset);
+	};
+	for (auto& model : aScene.models) {
+		if (mModelRanges.find(model.get()) != mModelRanges.end()) continue;
+		ModelRange_s range = required[model.get()];
+		// the allocator has no gaps, so first fit appends in scene order
+		const uint32_t indexOffset = allocate(mIndexRanges, range.mIndexCount, INDEX_CHUNK_SIZE);
+		const uint32_t vertexOffset = allocate(mVertexRanges, range.mVertexCount, VERTEX_CHUNK_SIZE);
+		if ((range.mIndexCount && indexOffset != range.mIndexOffset) || (range.mVertexCount && vertexOffset != range.mVertexOffset)) {
+			spdlog::error("Geometry: ranges of model '{}' do not follow the scene order", model->getName());
 		}
-		mModelToBOffset.reserve(aScene.models.size());
-		mMeshToBOffset.reserve(mcount);
-		if (vcount) {
+		mModelRanges.emplace(model.get(), range);
+	}
+	// the content is not copied, every model is uploaded below
+	if (mIndexRanges.capacity() != indexCapacity) {
+		spdlog::info("Geometry: index buffer grows to {} indices", mIndexRanges.capacity());
+		growBuffer(mIndexBuffer, mIndexBufferUsageFlags, mIndexRanges.capacity() * sizeof(uint32_t));
+	}
+	if (mVertexRanges.capacity() != vertexCapacity) {
+		spdlog::info("Geometry: vertex buffer grows to {} vertices", mVertexRanges.capacity());
+		growBuffer(mVertexBuffer, mVertexBufferUsageFlags, mVertexRanges.capacity() * sizeof(vertex_s));
+	}
+
+	// every model is uploaded again, its geometry may have changed in place
+	mModelToBOffset.clear();
+	mMeshToBOffset.clear();
+	mModelToBOffset.reserve(aScene.models.size());
+	// all mesh uploads share one submit
+	aStc->begin();
+	for (auto& model : aScene.models) {
+		const ModelRange_s& range = mModelRanges[model.get()];
+		primitveBufferOffset_s offsets = {};
+		offsets.mIndexOffset = range.mIndexOffset;
+		offsets.mIndexByteOffset = range.mIndexOffset * sizeof(uint32_t);
+		offsets.mVertexOffset = range.mVertexOffset;
+		offsets.mVertexByteOffset = range.mVertexOffset * sizeof(vertex_s);
+		mModelToBOffset.insert(std::pair(model.get(), offsets));
+		for (const auto& mesh : *model) {
+			mMeshToBOffset.insert(std::pair(mesh.get(), offsets));
 			
-			primitveBufferOffset_s offsets = {};
-			for (auto& model : aScene.models) {
-				
-				mModelToBOffset.insert(std::pair(model.get(), offsets));
-				for (const auto& mesh : *model) {
-					mMeshToBOffset.insert(std::pair(mesh.get(), offsets));
-					
-					if (mesh->hasIndices()) {
-						mIndexBuffer.STC_UploadData(aStc, mesh->getIndicesArray(), mesh->getIndexCount() * sizeof(uint32_t), offsets.mIndexByteOffset);
-						offsets.mIndexOffset += mesh->getIndexCount();
-						offsets.mIndexByteOffset += mesh->getIndexCount() * sizeof(uint32_t);
-						if (offsets.mIndexOffset > mMaxIndexCount) spdlog::error("Indices count > buffer size");
-					}
-					
-					mVertexBuffer.STC_UploadData(aStc, mesh->getVerticesArray(), mesh->getVertexCount() * sizeof(vertex_s), offsets.mVertexByteOffset);
-					offsets.mVertexOffset += mesh->getVertexCount();
-					offsets.mVertexByteOffset += mesh->getVertexCount() * sizeof(vertex_s);
-					if (offsets.mVertexOffset > mMaxVertexCount) spdlog::error("Vertices count > buffer size");
-				}
+			if (mesh->hasIndices()) {
+				mIndexBuffer->STC_UploadData(aStc, std::as_const(*mesh).getIndicesArray(), mesh->getIndexCount() * sizeof(uint32_t), offsets.mIndexByteOffset);
+				offsets.mIndexOffset += mesh->getIndexCount();
+				offsets.mIndexByteOffset += mesh->getIndexCount() * sizeof(uint32_t);
 			}
-			mBufferOffset = offsets;
+			
+			mVertexBuffer->STC_UploadData(aStc, std::as_const(*mesh).getVerticesArray(), mesh->getVertexCount() * sizeof(vertex_s), offsets.mVertexByteOffset);
+			offsets.mVertexOffset += mesh->getVertexCount();
+			offsets.mVertexByteOffset += mesh->getVertexCount() * sizeof(vertex_s);
 		}
 	}
-}
+	aStc->end();
 
-void GeometryDataVulkan::update(rvk::SingleTimeCommand* aStc, const SceneBackendData aScene)
-{
-	unloadScene();
-	loadScene(aStc, aScene);
+	mBufferOffset.mIndexOffset = static_cast<uint32_t>(mIndexRanges.end());
+	mBufferOffset.mIndexByteOffset = mBufferOffset.mIndexOffset * sizeof(uint32_t);
+	mBufferOffset.mVertexOffset = static_cast<uint32_t>(mVertexRanges.end());
+	mBufferOffset.mVertexByteOffset = mBufferOffset.mVertexOffset * sizeof(vertex_s);
 }
 
 void GeometryDataVulkan::unloadScene()
 {
 	mModelToBOffset.clear();
 	mMeshToBOffset.clear();
+	mModelRanges.clear();
+	mIndexRanges.reset(mIndexRanges.capacity());
+	mVertexRanges.reset(mVertexRanges.capacity());
 	mBufferOffset = {};
 }
 
+void GeometryDataVulkan::growBuffer(std::unique_ptr<rvk::Buffer>& aBuffer, const uint32_t aUsageFlags, const VkDeviceSize aSize)
+{
+	// frames in flight may still read the old buffer
+	mDevice->waitIdle();
+	aBuffer = std::make_unique<rvk::Buffer>(mDevice);
+	aBuffer->create(aUsageFlags, aSize, rvk::Buffer::Location::DEVICE);
+	mBufferResized = true;
+}
+
+bool GeometryDataVulkan::bufferChanged(const bool aReset)
+{
+	const bool ret = mBufferResized;
+	if (aReset) mBufferResized = false;
+	return ret;
+}
+
 rvk::Buffer* GeometryDataVulkan::getIndexBuffer()
-{ return &mIndexBuffer; }
+{ return mIndexBuffer.get(); }
 
 rvk::Buffer* GeometryDataVulkan::getVertexBuffer()
-{ return &mVertexBuffer; }
+{ return mVertexBuffer.get(); }
 
 GeometryDataVulkan::primitveBufferOffset_s GeometryDataVulkan::getOffset() const
 { return mBufferOffset; }
@@ -183,8 +278,8 @@ void GeometryDataBlasVulkan::loadScene(rvk::SingleTimeCommand* aStc, const tamas
 
 			
 			rvk::ASTriangleGeometry astri;
-			if (mesh->hasIndices()) astri.setIndicesFromDevice(VK_INDEX_TYPE_UINT32, static_cast<uint32_t>(mesh->getIndexCount()), &mIndexBuffer, mMeshToBOffset[mesh.get()].mIndexByteOffset);
-			astri.setVerticesFromDevice(VK_FORMAT_R32G32B32_SFLOAT, sizeof(vertex_s), static_cast<uint32_t>(mesh->getVertexCount()), &mVertexBuffer, mMeshToBOffset[mesh.get()].mVertexByteOffset);
+			if (mesh->hasIndices()) astri.setIndicesFromDevice(VK_INDEX_TYPE_UINT32, static_cast<uint32_t>(mesh->getIndexCount()), mIndexBuffer.get(), mMeshToBOffset[mesh.get()].mIndexByteOffset);
+			astri.setVerticesFromDevice(VK_FORMAT_R32G32B32_SFLOAT, sizeof(vertex_s), static_cast<uint32_t>(mesh->getVertexCount()), mVertexBuffer.get(), mMeshToBOffset[mesh.get()].mVertexByteOffset);
 
 			blas->addGeometry(astri, mesh->getMaterial()->getBlendMode() == Material::BlendMode::_OPAQUE ? VK_GEOMETRY_OPAQUE_BIT_KHR : 0);
 		}
@@ -4,12 +4,136 @@
 #include <tamashii/core/scene/ref_entities.hpp>
 #include <tamashii/core/scene/model.hpp>
 #include <tamashii/core/scene/material.hpp>
+#include <tamashii/core/common/thread_pool.hpp>
 
 #include "tamashii/renderer_vk/convenience/geometry_to_gpu.hpp"
 
 T_USE_NAMESPACE
 
-LightDataVulkan::LightDataVulkan(rvk::LogicalDevice* aDevice): mDevice(aDevice), mMaxLightCount(0), mLightBuffer(aDevice)
+namespace {
+	constexpr size_t INITIAL_ALIAS_TABLE_SIZE = 1024;
+	constexpr float EMISSION_FLOOR = 1e-2f;
+	constexpr float PI = 3.14159265358979323846f;
+
+	float srgbToLinear(const float aValue)
+	{
+		return aValue <= 0.04045f ? aValue / 12.92f : std::pow((aValue + 0.055f) / 1.055f, 2.4f);
+	}
+
+	// nearest texel with clamped coordinates, missing channels read as zero like the shader fetch
+	float texelLuminance(Image* aImage, const glm::vec2 aUv)
+	{
+		const uint32_t width = aImage->getWidth();
+		const uint32_t height = aImage->getHeight();
+		if (!width || !height || aImage->getDataVector().empty()) return 1.0f;
+		const glm::vec2 uv = glm::clamp(aUv, glm::vec2(0.0f), glm::vec2(1.0f));
+		const uint32_t x = std::min(static_cast<uint32_t>(uv.x * static_cast<float>(width)), width - 1);
+		const uint32_t y = std::min(static_cast<uint32_t>(uv.y * static_cast<float>(height)), height - 1);
+		const uint8_t* texel = aImage->getData() + (static_cast<size_t>(y) * width + x) * aImage->getPixelSizeInBytes();
+
+		glm::vec3 c(0.0f);
+		switch (aImage->getFormat()) {
+		case Image::Format::RGBA8_UNORM:
+		case Image::Format::RGB8_UNORM: c.b = texel[2] / 255.0f; [[fallthrough]];
+		case Image::Format::RG8_UNORM: c.g = texel[1] / 255.0f; [[fallthrough]];
+		case Image::Format::R8_UNORM: c.r = texel[0] / 255.0f; break;
+		case Image::Format::RGBA8_SRGB:
+		case Image::Format::RGB8_SRGB:
+			c = glm::vec3(srgbToLinear(texel[0] / 255.0f), srgbToLinear(texel[1] / 255.0f), srgbToLinear(texel[2] / 255.0f));
+			break;
+		case Image::Format::RGBA16_UNORM:
+		case Image::Format::RGB16_UNORM: c.b = reinterpret_cast<const uint16_t*>(texel)[2] / 65535.0f; [[fallthrough]];
+		case Image::Format::RG16_UNORM: c.g = reinterpret_cast<const uint16_t*>(texel)[1] / 65535.0f; [[fallthrough]];
+		case Image::Format::R16_UNORM: c.r = reinterpret_cast<const uint16_t*>(texel)[0] / 65535.0f; break;
+		case Image::Format::RGBA32_FLOAT:
+		case Image::Format::RGB32_FLOAT: c.b = reinterpret_cast<const float*>(texel)[2]; [[fallthrough]];
+		case Image::Format::RG32_FLOAT: c.g = reinterpret_cast<const float*>(texel)[1]; [[fallthrough]];
+		case Image::Format::R32_FLOAT: c.r = reinterpret_cast<const float*>(texel)[0]; break;
+		case Image::Format::RGBA64_FLOAT:
+		case Image::Format::RGB64_FLOAT: c.b = static_cast<float>(reinterpret_cast<const double*>(texel)[2]); [[fallthrough]];
+		case Image::Format::RG64_FLOAT: c.g = static_cast<float>(reinterpret_cast<const double*>(texel)[1]); [[fallthrough]];
+		case Image::Format::R64_FLOAT: c.r = static_cast<float>(reinterpret_cast<const double*>(texel)[0]); break;
+		default: return 1.0f;
+		}
+		return std::max(0.0f, glm::dot(c, glm::vec3(0.2126f, 0.7152f, 0.0722f)));
+	}
+
+	// world space area times the emission averaged over the corners, edge midpoints and centroid of each triangle.
+	// A small fraction of the mean emission is added to every triangle, the texture may change on the gpu
+	// (optimization) without the table being rebuilt and no triangle may end up with a zero probability
+	bool buildTriangleTable(AliasTable& aTable, float& aEmittingArea, const RefModel* aRefModel, const RefMesh* aRefMesh, const Texture* aTexture)
+	{
+		const Mesh* mesh = aRefMesh->mesh.get();
+		const size_t triangleCount = mesh->getPrimitiveCount();
+		const uint32_t* indices = mesh->hasIndices() ? mesh->getIndicesArray() : nullptr;
+		const vertex_s* vertices = mesh->getVerticesArray();
+		Image* image = aTexture ? aTexture->image : nullptr;
+
+		std::vector<float> area(triangleCount);
+		std::vector<float> emission(triangleCount, 1.0f);
+		for (size_t t = 0; t < triangleCount; t++) {
+			const vertex_s& v0 = vertices[indices ? indices[t * 3 + 0] : t * 3 + 0];
+			const vertex_s& v1 = vertices[indices ? indices[t * 3 + 1] : t * 3 + 1];
+			const vertex_s& v2 = vertices[indices ? indices[t * 3 + 2] : t * 3 + 2];
+			const glm::vec3 p0 = glm::vec3(aRefModel->model_matrix * v0.position);
+			const glm::vec3 p1 = glm::vec3(aRefModel->model_matrix * v1.position);
+			const glm::vec3 p2 = glm::vec3(aRefModel->model_matrix * v2.position);
+			area[t] = 0.5f * glm::length(glm::cross(p1 - p0, p2 - p0));
+			if (!image) continue;
+
+			const glm::vec2 uv0 = v0.texture_coordinates_0;
+			const glm::vec2 uv1 = v1.texture_coordinates_0;
+			const glm::vec2 uv2 = v2.texture_coordinates_0;
+			const glm::vec2 uvs[7] = { uv0, uv1, uv2, (uv0 + uv1) * 0.5f, (uv1 + uv2) * 0.5f, (uv2 + uv0) * 0.5f, (uv0 + uv1 + uv2) / 3.0f };
+			float sum = 0.0f;
+			for (const glm::vec2& uv : uvs) sum += texelLuminance(image, uv);
+			emission[t] = sum / 7.0f;
+		}
+
+		double totalArea = 0.0;
+		double totalPower = 0.0;
+		for (size_t t = 0; t < triangleCount; t++) {
+			totalArea += area[t];
+			totalPower += static_cast<double>(area[t]) * emission[t];
+		}
+		aEmittingArea = static_cast<float>(std::max(totalPower, static_cast<double>(EMISSION_FLOOR) * totalArea));
+		const float floor = totalArea > 0.0 ? EMISSION_FLOOR * static_cast<float>(totalPower / totalArea) : 0.0f;
+		std::vector<float>& weights = area;
+		for (size_t t = 0; t < triangleCount; t++) weights[t] = area[t] * (emission[t] + floor);
+		return aTable.build(weights);
+	}
+
+	float luminance(const glm::vec3& aColor) { return glm::dot(aColor, glm::vec3(0.2126f, 0.7152f, 0.0722f)); }
+
+	// bounds, emission cone and power of an analytic light, the power only steers the sampling
+	LightTreeLight treeLight(const Light_s& aLight)
+	{
+		LightTreeLight l = {};
+		const auto type = static_cast<LightType>(aLight.type);
+		const glm::vec3 position = glm::vec3(aLight.pos_ws);
+		float radius = aLight.light_offset;
+		l.mAxis = glm::vec3(aLight.n_ws_norm);
+		l.mCosThetaO = -1.0f;
+		l.mCosThetaE = 0.0f;
+		l.mPower = aLight.intensity * luminance(aLight.color);
+		if (type == LightType::DIRECTIONAL) {
+			l.mInfinite = true;
+			radius = 0.0f;
+		} else if (type == LightType::SPOT) {
+			l.mCosThetaO = std::cos(aLight.inner_angle);
+			l.mCosThetaE = std::cos(std::max(aLight.outer_angle - aLight.inner_angle, 0.0f));
+		} else if (static_cast<uint32_t>(type) & static_cast<uint32_t>(LightType::SURFACE)) {
+			radius = 0.5f * glm::length(glm::vec2(aLight.dimensions));
+			if (!aLight.double_sided) l.mCosThetaO = 1.0f;
+		}
+		l.mMin = position - glm::vec3(radius);
+		l.mMax = position + glm::vec3(radius);
+		return l;
+	}
+}
+
+LightDataVulkan::LightDataVulkan(rvk::LogicalDevice* aDevice): mDevice(aDevice), mBufferUsageFlags(0), mMaxLightCount(0), mLightBuffer(aDevice),
+	mAliasTableBuffer(aDevice), mLightTreeBuffer(aDevice)
 {}
 
 LightDataVulkan::~LightDataVulkan()
@@ -22,11 +146,18 @@ void LightDataVulkan::prepare(const uint32_t aLightBufferUsageFlags, const uint3
 	mRefLightToIndex.reserve(aLightCount);
 	mRefMeshToIndex.reserve(aLightCount);
 	mLightBuffer.create(aLightBufferUsageFlags, aLightCount * sizeof(Light_s), rvk::Buffer::Location::DEVICE);
+	mBufferUsageFlags = aLightBufferUsageFlags;
+	mAliasTableBuffer.create(mBufferUsageFlags, INITIAL_ALIAS_TABLE_SIZE * sizeof(AliasTableEntry_s), rvk::Buffer::Location::DEVICE);
+	// a tree over n lights has at most 2n - 1 nodes, infinite lights take one node each
+	mLightTreeBuffer.create(mBufferUsageFlags, 2ull * std::max(aLightCount, 1u) * sizeof(LightTreeNode_s), rvk::Buffer::Location::DEVICE);
 }
 void LightDataVulkan::destroy()
 {
 	unloadScene();
 	mLightBuffer.destroy();
+	mAliasTableBuffer.destroy();
+	mLightTreeBuffer.destroy();
+	mAliasTables.clear();
 	mMaxLightCount = 0;
 }
 
@@ -45,6 +176,7 @@ void LightDataVulkan::loadScene(rvk::SingleTimeCommand* aStc, const std::deque<s
 			l.pos_ws = glm::vec4(refLight->position, 1);
 			l.n_ws_norm = glm::vec4(refLight->direction,0);
 			l.t_ws_norm = glm::normalize(refLight->model_matrix * refLight->light->getDefaultTangent());
+			l.alias_table_offset = static_cast<uint32_t>(-1);
 
 			if (refLight->light->getType() == Light::Type::IES && aTextureDataVulkan)
 			{
@@ -57,6 +189,7 @@ void LightDataVulkan::loadScene(rvk::SingleTimeCommand* aStc, const std::deque<s
 			if (mLights.size() > mMaxLightCount) spdlog::error("Light count > buffer size");
 		}
 	}
+	std::vector<std::pair<RefModel*, RefMesh*>> meshLights;
 	if (aTextureDataVulkan && aRefModels && aGeometryDataVulkan) {
 		
 		for (auto& refModel : *aRefModels) {
@@ -82,6 +215,8 @@ void LightDataVulkan::loadScene(rvk::SingleTimeCommand* aStc, const std::deque<s
 				l.index_buffer_offset = refMesh->mesh->hasIndices() ? offsets.mIndexOffset : -1;
 				l.vertex_buffer_offset = offsets.mVertexOffset;
 				l.triangle_count = static_cast<uint32_t>(refMesh->mesh->getPrimitiveCount());
+				l.alias_table_offset = static_cast<uint32_t>(-1);
+				meshLights.emplace_back(refModel.get(), refMesh.get());
 
 				mRefMeshToIndex.insert(std::pair(refMesh.get(), static_cast<uint32_t>(mLights.size())));
 				mLights.push_back(l);
@@ -89,6 +224,8 @@ void LightDataVulkan::loadScene(rvk::SingleTimeCommand* aStc, const std::deque<s
 			}
 		}
 	}
+	updateAliasTables(aStc, meshLights);
+	updateLightTree(aStc, meshLights);
 	if(!mLights.empty()) mLightBuffer.STC_UploadData(aStc, mLights.data(), mLights.size() * sizeof(Light_s), 0);
 }
 
@@ -97,6 +234,7 @@ void LightDataVulkan::unloadScene()
 	mLights.clear();
 	mRefLightToIndex.clear();
 	mRefMeshToIndex.clear();
+	mLightTree.clear();
 }
 
 void LightDataVulkan::update(rvk::SingleTimeCommand* aStc, const SceneBackendData aScene, TextureDataVulkan* aTextureDataVulkan, GeometryDataVulkan* aGeometryDataVulkan)
@@ -113,6 +251,98 @@ void LightDataVulkan::update(rvk::SingleTimeCommand* aStc, const std::deque<std:
 rvk::Buffer* LightDataVulkan::getLightBuffer()
 { return &mLightBuffer; }
 
+rvk::Buffer* LightDataVulkan::getAliasTableBuffer()
+{ return &mAliasTableBuffer; }
+
+const AliasTable* LightDataVulkan::getAliasTable(RefMesh* aRefMesh) const
+{
+	const auto it = mAliasTables.find(aRefMesh);
+	if (it == mAliasTables.end() || it->second.mTable.empty()) return nullptr;
+	return &it->second.mTable;
+}
+
+void LightDataVulkan::updateAliasTables(rvk::SingleTimeCommand* aStc, const std::vector<std::pair<RefModel*, RefMesh*>>& aMeshLights)
+{
+	// tables are kept as long as transform, emission texture and triangle count of the mesh light stay the same
+	std::unordered_map<RefMesh*, MeshAliasTable> tables;
+	std::vector<std::pair<size_t, MeshAliasTable*>> rebuild;
+	tables.reserve(aMeshLights.size());
+	for (size_t i = 0; i < aMeshLights.size(); i++) {
+		const auto [refModel, refMesh] = aMeshLights[i];
+		const Texture* tex = refMesh->mesh->getMaterial()->getEmissionTexture();
+		const size_t triangleCount = refMesh->mesh->getPrimitiveCount();
+		const auto it = mAliasTables.find(refMesh);
+		if (it != mAliasTables.end() && it->second.mModelMatrix == refModel->model_matrix && it->second.mTexture == tex && it->second.mTriangleCount == triangleCount) {
+			tables.emplace(refMesh, std::move(it->second));
+		} else {
+			auto& entry = tables[refMesh];
+			entry = { refModel->model_matrix, tex, triangleCount, {}, 0.0f };
+			rebuild.emplace_back(i, &entry);
+		}
+	}
+	bool changed = !rebuild.empty() || tables.size() != mAliasTables.size();
+	mAliasTables = std::move(tables);
+
+	ThreadPool::getInstance().parallelFor(0, rebuild.size(), [&](const size_t aIndex) {
+		const auto [meshLight, entry] = rebuild[aIndex];
+		const auto [refModel, refMesh] = aMeshLights[meshLight];
+		if (!buildTriangleTable(entry->mTable, entry->mEmittingArea, refModel, refMesh, entry->mTexture)) {
+			spdlog::warn("Mesh light '{}' has no emitting area, sampling its triangles uniformly", refModel->model->getName());
+		}
+	});
+
+	// unchanged tables in a new order (a mesh light was removed or the lights were reordered) still move in the buffer
+	std::vector<AliasTableEntry_s> entries;
+	std::vector<std::pair<RefMesh*, uint32_t>> offsets;
+	offsets.reserve(aMeshLights.size());
+	for (const auto& [refModel, refMesh] : aMeshLights) {
+		const AliasTable& table = mAliasTables[refMesh].mTable;
+		if (table.empty()) continue;
+		const auto offset = static_cast<uint32_t>(entries.size());
+		mLights[mRefMeshToIndex[refMesh]].alias_table_offset = offset;
+		offsets.emplace_back(refMesh, offset);
+		entries.insert(entries.end(), table.getEntries().begin(), table.getEntries().end());
+	}
+	changed |= offsets != mAliasTableOffsets;
+	mAliasTableOffsets = std::move(offsets);
+	if (!changed || entries.empty()) return;
+
+	const size_t size = entries.size() * sizeof(AliasTableEntry_s);
+	if (mAliasTableBuffer.getSize() < size) {
+		mAliasTableBuffer.destroy();
+		mAliasTableBuffer.create(mBufferUsageFlags, std::max(size, 2 * mAliasTableBuffer.getSize()), rvk::Buffer::Location::DEVICE);
+	}
+	mAliasTableBuffer.STC_UploadData(aStc, entries.data(), size, 0);
+}
+
+void LightDataVulkan::updateLightTree(rvk::SingleTimeCommand* aStc, const std::vector<std::pair<RefModel*, RefMesh*>>& aMeshLights)
+{
+	std::vector<LightTreeLight> lights(mLights.size());
+	for (size_t i = 0; i < mLights.size(); i++) {
+		if (static_cast<LightType>(mLights[i].type) != LightType::TRIANGLE_MESH) lights[i] = treeLight(mLights[i]);
+	}
+	// mesh lights emit to all sides, their power is the radiance times the emitting area
+	for (const auto& [refModel, refMesh] : aMeshLights) {
+		const Light_s& light = mLights[mRefMeshToIndex[refMesh]];
+		const aabb_s aabb = refMesh->mesh->getAABB().transform(refModel->model_matrix);
+		LightTreeLight& l = lights[mRefMeshToIndex[refMesh]];
+		l.mMin = aabb.mMin;
+		l.mMax = aabb.mMax;
+		l.mAxis = glm::vec3(0, 0, 1);
+		l.mCosThetaO = -1.0f;
+		l.mCosThetaE = 0.0f;
+		l.mPower = PI * light.intensity * luminance(light.color) * mAliasTables[refMesh].mEmittingArea;
+	}
+	mLightTree.build(lights);
+	if (!mLightTree.empty()) mLightTreeBuffer.STC_UploadData(aStc, mLightTree.getNodes().data(), mLightTree.getNodes().size() * sizeof(LightTreeNode_s), 0);
+}
+
+rvk::Buffer* LightDataVulkan::getLightTreeBuffer()
+{ return &mLightTreeBuffer; }
+
+const LightTree& LightDataVulkan::getLightTree() const
+{ return mLightTree; }
+
 uint32_t LightDataVulkan::getLightCount() const
 { return static_cast<uint32_t>(mLights.size()); }
 
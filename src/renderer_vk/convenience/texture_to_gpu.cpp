@@ -2,6 +2,7 @@
 #include <tamashii/renderer_vk/convenience/rvk_type_converter.hpp>
 #include <tamashii/core/io/io.hpp>
 #include <tamashii/core/scene/light.hpp>
+#include <tamashii/core/common/profiler.hpp>
 
 #include <algorithm>
 
@@ -38,6 +39,7 @@ void TextureDataVulkan::loadScene(rvk::SingleTimeCommand* aStc, const tamashii::
 }
 void TextureDataVulkan::loadScene(rvk::SingleTimeCommand* aStc, const std::deque<tamashii::Image*>& aImages, const std::deque<Texture*>& aTextures)
 {
+	T_PROFILE_SCOPE("upload textures");
 	unloadScene();
 	
 	
@@ -212,12 +212,13 @@ void VulkanInstance::init(tamashii::Window* aWindow)
 	
 	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT };
 	VkPhysicalDeviceShaderAtomicFloatFeaturesEXT atomicFloatFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_FLOAT_FEATURES_EXT };
+	VkPhysicalDeviceShaderAtomicInt64Features atomicInt64Features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_INT64_FEATURES };
 	VkPhysicalDeviceRayTracingPipelineFeaturesKHR pipelineFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR };
 	VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR };
 	VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeature{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES };
 	VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES };
 	VkPhysicalDeviceFeatures2 device_features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR };
-	rvkChain(device_features, dynamicRenderingFeatures, bufferDeviceAddressFeature, accelerationStructureFeatures, pipelineFeatures, atomicFloatFeatures, indexingFeatures);
+	rvkChain(device_features, dynamicRenderingFeatures, bufferDeviceAddressFeature, accelerationStructureFeatures, pipelineFeatures, atomicFloatFeatures, atomicInt64Features, indexingFeatures);
 	mInstance->vk.GetPhysicalDeviceFeatures2(d->getHandle(), &device_features);
 
 #define CHECK_FEATURE(struct, feat) if(!struct.feat) spdlog::warn("Vulkan: Feature '" #feat "' not supported by device")
@@ -233,6 +234,7 @@ void VulkanInstance::init(tamashii::Window* aWindow)
 	CHECK_FEATURE(indexingFeatures, descriptorBindingPartiallyBound);
 	CHECK_FEATURE(atomicFloatFeatures, shaderBufferFloat32AtomicAdd);
 	CHECK_FEATURE(atomicFloatFeatures, shaderBufferFloat64AtomicAdd);
+	CHECK_FEATURE(atomicInt64Features, shaderBufferInt64Atomics);
 	CHECK_FEATURE(dynamicRenderingFeatures, dynamicRendering);
 	if (rtAvailable) {
 		CHECK_FEATURE(pipelineFeatures, rayTracingPipeline);
@@ -63,6 +63,8 @@ public:
 													
 													
 													
+													// device buffers are staged through the staging ring of the device, if aStc is recording
+													// already the copy is appended and executed when the caller ends aStc
 	void											STC_UploadData(SingleTimeCommand* aStc, const void* aDataUp, uint64_t aSize = UINT64_MAX, uint64_t aOffset = 0) const;
 													
 	void											STC_DownloadData(SingleTimeCommand* aStc, void* aDataDown, uint64_t aSize = UINT64_MAX, uint64_t aOffset = 0) const;
@@ -70,11 +70,14 @@ public:
 	void					end();
 							
 	void					execute(const std::function<void(CommandBuffer*)>& aFunction);
+							// called once after the next end() finished executing on the queue
+	void					onEnd(std::function<void()> aCallback);
 
 private:
 	CommandPool*			mCommandPool;
 	Queue*					mQueue;
 
 	CommandBuffer*			mCommandBuffer;
+	std::vector<std::function<void()>> mOnEnd;
 };
 RVK_END_NAMESPACE
\ No newline at end of file
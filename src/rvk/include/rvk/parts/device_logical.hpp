@@ -4,6 +4,7 @@
 
 #include <deque>
 #include <unordered_map>
+#include <mutex>
 
 RVK_BEGIN_NAMESPACE
 class PhysicalDevice;
@@ -14,6 +15,7 @@ class Semaphore;
 class Queue;
 class QueueFamily;
 class Sampler;
+class StagingRing;
 
 
 
@@ -52,6 +54,8 @@ public:
 	[[nodiscard]] VkDeviceMemory					allocMemory(VkDeviceSize aAllocationSize, uint32_t aMemoryTypeIndex) const;
 
 	Sampler*										getSampler(SamplerConfig aConfig);
+													// shared by all buffer uploads of this device, created on first use
+	StagingRing*									getStagingRing();
 
 	VkDevice										getHandle() const;
 	PhysicalDevice*									getPhysicalDevice() const;
@@ -82,6 +86,8 @@ private:
 	std::deque<Fence*>								mFences;
 	
 	std::unordered_map<SamplerConfig, Sampler*, SamplerConfig> mSamplers;
+	StagingRing*									mStagingRing;
+	std::once_flag									mStagingRingOnce;
 
 	VkDevice										mLogicalDevice;
 };
@@ -0,0 +1,41 @@
+#pragma once
+// only depends on the standard library, so it can be built and tested without vulkan
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace rvk {
+/**
+* RingAllocator
+* Suballocates aligned regions from a fixed range in FIFO order, independent of any graphics api.
+* Every region is tagged with a fence value. Regions are handed back from the oldest on, once the
+* fence source reports their value as signaled.
+**/
+class RingAllocator {
+public:
+	static constexpr uint64_t						INVALID = UINT64_MAX;
+
+	explicit										RingAllocator(uint64_t aCapacity = 0);
+
+	void											reset(uint64_t aCapacity);
+													// returns the offset of the region or INVALID if there is no room until older regions retire
+	uint64_t										allocate(uint64_t aSize, uint64_t aAlignment, uint64_t aFenceValue);
+													// frees regions from the oldest on while aSignaled returns true for their fence value
+	void											retire(const std::function<bool(uint64_t)>& aSignaled);
+
+	[[nodiscard]] uint64_t							capacity() const { return mCapacity; }
+	[[nodiscard]] uint64_t							used() const { return mUsed; }
+	[[nodiscard]] bool								empty() const { return mRegions.empty(); }
+private:
+	struct Region {
+		uint64_t									mEnd;
+		uint64_t									mSize;		// including alignment padding and the skipped end of the range on wrap around
+		uint64_t									mFenceValue;
+	};
+	std::deque<Region>								mRegions;
+	uint64_t										mCapacity;
+	uint64_t										mHead;
+	uint64_t										mTail;
+	uint64_t										mUsed;
+};
+}
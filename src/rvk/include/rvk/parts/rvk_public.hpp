@@ -11,6 +11,8 @@
 
 
 #define RVK_USE_INVERSE_Z
+// size of the persistently mapped staging buffer every device uses for uploads, larger uploads get their own
+#define RVK_STAGING_RING_SIZE (64ull << 20)
 
 #include <deque>
 #include <thread>
@@ -0,0 +1,40 @@
+#pragma once
+#include <rvk/parts/rvk_public.hpp>
+#include <rvk/parts/buffer.hpp>
+#include <rvk/parts/ring_allocator.hpp>
+
+#include <mutex>
+#include <unordered_set>
+
+RVK_BEGIN_NAMESPACE
+class LogicalDevice;
+class SingleTimeCommand;
+/**
+* StagingRing
+* Persistently mapped host buffer shared by all uploads of a device. Uploads suballocate from it and record
+* their copy into the command buffer of the single time command, the region is reclaimed when that command ends.
+**/
+class StagingRing {
+public:
+													StagingRing(LogicalDevice* aDevice, VkDeviceSize aCapacity);
+													~StagingRing();
+													StagingRing(StagingRing const&) = delete;
+	void											operator=(StagingRing const&) = delete;
+
+													// aStc has to be recording, returns false if the data does not fit into the ring
+	bool											CMD_Upload(SingleTimeCommand* aStc, const Buffer* aBufferDst, const void* aData, uint64_t aSize, uint64_t aOffsetDst);
+	[[nodiscard]] VkDeviceSize						getCapacity() const;
+
+private:
+	void											signal(const SingleTimeCommand* aStc, uint64_t aFenceValue);
+
+	LogicalDevice*									mDevice;
+	Buffer											mBuffer;
+	RingAllocator									mAllocator;
+	std::mutex										mMutex;
+	uint64_t										mFenceValue;
+													// every single time command that is recording uploads holds one fence value
+	std::unordered_map<const SingleTimeCommand*, uint64_t> mOpenBatches;
+	std::unordered_set<uint64_t>					mSignaled;
+};
+RVK_END_NAMESPACE
@@ -13,6 +13,8 @@
 #include <rvk/parts/fence.hpp>
 
 #include <rvk/parts/buffer.hpp>
+#include <rvk/parts/ring_allocator.hpp>
+#include <rvk/parts/staging_ring.hpp>
 #include <rvk/parts/sampler.hpp>
 #include <rvk/parts/image.hpp>
 #include <rvk/parts/acceleration_structure.hpp>
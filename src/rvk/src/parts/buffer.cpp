@@ -1,4 +1,5 @@
 #include <rvk/parts/buffer.hpp>
+#include <rvk/parts/staging_ring.hpp>
 #include "rvk_private.hpp"
 RVK_USE_NAMESPACE
 
@@ -180,19 +181,24 @@ void Buffer::STC_UploadData(SingleTimeCommand* aStc, const void* aDataUp, uint64
 			return;
 		}
 
-		Buffer stagingBuffer(mDevice);
-		stagingBuffer.create(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, aSize, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		stagingBuffer.mapBuffer();
-		uint8_t* p = stagingBuffer.getMemoryPointer();
-		memcpy(p, aDataUp, (size_t)aSize);
-		stagingBuffer.unmapBuffer();
+		// a single time command that is already recording collects the upload, it is executed when the caller ends it
+		const bool recording = aStc->buffer() != nullptr;
+		if (!recording) aStc->begin();
 
-		aStc->begin();
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = aSize;
-		copyRegion.dstOffset = aOffset;
-		mDevice->vkCmd.CopyBuffer(aStc->buffer()->getHandle(), stagingBuffer.getRawHandle(), mBuffer, 1, &copyRegion);
+		Buffer stagingBuffer(mDevice);
+		if (!mDevice->getStagingRing()->CMD_Upload(aStc, this, aDataUp, aSize, aOffset)) {
+			stagingBuffer.create(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, aSize, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+			stagingBuffer.mapBuffer();
+			uint8_t* p = stagingBuffer.getMemoryPointer();
+			memcpy(p, aDataUp, (size_t)aSize);
+			stagingBuffer.unmapBuffer();
+
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = aSize;
+			copyRegion.dstOffset = aOffset;
+			mDevice->vkCmd.CopyBuffer(aStc->buffer()->getHandle(), stagingBuffer.getRawHandle(), mBuffer, 1, &copyRegion);
+		}
 
 		VkMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
@@ -210,7 +216,11 @@ void Buffer::STC_UploadData(SingleTimeCommand* aStc, const void* aDataUp, uint64
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT,
 			0, 1, &barrier, 0, &bufferbarrier, 0, VK_NULL_HANDLE);
-		aStc->end();
+
+		// a dedicated staging buffer has to outlive the copy
+		const bool dedicated = stagingBuffer.getRawHandle() != VK_NULL_HANDLE;
+		if (!recording || dedicated) aStc->end();
+		if (recording && dedicated) aStc->begin();
 	}
 }
 
@@ -163,6 +163,10 @@ void SingleTimeCommand::end()
 	mQueue->waitIdle();
 	mCommandPool->freeCommandBuffers({ mCommandBuffer });
 	mCommandBuffer = nullptr;
+
+	std::vector<std::function<void()>> callbacks;
+	callbacks.swap(mOnEnd);
+	for (const auto& callback : callbacks) callback();
 }
 
 void SingleTimeCommand::execute(const std::function<void(CommandBuffer*)>& aFunction)
@@ -171,3 +175,8 @@ void SingleTimeCommand::execute(const std::function<void(CommandBuffer*)>& aFunc
 	aFunction(mCommandBuffer);
 	end();
 }
+
+void SingleTimeCommand::onEnd(std::function<void()> aCallback)
+{
+	mOnEnd.push_back(std::move(aCallback));
+}
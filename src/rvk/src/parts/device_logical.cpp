@@ -1,10 +1,11 @@
 #include <rvk/parts/device_logical.hpp>
 #include <rvk/parts/semaphore.hpp>
 #include <rvk/parts/fence.hpp>
+#include <rvk/parts/staging_ring.hpp>
 #include "rvk_private.hpp"
 RVK_USE_NAMESPACE
 
-LogicalDevice::LogicalDevice(PhysicalDevice* aPhysicalDevice, const VkDevice aDevice) : mPhysicalDevice{ aPhysicalDevice }, mSamplers{ 40 }, mLogicalDevice{ aDevice }
+LogicalDevice::LogicalDevice(PhysicalDevice* aPhysicalDevice, const VkDevice aDevice) : mPhysicalDevice{ aPhysicalDevice }, mSamplers{ 40 }, mStagingRing{ nullptr }, mLogicalDevice{ aDevice }
 {
 	const Instance* instance = mPhysicalDevice->getInstance();
 #define VK_DEVICE_LEVEL_FUNCTION(fn) vk.fn = (PFN_vk##fn) instance->vk.GetDeviceProcAddr( mLogicalDevice , "vk"#fn );
@@ -16,6 +17,8 @@ LogicalDevice::LogicalDevice(PhysicalDevice* aPhysicalDevice, const VkDevice aDe
 
 LogicalDevice::~LogicalDevice()
 {
+	delete mStagingRing;
+	mStagingRing = nullptr;
 	mQueueFamilies.clear();
 	for (const Semaphore* s : mSemaphores) delete s;
 	mSemaphores.clear();
@@ -190,3 +193,9 @@ PhysicalDevice* LogicalDevice::getPhysicalDevice() const
 {
 	return mPhysicalDevice;
 }
+
+StagingRing* LogicalDevice::getStagingRing()
+{
+	std::call_once(mStagingRingOnce, [this] { mStagingRing = new StagingRing(this, RVK_STAGING_RING_SIZE); });
+	return mStagingRing;
+}
@@ -0,0 +1,55 @@
+#include <rvk/parts/ring_allocator.hpp>
+using namespace rvk;
+
+RingAllocator::RingAllocator(const uint64_t aCapacity) : mCapacity(0), mHead(0), mTail(0), mUsed(0)
+{
+	reset(aCapacity);
+}
+
+void RingAllocator::reset(const uint64_t aCapacity)
+{
+	mRegions.clear();
+	mCapacity = aCapacity;
+	mHead = 0;
+	mTail = 0;
+	mUsed = 0;
+}
+
+uint64_t RingAllocator::allocate(const uint64_t aSize, uint64_t aAlignment, const uint64_t aFenceValue)
+{
+	if (aSize == 0 || aSize > mCapacity) return INVALID;
+	if (aAlignment == 0) aAlignment = 1;
+	const auto alignUp = [aAlignment](const uint64_t aValue) { return (aValue + aAlignment - 1) / aAlignment * aAlignment; };
+
+	uint64_t offset = INVALID;
+	if (mRegions.empty()) {
+		mHead = mTail = 0;
+		offset = 0;
+	}
+	else if (mHead > mTail) {
+		// free space is the end of the range and the start up to the tail
+		if (alignUp(mHead) + aSize <= mCapacity) offset = alignUp(mHead);
+		else if (aSize <= mTail) offset = 0;
+	}
+	else if (mHead < mTail) {
+		if (alignUp(mHead) + aSize <= mTail) offset = alignUp(mHead);
+	}
+	if (offset == INVALID) return INVALID;
+
+	// the region owns everything from the old head, so retiring it moves the tail past the padding
+	const uint64_t size = offset >= mHead ? offset + aSize - mHead : mCapacity - mHead + aSize;
+	mRegions.push_back({ offset + aSize, size, aFenceValue });
+	mHead = offset + aSize;
+	mUsed += size;
+	return offset;
+}
+
+void RingAllocator::retire(const std::function<bool(uint64_t)>& aSignaled)
+{
+	while (!mRegions.empty() && aSignaled(mRegions.front().mFenceValue)) {
+		mTail = mRegions.front().mEnd;
+		mUsed -= mRegions.front().mSize;
+		mRegions.pop_front();
+	}
+	if (mRegions.empty()) mHead = mTail = 0;
+}
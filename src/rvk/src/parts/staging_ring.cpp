@@ -0,0 +1,68 @@
+#include <rvk/parts/staging_ring.hpp>
+#include "rvk_private.hpp"
+RVK_USE_NAMESPACE
+
+namespace {
+	constexpr uint64_t STAGING_ALIGNMENT = 16;
+}
+
+StagingRing::StagingRing(LogicalDevice* aDevice, const VkDeviceSize aCapacity) : mDevice(aDevice), mBuffer(aDevice), mFenceValue(0)
+{
+	mBuffer.create(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, aCapacity, Buffer::Location::HOST_COHERENT);
+	mBuffer.mapBuffer();
+	mAllocator.reset(aCapacity);
+}
+
+StagingRing::~StagingRing()
+{
+	mBuffer.destroy();
+}
+
+bool StagingRing::CMD_Upload(SingleTimeCommand* aStc, const Buffer* aBufferDst, const void* aData, const uint64_t aSize, const uint64_t aOffsetDst)
+{
+	if (aSize > mAllocator.capacity()) return false;
+
+	uint64_t offset = RingAllocator::INVALID;
+	while (offset == RingAllocator::INVALID) {
+		std::unique_lock lock(mMutex);
+		const auto batch = mOpenBatches.find(aStc);
+		const uint64_t fenceValue = batch != mOpenBatches.end() ? batch->second : mFenceValue + 1;
+		offset = mAllocator.allocate(aSize, STAGING_ALIGNMENT, fenceValue);
+		if (offset != RingAllocator::INVALID) {
+			if (batch == mOpenBatches.end()) {
+				mFenceValue = fenceValue;
+				mOpenBatches.emplace(aStc, fenceValue);
+				aStc->onEnd([this, aStc, fenceValue] { signal(aStc, fenceValue); });
+			}
+			break;
+		}
+		// the ring is full with copies of commands that are still recording elsewhere
+		if (batch == mOpenBatches.end()) return false;
+		lock.unlock();
+		// the ring is full with copies of this command, submit them and continue in a new command buffer
+		aStc->end();
+		aStc->begin();
+	}
+	std::memcpy(mBuffer.getMemoryPointer() + offset, aData, aSize);
+
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = offset;
+	copyRegion.dstOffset = aOffsetDst;
+	copyRegion.size = aSize;
+	mDevice->vkCmd.CopyBuffer(aStc->buffer()->getHandle(), mBuffer.getRawHandle(), aBufferDst->getRawHandle(), 1, &copyRegion);
+	return true;
+}
+
+VkDeviceSize StagingRing::getCapacity() const
+{
+	return mAllocator.capacity();
+}
+
+void StagingRing::signal(const SingleTimeCommand* aStc, const uint64_t aFenceValue)
+{
+	std::scoped_lock lock(mMutex);
+	mOpenBatches.erase(aStc);
+	mSignaled.insert(aFenceValue);
+	mAllocator.retire([this](const uint64_t aValue) { return mSignaled.count(aValue) > 0; });
+	if (mAllocator.empty()) mSignaled.clear();
+}
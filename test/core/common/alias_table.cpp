@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+#include <tamashii/core/common/alias_table.hpp>
+
+#include <cmath>
+#include <random>
+
+T_USE_NAMESPACE
+
+namespace {
+	// probability of every index implied by the table: its own column plus the columns that alias to it
+	std::vector<double> impliedProbabilities(const AliasTable& aTable)
+	{
+		const std::vector<AliasTableEntry_s>& entries = aTable.getEntries();
+		std::vector<double> p(entries.size(), 0.0);
+		for (const AliasTableEntry_s& e : entries) {
+			const size_t i = &e - entries.data();
+			p[i] += e.probability / static_cast<double>(entries.size());
+			p[e.alias] += (1.0 - e.probability) / static_cast<double>(entries.size());
+		}
+		return p;
+	}
+
+	std::vector<float> randomWeights(const size_t aCount, std::mt19937& aRng)
+	{
+		std::uniform_real_distribution<float> u(0, 1);
+		std::vector<float> weights(aCount);
+		// every third weight is zero, a few are much larger than the rest
+		for (size_t i = 0; i < aCount; i++) weights[i] = i % 3 == 0 ? 0.0f : (i % 101 == 1 ? 1000.0f : u(aRng));
+		return weights;
+	}
+}
+
+TEST_CASE("alias table sample frequencies match the weights", "[alias_table]")
+{
+	std::mt19937 rng(19);
+	std::uniform_real_distribution<float> u(0, 1);
+	for (const size_t count : { size_t(1), size_t(2), size_t(7), size_t(300) }) {
+		std::vector<float> weights = randomWeights(count, rng);
+		if (count == 1) weights[0] = 2.0f;
+		double sum = 0;
+		for (const float w : weights) sum += w;
+		AliasTable table;
+		REQUIRE(table.build(weights));
+		REQUIRE(table.size() == count);
+
+		constexpr int sampleCount = 500000;
+		std::vector<double> histogram(count, 0);
+		for (int s = 0; s < sampleCount; s++) histogram[table.sample(u(rng))]++;
+		double maxSigma = 0;
+		for (size_t i = 0; i < count; i++) {
+			const double p = weights[i] / sum;
+			REQUIRE(std::abs(table.pdf(static_cast<uint32_t>(i)) - p) <= 1e-6 * std::max(1.0, p));
+			// zero weights are never picked
+			if (weights[i] == 0.0f) REQUIRE(histogram[i] == 0);
+			const double sigma = std::sqrt(std::max(p * (1.0 - p), 1e-7) / sampleCount);
+			maxSigma = std::max(maxSigma, std::abs(histogram[i] / sampleCount - p) / sigma);
+		}
+		REQUIRE(maxSigma < 6.0);
+	}
+}
+
+TEST_CASE("alias table columns add up to the weights", "[alias_table]")
+{
+	std::mt19937 rng(29);
+	// the large list is normalized on the thread pool
+	for (const size_t count : { size_t(1000), size_t(200000) }) {
+		const std::vector<float> weights = randomWeights(count, rng);
+		double sum = 0;
+		for (const float w : weights) sum += w;
+		AliasTable table;
+		REQUIRE(table.build(weights));
+
+		const std::vector<double> p = impliedProbabilities(table);
+		size_t mismatches = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (std::abs(p[i] - weights[i] / sum) > 1e-6 / static_cast<double>(count) + 1e-5 * weights[i] / sum) mismatches++;
+			// a zero weight column always redirects to a weighted entry
+			const AliasTableEntry_s& e = table.getEntries()[i];
+			if (weights[i] == 0.0f && (e.probability != 0.0f || weights[e.alias] == 0.0f)) mismatches++;
+		}
+		REQUIRE(mismatches == 0);
+	}
+}
+
+TEST_CASE("alias table rejects weights without mass", "[alias_table]")
+{
+	AliasTable table;
+	REQUIRE_FALSE(table.build(std::vector<float>{}));
+	REQUIRE_FALSE(table.build(std::vector<float>{ 0.0f, 0.0f, -1.0f }));
+	REQUIRE(table.empty());
+	// invalid weights count as zero
+	REQUIRE(table.build(std::vector<float>{ 0.0f, NAN, 3.0f, -2.0f, INFINITY }));
+	for (int s = 0; s < 1000; s++) REQUIRE(table.sample(s / 1000.0f) == 2);
+	REQUIRE(table.pdf(2) == 1.0f);
+	table.clear();
+	REQUIRE(table.empty());
+}
@@ -0,0 +1,96 @@
+#include <catch2/catch_test_macros.hpp>
+#include <tamashii/core/common/light_tree.hpp>
+
+#include <cmath>
+#include <random>
+
+T_USE_NAMESPACE
+
+namespace {
+	// a mix of points and boxes, spot cones and omni lights, some infinite and one without power
+	std::vector<LightTreeLight> randomLights(const int aCount, const bool aInfinite, std::mt19937& aRng)
+	{
+		std::uniform_real_distribution<float> u(0, 1);
+		std::vector<LightTreeLight> lights;
+		for (int i = 0; i < aCount; i++) {
+			const glm::vec3 center(u(aRng) * 10, u(aRng) * 10, u(aRng) * 10);
+			const float radius = i % 3 == 0 ? 0 : u(aRng) * 0.5f;
+			LightTreeLight light;
+			light.mMin = center - glm::vec3(radius);
+			light.mMax = center + glm::vec3(radius);
+			light.mAxis = glm::normalize(glm::vec3(u(aRng) - 0.5f, u(aRng) - 0.5f, u(aRng) - 0.5f));
+			light.mCosThetaO = i % 2 ? -1.0f : std::cos(0.3f);
+			light.mCosThetaE = i % 2 ? 0.0f : std::cos(0.5f);
+			light.mPower = i == 5 ? 0.0f : u(aRng) * 5 + 0.01f;
+			light.mInfinite = aInfinite && i % 17 == 0;
+			lights.push_back(light);
+		}
+		return lights;
+	}
+}
+
+TEST_CASE("light tree sample frequencies match pdf", "[light_tree]")
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> u(0, 1);
+	for (const int count : { 1, 2, 50, 150 }) {
+		const std::vector<LightTreeLight> lights = randomLights(count, count > 50, rng);
+		LightTree tree;
+		tree.build(lights);
+		REQUIRE_FALSE(tree.empty());
+
+		for (int query = 0; query < 4; query++) {
+			const glm::vec3 p(u(rng) * 12 - 1, u(rng) * 12 - 1, u(rng) * 12 - 1);
+			const glm::vec3 n = query % 2 ? glm::normalize(glm::vec3(0, 1, 0.2f)) : glm::vec3(0);
+			constexpr int sampleCount = 200000;
+			std::vector<double> histogram(count, 0);
+			int pdfMismatches = 0, failures = 0;
+			for (int s = 0; s < sampleCount; s++) {
+				float pdf;
+				const int index = tree.sample(p, n, u(rng), pdf);
+				if (index < 0) { failures++; continue; }
+				histogram[index]++;
+				const float expected = tree.pdf(p, n, index);
+				if (std::abs(expected - pdf) > 1e-4f * pdf) pdfMismatches++;
+			}
+			REQUIRE(pdfMismatches == 0);
+
+			// every frequency is within a few standard deviations of the pdf. The descent can end in a subtree
+			// without importance, so the missing pdf mass is the probability of a failed sample
+			double pdfSum = 0, maxSigma = 0;
+			auto check = [&](const double aFrequency, const double aPdf) {
+				const double sigma = std::sqrt(std::max(aPdf * (1.0 - aPdf), 1e-7) / sampleCount);
+				maxSigma = std::max(maxSigma, std::abs(aFrequency - aPdf) / sigma);
+			};
+			for (int i = 0; i < count; i++) {
+				const double pdf = tree.pdf(p, n, i);
+				pdfSum += pdf;
+				check(histogram[i] / sampleCount, pdf);
+			}
+			check(static_cast<double>(failures) / sampleCount, pdfSum > 1.0 - 1e-4 ? 0.0 : 1.0 - pdfSum);
+			REQUIRE(pdfSum < 1.0 + 1e-4);
+			REQUIRE(tree.pdf(p, n, 5) == 0.0f);
+			REQUIRE(maxSigma < 6.0);
+		}
+	}
+}
+
+TEST_CASE("light tree stores infinite lights after the tree", "[light_tree]")
+{
+	std::mt19937 rng(11);
+	const std::vector<LightTreeLight> lights = randomLights(100, true, rng);
+	LightTree tree;
+	tree.build(lights);
+
+	uint32_t infinite = 0;
+	for (const LightTreeLight& light : lights) infinite += light.mInfinite;
+	REQUIRE(tree.getInfiniteLightCount() == infinite);
+	const std::vector<LightTreeNode_s>& nodes = tree.getNodes();
+	for (uint32_t i = tree.getTreeNodeCount(); i < nodes.size(); i++) {
+		REQUIRE(nodes[i].is_leaf);
+		REQUIRE(lights[nodes[i].light_index].mInfinite);
+	}
+
+	tree.clear();
+	REQUIRE(tree.empty());
+}
@@ -0,0 +1,71 @@
+#include <catch2/catch_test_macros.hpp>
+#include <tamashii/core/common/mpsc_queue.hpp>
+
+#include <thread>
+#include <vector>
+
+T_USE_NAMESPACE
+
+TEST_CASE("mpsc queue is a bounded fifo", "[mpsc_queue]")
+{
+	MpscQueue<int> queue(5);
+	REQUIRE(queue.capacity() == 8);
+
+	int value;
+	REQUIRE_FALSE(queue.tryPop(value));
+	for (int i = 0; i < 8; i++) REQUIRE(queue.tryPush(i));
+	REQUIRE_FALSE(queue.tryPush(8));
+	REQUIRE(queue.size() == 8);
+
+	// wraps around several times
+	for (int i = 0; i < 100; i++) {
+		REQUIRE(queue.tryPop(value));
+		REQUIRE(value == i);
+		REQUIRE(queue.tryPush(i + 8));
+	}
+	for (int i = 100; i < 108; i++) {
+		REQUIRE(queue.tryPop(value));
+		REQUIRE(value == i);
+	}
+	REQUIRE_FALSE(queue.tryPop(value));
+	REQUIRE(queue.size() == 0);
+}
+
+TEST_CASE("mpsc queue keeps every value and the order of each producer", "[mpsc_queue]")
+{
+	struct Value {
+		uint32_t mProducer;
+		uint32_t mSequence;
+	};
+	constexpr uint32_t producerCount = 16;
+	constexpr uint32_t valueCount = 100000;
+	// small, so producers keep running into a full queue
+	MpscQueue<Value> queue(64);
+
+	std::vector<std::thread> producers;
+	for (uint32_t p = 0; p < producerCount; p++) {
+		producers.emplace_back([&queue, p] {
+			for (uint32_t i = 0; i < valueCount; i++) {
+				while (!queue.tryPush(Value{ p, i })) std::this_thread::yield();
+			}
+		});
+	}
+
+	std::vector<uint32_t> next(producerCount, 0);
+	uint64_t received = 0, outOfOrder = 0;
+	Value value {};
+	while (received < static_cast<uint64_t>(producerCount) * valueCount) {
+		if (!queue.tryPop(value)) {
+			std::this_thread::yield();
+			continue;
+		}
+		if (value.mProducer >= producerCount || value.mSequence != next[value.mProducer]) outOfOrder++;
+		else next[value.mProducer]++;
+		received++;
+	}
+	for (std::thread& t : producers) t.join();
+
+	REQUIRE(outOfOrder == 0);
+	REQUIRE_FALSE(queue.tryPop(value));
+	for (const uint32_t n : next) REQUIRE(n == valueCount);
+}
@@ -0,0 +1,122 @@
+#include <catch2/catch_test_macros.hpp>
+#include <tamashii/core/common/range_allocator.hpp>
+
+#include <map>
+#include <random>
+
+T_USE_NAMESPACE
+
+TEST_CASE("range allocator first fit and fragmentation", "[range_allocator]")
+{
+	RangeAllocator ranges(100);
+	REQUIRE(ranges.allocate(10) == 0);
+	REQUIRE(ranges.allocate(20) == 10);
+	REQUIRE(ranges.allocate(30) == 30);
+	REQUIRE(ranges.used() == 60);
+	REQUIRE(ranges.end() == 60);
+
+	// a hole in the middle is reused by the next range that fits
+	ranges.free(10, 20);
+	REQUIRE(ranges.freeRangeCount() == 2);
+	REQUIRE(ranges.end() == 60);
+	REQUIRE(ranges.largestFreeRange() == 40);
+	REQUIRE(ranges.allocate(15) == 10);
+	REQUIRE(ranges.allocate(10) == 60);
+	REQUIRE(ranges.allocate(5) == 25);
+	REQUIRE(ranges.freeRangeCount() == 1);
+
+	// 30 free in total but not in one piece
+	ranges.free(0, 10);
+	REQUIRE(ranges.allocate(35) == RangeAllocator::INVALID);
+	REQUIRE(ranges.allocate(0) == RangeAllocator::INVALID);
+}
+
+TEST_CASE("range allocator coalesces free neighbours", "[range_allocator]")
+{
+	RangeAllocator ranges(40);
+	for (uint64_t i = 0; i < 4; i++) REQUIRE(ranges.allocate(10) == i * 10);
+	REQUIRE(ranges.freeRangeCount() == 0);
+	REQUIRE(ranges.end() == 40);
+
+	ranges.free(0, 10);
+	ranges.free(20, 10);
+	REQUIRE(ranges.freeRangeCount() == 2);
+	// merges with both sides
+	ranges.free(10, 10);
+	REQUIRE(ranges.freeRangeCount() == 1);
+	REQUIRE(ranges.largestFreeRange() == 30);
+	REQUIRE(ranges.end() == 40);
+	ranges.free(30, 10);
+	REQUIRE(ranges.freeRangeCount() == 1);
+	REQUIRE(ranges.used() == 0);
+	REQUIRE(ranges.end() == 0);
+	REQUIRE(ranges.allocate(40) == 0);
+
+	// ranges outside of the capacity are rejected
+	ranges.free(35, 10);
+	REQUIRE(ranges.used() == 40);
+}
+
+TEST_CASE("range allocator grows at its end", "[range_allocator]")
+{
+	RangeAllocator ranges(32);
+	REQUIRE(ranges.allocate(24) == 0);
+	REQUIRE(ranges.allocate(16) == RangeAllocator::INVALID);
+
+	// the new space merges with the free tail
+	ranges.grow(64);
+	REQUIRE(ranges.capacity() == 64);
+	REQUIRE(ranges.freeRangeCount() == 1);
+	REQUIRE(ranges.largestFreeRange() == 40);
+	REQUIRE(ranges.allocate(16) == 24);
+	REQUIRE(ranges.used() == 40);
+
+	ranges.grow(16);
+	REQUIRE(ranges.capacity() == 64);
+
+	ranges.reset(8);
+	REQUIRE(ranges.capacity() == 8);
+	REQUIRE(ranges.used() == 0);
+	REQUIRE(ranges.allocate(8) == 0);
+	// a full allocator grows without a free tail
+	ranges.grow(16);
+	REQUIRE(ranges.allocate(8) == 8);
+	REQUIRE(ranges.end() == 16);
+}
+
+TEST_CASE("range allocator random allocations", "[range_allocator]")
+{
+	RangeAllocator ranges(1024);
+	std::map<uint64_t, uint64_t> live;
+	std::mt19937 rng(5);
+	uint64_t used = 0;
+
+	for (int step = 0; step < 20000; step++) {
+		if (live.empty() || rng() % 2) {
+			const uint64_t size = 1 + rng() % 64;
+			uint64_t offset = ranges.allocate(size);
+			if (offset == RangeAllocator::INVALID) {
+				ranges.grow(ranges.capacity() + 256);
+				offset = ranges.allocate(size);
+			}
+			REQUIRE(offset != RangeAllocator::INVALID);
+			REQUIRE(offset + size <= ranges.capacity());
+			// no overlap with the neighbours
+			const auto next = live.lower_bound(offset);
+			if (next != live.end()) REQUIRE(offset + size <= next->first);
+			if (next != live.begin()) REQUIRE(std::prev(next)->first + std::prev(next)->second <= offset);
+			live.emplace(offset, size);
+			used += size;
+		}
+		else {
+			auto it = live.begin();
+			std::advance(it, rng() % live.size());
+			ranges.free(it->first, it->second);
+			used -= it->second;
+			live.erase(it);
+		}
+		REQUIRE(ranges.used() == used);
+		const uint64_t end = live.empty() ? 0 : live.rbegin()->first + live.rbegin()->second;
+		REQUIRE(ranges.end() == end);
+	}
+}
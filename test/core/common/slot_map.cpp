@@ -0,0 +1,117 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <tamashii/core/common/slot_map.hpp>
+
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+T_USE_NAMESPACE
+
+namespace {
+	// counts how often values are moved around inside the map
+	struct Counted {
+		static inline uint64_t sMoves = 0;
+		uint64_t mValue = 0;
+
+		Counted() = default;
+		explicit Counted(const uint64_t aValue) : mValue(aValue) {}
+		Counted(Counted&& aOther) noexcept : mValue(aOther.mValue) { sMoves++; }
+		Counted& operator=(Counted&& aOther) noexcept { mValue = aOther.mValue; sMoves++; return *this; }
+	};
+}
+
+TEST_CASE("slot map survives random inserts and erases", "[slot_map]")
+{
+	SlotMap<uint64_t> map;
+	std::vector<std::pair<SlotHandle, uint64_t>> live;
+	std::vector<SlotHandle> stale;
+	std::mt19937 rng(42);
+	uint64_t next = 0;
+
+	for (int step = 0; step < 100000; step++) {
+		// grows and shrinks over time so slots are reused many times
+		const bool grow = (step / 10000) % 2 == 0;
+		if (live.empty() || rng() % 100 < (grow ? 60u : 40u)) {
+			const SlotHandle handle = map.insert(next);
+			REQUIRE(map.contains(handle));
+			live.emplace_back(handle, next++);
+		}
+		else {
+			const size_t pick = rng() % live.size();
+			const auto [handle, value] = live[pick];
+			REQUIRE(*map.get(handle) == value);
+			const uint32_t moved = map.erase(handle);
+			REQUIRE(moved <= map.size());
+			stale.push_back(handle);
+			live[pick] = live.back();
+			live.pop_back();
+		}
+		REQUIRE(map.size() == live.size());
+
+		if (step % 1000 == 0) {
+			for (const auto& [handle, value] : live) {
+				REQUIRE(map.contains(handle));
+				REQUIRE(*map.get(handle) == value);
+			}
+			for (const SlotHandle& handle : stale) {
+				REQUIRE_FALSE(map.contains(handle));
+				REQUIRE(map.get(handle) == nullptr);
+				REQUIRE(map.erase(handle) == std::numeric_limits<uint32_t>::max());
+			}
+			// the dense storage and the handles agree
+			for (uint32_t i = 0; i < map.size(); i++) REQUIRE(map.get(map.handle(i)) == &map[i]);
+		}
+	}
+
+	map.clear();
+	REQUIRE(map.empty());
+	for (const auto& [handle, value] : live) REQUIRE_FALSE(map.contains(handle));
+	REQUIRE_FALSE(map.contains(SlotHandle{}));
+}
+
+TEST_CASE("slot map erase moves at most one value", "[slot_map]")
+{
+	SlotMap<Counted> map;
+	std::vector<SlotHandle> handles;
+	for (uint64_t i = 0; i < 10000; i++) handles.push_back(map.insert(Counted(i)));
+
+	std::mt19937 rng(7);
+	while (!handles.empty()) {
+		const size_t pick = rng() % handles.size();
+		const SlotHandle handle = handles[pick];
+		const uint64_t lastValue = map[map.size() - 1].mValue;
+		const SlotHandle lastHandle = map.handle(static_cast<uint32_t>(map.size() - 1));
+
+		Counted::sMoves = 0;
+		const uint32_t moved = map.erase(handle);
+		REQUIRE(Counted::sMoves <= 1);
+		if (moved < map.size()) {
+			REQUIRE(map[moved].mValue == lastValue);
+			REQUIRE(map.handle(moved) == lastHandle);
+		}
+		else REQUIRE(lastHandle == handle);
+		handles[pick] = handles.back();
+		handles.pop_back();
+	}
+	REQUIRE(map.empty());
+}
+
+TEST_CASE("slot map erase", "[slot_map][!benchmark]")
+{
+	for (const uint32_t count : { 1000u, 100000u }) {
+		BENCHMARK_ADVANCED("erase and insert, " + std::to_string(count) + " values")(Catch::Benchmark::Chronometer meter) {
+			SlotMap<uint64_t> map;
+			std::vector<SlotHandle> handles;
+			for (uint32_t i = 0; i < count; i++) handles.push_back(map.insert(i));
+			std::mt19937 rng(1);
+			meter.measure([&] {
+				const size_t pick = rng() % handles.size();
+				map.erase(handles[pick]);
+				handles[pick] = map.insert(pick);
+			});
+		};
+	}
+}
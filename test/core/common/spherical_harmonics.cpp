@@ -0,0 +1,231 @@
+#include <catch2/catch_test_macros.hpp>
+#include <tamashii/core/common/spherical_harmonics.hpp>
+
+#include <cmath>
+#include <random>
+
+T_USE_NAMESPACE
+
+namespace {
+	constexpr double PI = 3.14159265358979323846;
+
+	// EVAL_SH from assets/shader/utils/glsl/spherical_harmonics.glsl in double, the cpu basis is eval4PiNormSH
+	// (sqrt(4pi) * evalOrthonormSH) and eval2PiNormHSH (sqrt(2pi) * evalOrthonormHSH)
+	double legendre(const int aL, const int aM, const double aX)
+	{
+		double pmm = 1.0;
+		if (aM > 0) {
+			double doubleFactorial = 1.0;
+			for (int n = 2 * aM - 1; n >= 2; n -= 2) doubleFactorial *= n;
+			pmm = (aM % 2 == 0 ? 1.0 : -1.0) * doubleFactorial * std::pow(1.0 - aX * aX, aM / 2.0);
+		}
+		if (aL == aM) return pmm;
+		double pmm1 = aX * (2.0 * aM + 1.0) * pmm;
+		for (int n = aM + 2; n <= aL; n++) {
+			const double pmn = (aX * (2 * n - 1) * pmm1 - (n + aM - 1) * pmm) / (n - aM);
+			pmm = pmm1;
+			pmm1 = pmn;
+		}
+		return pmm1;
+	}
+
+	double shaderBasis(const int aL, const int aM, const double aCosTheta, const double aPhi)
+	{
+		const int absM = std::abs(aM);
+		double factorialRatio = 1.0;
+		for (int n = aL - absM + 1; n <= aL + absM; n++) factorialRatio *= n;
+		const double k = std::sqrt((2.0 * aL + 1.0) / factorialRatio) * legendre(aL, absM, aCosTheta);
+		if (aM == 0) return k;
+		return std::sqrt(2.0) * k * (aM > 0 ? std::cos(absM * aPhi) : std::sin(absM * aPhi));
+	}
+
+	glm::vec3 randomDirection(std::mt19937& aRng)
+	{
+		std::uniform_real_distribution<float> u(0, 1);
+		const float z = 2.0f * u(aRng) - 1.0f;
+		const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+		const float phi = 2.0f * static_cast<float>(PI) * u(aRng);
+		return { r * std::cos(phi), r * std::sin(phi), z };
+	}
+
+	glm::mat3 rotation(const glm::vec3& aAxis, const float aAngle)
+	{
+		const glm::vec3 a = glm::normalize(aAxis);
+		const float c = std::cos(aAngle), s = std::sin(aAngle), t = 1.0f - c;
+		return glm::mat3(glm::vec3(t * a.x * a.x + c, t * a.x * a.y + s * a.z, t * a.x * a.z - s * a.y),
+			glm::vec3(t * a.x * a.y - s * a.z, t * a.y * a.y + c, t * a.y * a.z + s * a.x),
+			glm::vec3(t * a.x * a.z + s * a.y, t * a.y * a.z - s * a.x, t * a.z * a.z + c));
+	}
+
+	bool approx(const double aValue, const double aExpected, const double aTolerance)
+	{
+		return std::abs(aValue - aExpected) <= aTolerance * std::max(1.0, std::abs(aExpected));
+	}
+}
+
+TEST_CASE("spherical harmonics match the shader basis", "[spherical_harmonics]")
+{
+	constexpr uint32_t order = 15;
+	std::mt19937 rng(5);
+	std::vector<float> sh(sh::coefficientCount(order)), hsh(sh::coefficientCount(order));
+	size_t mismatches = 0;
+	for (int i = 0; i < 1000; i++) {
+		glm::vec3 d = randomDirection(rng);
+		// poles and the horizon
+		if (i == 0) d = glm::vec3(0, 0, 1);
+		if (i == 1) d = glm::vec3(0, 0, -1);
+		if (i == 2) d = glm::vec3(0.6f, 0.8f, 0);
+		sh::evalSH(order, d, sh.data());
+		sh::evalHSH(order, d, hsh.data());
+		const double phi = std::atan2(d.y, d.x);
+		// below the horizon the hemisphere basis is clamped to theta = pi/2
+		const double hemisphereCosTheta = std::max(0.0, static_cast<double>(d.z));
+		for (int l = 0; l <= static_cast<int>(order); l++) {
+			for (int m = -l; m <= l; m++) {
+				if (!approx(sh[sh::index(l, m)], shaderBasis(l, m, d.z, phi), 1e-4)) mismatches++;
+				if (!approx(hsh[sh::index(l, m)], shaderBasis(l, m, 2.0 * hemisphereCosTheta - 1.0, phi), 1e-4)) mismatches++;
+			}
+		}
+	}
+	REQUIRE(mismatches == 0);
+
+	// the hardcoded low orders of assets/shader/sphericalharmonics/sphericalharmonics.glsl are orthonormal
+	const float norm = std::sqrt(4.0f * static_cast<float>(PI));
+	const glm::vec3 d = glm::normalize(glm::vec3(0.3f, -0.5f, 0.7f));
+	sh::evalSH(2, d, sh.data());
+	REQUIRE(approx(sh[0], norm * 0.282095, 1e-5));
+	REQUIRE(approx(sh[1], norm * -0.488603 * d.y, 1e-5));
+	REQUIRE(approx(sh[2], norm * 0.488603 * d.z, 1e-5));
+	REQUIRE(approx(sh[3], norm * -0.488603 * d.x, 1e-5));
+	REQUIRE(approx(sh[4], norm * 1.092548 * d.x * d.y, 1e-5));
+	REQUIRE(approx(sh[5], norm * -1.092548 * d.y * d.z, 1e-5));
+	REQUIRE(approx(sh[6], norm * 0.315392 * (-d.x * d.x - d.y * d.y + 2.0 * d.z * d.z), 1e-5));
+	REQUIRE(approx(sh[7], norm * -1.092548 * d.x * d.z, 1e-5));
+	REQUIRE(approx(sh[8], norm * 0.546274 * (d.x * d.x - d.y * d.y), 1e-5));
+}
+
+TEST_CASE("spherical harmonics are orthonormal", "[spherical_harmonics]")
+{
+	// midpoint rule in cos(theta) and phi, independent of the gauss-legendre rule used by the projection
+	constexpr uint32_t order = 6;
+	constexpr uint32_t count = sh::coefficientCount(order);
+	constexpr uint32_t zSteps = 2000, phiSteps = 32;
+	for (const bool hemisphere : { false, true }) {
+		std::vector<float> x, y, z;
+		for (uint32_t i = 0; i < zSteps; i++) {
+			const double cosTheta = hemisphere ? (i + 0.5) / zSteps : 2.0 * (i + 0.5) / zSteps - 1.0;
+			const double r = std::sqrt(1.0 - cosTheta * cosTheta);
+			for (uint32_t j = 0; j < phiSteps; j++) {
+				const double phi = 2.0 * PI * (j + 0.5) / phiSteps;
+				x.push_back(static_cast<float>(r * std::cos(phi)));
+				y.push_back(static_cast<float>(r * std::sin(phi)));
+				z.push_back(static_cast<float>(cosTheta));
+			}
+		}
+		const size_t n = x.size();
+		std::vector<float> basis(count * n);
+		if (hemisphere) sh::evalHSHBatch(order, x.data(), y.data(), z.data(), n, basis.data());
+		else sh::evalSHBatch(order, x.data(), y.data(), z.data(), n, basis.data());
+
+		// the basis is normalized to the area, so the mean of Y_j * Y_k is the kronecker delta
+		double maxError = 0;
+		for (uint32_t j = 0; j < count; j++) {
+			for (uint32_t k = j; k < count; k++) {
+				double sum = 0;
+				for (size_t i = 0; i < n; i++) sum += static_cast<double>(basis[j * n + i]) * basis[k * n + i];
+				maxError = std::max(maxError, std::abs(sum / n - (j == k ? 1.0 : 0.0)));
+			}
+		}
+		REQUIRE(maxError < 1e-3);
+	}
+}
+
+TEST_CASE("spherical harmonics batches match the scalar path", "[spherical_harmonics]")
+{
+	constexpr uint32_t order = 15;
+	constexpr uint32_t count = sh::coefficientCount(order);
+	std::mt19937 rng(9);
+	// a tail that does not fill a simd register, and enough directions for the parallel chunks
+	for (const size_t n : { size_t(1), size_t(1003), size_t(40005) }) {
+		std::vector<float> x(n), y(n), z(n);
+		for (size_t i = 0; i < n; i++) {
+			glm::vec3 d = randomDirection(rng);
+			if (i % 97 == 1) d = glm::vec3(0, 0, i % 2 ? 1.0f : -1.0f);
+			x[i] = d.x; y[i] = d.y; z[i] = d.z;
+		}
+		for (const bool hemisphere : { false, true }) {
+			std::vector<float> batch(count * n), scalar(count);
+			if (hemisphere) sh::evalHSHBatch(order, x.data(), y.data(), z.data(), n, batch.data());
+			else sh::evalSHBatch(order, x.data(), y.data(), z.data(), n, batch.data());
+			size_t mismatches = 0;
+			for (size_t i = 0; i < n; i++) {
+				if (hemisphere) sh::evalHSH(order, glm::vec3(x[i], y[i], z[i]), scalar.data());
+				else sh::evalSH(order, glm::vec3(x[i], y[i], z[i]), scalar.data());
+				for (uint32_t k = 0; k < count; k++) if (!approx(batch[k * n + i], scalar[k], 1e-5)) mismatches++;
+			}
+			REQUIRE(mismatches == 0);
+		}
+	}
+}
+
+TEST_CASE("spherical harmonics projection and rotation round trip", "[spherical_harmonics]")
+{
+	constexpr uint32_t order = 4;
+	constexpr uint32_t count = sh::coefficientCount(order);
+	std::mt19937 rng(13);
+	std::uniform_real_distribution<float> u(-1, 1);
+	std::vector<float> coefficients(count * 3);
+	for (float& c : coefficients) c = u(rng);
+
+	SECTION("projection") {
+		// a band limited function comes back unchanged, higher bands stay empty
+		constexpr uint32_t projectionOrder = order + 2;
+		for (const bool hemisphere : { false, true }) {
+			const glm::vec3 normal(0, 0, 1), tangent(1, 0, 0);
+			const auto func = [&](const glm::vec3& aDir) {
+				return hemisphere ? sh::evalHSHSumRGB(order, coefficients.data(), aDir, normal, tangent) : sh::evalSHSumRGB(order, coefficients.data(), aDir);
+			};
+			std::vector<float> projected;
+			if (hemisphere) sh::projectHSH(projectionOrder, func, order + projectionOrder + 1, projected);
+			else sh::projectSH(projectionOrder, func, order + projectionOrder + 1, projected);
+			REQUIRE(projected.size() == sh::coefficientCount(projectionOrder) * 3);
+			size_t mismatches = 0;
+			for (size_t i = 0; i < projected.size(); i++) {
+				if (!approx(projected[i], i < coefficients.size() ? coefficients[i] : 0.0f, 1e-4)) mismatches++;
+			}
+			REQUIRE(mismatches == 0);
+		}
+	}
+
+	SECTION("rotation") {
+		const glm::mat3 r = rotation(glm::vec3(0.2f, -0.7f, 0.4f), 1.1f);
+		const sh::Rotation forward(order, r);
+		const sh::Rotation backward(order, glm::transpose(r));
+		std::vector<float> rotated(count * 3), restored(count * 3);
+		forward.apply(coefficients.data(), rotated.data());
+		backward.apply(rotated.data(), restored.data());
+
+		size_t mismatches = 0;
+		for (uint32_t i = 0; i < count * 3; i++) if (!approx(restored[i], coefficients[i], 1e-4)) mismatches++;
+		// the rotated set evaluated in direction R * d is the input in direction d
+		for (int i = 0; i < 100; i++) {
+			const glm::vec3 d = randomDirection(rng);
+			const glm::vec3 expected = sh::evalSHSumRGB(order, coefficients.data(), d);
+			const glm::vec3 value = sh::evalSHSumRGB(order, rotated.data(), r * d);
+			for (int c = 0; c < 3; c++) if (!approx(value[c], expected[c], 1e-4)) mismatches++;
+		}
+		// bands are orthogonal matrices
+		for (uint32_t l = 0; l <= order; l++) {
+			const uint32_t size = 2 * l + 1;
+			const std::vector<float>& band = forward.band(l);
+			for (uint32_t j = 0; j < size; j++) {
+				for (uint32_t k = 0; k < size; k++) {
+					double dot = 0;
+					for (uint32_t i = 0; i < size; i++) dot += static_cast<double>(band[j * size + i]) * band[k * size + i];
+					if (!approx(dot, j == k ? 1.0 : 0.0, 1e-4)) mismatches++;
+				}
+			}
+		}
+		REQUIRE(mismatches == 0);
+	}
+}
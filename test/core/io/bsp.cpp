@@ -0,0 +1,261 @@
+#include <catch2/catch_test_macros.hpp>
+#include <tamashii/core/io/io.hpp>
+#include <tamashii/core/scene/image.hpp>
+#include <tamashii/core/scene/model.hpp>
+#include <tamashii/core/topology/topology.hpp>
+#include <tamashii/core/common/vars.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+T_USE_NAMESPACE
+
+// synthetic quake 3 maps, the loader output is compared against a serial conversion of the same lumps
+namespace {
+	struct Lump { int offset; int size; };
+	struct Header { char type[4]; int version; Lump lumps[17]; };
+	struct Face {
+		int shader, effect, type;
+		int vertexOffset, vertexCount;
+		int meshVertexOffset, meshVertexCount;
+		int lightMap;
+		int lightMapStart[2], lightMapSize[2];
+		glm::vec3 lightMapOrigin;
+		glm::vec3 lightMapVecs[2];
+		glm::vec3 normal;
+		int size[2];
+	};
+	struct Texture { char name[64]; int surface; int contents; };
+	struct Vertex {
+		glm::vec3 position;
+		glm::vec2 texCoord;
+		glm::vec2 lmCoord;
+		glm::vec3 normal;
+		unsigned char color[4];
+	};
+
+	constexpr int TEXTURES = 1;
+	constexpr int VERTEX = 10;
+	constexpr int MESHVERTEX = 11;
+	constexpr int FACE = 13;
+	constexpr int LIGHTMAP = 14;
+	constexpr size_t LIGHTMAP_BYTES = 128 * 128 * 3;
+
+	struct Map {
+		std::vector<Face> faces;
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> meshVertices;
+		std::vector<uint8_t> lightMaps;
+	};
+
+	Map randomMap(const int aFaceCount)
+	{
+		Map map;
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+		auto vertex = [&] {
+			Vertex v {};
+			v.position = { dist(rng), dist(rng), dist(rng) };
+			v.texCoord = { dist(rng), dist(rng) };
+			v.lmCoord = { dist(rng), dist(rng) };
+			v.normal = glm::normalize(glm::vec3(dist(rng), dist(rng), dist(rng)) + glm::vec3(0.01f));
+			for (unsigned char& c : v.color) c = static_cast<unsigned char>(rng());
+			return v;
+		};
+
+		for (int f = 0; f < aFaceCount; f++) {
+			Face face {};
+			face.type = 1 + f % 4;
+			face.shader = 0;
+			face.lightMap = f % 3 == 0 ? -1 : f % 2;
+			face.vertexOffset = static_cast<int>(map.vertices.size());
+			face.meshVertexOffset = static_cast<int>(map.meshVertices.size());
+			if (face.type == 2) {
+				// patches of 1x1 up to 3x2 bezier pieces
+				face.size[0] = 3 + 2 * (f % 3);
+				face.size[1] = 3 + 2 * (f % 2);
+				face.vertexCount = face.size[0] * face.size[1];
+			}
+			else face.vertexCount = 3 + f % 5;
+			for (int i = 0; i < face.vertexCount; i++) map.vertices.push_back(vertex());
+			if (face.type == 1 || face.type == 3) {
+				face.meshVertexCount = 3 * (face.vertexCount - 2);
+				for (int i = 0; i < face.vertexCount - 2; i++) map.meshVertices.insert(map.meshVertices.end(), { 0u, static_cast<uint32_t>(i + 1), static_cast<uint32_t>(i + 2) });
+			}
+			map.faces.push_back(face);
+		}
+
+		map.lightMaps.resize(2 * LIGHTMAP_BYTES);
+		for (uint8_t& b : map.lightMaps) b = static_cast<uint8_t>(rng());
+		return map;
+	}
+
+	std::string writeMap(const Map& aMap, const std::string& aName, const int aLightMapBytesMissing = 0)
+	{
+		Texture texture {};
+		std::strncpy(texture.name, "textures/does_not_exist", sizeof(texture.name) - 1);
+
+		Header header {};
+		std::memcpy(header.type, "IBSP", 4);
+		header.version = 0x2E;
+		int offset = sizeof(Header);
+		auto lump = [&](const int aIndex, const size_t aSize) {
+			header.lumps[aIndex] = { offset, static_cast<int>(aSize) };
+			offset += static_cast<int>(aSize);
+		};
+		lump(TEXTURES, sizeof(Texture));
+		lump(VERTEX, aMap.vertices.size() * sizeof(Vertex));
+		lump(MESHVERTEX, aMap.meshVertices.size() * sizeof(uint32_t));
+		lump(FACE, aMap.faces.size() * sizeof(Face));
+		lump(LIGHTMAP, aMap.lightMaps.size());
+
+		const std::string file = (std::filesystem::temp_directory_path() / aName).string();
+		std::ofstream out(file, std::ios::binary | std::ios::trunc);
+		out.write((const char*)&header, sizeof(Header));
+		out.write((const char*)&texture, sizeof(Texture));
+		out.write((const char*)aMap.vertices.data(), static_cast<std::streamsize>(aMap.vertices.size() * sizeof(Vertex)));
+		out.write((const char*)aMap.meshVertices.data(), static_cast<std::streamsize>(aMap.meshVertices.size() * sizeof(uint32_t)));
+		out.write((const char*)aMap.faces.data(), static_cast<std::streamsize>(aMap.faces.size() * sizeof(Face)));
+		out.write((const char*)aMap.lightMaps.data(), static_cast<std::streamsize>(aMap.lightMaps.size() - aLightMapBytesMissing));
+		return file;
+	}
+
+	// same arithmetic as the importer, evaluated face after face on one thread
+	Vertex operator+(const Vertex& v1, const Vertex& v2)
+	{
+		Vertex temp {};
+		temp.position = v1.position + v2.position;
+		temp.texCoord = v1.texCoord + v2.texCoord;
+		temp.lmCoord = v1.lmCoord + v2.lmCoord;
+		temp.normal = v1.normal + v2.normal;
+		return temp;
+	}
+
+	Vertex operator*(const Vertex& v1, const float& d)
+	{
+		Vertex temp {};
+		temp.position = v1.position * d;
+		temp.texCoord = v1.texCoord * d;
+		temp.lmCoord = v1.lmCoord * d;
+		temp.normal = v1.normal * d;
+		return temp;
+	}
+
+	void tesselate(const Vertex* aControl, const int aStride, const int aLevel, std::vector<Vertex>& aVertices, std::vector<uint32_t>& aIndices)
+	{
+		auto c = [&](const int aRow, const int aColumn) -> const Vertex& { return aControl[aStride * aRow + aColumn]; };
+		const auto offset = static_cast<uint32_t>(aVertices.size());
+		for (int j = 0; j <= aLevel; j++) {
+			const float a = (float)j / aLevel;
+			const float b = 1.f - a;
+			aVertices.push_back(c(0, 0) * b * b + c(1, 0) * 2 * b * a + c(2, 0) * a * a);
+		}
+		for (int i = 1; i <= aLevel; i++) {
+			const float a = (float)i / aLevel;
+			const float b = 1.f - a;
+			Vertex temp[3];
+			for (int k = 0; k < 3; k++) temp[k] = c(k, 0) * b * b + c(k, 1) * 2 * b * a + c(k, 2) * a * a;
+			for (int j = 0; j <= aLevel; j++) {
+				const float a = (float)j / aLevel;
+				const float b = 1.f - a;
+				aVertices.push_back(temp[0] * b * b + temp[1] * 2 * b * a + temp[2] * a * a);
+			}
+		}
+		const int l1 = aLevel + 1;
+		for (int i = 0; i < aLevel; i++) {
+			for (int j = 0; j < aLevel; j++) {
+				aIndices.insert(aIndices.end(), {
+					offset + i * l1 + j, offset + (i + 1) * l1 + (j + 1), offset + i * l1 + (j + 1),
+					offset + (i + 1) * l1 + (j + 1), offset + i * l1 + j, offset + (i + 1) * l1 + j });
+			}
+		}
+	}
+
+	struct Expected {
+		std::vector<vertex_s> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	std::vector<Expected> serialConversion(const Map& aMap)
+	{
+		const int level = static_cast<int>(std::max(var::bsp_patch_level.value(), 1u));
+		std::vector<Expected> result;
+		for (const Face& face : aMap.faces) {
+			std::vector<Vertex> vertices;
+			Expected e;
+			if (face.type == 1 || face.type == 3) {
+				vertices.assign(aMap.vertices.begin() + face.vertexOffset, aMap.vertices.begin() + face.vertexOffset + face.vertexCount);
+				for (int i = 0; i < face.meshVertexCount; i += 3) {
+					e.indices.push_back(aMap.meshVertices[face.meshVertexOffset + i]);
+					e.indices.push_back(aMap.meshVertices[face.meshVertexOffset + i + 2]);
+					e.indices.push_back(aMap.meshVertices[face.meshVertexOffset + i + 1]);
+				}
+			}
+			else if (face.type == 2) {
+				for (int n = 0; n < (face.size[0] - 1) / 2; n++) {
+					for (int m = 0; m < (face.size[1] - 1) / 2; m++) {
+						tesselate(&aMap.vertices[face.vertexOffset + 2 * n + face.size[0] * 2 * m], face.size[0], level, vertices, e.indices);
+					}
+				}
+			}
+			else continue;
+
+			for (const Vertex& v : vertices) {
+				vertex_s vertex {};
+				vertex.position = { v.position.x, v.position.y, v.position.z, 1 };
+				vertex.normal = { v.normal.x, v.normal.y, v.normal.z, 1 };
+				vertex.tangent = glm::vec4(topology::calcStarkTangent(v.normal), 1);
+				vertex.texture_coordinates_0 = v.texCoord;
+				vertex.texture_coordinates_1 = v.lmCoord;
+				if (face.lightMap < 0) vertex.color_0 = { v.color[0] / 255.0, v.color[1] / 255.0, v.color[2] / 255.0, v.color[3] / 255.0 };
+				else vertex.color_0 = { 1.0f, 1.0f, 1.0f, 1.0f };
+				e.vertices.push_back(vertex);
+			}
+			result.push_back(std::move(e));
+		}
+		return result;
+	}
+}
+
+TEST_CASE("bsp import matches the serial conversion bit for bit", "[bsp]")
+{
+	const Map map = randomMap(256);
+	const std::string file = writeMap(map, "tamashii_test_map.bsp");
+	const std::vector<Expected> expected = serialConversion(map);
+
+	// twice, so a scheduling dependent result would show up as a mismatch
+	for (int run = 0; run < 2; run++) {
+		const std::unique_ptr<io::SceneData> scene = io::Import::load_bsp(file);
+		REQUIRE(scene);
+		REQUIRE(scene->mModels.size() == expected.size());
+		for (size_t i = 0; i < expected.size(); i++) {
+			const Mesh& mesh = *scene->mModels[i]->getMeshList().front();
+			const std::vector<vertex_s>& vertices = *mesh.getVerticesVector();
+			REQUIRE(vertices.size() == expected[i].vertices.size());
+			REQUIRE(std::memcmp(vertices.data(), expected[i].vertices.data(), vertices.size() * sizeof(vertex_s)) == 0);
+			REQUIRE(*mesh.getIndicesVector() == expected[i].indices);
+		}
+
+		// lightmaps are expanded to rgba with an opaque alpha
+		REQUIRE(scene->mImages.size() == 2);
+		for (size_t l = 0; l < scene->mImages.size(); l++) {
+			const uint8_t* rgba = scene->mImages[l]->getData();
+			const uint8_t* rgb = map.lightMaps.data() + l * LIGHTMAP_BYTES;
+			bool equal = true;
+			for (size_t p = 0; p < 128 * 128; p++) {
+				equal &= rgba[p * 4 + 0] == rgb[p * 3 + 0] && rgba[p * 4 + 1] == rgb[p * 3 + 1] && rgba[p * 4 + 2] == rgb[p * 3 + 2] && rgba[p * 4 + 3] == 255;
+			}
+			REQUIRE(equal);
+		}
+	}
+	std::filesystem::remove(file);
+}
+
+TEST_CASE("bsp import rejects a truncated lightmap lump", "[bsp]")
+{
+	const std::string file = writeMap(randomMap(8), "tamashii_test_truncated.bsp", 100);
+	REQUIRE_FALSE(io::Import::load_bsp(file));
+	std::filesystem::remove(file);
+}
@@ -0,0 +1,178 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <tamashii/core/io/io.hpp>
+#include <tamashii/core/scene/model.hpp>
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+T_USE_NAMESPACE
+
+// the importer used to be tinyobj, its output is the reference. All coordinates are multiples of 1/8
+// so both float parsers produce the exact same values
+namespace {
+	struct GridOptions {
+		int mSize = 8;
+		bool mTexCoords = true;
+		bool mNormals = true;
+		bool mNegativeIndices = false;
+		bool mColors = false;
+	};
+
+	std::string gridObj(const GridOptions& aOptions)
+	{
+		const int n = aOptions.mSize;
+		const int row = n + 1;
+		std::ostringstream out;
+		out << "# grid " << n << "x" << n << "\no grid\n";
+		for (int y = 0; y <= n; y++) {
+			for (int x = 0; x <= n; x++) {
+				out << "v " << x * 0.125 << ' ' << y * 0.125 << ' ' << ((x * y) % 7) * 0.25;
+				if (aOptions.mColors) out << ' ' << (x % 8) * 0.125 << ' ' << (y % 8) * 0.125 << " 1";
+				out << '\n';
+			}
+		}
+		if (aOptions.mTexCoords) {
+			for (int y = 0; y <= n; y++) for (int x = 0; x <= n; x++) out << "vt " << x * 0.5 << ' ' << y * 0.5 << '\n';
+		}
+		// a few normals, so corners of one position get different vertices
+		if (aOptions.mNormals) out << "vn 0 0 1\nvn 0 1 0\nvn 1 0 0\nvn 0 0.5 0.5\n";
+
+		const int positions = row * row;
+		auto corner = [&](const int aX, const int aY) {
+			const int v = aY * row + aX + 1;
+			const int index = aOptions.mNegativeIndices && aY % 2 ? v - positions - 1 : v;
+			std::string s = std::to_string(index);
+			if (aOptions.mTexCoords || aOptions.mNormals) s += '/';
+			if (aOptions.mTexCoords) s += std::to_string(index);
+			if (aOptions.mNormals) s += '/' + std::to_string(aOptions.mNegativeIndices && aY % 2 ? (aX + aY) % 4 - 4 : (aX + aY) % 4 + 1);
+			return s;
+		};
+		for (int y = 0; y < n; y++) {
+			if (y == n / 2) out << "g second_half\n";
+			for (int x = 0; x < n; x++) {
+				out << "f " << corner(x, y) << ' ' << corner(x + 1, y) << ' ' << corner(x + 1, y + 1) << '\n';
+				out << "f " << corner(x, y) << ' ' << corner(x + 1, y + 1) << ' ' << corner(x, y + 1) << '\n';
+			}
+		}
+		return out.str();
+	}
+
+	std::string writeFile(const std::string& aName, const std::string& aContent)
+	{
+		const std::string file = (std::filesystem::temp_directory_path() / aName).string();
+		std::ofstream(file, std::ios::binary | std::ios::trunc) << aContent;
+		return file;
+	}
+
+	struct Reference {
+		tinyobj::attrib_t							mAttrib;
+		std::vector<tinyobj::index_t>				mCorners;
+	};
+
+	Reference loadTinyObj(const std::string& aFile)
+	{
+		Reference ref;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+		REQUIRE(tinyobj::LoadObj(&ref.mAttrib, &shapes, &materials, &warn, &err, aFile.c_str()));
+		for (const tinyobj::shape_t& shape : shapes) ref.mCorners.insert(ref.mCorners.end(), shape.mesh.indices.begin(), shape.mesh.indices.end());
+		return ref;
+	}
+
+	// corners resolve to the same attributes, and vertices are numbered by first occurrence of (v, vt, vn)
+	void requireEquivalent(const Mesh& aMesh, const Reference& aRef)
+	{
+		const std::vector<uint32_t>& indices = *aMesh.getIndicesVector();
+		const std::vector<vertex_s>& vertices = *aMesh.getVerticesVector();
+		const tinyobj::attrib_t& a = aRef.mAttrib;
+		REQUIRE(indices.size() == aRef.mCorners.size());
+
+		bool usesAttributes = false, allNormals = true;
+		for (const tinyobj::index_t& c : aRef.mCorners) {
+			usesAttributes |= c.texcoord_index >= 0 || c.normal_index >= 0;
+			allNormals &= c.normal_index >= 0;
+		}
+		std::map<std::tuple<int, int, int>, uint32_t> firstOccurrence;
+		size_t mismatches = 0;
+		for (size_t i = 0; i < indices.size(); i++) {
+			const tinyobj::index_t& c = aRef.mCorners[i];
+			const auto next = static_cast<uint32_t>(firstOccurrence.size());
+			const uint32_t expected = usesAttributes ? firstOccurrence.try_emplace({ c.vertex_index, c.texcoord_index, c.normal_index }, next).first->second : c.vertex_index;
+			if (indices[i] != expected) { mismatches++; continue; }
+
+			const vertex_s& v = vertices[indices[i]];
+			const size_t p = c.vertex_index;
+			if (v.position != glm::vec4(a.vertices[3 * p], a.vertices[3 * p + 1], a.vertices[3 * p + 2], 1)) mismatches++;
+			const glm::vec4 color = a.colors.empty() ? glm::vec4(1) : glm::vec4(a.colors[3 * p], a.colors[3 * p + 1], a.colors[3 * p + 2], 1);
+			if (v.color_0 != color) mismatches++;
+			if (c.texcoord_index >= 0) {
+				const size_t t = c.texcoord_index;
+				if (v.texture_coordinates_0 != glm::vec2(a.texcoords[2 * t], a.texcoords[2 * t + 1])) mismatches++;
+			}
+			if (allNormals) {
+				const size_t n = c.normal_index;
+				if (v.normal != glm::vec4(a.normals[3 * n], a.normals[3 * n + 1], a.normals[3 * n + 2], 0)) mismatches++;
+			}
+		}
+		REQUIRE(mismatches == 0);
+		REQUIRE(vertices.size() == (usesAttributes ? firstOccurrence.size() : a.vertices.size() / 3));
+	}
+
+	void requireEquivalent(const std::string& aName, const GridOptions& aOptions)
+	{
+		const std::string file = writeFile(aName, gridObj(aOptions));
+		const std::unique_ptr<Mesh> mesh = io::Import::load_obj_mesh(file);
+		REQUIRE(mesh);
+		requireEquivalent(*mesh, loadTinyObj(file));
+		std::filesystem::remove(file);
+	}
+}
+
+TEST_CASE("obj import matches tinyobj", "[obj]")
+{
+	SECTION("positions only") { requireEquivalent("tamashii_test_positions.obj", { 8, false, false }); }
+	SECTION("texture coordinates and normals") { requireEquivalent("tamashii_test_full.obj", { 8, true, true }); }
+	SECTION("normals only") { requireEquivalent("tamashii_test_normals.obj", { 8, false, true }); }
+	SECTION("negative indices") { requireEquivalent("tamashii_test_negative.obj", { 8, true, true, true }); }
+	SECTION("vertex colors") { requireEquivalent("tamashii_test_colors.obj", { 8, true, false, false, true }); }
+	// larger than one parse chunk and enough corners for the sharded deduplication
+	SECTION("many chunks") { requireEquivalent("tamashii_test_large.obj", { 400, true, true, true }); }
+}
+
+TEST_CASE("obj import triangulates polygons as a fan", "[obj]")
+{
+	const std::string file = writeFile("tamashii_test_polygon.obj", "v 0 0 0\nv 1 0 0\nv 2 1 0\nv 1 2 0\nv 0 1 0\nf 1 2 3 4 5\n");
+	const std::unique_ptr<Mesh> mesh = io::Import::load_obj_mesh(file);
+	REQUIRE(mesh);
+	REQUIRE(*mesh->getIndicesVector() == std::vector<uint32_t>{ 0, 1, 2, 0, 2, 3, 0, 3, 4 });
+	std::filesystem::remove(file);
+}
+
+TEST_CASE("obj import rejects broken faces", "[obj]")
+{
+	const std::string file = writeFile("tamashii_test_broken.obj", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n");
+	REQUIRE_FALSE(io::Import::load_obj_mesh(file));
+	std::filesystem::remove(file);
+}
+
+TEST_CASE("obj import throughput", "[obj][!benchmark]")
+{
+	const std::string file = writeFile("tamashii_bench.obj", gridObj({ 500, true, true }));
+	// the tamashii loader also computes tangents, tinyobj stops after parsing
+	BENCHMARK("tamashii") { return io::Import::load_obj_mesh(file); };
+	BENCHMARK("tinyobj") {
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+		return tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, file.c_str());
+	};
+	std::filesystem::remove(file);
+}
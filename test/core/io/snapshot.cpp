@@ -0,0 +1,127 @@
+#include <catch2/catch_test_macros.hpp>
+#include <tamashii/core/io/snapshot.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+T_USE_NAMESPACE
+
+namespace {
+	constexpr uint32_t CHUNK_SIZE = 1024;
+
+	struct Data {
+		std::vector<float>		mSmooth;	// compresses
+		std::vector<float>		mNoise;		// does not, chunks are stored raw
+	};
+
+	Data testData()
+	{
+		Data data;
+		std::mt19937 rng(17);
+		std::uniform_real_distribution<float> u(0, 1);
+		// several chunks, the last one partial
+		for (int i = 0; i < 5000; i++) data.mSmooth.push_back(std::floor(std::sin(i * 0.01f) * 16.0f) / 16.0f);
+		for (int i = 0; i < 3001; i++) data.mNoise.push_back(u(rng));
+		return data;
+	}
+
+	std::string writeSnapshot(const std::string& aName, const Data& aData, const io::Snapshot::Compression aCompression)
+	{
+		const std::string file = (std::filesystem::temp_directory_path() / aName).string();
+		const std::vector<io::Snapshot::Section> sections = {
+			{ "noise", aData.mNoise.data(), aData.mNoise.size() * sizeof(float), sizeof(float) },
+			{ "smooth", aData.mSmooth.data(), aData.mSmooth.size() * sizeof(float), sizeof(float) },
+			{ "empty", nullptr, 0, sizeof(float) }
+		};
+		REQUIRE(io::Snapshot::write(file, { { "vertex_count", 5000 }, { "sh_order", 2 } }, sections, aCompression, CHUNK_SIZE));
+		return file;
+	}
+
+	std::vector<float> readSection(const io::Snapshot& aSnapshot, const std::string& aSection)
+	{
+		std::vector<float> out(aSnapshot.size(aSection) / sizeof(float));
+		REQUIRE(aSnapshot.read(aSection, out.data(), out.size() * sizeof(float)));
+		return out;
+	}
+}
+
+TEST_CASE("snapshot round trip", "[snapshot]")
+{
+	const Data data = testData();
+	for (const io::Snapshot::Compression compression : { io::Snapshot::Compression::NONE, io::Snapshot::Compression::DEFLATE }) {
+		const bool compressed = compression == io::Snapshot::Compression::DEFLATE;
+		const std::string file = writeSnapshot(compressed ? "tamashii_test_compressed.snap" : "tamashii_test_raw.snap", data, compression);
+		{
+			io::Snapshot snapshot;
+			REQUIRE(snapshot.open(file));
+			REQUIRE(snapshot.meta("vertex_count") == 5000u);
+			REQUIRE(snapshot.meta("sh_order") == 2u);
+			REQUIRE_FALSE(snapshot.meta("basis").has_value());
+			REQUIRE(snapshot.has("smooth"));
+			REQUIRE_FALSE(snapshot.has("target"));
+			REQUIRE(snapshot.size("smooth") == data.mSmooth.size() * sizeof(float));
+
+			REQUIRE(readSection(snapshot, "smooth") == data.mSmooth);
+			REQUIRE(readSection(snapshot, "noise") == data.mNoise);
+			REQUIRE(readSection(snapshot, "empty").empty());
+			std::vector<float> wrongSize(data.mNoise.size() - 1);
+			REQUIRE_FALSE(snapshot.read("noise", wrongSize.data(), wrongSize.size() * sizeof(float)));
+
+			if (compressed) REQUIRE(snapshot.view("smooth") == nullptr);
+			else {
+				// uncompressed sections are used in place
+				const void* view = snapshot.view("smooth");
+				REQUIRE(view);
+				REQUIRE(reinterpret_cast<uintptr_t>(view) % 64 == 0);
+				REQUIRE(std::memcmp(view, data.mSmooth.data(), data.mSmooth.size() * sizeof(float)) == 0);
+			}
+		}
+		if (compressed) {
+			// compression paid off for the smooth section only
+			const uintmax_t raw = std::filesystem::file_size(writeSnapshot("tamashii_test_raw.snap", data, io::Snapshot::Compression::NONE));
+			REQUIRE(std::filesystem::file_size(file) < raw - data.mSmooth.size() * sizeof(float) / 2);
+			std::filesystem::remove((std::filesystem::temp_directory_path() / "tamashii_test_raw.snap").string());
+		}
+		std::filesystem::remove(file);
+	}
+}
+
+TEST_CASE("snapshot rejects a truncated file", "[snapshot]")
+{
+	const Data data = testData();
+	for (const io::Snapshot::Compression compression : { io::Snapshot::Compression::NONE, io::Snapshot::Compression::DEFLATE }) {
+		const std::string file = writeSnapshot("tamashii_test_truncated.snap", data, compression);
+		const uintmax_t size = std::filesystem::file_size(file);
+		// in the chunk data and in the header
+		for (const uintmax_t cut : { size - 1, uintmax_t(100), uintmax_t(10) }) {
+			std::filesystem::resize_file(file, cut);
+			io::Snapshot snapshot;
+			REQUIRE_FALSE(snapshot.open(file));
+			REQUIRE_FALSE(snapshot.has("smooth"));
+		}
+		std::filesystem::remove(file);
+	}
+}
+
+TEST_CASE("snapshot reports a corrupt chunk", "[snapshot]")
+{
+	const Data data = testData();
+	const std::string file = writeSnapshot("tamashii_test_corrupt.snap", data, io::Snapshot::Compression::DEFLATE);
+	{
+		// the file ends with the last deflated chunk of the smooth section, overwrite its checksum
+		std::fstream f(file, std::ios::binary | std::ios::in | std::ios::out);
+		f.seekp(-4, std::ios::end);
+		f.write("\xde\xad\xbe\xef", 4);
+	}
+	io::Snapshot snapshot;
+	REQUIRE(snapshot.open(file));
+	std::vector<float> out(data.mSmooth.size());
+	REQUIRE_FALSE(snapshot.read("smooth", out.data(), out.size() * sizeof(float)));
+	// the other sections are still readable
+	REQUIRE(readSection(snapshot, "noise") == data.mNoise);
+	snapshot.close();
+	std::filesystem::remove(file);
+}
@@ -0,0 +1,96 @@
+#include <catch2/catch_test_macros.hpp>
+#include <tamashii/core/scene/model.hpp>
+
+#include <utility>
+
+T_USE_NAMESPACE
+
+namespace {
+	std::unique_ptr<Model> triangleModel()
+	{
+		auto model = Model::alloc("triangle");
+		std::shared_ptr mesh = Mesh::alloc("triangle");
+		std::vector<vertex_s>& vertices = mesh->getVerticesVectorRef();
+		vertices.resize(3);
+		vertices[0].position = glm::vec4(0, 0, 0, 1);
+		vertices[1].position = glm::vec4(1, 0, 0, 1);
+		vertices[2].position = glm::vec4(0, 1, 0, 1);
+		mesh->getIndicesVectorRef() = { 0, 1, 2 };
+		model->addMesh(mesh);
+		return model;
+	}
+}
+
+TEST_CASE("copied models share mesh data", "[mesh]")
+{
+	const std::unique_ptr<Model> original = triangleModel();
+	const Mesh& originalMesh = *original->getMeshList().front();
+
+	std::vector<Model> copies;
+	copies.reserve(100);
+	for (int i = 0; i < 100; i++) copies.emplace_back(*original);
+
+	// reading through const meshes must not allocate new storage
+	for (const Model& copy : copies) {
+		const Mesh& mesh = *copy.getMeshList().front();
+		REQUIRE(mesh.sharesGeometryWith(originalMesh));
+		REQUIRE(mesh.getVerticesArray() == originalMesh.getVerticesArray());
+		REQUIRE(mesh.getIndicesArray() == originalMesh.getIndicesArray());
+		REQUIRE(mesh.getVerticesArray()[1].position.x == 1.0f);
+	}
+}
+
+TEST_CASE("writes through a copy do not reach the other copies", "[mesh]")
+{
+	const std::unique_ptr<Model> original = triangleModel();
+	std::vector<Model> copies;
+	copies.reserve(100);
+	for (int i = 0; i < 100; i++) copies.emplace_back(*original);
+	const Mesh& originalMesh = *original->getMeshList().front();
+
+	Mesh& written = *copies[42].getMeshList().front();
+	written.getVerticesVectorRef()[0].color_0 = glm::vec4(1, 0, 0, 1);
+	(*written.getVerticesVector())[1].position.x = 5.0f;
+	written.getVerticesArray()[2].normal = glm::vec4(0, 0, 1, 0);
+	written.getIndicesVectorRef()[0] = 2;
+	written.getIndicesArray()[2] = 0;
+
+	REQUIRE_FALSE(written.sharesGeometryWith(originalMesh));
+	REQUIRE(std::as_const(written).getVerticesArray()[1].position.x == 5.0f);
+	REQUIRE(*std::as_const(written).getIndicesVector() == std::vector<uint32_t>{ 2, 1, 0 });
+	auto unchanged = [](const Mesh& aMesh) {
+		const vertex_s* vertices = aMesh.getVerticesArray();
+		return vertices[0].color_0 == glm::vec4(0) && vertices[1].position.x == 1.0f && vertices[2].normal == glm::vec4(0)
+			&& *aMesh.getIndicesVector() == std::vector<uint32_t>{ 0, 1, 2 };
+	};
+	REQUIRE(unchanged(originalMesh));
+	for (size_t i = 0; i < copies.size(); i++) {
+		if (i == 42) continue;
+		const Mesh& mesh = *copies[i].getMeshList().front();
+		REQUIRE(unchanged(mesh));
+		REQUIRE(mesh.sharesGeometryWith(originalMesh));
+	}
+
+	// a mesh that owns its data alone writes in place
+	const vertex_s* vertices = std::as_const(written).getVerticesArray();
+	written.getVerticesVectorRef()[0].color_0 = glm::vec4(0, 1, 0, 1);
+	REQUIRE(std::as_const(written).getVerticesArray() == vertices);
+}
+
+TEST_CASE("detaching before parallel writes", "[mesh]")
+{
+	const std::unique_ptr<Model> original = triangleModel();
+	Model copy(*original);
+	Mesh& originalMesh = *original->getMeshList().front();
+	Mesh& copiedMesh = *copy.getMeshList().front();
+
+	// only the vertices are detached, the indices stay shared
+	copiedMesh.detachVertices();
+	REQUIRE(std::as_const(copiedMesh).getVerticesArray() != std::as_const(originalMesh).getVerticesArray());
+	REQUIRE(std::as_const(copiedMesh).getIndicesArray() == std::as_const(originalMesh).getIndicesArray());
+
+	// after detaching, the non const getters return the same storage every time
+	const vertex_s* vertices = copiedMesh.getVerticesArray();
+	REQUIRE(copiedMesh.getVerticesArray() == vertices);
+	REQUIRE(copiedMesh.getVerticesVector()->data() == vertices);
+}
@@ -0,0 +1,219 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <tamashii/core/scene/render_scene.hpp>
+#include <tamashii/core/scene/scene_graph.hpp>
+#include <tamashii/core/scene/model.hpp>
+#include <tamashii/core/scene/light.hpp>
+#include <tamashii/core/scene/ref_entities.hpp>
+#include <tamashii/core/io/io.hpp>
+
+#include <algorithm>
+#include <random>
+
+T_USE_NAMESPACE
+
+namespace {
+	// a chain of aDepth nodes with aInstances model nodes below the last one, if aAnimated the
+	// second node of the chain moves and everything below it with it
+	void buildDeepScene(io::SceneData& aData, const uint32_t aDepth, const uint32_t aInstances, const bool aAnimated)
+	{
+		const std::shared_ptr<Model> model = Model::alloc("empty");
+		aData.mModels.push_back(model);
+		aData.mCycleTime = 1.0f;
+
+		std::shared_ptr<Node> root = Node::alloc("root");
+		Node* node = root.get();
+		for (uint32_t i = 0; i < aDepth; i++) {
+			node = &node->addChildNode("chain");
+			node->setTranslation(glm::vec3(0, 1, 0));
+			if (aAnimated && i == 1) node->setTranslationAnimation(TRS::Interpolation::LINEAR, { 0.0f, 1.0f }, { glm::vec3(0), glm::vec3(1) });
+		}
+		for (uint32_t i = 0; i < aInstances; i++) {
+			Node& instance = node->addChildNode("instance");
+			instance.setTranslation(glm::vec3(static_cast<float>(i), 0, 0));
+			instance.setModel(model);
+		}
+		aData.mSceneGraphs.push_back(root);
+	}
+}
+
+TEST_CASE("refs see the transforms above them", "[scene]")
+{
+	io::SceneData data;
+	buildDeepScene(data, 8, 4, true);
+	RenderScene scene;
+	scene.initFromData(data);
+
+	REQUIRE(scene.getModelList().size() == 4);
+	for (const std::shared_ptr<RefModel>& ref : scene.getModelList()) {
+		const std::vector<TRS*> transforms = scene.getTransforms(*ref);
+		REQUIRE(transforms.size() == 9);
+		REQUIRE(transforms.front() == &data.mSceneGraphs.front()->getChildNode(0).getTRS());
+		REQUIRE(ref->animated);
+	}
+
+	scene.readyToRender(true);
+	scene.update(500.0f);
+	for (const std::shared_ptr<RefModel>& ref : scene.getModelList()) {
+		glm::mat4 expected(1.0f);
+		for (const TRS* trs : scene.getTransforms(*ref)) expected *= trs->getMatrix(0.5f);
+		REQUIRE(ref->model_matrix == expected);
+	}
+}
+
+TEST_CASE("transform nodes of removed refs are reused", "[scene]")
+{
+	RenderScene scene;
+	const std::shared_ptr<Model> model = Model::alloc("empty");
+
+	const std::shared_ptr<RefModel> first = scene.addModelRef(model, glm::vec3(1, 0, 0));
+	const std::shared_ptr<RefModel> second = scene.addModelRef(model, glm::vec3(2, 0, 0));
+	const int node = first->transform_node;
+	scene.removeModel(first);
+	REQUIRE(first->transform_node == -1);
+
+	// adding and removing refs does not grow the transform nodes
+	for (int i = 0; i < 1000; i++) {
+		const std::shared_ptr<RefModel> ref = scene.addModelRef(model, glm::vec3(3, 0, 0));
+		REQUIRE(ref->transform_node == node);
+		REQUIRE(scene.getTransforms(*ref).size() == 1);
+		scene.removeModel(ref);
+	}
+	REQUIRE(scene.getTransforms(*second).size() == 1);
+	REQUIRE(scene.getTransforms(*second).front()->translation == glm::vec3(2, 0, 0));
+}
+
+TEST_CASE("refs survive random adds and removes", "[scene]")
+{
+	RenderScene scene;
+	std::vector<std::shared_ptr<Model>> models;
+	std::vector<std::shared_ptr<Light>> lights;
+	for (int i = 0; i < 8; i++) models.push_back(Model::alloc("model"));
+	for (int i = 0; i < 4; i++) lights.push_back(std::make_shared<PointLight>());
+
+	std::vector<std::shared_ptr<RefModel>> liveModels, removedModels;
+	std::vector<std::shared_ptr<RefLight>> liveLights, removedLights;
+	std::vector<SlotHandle> staleModels, staleLights;
+	std::mt19937 rng(23);
+	size_t indexMismatches = 0, staleHits = 0, assetMismatches = 0;
+
+	// asset lists hold an asset exactly once while refs use it
+	auto checkAssets = [&](const auto& aAssets, const auto& aLive, const auto& aList, auto aGet) {
+		for (const auto& asset : aAssets) {
+			const bool used = std::any_of(aLive.begin(), aLive.end(), [&](const auto& aRef) { return aGet(*aRef) == asset; });
+			if (std::count(aList.begin(), aList.end(), asset) != (used ? 1 : 0)) assetMismatches++;
+		}
+	};
+
+	for (int step = 0; step < 100000; step++) {
+		// grows and shrinks, so slots are reused many times
+		const bool grow = (step / 2000) % 2 == 0;
+		const uint32_t op = rng() % 100;
+		if (op < 45) {
+			if (liveModels.empty() || rng() % 100 < (grow ? 60u : 40u)) liveModels.push_back(scene.addModelRef(models[rng() % models.size()]));
+			else {
+				const size_t pick = rng() % liveModels.size();
+				scene.removeModel(liveModels[pick]);
+				staleModels.push_back(liveModels[pick]->handle);
+				removedModels.push_back(liveModels[pick]);
+				liveModels[pick] = liveModels.back();
+				liveModels.pop_back();
+			}
+		}
+		else if (op < 90) {
+			if (liveLights.empty() || rng() % 100 < (grow ? 60u : 40u)) liveLights.push_back(scene.addLightRef(lights[rng() % lights.size()]));
+			else {
+				const size_t pick = rng() % liveLights.size();
+				scene.removeLight(liveLights[pick]);
+				staleLights.push_back(liveLights[pick]->handle);
+				removedLights.push_back(liveLights[pick]);
+				liveLights[pick] = liveLights.back();
+				liveLights.pop_back();
+			}
+		}
+		// removing a ref a second time is ignored
+		else if (op < 95 && !removedModels.empty()) scene.removeModel(removedModels[rng() % removedModels.size()]);
+		else if (!removedLights.empty()) scene.removeLight(removedLights[rng() % removedLights.size()]);
+
+		const std::deque<std::shared_ptr<RefModel>>& modelList = scene.getModelList();
+		const std::deque<std::shared_ptr<RefLight>>& lightList = scene.getLightList();
+		REQUIRE(modelList.size() == liveModels.size());
+		REQUIRE(lightList.size() == liveLights.size());
+		for (size_t i = 0; i < modelList.size(); i++) if (modelList[i]->ref_model_index != static_cast<int>(i)) indexMismatches++;
+		for (size_t i = 0; i < lightList.size(); i++) if (lightList[i]->ref_light_index != static_cast<int>(i)) indexMismatches++;
+		if (!staleModels.empty() && scene.getModelRef(staleModels.back())) staleHits++;
+		if (!staleLights.empty() && scene.getLightRef(staleLights.back())) staleHits++;
+
+		const SceneBackendData data = scene.getSceneData();
+		checkAssets(models, liveModels, data.models, [](const RefModel& aRef) { return aRef.model; });
+		// the light list is only reachable through the scene info, which also writes back every transform
+		if (step % 100 == 0) checkAssets(lights, liveLights, scene.getSceneInfo().mLights, [](const RefLight& aRef) { return aRef.light; });
+
+		if (step % 5000 == 0) {
+			for (const std::shared_ptr<RefModel>& ref : liveModels) if (scene.getModelRef(ref->handle) != ref) staleHits++;
+			for (const std::shared_ptr<RefLight>& ref : liveLights) if (scene.getLightRef(ref->handle) != ref) staleHits++;
+			for (const SlotHandle& handle : staleModels) if (scene.getModelRef(handle)) staleHits++;
+			for (const SlotHandle& handle : staleLights) if (scene.getLightRef(handle)) staleHits++;
+			for (const std::shared_ptr<RefModel>& ref : removedModels) if (ref->ref_model_index != -1 || ref->transform_node != -1) indexMismatches++;
+			for (const std::shared_ptr<RefLight>& ref : removedLights) if (ref->ref_light_index != -1 || ref->transform_node != -1) indexMismatches++;
+			REQUIRE(indexMismatches == 0);
+			REQUIRE(staleHits == 0);
+			REQUIRE(assetMismatches == 0);
+		}
+	}
+	REQUIRE(indexMismatches == 0);
+	REQUIRE(staleHits == 0);
+	REQUIRE(assetMismatches == 0);
+}
+
+TEST_CASE("scene update", "[scene][!benchmark]")
+{
+	constexpr uint32_t depth = 64;
+	constexpr uint32_t instances = 8192;
+
+	io::SceneData staticData;
+	buildDeepScene(staticData, depth, instances, false);
+	RenderScene staticScene;
+	staticScene.initFromData(staticData);
+	staticScene.readyToRender(true);
+
+	io::SceneData animatedData;
+	buildDeepScene(animatedData, depth, instances, true);
+	RenderScene animatedScene;
+	animatedScene.initFromData(animatedData);
+	animatedScene.readyToRender(true);
+
+	// only the nodes below the animation are recomputed, a static scene costs a walk over the refs
+	BENCHMARK("static") { staticScene.update(16.0f); };
+	BENCHMARK("animated") { animatedScene.update(16.0f); };
+	BENCHMARK("edited") {
+		staticScene.requestTransformUpdate();
+		staticScene.update(16.0f);
+	};
+}
+
+TEST_CASE("scene ref insert and erase", "[scene][!benchmark]")
+{
+	RenderScene scene;
+	const std::shared_ptr<Model> model = Model::alloc("empty");
+	const std::shared_ptr<Light> light = std::make_shared<PointLight>();
+	std::vector<std::shared_ptr<RefModel>> models;
+	std::vector<std::shared_ptr<RefLight>> lights;
+	for (int i = 0; i < 10000; i++) {
+		models.push_back(scene.addModelRef(model));
+		lights.push_back(scene.addLightRef(light));
+	}
+
+	// removing from the middle of the lists used to reindex every ref behind it
+	std::mt19937 rng(5);
+	BENCHMARK("model") {
+		const size_t pick = rng() % models.size();
+		scene.removeModel(models[pick]);
+		models[pick] = scene.addModelRef(model);
+	};
+	BENCHMARK("light") {
+		const size_t pick = rng() % lights.size();
+		scene.removeLight(lights[pick]);
+		lights[pick] = scene.addLightRef(light);
+	};
+}
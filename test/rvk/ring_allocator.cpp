@@ -0,0 +1,124 @@
+#include <catch2/catch_test_macros.hpp>
+#include <rvk/parts/ring_allocator.hpp>
+
+#include <deque>
+#include <random>
+
+using namespace rvk;
+
+namespace {
+	// stands in for the gpu, fence values complete in order
+	struct FakeFences {
+		uint64_t mCompleted = 0;
+
+		void complete(const uint64_t aValue) { mCompleted = aValue; }
+		[[nodiscard]] std::function<bool(uint64_t)> signaled() const { return [this](const uint64_t aValue) { return aValue <= mCompleted; }; }
+	};
+}
+
+TEST_CASE("ring allocator wraps around", "[ring_allocator]")
+{
+	RingAllocator ring(100);
+	FakeFences fences;
+
+	REQUIRE(ring.allocate(40, 1, 1) == 0);
+	REQUIRE(ring.allocate(40, 1, 2) == 40);
+	// 20 left at the end, nothing free at the start yet
+	REQUIRE(ring.allocate(30, 1, 3) == RingAllocator::INVALID);
+
+	fences.complete(1);
+	ring.retire(fences.signaled());
+	REQUIRE(ring.used() == 40);
+	REQUIRE(ring.allocate(30, 1, 3) == 0);
+	// the skipped end of the range belongs to the wrapped region
+	REQUIRE(ring.used() == 90);
+	REQUIRE(ring.allocate(10, 1, 3) == 30);
+	REQUIRE(ring.allocate(1, 1, 3) == RingAllocator::INVALID);
+
+	fences.complete(2);
+	ring.retire(fences.signaled());
+	REQUIRE(ring.used() == 60);
+	fences.complete(3);
+	ring.retire(fences.signaled());
+	REQUIRE(ring.empty());
+	REQUIRE(ring.used() == 0);
+}
+
+TEST_CASE("ring allocator retires in order", "[ring_allocator]")
+{
+	RingAllocator ring(64);
+	REQUIRE(ring.allocate(16, 1, 1) == 0);
+	REQUIRE(ring.allocate(16, 1, 2) == 16);
+
+	// a younger fence does not free anything while an older one is pending
+	ring.retire([](const uint64_t aValue) { return aValue == 2; });
+	REQUIRE(ring.used() == 32);
+	ring.retire([](const uint64_t aValue) { return aValue == 1 || aValue == 2; });
+	REQUIRE(ring.empty());
+	// an empty ring starts over at the beginning
+	REQUIRE(ring.allocate(16, 1, 3) == 0);
+}
+
+TEST_CASE("ring allocator aligns regions", "[ring_allocator]")
+{
+	RingAllocator ring(64);
+	REQUIRE(ring.allocate(3, 16, 1) == 0);
+	REQUIRE(ring.allocate(8, 16, 1) == 16);
+	// the padding is part of the region
+	REQUIRE(ring.used() == 24);
+	REQUIRE(ring.allocate(8, 0, 1) == 24);
+	REQUIRE(ring.allocate(40, 16, 1) == RingAllocator::INVALID);
+}
+
+TEST_CASE("ring allocator full ring", "[ring_allocator]")
+{
+	RingAllocator ring(100);
+	FakeFences fences;
+
+	REQUIRE(ring.allocate(0, 1, 1) == RingAllocator::INVALID);
+	REQUIRE(ring.allocate(101, 1, 1) == RingAllocator::INVALID);
+	REQUIRE(ring.allocate(100, 1, 1) == 0);
+	REQUIRE(ring.used() == ring.capacity());
+	REQUIRE(ring.allocate(1, 1, 2) == RingAllocator::INVALID);
+
+	ring.retire(fences.signaled());
+	REQUIRE_FALSE(ring.empty());
+	fences.complete(1);
+	ring.retire(fences.signaled());
+	REQUIRE(ring.empty());
+	REQUIRE(ring.allocate(100, 1, 2) == 0);
+
+	ring.reset(50);
+	REQUIRE(ring.empty());
+	REQUIRE(ring.capacity() == 50);
+	REQUIRE(ring.allocate(100, 1, 1) == RingAllocator::INVALID);
+}
+
+TEST_CASE("ring allocator regions never overlap", "[ring_allocator]")
+{
+	constexpr uint64_t capacity = 4096;
+	RingAllocator ring(capacity);
+	FakeFences fences;
+	struct Live { uint64_t mOffset, mSize, mFence; };
+	std::deque<Live> live;
+	std::mt19937 rng(3);
+
+	for (uint64_t frame = 1; frame < 5000; frame++) {
+		for (uint32_t i = rng() % 4; i > 0; i--) {
+			const uint64_t size = 1 + rng() % 700;
+			const uint64_t alignment = 1ull << (rng() % 5);
+			const uint64_t offset = ring.allocate(size, alignment, frame);
+			if (offset == RingAllocator::INVALID) continue;
+			REQUIRE(offset % alignment == 0);
+			REQUIRE(offset + size <= capacity);
+			for (const Live& l : live) REQUIRE((offset + size <= l.mOffset || l.mOffset + l.mSize <= offset));
+			live.push_back({ offset, size, frame });
+		}
+		REQUIRE(ring.used() <= capacity);
+		// the gpu lags a few frames behind
+		if (frame > 3 && rng() % 3) fences.complete(frame - 3);
+		ring.retire(fences.signaled());
+		while (!live.empty() && live.front().mFence <= fences.mCompleted) live.pop_front();
+		REQUIRE(ring.empty() == live.empty());
+	}
+}